@@ -0,0 +1,69 @@
+#ifndef H_ATOMICCOUNTER
+#define H_ATOMICCOUNTER
+
+#include <atomic>
+
+using namespace std;
+
+/**
+ * @brief A counter that one thread at a time updates while any thread reads it without a lock, e.g. a
+ * metrics scraper polling while queries run. Updates are serialized by the owner of the counter, so
+ * they are a relaxed load and store instead of a locked read-modify-write, and reads never tear.
+ * 
+ * @tparam T The integer type counted.
+ */
+template <typename T>
+class AtomicCounter {
+  private:
+    atomic<T> value; // current count
+
+  public:
+    /**
+     * @brief Construct a counter starting at zero.
+     * 
+     */
+    AtomicCounter() : value(0) {}
+
+    AtomicCounter(const AtomicCounter&) = delete;
+    AtomicCounter& operator=(const AtomicCounter&) = delete;
+
+    /**
+     * @brief Sets the count.
+     * 
+     * @param newValue The new count.
+     * @return AtomicCounter& This counter.
+     */
+    AtomicCounter& operator=(T newValue) {
+      value.store(newValue, memory_order_relaxed);
+      return *this;
+    }
+
+    /**
+     * @brief Reads the count, safe from any thread.
+     * 
+     * @return T The current count.
+     */
+    operator T() const {
+      return value.load(memory_order_relaxed);
+    }
+
+    AtomicCounter& operator+=(T delta) {
+      value.store(value.load(memory_order_relaxed) + delta, memory_order_relaxed);
+      return *this;
+    }
+
+    AtomicCounter& operator-=(T delta) {
+      value.store(value.load(memory_order_relaxed) - delta, memory_order_relaxed);
+      return *this;
+    }
+
+    AtomicCounter& operator++() {
+      return *this += 1;
+    }
+
+    AtomicCounter& operator--() {
+      return *this -= 1;
+    }
+};
+
+#endif
@@ -0,0 +1,1231 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <thread>
+#include <mutex>
+#include <set>
+#include <cmath>
+#include <cfloat>
+
+#include "benchmark.h"
+#include "bplustree.h"
+#include "storage.h"
+#include "block.h"
+#include "constants.h"
+#include "perfcounters.h"
+#include "blocklayout.h"
+#include "threadpool.h"
+#include "learnedindex.h"
+#include "shardedindex.h"
+#include "scanengine.h"
+#include "queryplanner.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// function declarations
+double timeInserts(Storage* disk, NumVotesIndex* bPlusTree);
+double timeBatchInserts(Storage* disk, NumVotesIndex* bPlusTree, uint batchSize);
+void printThroughput(const string& label, uint numberOfRecords, double elapsedMs, NumVotesIndex* bPlusTree);
+void copyRecords(Storage* disk, Storage* copy);
+uint countRecords(Storage* disk);
+vector<double> timeDeletes(Storage* copy, NumVotesIndex* bPlusTree, int minimumNumVotes);
+void printDeleteLatencies(const string& label, vector<double>& latenciesUs);
+void printPurge(const string& label, double elapsedMs, const DeleteSummary& summary, Storage* copy, NumVotesIndex* bPlusTree);
+void checkRangeDeletesAtTinyFanout(Storage* disk, uint blockSize, uint maxBlkPtrs, uint maxRecords);
+vector<int> sampleNumVotes(Storage* disk, uint numberOfKeys);
+void printCountersPerOperation(const string& operation, uint numberOfOperations, double elapsedMs, const CounterReadings& readings);
+long getHardwareSize(int sysconfName);
+void printCacheAndPageSizes();
+double timeShardedLoad(const vector<Record>& records, ShardedIndex* shardedIndex, uint numberOfThreads);
+void printScanLayout(const string& label, Storage* layout, uint blockSize);
+vector<int> pickAbsentNumVotes(Storage* disk, uint numberOfKeys);
+double timeLookups(NumVotesIndex* bPlusTree, const vector<int>& keys, uint& keysFound);
+ScanAggregate scanRecordByRecord(Storage* disk, const ScanPredicate& predicate);
+
+/**
+ * @brief Inserts every record on disk into the tree and times it, including flushing any buffered inserts.
+ * 
+ * @param disk The storage holding the records to index.
+ * @param bPlusTree The empty tree to insert into.
+ * @return double Time taken in milliseconds.
+ */
+double timeInserts(Storage* disk, NumVotesIndex* bPlusTree) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      bPlusTree->insertKey(record.__numVotes, blockPtr);
+    }
+  }
+  bPlusTree->flushAllBuffers(); // the inserts only count as done once they reached the leaves
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  return chrono::duration<double, milli>(end - start).count();
+}
+
+/**
+ * @brief Inserts every record on disk into the tree in batches and times it.
+ * 
+ * @param disk The storage holding the records to index.
+ * @param bPlusTree The empty tree to insert into.
+ * @param batchSize Records per batch.
+ * @return double Time taken in milliseconds.
+ */
+double timeBatchInserts(Storage* disk, NumVotesIndex* bPlusTree, uint batchSize) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<pair<int, Block*>> batch;
+  batch.reserve(batchSize);
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      batch.push_back(make_pair(record.__numVotes, blockPtr));
+      if (batch.size() == batchSize) {
+        bPlusTree->insertBatch(batch);
+        batch.clear();
+      }
+    }
+  }
+  bPlusTree->insertBatch(batch);
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  return chrono::duration<double, milli>(end - start).count();
+}
+
+/**
+ * @brief Prints the throughput of one run.
+ * 
+ * @param label Name of the tree configuration.
+ * @param numberOfRecords Records inserted.
+ * @param elapsedMs Time taken in milliseconds.
+ * @param bPlusTree The tree built.
+ */
+void printThroughput(const string& label, uint numberOfRecords, double elapsedMs, NumVotesIndex* bPlusTree) {
+  cout << label << ": " << elapsedMs << "ms, " << uint(numberOfRecords / (elapsedMs / 1000)) << " inserts/s, "
+       << bPlusTree->getNumberOfNodesInTree() << " nodes, height " << bPlusTree->getTreeHeight() << endl;
+}
+
+void runInsertThroughputBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Insert Throughput Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+
+  uint numberOfRecords = countRecords(disk);
+  if (numberOfRecords == 0) {
+    cout << "No records to insert. Check that the data file exists." << endl;
+    return;
+  }
+  cout << "Inserting " << numberOfRecords << " records into a numVotes index with " << blockSize << "B nodes..." << endl;
+
+  NumVotesIndex unbufferedTree(maxKeys, maxBlkPtrs);
+  printThroughput("Inserting into the leaves", numberOfRecords, timeInserts(disk, &unbufferedTree), &unbufferedTree);
+
+  // a buffer holding one block worth of (key, block pointer) messages, then larger buffers
+  uint insertsPerBlock = blockSize / (sizeof(int) + SIZE_OF_POINTER);
+  for (uint blocksPerBuffer = 1; blocksPerBuffer <= 16; blocksPerBuffer *= 4) {
+    NumVotesIndex bufferedTree(maxKeys, maxBlkPtrs);
+    bufferedTree.enableBufferedInserts(insertsPerBlock * blocksPerBuffer);
+    double elapsedMs = timeInserts(disk, &bufferedTree);
+    printThroughput("Buffering " + to_string(insertsPerBlock * blocksPerBuffer) + " inserts per node", numberOfRecords, elapsedMs, &bufferedTree);
+  }
+
+  // sorted batches, a single batch of every record is as close as the tree gets to a bulk load
+  for (uint batchSize = 1000; batchSize < numberOfRecords; batchSize *= 10) {
+    NumVotesIndex batchTree(maxKeys, maxBlkPtrs);
+    printThroughput("Batches of " + to_string(batchSize) + " inserts", numberOfRecords, timeBatchInserts(disk, &batchTree, batchSize), &batchTree);
+  }
+  NumVotesIndex bulkTree(maxKeys, maxBlkPtrs);
+  printThroughput("One batch of every insert", numberOfRecords, timeBatchInserts(disk, &bulkTree, numberOfRecords), &bulkTree);
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Inserts every record on disk into another storage, which indexes them.
+ * 
+ * @param disk The storage holding the records to copy.
+ * @param copy The empty storage to copy into.
+ */
+void copyRecords(Storage* disk, Storage* copy) {
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      copy->insertRecord(record);
+    }
+  }
+}
+
+/**
+ * @brief Counts the records stored in every block.
+ * 
+ * @param disk The storage to count.
+ * @return uint The number of records stored.
+ */
+uint countRecords(Storage* disk) {
+  uint numberOfRecords = 0;
+  for (auto blockPtr: disk->__blocks) {
+    numberOfRecords += blockPtr->getNumberOfRecordsInBlock();
+  }
+  return numberOfRecords;
+}
+
+/**
+ * @brief Prints the time taken and what one purge freed.
+ * 
+ * @param label Name of the delete path.
+ * @param elapsedMs Time taken in milliseconds.
+ * @param summary What the purge deleted.
+ * @param copy The storage purged.
+ * @param bPlusTree The numVotes index of the storage purged.
+ */
+void printPurge(const string& label, double elapsedMs, const DeleteSummary& summary, Storage* copy, NumVotesIndex* bPlusTree) {
+  cout << label << ": " << elapsedMs << "ms, " << summary.recordsDeleted << " records, "
+       << summary.nodesDeleted << " tree nodes and " << summary.dataBlocksFreed << " data blocks freed, "
+       << bPlusTree->getNumberOfNodesInTree() << " nodes and " << copy->getNumberOfBlocksInStorage() << " blocks left" << endl;
+}
+
+void runPurgeBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs, uint maxRecords, int minimumNumVotes) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Purge Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (disk->getNumberOfBlocksInStorage() == 0) {
+    cout << "No records to delete. Check that the data file exists." << endl;
+    return;
+  }
+  cout << "Deleting every title with fewer than " << minimumNumVotes << " votes..." << endl;
+
+  Storage keyByKeyDisk(blockSize, DISK_CAPACITY, maxRecords);
+  NumVotesIndex keyByKeyTree(maxKeys, maxBlkPtrs);
+  keyByKeyDisk.attachNumVotesIndex(&keyByKeyTree);
+  copyRecords(disk, &keyByKeyDisk);
+
+  // every single key delete reports itself, keep that out of the output and the timing
+  ostringstream discardedOutput;
+  streambuf* coutBuffer = cout.rdbuf(discardedOutput.rdbuf());
+  DeleteSummary keyByKeySummary;
+  uint recordsBefore = countRecords(&keyByKeyDisk);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (auto& keyAndOverflowBlock: keyByKeyTree.getOverflowBlocksOfRange(0, minimumNumVotes - 1)) {
+    ++keyByKeySummary.keysDeleted;
+    keyByKeySummary.nodesDeleted += keyByKeyDisk.deleteRecordsByNumVotes(keyAndOverflowBlock.first);
+  }
+  keyByKeySummary.dataBlocksFreed = keyByKeyDisk.releaseEmptyBlocks();
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  cout.rdbuf(coutBuffer);
+  keyByKeySummary.recordsDeleted = recordsBefore - countRecords(&keyByKeyDisk);
+  printPurge("One key at a time", chrono::duration<double, milli>(end - start).count(), keyByKeySummary, &keyByKeyDisk, &keyByKeyTree);
+
+  Storage rangeDisk(blockSize, DISK_CAPACITY, maxRecords);
+  NumVotesIndex rangeTree(maxKeys, maxBlkPtrs);
+  rangeDisk.attachNumVotesIndex(&rangeTree);
+  copyRecords(disk, &rangeDisk);
+  start = chrono::steady_clock::now();
+  DeleteSummary rangeSummary = rangeDisk.deleteRecordsByNumVotesRange(0, minimumNumVotes - 1);
+  end = chrono::steady_clock::now();
+  printPurge("One range delete", chrono::duration<double, milli>(end - start).count(), rangeSummary, &rangeDisk, &rangeTree);
+  checkRangeDeletesAtTinyFanout(disk, blockSize, maxBlkPtrs, maxRecords);
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Deletes numVotes ranges one after another from a copy of the records indexed with 3 keys per node,
+ * where merges cascade through most levels, and checks that no node is left underfull after any of them.
+ * 
+ * @param disk The storage holding the records to copy, it is left untouched.
+ * @param blockSize User specified block size.
+ * @param maxBlkPtrs Maximum number of pointers per overflow block.
+ * @param maxRecords Maximum number of records per data block.
+ */
+void checkRangeDeletesAtTinyFanout(Storage* disk, uint blockSize, uint maxBlkPtrs, uint maxRecords) {
+  Storage copy(blockSize, DISK_CAPACITY, maxRecords);
+  NumVotesIndex tinyTree(3, maxBlkPtrs);
+  copy.attachNumVotesIndex(&tinyTree);
+  copyRecords(disk, &copy);
+
+  // ranges of 1 to 25 keys spread over the key space, each starting at a key still in the tree
+  uint numberOfRanges = 200;
+  uint rangesLeavingUnderfullNodes = 0;
+  DeleteSummary totalSummary;
+  for (uint range = 0; range < numberOfRanges; ++range) {
+    vector<pair<int, OverflowBlock*>> keys = tinyTree.getOverflowBlocksOfRange(INT_MIN, INT_MAX);
+    if (keys.empty()) {
+      break;
+    }
+    uint firstKeyIdx = (unsigned long long) range * 7919 % keys.size();
+    uint lastKeyIdx = min((uint) keys.size() - 1, firstKeyIdx + range % 25);
+    DeleteSummary summary = copy.deleteRecordsByNumVotesRange(keys[firstKeyIdx].first, keys[lastKeyIdx].first);
+    totalSummary.recordsDeleted += summary.recordsDeleted;
+    totalSummary.nodesDeleted += summary.nodesDeleted;
+    rangesLeavingUnderfullNodes += tinyTree.getNumberOfUnderfullNodes() > 0;
+  }
+  cout << "Range deletes with 3 keys per node: " << numberOfRanges << " ranges, " << totalSummary.recordsDeleted << " records and "
+       << totalSummary.nodesDeleted << " tree nodes deleted, " << rangesLeavingUnderfullNodes << " ranges left underfull nodes"
+       << (rangesLeavingUnderfullNodes == 0 ? "" : ", NODES UNDERFULL")
+       << (tinyTree.getNumberOfRecordsIndexed() == countRecords(&copy) ? "" : ", RECORDS DIFFER") << endl;
+}
+
+/**
+ * @brief Deletes the records of every numVotes given one key at a time and times every delete.
+ * 
+ * @param copy The storage to delete from.
+ * @param keys The numVotes to delete, in the order they are deleted.
+ * @return vector<double> Time taken by every delete in microseconds.
+ */
+vector<double> timeDeletes(Storage* copy, const vector<int>& keys) {
+  vector<double> latenciesUs;
+  ostringstream discardedOutput;
+  streambuf* coutBuffer = cout.rdbuf(discardedOutput.rdbuf());
+  for (int key: keys) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    copy->deleteRecordsByNumVotes(key);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    latenciesUs.push_back(chrono::duration<double, micro>(end - start).count());
+  }
+  cout.rdbuf(coutBuffer);
+  return latenciesUs;
+}
+
+/**
+ * @brief Prints the median, 99th percentile and slowest delete.
+ * 
+ * @param label Name of the delete mode.
+ * @param latenciesUs Time taken by every delete in microseconds, sorted in place.
+ */
+void printDeleteLatencies(const string& label, vector<double>& latenciesUs) {
+  if (latenciesUs.empty()) {
+    cout << label << ": no keys deleted" << endl;
+    return;
+  }
+  sort(latenciesUs.begin(), latenciesUs.end());
+  cout << label << ": " << latenciesUs.size() << " deletes, p50 " << latenciesUs[latenciesUs.size() / 2]
+       << "us, p99 " << latenciesUs[latenciesUs.size() * 99 / 100] << "us, max " << latenciesUs.back() << "us" << endl;
+}
+
+void runDeleteLatencyBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs, uint maxRecords, int minimumNumVotes) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Delete Latency Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (disk->getNumberOfBlocksInStorage() == 0) {
+    cout << "No records to delete. Check that the data file exists." << endl;
+    return;
+  }
+  cout << "Deleting every title with fewer than " << minimumNumVotes << " votes one key at a time, then every other numVotes above..." << endl;
+
+  Storage eagerDisk(blockSize, DISK_CAPACITY, maxRecords);
+  NumVotesIndex eagerTree(maxKeys, maxBlkPtrs);
+  eagerDisk.attachNumVotesIndex(&eagerTree);
+  copyRecords(disk, &eagerDisk);
+  // the purged numVotes hold many records each, those above hold a few, so their deletes are mostly the work on the tree
+  vector<int> purgedKeys;
+  vector<int> sparseKeys;
+  uint keysAbove = 0;
+  for (auto& keyAndOverflowBlock: eagerTree.getOverflowBlocksOfRange(INT_MIN, INT_MAX)) {
+    if (keyAndOverflowBlock.first < minimumNumVotes) {
+      purgedKeys.push_back(keyAndOverflowBlock.first);
+    } else if (keysAbove++ % 2 == 0) {
+      sparseKeys.push_back(keyAndOverflowBlock.first);
+    }
+  }
+  vector<double> eagerLatenciesUs = timeDeletes(&eagerDisk, purgedKeys);
+  printDeleteLatencies("Rebalancing on delete", eagerLatenciesUs);
+  vector<double> eagerSparseLatenciesUs = timeDeletes(&eagerDisk, sparseKeys);
+  printDeleteLatencies("Rebalancing on delete, every other numVotes above", eagerSparseLatenciesUs);
+
+  // maintenance merges the nodes below the B+ Tree minimum, so both trees end up alike
+  Storage lazyDisk(blockSize, DISK_CAPACITY, maxRecords);
+  ThreadPool scheduler(1); // runs the maintenance passes, destroyed after the tree it maintains
+  NumVotesIndex lazyTree(maxKeys, maxBlkPtrs);
+  lazyDisk.attachNumVotesIndex(&lazyTree);
+  copyRecords(disk, &lazyDisk);
+  lazyTree.enableLazyDeletes(0.5, 0.5, 10, scheduler);
+  vector<double> lazyLatenciesUs = timeDeletes(&lazyDisk, purgedKeys);
+  printDeleteLatencies("Lazy deletes, maintenance every 10ms", lazyLatenciesUs);
+  vector<double> lazySparseLatenciesUs = timeDeletes(&lazyDisk, sparseKeys);
+  printDeleteLatencies("Lazy deletes, every other numVotes above", lazySparseLatenciesUs);
+  lazyTree.printMaintenanceBatches();
+
+  cout << "Lazily deleted tree before its next maintenance pass:" << endl;
+  lazyTree.printTreeHealth();
+  lazyTree.disableLazyDeletes();
+  cout << "Lazily deleted tree after maintenance:" << endl;
+  lazyTree.printTreeHealth();
+  cout << "Tree rebalanced on delete:" << endl;
+  eagerTree.printTreeHealth();
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Picks numVotes spread evenly over the records on disk, in the order they were stored.
+ * 
+ * @param disk The storage holding the records.
+ * @param numberOfKeys Number of numVotes to pick.
+ * @return vector<int> The numVotes picked, fewer if there are fewer records.
+ */
+vector<int> sampleNumVotes(Storage* disk, uint numberOfKeys) {
+  vector<int> allNumVotes;
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      allNumVotes.push_back(record.__numVotes);
+    }
+  }
+  if (allNumVotes.size() <= numberOfKeys) {
+    return allNumVotes;
+  }
+  vector<int> sampledNumVotes;
+  sampledNumVotes.reserve(numberOfKeys);
+  for (uint i = 0; i < numberOfKeys; ++i) {
+    sampledNumVotes.push_back(allNumVotes[(unsigned long long) i * allNumVotes.size() / numberOfKeys]);
+  }
+  return sampledNumVotes;
+}
+
+/**
+ * @brief Prints the time and the hardware events of one loop of operations, per operation.
+ * 
+ * @param operation Name of the operation looped over.
+ * @param numberOfOperations Operations in the loop.
+ * @param elapsedMs Time taken by the loop in milliseconds.
+ * @param readings What the counters counted over the loop.
+ */
+void printCountersPerOperation(const string& operation, uint numberOfOperations, double elapsedMs, const CounterReadings& readings) {
+  if (numberOfOperations == 0) {
+    cout << operation << ": no operations run" << endl;
+    return;
+  }
+  cout << operation << ": " << numberOfOperations << " operations, " << elapsedMs * 1000 / numberOfOperations << "us";
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    cout << ", ";
+    if (readings.isCounted[counter]) {
+      cout << (double) readings.values[counter] / numberOfOperations;
+    } else {
+      cout << "n/a";
+    }
+    cout << " " << PerfCounters::getCounterName((HardwareCounter) counter);
+  }
+  cout << " per operation" << endl;
+}
+
+void runHardwareCounterBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Hardware Counter Benchmark, " << blockSize << "B nodes of up to " << maxKeys
+       << " keys:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  uint numberOfRecords = countRecords(disk);
+  if (numberOfRecords == 0) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+
+  PerfCounters perfCounters;
+  if (!perfCounters.isAvailable()) {
+    cout << "Hardware counters unavailable (" << perfCounters.getUnavailableReason()
+         << "), a virtual machine may not expose them and /proc/sys/kernel/perf_event_paranoid may forbid them. Reporting time only." << endl;
+  } else if (!perfCounters.getUnavailableReason().empty()) {
+    cout << "Some hardware counters are unavailable (" << perfCounters.getUnavailableReason() << ")." << endl;
+  }
+  vector<int> searchKeys = sampleNumVotes(disk, 10000);
+  vector<int> rangeStartKeys = sampleNumVotes(disk, 1000);
+
+  NumVotesIndex bPlusTree(maxKeys, maxBlkPtrs);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  perfCounters.start();
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      bPlusTree.insertKey(record.__numVotes, blockPtr);
+    }
+  }
+  CounterReadings readings = perfCounters.stop();
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  printCountersPerOperation("insertKey", numberOfRecords, chrono::duration<double, milli>(end - start).count(), readings);
+
+  // the queries report the nodes they access, which is counted too but written nowhere
+  ostringstream discardedOutput;
+  streambuf* coutBuffer = cout.rdbuf(discardedOutput.rdbuf());
+  start = chrono::steady_clock::now();
+  perfCounters.start();
+  for (int key: searchKeys) {
+    bPlusTree.searchQuery(key);
+  }
+  readings = perfCounters.stop();
+  end = chrono::steady_clock::now();
+  cout.rdbuf(coutBuffer);
+  printCountersPerOperation("searchQuery", searchKeys.size(), chrono::duration<double, milli>(end - start).count(), readings);
+
+  coutBuffer = cout.rdbuf(discardedOutput.rdbuf());
+  start = chrono::steady_clock::now();
+  perfCounters.start();
+  for (int key: rangeStartKeys) {
+    bPlusTree.rangeQuery(key, key + 100);
+  }
+  readings = perfCounters.stop();
+  end = chrono::steady_clock::now();
+  cout.rdbuf(coutBuffer);
+  printCountersPerOperation("rangeQuery of 100 numVotes", rangeStartKeys.size(), chrono::duration<double, milli>(end - start).count(), readings);
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Get a cache or page size of this hardware.
+ * 
+ * @param sysconfName The sysconf name of the size.
+ * @return long The size in bytes, 0 where it is unknown.
+ */
+long getHardwareSize(int sysconfName) {
+#if defined(__linux__) || defined(__APPLE__)
+  long size = sysconf(sysconfName);
+  return size > 0 ? size : 0;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Prints the cache line, cache and page sizes a node size could be matched to, where known.
+ * 
+ */
+void printCacheAndPageSizes() {
+  vector<pair<string, long>> sizes;
+#if defined(__linux__) || defined(__APPLE__)
+  sizes.push_back(make_pair("page", getHardwareSize(_SC_PAGESIZE)));
+#endif
+#ifdef _SC_LEVEL1_DCACHE_LINESIZE
+  sizes.push_back(make_pair("cache line", getHardwareSize(_SC_LEVEL1_DCACHE_LINESIZE)));
+  sizes.push_back(make_pair("L1d cache", getHardwareSize(_SC_LEVEL1_DCACHE_SIZE)));
+  sizes.push_back(make_pair("L2 cache", getHardwareSize(_SC_LEVEL2_CACHE_SIZE)));
+  sizes.push_back(make_pair("L3 cache", getHardwareSize(_SC_LEVEL3_CACHE_SIZE)));
+#endif
+  cout << "Hardware:";
+  for (auto& nameAndSize: sizes) {
+    cout << " " << nameAndSize.first << " ";
+    if (nameAndSize.second == 0) {
+      cout << "unknown";
+    } else {
+      cout << nameAndSize.second << "B";
+    }
+    cout << (&nameAndSize == &sizes.back() ? "" : ",");
+  }
+  cout << (sizes.empty() ? " sizes unknown" : "") << endl;
+}
+
+void runNodeSizeSweepBenchmark(Storage* disk) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Node Size Sweep Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  uint numberOfRecords = countRecords(disk);
+  if (numberOfRecords == 0) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+  printCacheAndPageSizes();
+  long pageSize = 0;
+#if defined(__linux__) || defined(__APPLE__)
+  pageSize = getHardwareSize(_SC_PAGESIZE);
+#endif
+
+  // the lookups that print nothing, so the time is the tree's alone
+  vector<int> lookupKeys = sampleNumVotes(disk, 10000);
+  vector<int> rangeStartKeys = sampleNumVotes(disk, 1000);
+  uint lookupRepetitions = 5;
+  uint fastestInsertSize = 0, fastestLookupSize = 0, fastestRangeSize = 0;
+  double fastestInsertUs = 0, fastestLookupUs = 0, fastestRangeUs = 0;
+
+  for (uint nodeSize = 256; nodeSize <= 64 * KB; nodeSize *= 2) {
+    uint maxKeys = calulateMaximumKeysInBPTreeNode(nodeSize);
+    NumVotesIndex bPlusTree(maxKeys, getMaxBlkPtrsInOverflowBlock(nodeSize));
+    double insertUs = timeInserts(disk, &bPlusTree) * 1000 / numberOfRecords;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint keysFound = 0;
+    for (uint repetition = 0; repetition < lookupRepetitions; ++repetition) {
+      for (int key: lookupKeys) {
+        keysFound += bPlusTree.getOverflowBlockOfKey(key) != nullptr;
+      }
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double lookupUs = chrono::duration<double, micro>(end - start).count() / (lookupRepetitions * lookupKeys.size());
+
+    start = chrono::steady_clock::now();
+    uint keysScanned = 0;
+    for (int key: rangeStartKeys) {
+      keysScanned += bPlusTree.getOverflowBlocksOfRange(key, key + 100).size();
+    }
+    end = chrono::steady_clock::now();
+    double rangeUs = chrono::duration<double, micro>(end - start).count() / rangeStartKeys.size();
+
+    cout << nodeSize << "B nodes" << (nodeSize == pageSize ? " (page)" : "") << ": fanout " << maxKeys + 1
+         << ", height " << bPlusTree.getTreeHeight() << ", " << bPlusTree.getNumberOfNodesInTree() << " nodes, "
+         << insertUs << "us per insert, " << lookupUs << "us per lookup, " << rangeUs << "us per range of 100 numVotes ("
+         << keysFound / lookupRepetitions << " keys found, " << keysScanned << " keys scanned)" << endl;
+
+    if (fastestInsertSize == 0 || insertUs < fastestInsertUs) {
+      fastestInsertSize = nodeSize;
+      fastestInsertUs = insertUs;
+    }
+    if (fastestLookupSize == 0 || lookupUs < fastestLookupUs) {
+      fastestLookupSize = nodeSize;
+      fastestLookupUs = lookupUs;
+    }
+    if (fastestRangeSize == 0 || rangeUs < fastestRangeUs) {
+      fastestRangeSize = nodeSize;
+      fastestRangeUs = rangeUs;
+    }
+  }
+  cout << "Fastest inserts with " << fastestInsertSize << "B nodes, lookups with " << fastestLookupSize
+       << "B nodes, range scans with " << fastestRangeSize << "B nodes." << endl;
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+void runParallelRangeScanBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint maxThreads) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Parallel Range Scan Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (maxThreads == 0) {
+    maxThreads = thread::hardware_concurrency() == 0 ? 1 : thread::hardware_concurrency();
+  }
+  cout << "Hardware threads: " << thread::hardware_concurrency() << ", timing up to " << maxThreads << " threads" << endl;
+
+  vector<pair<int, int>> ranges = {make_pair(0, INT_MAX), make_pair(1000, 100000), make_pair(30000, 40000)};
+  uint repetitions = 5;
+  for (auto& range: ranges) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    IndexAggregate serialAggregate;
+    for (uint repetition = 0; repetition < repetitions; ++repetition) {
+      serialAggregate = bPlusTree->rangeQueryAggregate(range.first, range.second);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double serialMs = chrono::duration<double, milli>(end - start).count() / repetitions;
+    cout << "numVotes " << range.first << " to " << range.second << ": " << serialAggregate.totalRecords << " records in "
+         << serialAggregate.dataBlocksAccessed << " data block accesses, 1 thread without partitions " << serialMs << "ms" << endl;
+
+    for (uint numberOfThreads = 1; numberOfThreads <= maxThreads; numberOfThreads *= 2) {
+      ThreadPool threadPool(numberOfThreads);
+      start = chrono::steady_clock::now();
+      IndexAggregate parallelAggregate;
+      for (uint repetition = 0; repetition < repetitions; ++repetition) {
+        parallelAggregate = bPlusTree->parallelRangeQueryAggregate(range.first, range.second, threadPool);
+      }
+      end = chrono::steady_clock::now();
+      double parallelMs = chrono::duration<double, milli>(end - start).count() / repetitions;
+      cout << "  " << numberOfThreads << " thread" << (numberOfThreads == 1 ? "" : "s") << ": " << parallelMs << "ms, speedup "
+           << serialMs / parallelMs << ", " << threadPool.getNumberOfTasksRun() << " tasks run, " << threadPool.getNumberOfSteals()
+           << " stolen" << (parallelAggregate.totalRecords == serialAggregate.totalRecords ? "" : ", RECORDS DIFFER") << endl;
+      if (numberOfThreads * 2 > maxThreads && numberOfThreads != maxThreads) {
+        numberOfThreads = maxThreads / 2; // finish with the largest pool asked for
+      }
+    }
+  }
+
+  vector<int> lookupKeys = sampleNumVotes(disk, 100000);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  uint serialKeysFound = 0;
+  for (int key: lookupKeys) {
+    serialKeysFound += bPlusTree->getOverflowBlockOfKey(key) != nullptr;
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  double serialMs = chrono::duration<double, milli>(end - start).count();
+  cout << "Batch of " << lookupKeys.size() << " lookups: 1 thread key by key " << serialMs << "ms" << endl;
+  for (uint numberOfThreads = 1; numberOfThreads <= maxThreads; numberOfThreads *= 2) {
+    ThreadPool threadPool(numberOfThreads);
+    start = chrono::steady_clock::now();
+    vector<OverflowBlock*> overflowBlocks = bPlusTree->searchBatch(lookupKeys, threadPool);
+    end = chrono::steady_clock::now();
+    double parallelMs = chrono::duration<double, milli>(end - start).count();
+    uint keysFound = overflowBlocks.size() - count(overflowBlocks.begin(), overflowBlocks.end(), nullptr);
+    cout << "  " << numberOfThreads << " thread" << (numberOfThreads == 1 ? "" : "s") << ": " << parallelMs << "ms, speedup "
+         << serialMs / parallelMs << ", " << threadPool.getNumberOfTasksRun() << " tasks run, " << threadPool.getNumberOfSteals()
+         << " stolen" << (keysFound == serialKeysFound ? "" : ", KEYS FOUND DIFFER") << endl;
+    if (numberOfThreads * 2 > maxThreads && numberOfThreads != maxThreads) {
+      numberOfThreads = maxThreads / 2; // finish with the largest pool asked for
+    }
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+void runLearnedIndexBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize, uint maxBlkPtrs) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Learned Index Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  vector<int> lookupKeys = sampleNumVotes(disk, 100000);
+  vector<int> rangeStartKeys = sampleNumVotes(disk, 1000);
+  if (lookupKeys.empty()) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+
+  TreeStatistics treeStatistics = bPlusTree->getStatistics(blockSize);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  uint treeKeysFound = 0;
+  for (int key: lookupKeys) {
+    treeKeysFound += bPlusTree->getOverflowBlockOfKey(key) != nullptr;
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  double treeLookupUs = chrono::duration<double, micro>(end - start).count() / lookupKeys.size();
+  start = chrono::steady_clock::now();
+  uint treeKeysInRanges = 0;
+  for (int key: rangeStartKeys) {
+    treeKeysInRanges += bPlusTree->getOverflowBlocksOfRange(key, key + 100).size();
+  }
+  end = chrono::steady_clock::now();
+  double treeRangeUs = chrono::duration<double, micro>(end - start).count() / rangeStartKeys.size();
+  cout << "B+ Tree: " << treeStatistics.numberOfKeys << " keys, height " << treeStatistics.height << ", nodes take "
+       << treeStatistics.nodes.heapBytes << "B, overflow blocks " << treeStatistics.overflowBlocks.heapBytes << "B, lookup "
+       << treeLookupUs << "us, range of 100 numVotes " << treeRangeUs << "us" << endl;
+
+  for (uint maxError: {4, 16, 64}) {
+    LearnedIndex learnedIndex(maxError, maxBlkPtrs);
+    start = chrono::steady_clock::now();
+    learnedIndex.build(disk);
+    end = chrono::steady_clock::now();
+    double buildMs = chrono::duration<double, milli>(end - start).count();
+
+    start = chrono::steady_clock::now();
+    uint keysFound = 0;
+    for (int key: lookupKeys) {
+      keysFound += learnedIndex.getOverflowBlockOfKey(key) != nullptr;
+    }
+    end = chrono::steady_clock::now();
+    double lookupUs = chrono::duration<double, micro>(end - start).count() / lookupKeys.size();
+    start = chrono::steady_clock::now();
+    uint keysInRanges = 0;
+    for (int key: rangeStartKeys) {
+      keysInRanges += learnedIndex.getOverflowBlocksOfRange(key, key + 100).size();
+    }
+    end = chrono::steady_clock::now();
+    double rangeUs = chrono::duration<double, micro>(end - start).count() / rangeStartKeys.size();
+
+    cout << "Learned index, max error " << maxError << ": segments per level";
+    for (uint segments: learnedIndex.getSegmentsPerLevel()) {
+      cout << " " << segments;
+    }
+    cout << ", keys and models take " << learnedIndex.getIndexSizeInBytes() << "B ("
+         << (double) learnedIndex.getIndexSizeInBytes() / treeStatistics.nodes.heapBytes << "x the nodes), overflow blocks "
+         << learnedIndex.getOverflowBlocksSizeInBytes() << "B, built in " << buildMs << "ms, lookup " << lookupUs
+         << "us (" << treeLookupUs / lookupUs << "x), range of 100 numVotes " << rangeUs << "us (" << treeRangeUs / rangeUs << "x)"
+         << (keysFound == treeKeysFound && keysInRanges == treeKeysInRanges && learnedIndex.getNumberOfKeys() == treeStatistics.numberOfKeys
+             ? "" : ", KEYS FOUND DIFFER") << endl;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+void runFrozenLevelsBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Frozen Internal Levels Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  vector<int> lookupKeys = sampleNumVotes(disk, 100000);
+  vector<int> rangeStartKeys = sampleNumVotes(disk, 1000);
+  if (lookupKeys.empty()) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+  TreeStatistics treeStatistics = bPlusTree->getStatistics(blockSize);
+  cout << "B+ Tree: height " << treeStatistics.height << ", nodes take " << treeStatistics.nodes.heapBytes << "B" << endl;
+
+  // the same loops run on the nodes, then on the frozen levels
+  for (uint pass = 0; pass < 2; ++pass) {
+    if (pass == 1) {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      bPlusTree->freezeInternalLevels();
+      chrono::steady_clock::time_point end = chrono::steady_clock::now();
+      FrozenLevels<int>* frozenLevels = bPlusTree->getFrozenLevels();
+      cout << "Froze " << frozenLevels->getNumberOfLevels() << " internal levels into " << frozenLevels->getSizeInBytes()
+           << "B in " << chrono::duration<double, milli>(end - start).count() << "ms, huge pages "
+           << (frozenLevels->isHugePageBackingEnabled() ? "advised" : "not used") << endl;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint keysFound = 0;
+    for (int key: lookupKeys) {
+      keysFound += bPlusTree->getOverflowBlockOfKey(key) != nullptr;
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double lookupUs = chrono::duration<double, micro>(end - start).count() / lookupKeys.size();
+    start = chrono::steady_clock::now();
+    uint keysInRanges = 0;
+    for (int key: rangeStartKeys) {
+      keysInRanges += bPlusTree->getOverflowBlocksOfRange(key, key + 100).size();
+    }
+    end = chrono::steady_clock::now();
+    double rangeUs = chrono::duration<double, micro>(end - start).count() / rangeStartKeys.size();
+    cout << (pass == 0 ? "Nodes" : "Frozen levels") << ": lookup " << lookupUs << "us, range of 100 numVotes " << rangeUs
+         << "us, " << keysFound << " keys found, " << keysInRanges << " keys in ranges" << endl;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+void runSnapshotScanBenchmark(Storage* disk, uint maxKeys, uint maxBlkPtrs) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Snapshot Scan Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  vector<pair<Block*, Record>> records;
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      records.push_back(make_pair(blockPtr, record));
+    }
+  }
+  if (records.empty()) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+  NumVotesIndex bPlusTree(maxKeys, maxBlkPtrs, false, true);
+  for (auto& blockAndRecord: records) {
+    bPlusTree.insertKey(blockAndRecord.second.__numVotes, blockAndRecord.first, IncludedColumns(blockAndRecord.second));
+  }
+  bPlusTree.enableSnapshots(1000000);
+
+  IndexAggregate baseline = bPlusTree.rangeQueryAggregate(0, INT_MAX);
+  ull snapshot = bPlusTree.takeSnapshot();
+  cout << "Snapshot " << snapshot << " taken of " << baseline.totalRecords << " records, average rating "
+       << baseline.totalRating / baseline.totalRecords << endl;
+
+  // the writer removes records and inserts copies of others while the snapshot is scanned
+  uint numberOfChanges = min((uint) records.size(), (uint) 20000);
+  bool isWriterDone = false;
+  mutex writerMutex;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  thread writer([&]() {
+    for (uint i = 0; i < numberOfChanges; ++i) {
+      pair<Block*, Record>& removed = records[(ull) i * 7919 % records.size()];
+      bPlusTree.removeBlockPointerFromKey(removed.second.__numVotes, removed.first, IncludedColumns(removed.second));
+      pair<Block*, Record>& copied = records[(ull) i * 104729 % records.size()];
+      bPlusTree.insertKey(copied.second.__numVotes, copied.first, IncludedColumns(copied.second));
+    }
+    lock_guard<mutex> writerLock(writerMutex);
+    isWriterDone = true;
+  });
+  uint scans = 0;
+  uint scansDiffering = 0;
+  double totalScanMs = 0;
+  while (true) {
+    {
+      lock_guard<mutex> writerLock(writerMutex);
+      if (isWriterDone && scans > 0) {
+        break;
+      }
+    }
+    chrono::steady_clock::time_point scanStart = chrono::steady_clock::now();
+    IndexAggregate aggregate = bPlusTree.snapshotRangeQueryAggregate(snapshot, 0, INT_MAX);
+    totalScanMs += chrono::duration<double, milli>(chrono::steady_clock::now() - scanStart).count();
+    ++scans;
+    scansDiffering += aggregate.totalRecords != baseline.totalRecords || abs(aggregate.totalRating - baseline.totalRating) > 1e-3;
+  }
+  writer.join();
+  double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  IndexAggregate live = bPlusTree.rangeQueryAggregate(0, INT_MAX);
+  SnapshotStatistics statistics = bPlusTree.getSnapshotStatistics();
+  cout << numberOfChanges << " removals and inserts in " << elapsedMs << "ms alongside " << scans << " snapshot scans of "
+       << totalScanMs / scans << "ms each, " << (scansDiffering == 0 ? "all matched the snapshot" : to_string(scansDiffering) + " DIFFERED FROM THE SNAPSHOT")
+       << endl;
+  cout << "Live scan now: " << live.totalRecords << " records, average rating " << live.totalRating / live.totalRecords << endl;
+  cout << "Change log: " << statistics.changesLogged << " changes logged, " << statistics.changesRetained << " retained ("
+       << statistics.bytesRetained << "B), peak " << statistics.peakChangesRetained << ", " << statistics.scanSteps << " scan steps" << endl;
+  bPlusTree.releaseSnapshot(snapshot);
+  statistics = bPlusTree.getSnapshotStatistics();
+  cout << "After releasing the snapshot: " << statistics.changesRetained << " changes retained, " << statistics.changesReclaimed << " reclaimed" << endl;
+
+  // a log limited to fewer changes than are made expires the snapshot needing them
+  bPlusTree.enableSnapshots(1000);
+  snapshot = bPlusTree.takeSnapshot();
+  for (uint i = 0; i < 2000; ++i) {
+    pair<Block*, Record>& copied = records[(ull) i * 104729 % records.size()];
+    bPlusTree.insertKey(copied.second.__numVotes, copied.first, IncludedColumns(copied.second));
+  }
+  try {
+    bPlusTree.snapshotRangeQueryAggregate(snapshot, 0, INT_MAX);
+    cout << "Snapshot " << snapshot << " still readable after 2000 inserts with a limit of 1000 changes, EXPECTED IT TO EXPIRE" << endl;
+  } catch (const char*) {
+    cout << "Snapshot " << snapshot << " expired after 2000 inserts with a limit of 1000 changes, "
+         << bPlusTree.getSnapshotStatistics().snapshotsExpired << " snapshots expired" << endl;
+  }
+  bPlusTree.releaseSnapshot(snapshot);
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Inserts records into a sharded index from several threads at once, each thread taking every
+ * numberOfThreads-th record, and times it.
+ * 
+ * @param records The records to insert.
+ * @param shardedIndex The empty index to insert into.
+ * @param numberOfThreads Writer threads.
+ * @return double Time taken in milliseconds.
+ */
+double timeShardedLoad(const vector<Record>& records, ShardedIndex* shardedIndex, uint numberOfThreads) {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  vector<thread> writers;
+  for (uint writer = 0; writer < numberOfThreads; ++writer) {
+    writers.push_back(thread([&records, shardedIndex, writer, numberOfThreads]() {
+      for (uint i = writer; i < records.size(); i += numberOfThreads) {
+        shardedIndex->insertRecord(records[i]);
+      }
+    }));
+  }
+  for (auto& writer: writers) {
+    writer.join();
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  return chrono::duration<double, milli>(end - start).count();
+}
+
+void runShardedIndexBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize, uint maxRecordsInBlock, uint maxKeys, uint maxBlkPtrs,
+                              uint maxThreads) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Sharded Index Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (maxThreads == 0) {
+    maxThreads = thread::hardware_concurrency() == 0 ? 1 : thread::hardware_concurrency();
+  }
+  vector<Record> records;
+  for (auto blockPtr: disk->__blocks) {
+    records.insert(records.end(), blockPtr->__records.begin(), blockPtr->__records.end());
+  }
+  if (records.empty()) {
+    cout << "No records to load. Check that the data file exists." << endl;
+    return;
+  }
+  vector<int> sampleKeys = sampleNumVotes(disk, 10000);
+  vector<int> rangeStartKeys = sampleNumVotes(disk, 1000);
+  vector<int> lookupKeys = sampleNumVotes(disk, 10000);
+  cout << records.size() << " records loaded by " << maxThreads << " writer thread" << (maxThreads == 1 ? "" : "s")
+       << ", ranges fanned out on a pool of as many threads" << endl;
+  ThreadPool threadPool(maxThreads);
+
+  for (uint numberOfShards = 1; numberOfShards <= 16; numberOfShards *= 2) {
+    ShardedIndex shardedIndex(sampleKeys, numberOfShards, UINT_MAX, threadPool, blockSize, DISK_CAPACITY, maxRecordsInBlock, maxKeys, maxBlkPtrs);
+    double loadMs = timeShardedLoad(records, &shardedIndex, maxThreads);
+
+    bool isEveryRangeEqual = true;
+    for (int key: rangeStartKeys) {
+      IndexAggregate aggregate = shardedIndex.rangeQueryAggregate(key, key + 100);
+      isEveryRangeEqual = isEveryRangeEqual && aggregate.totalRecords == bPlusTree->rangeQueryAggregate(key, key + 100).totalRecords;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int key: rangeStartKeys) {
+      shardedIndex.rangeQueryAggregate(key, key + 100);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double rangeUs = chrono::duration<double, micro>(end - start).count() / rangeStartKeys.size();
+
+    start = chrono::steady_clock::now();
+    vector<thread> readers;
+    for (uint reader = 0; reader < maxThreads; ++reader) {
+      readers.push_back(thread([&lookupKeys, &shardedIndex, reader, maxThreads]() {
+        for (uint i = reader; i < lookupKeys.size(); i += maxThreads) {
+          shardedIndex.getRecordsOfKey(lookupKeys[i]);
+        }
+      }));
+    }
+    for (auto& reader: readers) {
+      reader.join();
+    }
+    end = chrono::steady_clock::now();
+    double lookupMs = chrono::duration<double, milli>(end - start).count();
+
+    cout << shardedIndex.getNumberOfShards() << " shard" << (shardedIndex.getNumberOfShards() == 1 ? "" : "s") << ": load " << loadMs
+         << "ms (" << records.size() / loadMs * 1000 << " records/s), range of 100 numVotes " << rangeUs << "us, "
+         << lookupKeys.size() << " lookups " << lookupMs << "ms" << (isEveryRangeEqual ? "" : ", RECORDS DIFFER FROM THE INDEX") << endl;
+  }
+
+  // a single shard splitting as it grows ends with shards of similar size whatever the skew of the keys
+  ShardedIndex splittingIndex(vector<int>(), 1, records.size() / 8, threadPool, blockSize, DISK_CAPACITY, maxRecordsInBlock, maxKeys, maxBlkPtrs);
+  double loadMs = timeShardedLoad(records, &splittingIndex, maxThreads);
+  cout << "Splitting a shard past " << records.size() / 8 << " records: load " << loadMs << "ms, " << splittingIndex.getNumberOfSplits()
+       << " splits into " << splittingIndex.getNumberOfShards() << " shards" << endl;
+  for (auto& shard: splittingIndex.getShardStatistics()) {
+    cout << "  numVotes from " << (shard.firstKey == INT_MIN ? string("the lowest") : to_string(shard.firstKey)) << ": " << shard.numberOfRecords
+         << " records in " << shard.numberOfBlocks << " blocks, height " << shard.height << ", " << shard.operations << " operations" << endl;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Prints how many blocks a layout of the records takes and how full they are.
+ * 
+ * @param label Name of the layout.
+ * @param layout The storage holding the records.
+ * @param blockSize Size of the data blocks in bytes(B).
+ */
+void printScanLayout(const string& label, Storage* layout, uint blockSize) {
+  SpaceUsage blockSpaceUsage = layout->getBlockSpaceUsage();
+  cout << label << ": " << layout->getNumberOfBlocksInStorage() << " blocks, "
+       << (double) layout->getNumberOfRecords() / max(1u, layout->getNumberOfBlocksInStorage()) << " records per " << blockSize
+       << "B block, " << (double) blockSpaceUsage.bytesUsed / max(1ULL, blockSpaceUsage.bytesAllocated) * 100 << "% of the block bytes used" << endl;
+}
+
+void runZoneMapScanBenchmark(Storage* disk, uint blockSize, uint maxRecordsInBlock) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Zone Map Scan Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  vector<Record> records;
+  for (auto blockPtr: disk->__blocks) {
+    records.insert(records.end(), blockPtr->__records.begin(), blockPtr->__records.end());
+  }
+  if (records.empty()) {
+    cout << "No records to scan. Check that the data file exists." << endl;
+    return;
+  }
+  vector<Record> recordsByNumVotes = records;
+  stable_sort(recordsByNumVotes.begin(), recordsByNumVotes.end(),
+              [](const Record& first, const Record& second) { return first.__numVotes < second.__numVotes; });
+
+  // the zone maps only skip blocks when the records are clustered on the column filtered
+  vector<string> labels = {"Loaded order", "Loaded order, compressed", "Sorted by numVotes", "Sorted by numVotes, compressed"};
+  vector<Storage*> layouts;
+  for (uint layoutIdx = 0; layoutIdx < labels.size(); ++layoutIdx) {
+    Storage* layout = new Storage(blockSize, DISK_CAPACITY, maxRecordsInBlock);
+    if (layoutIdx % 2 == 1) {
+      layout->enableBlockCompression();
+    }
+    for (auto& record: layoutIdx < 2 ? records : recordsByNumVotes) {
+      layout->insertRecord(record);
+    }
+    printScanLayout(labels[layoutIdx], layout, blockSize);
+    layouts.push_back(layout);
+  }
+
+  struct ScanPredicate {
+    string description;
+    int startNumVotes;
+    int endNumVotes;
+    float startAvgRating;
+    float endAvgRating;
+  };
+  vector<ScanPredicate> predicates = {
+    {"numVotes 30000 to 40000", 30000, 40000, -FLT_MAX, FLT_MAX},
+    {"numVotes over 100000 and avgRating from 8", 100001, INT_MAX, 8.0f, FLT_MAX},
+    {"avgRating from 9.5", INT_MIN, INT_MAX, 9.5f, FLT_MAX},
+  };
+  for (auto& predicate: predicates) {
+    cout << predicate.description << ":" << endl;
+    ScanAggregate expected = layouts[0]->scanRecords(predicate.startNumVotes, predicate.endNumVotes, predicate.startAvgRating,
+                                                     predicate.endAvgRating, false);
+    for (uint layoutIdx = 0; layoutIdx < layouts.size(); ++layoutIdx) {
+      double scanMs[2];
+      ScanAggregate aggregate;
+      for (uint useZoneMaps = 0; useZoneMaps < 2; ++useZoneMaps) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        aggregate = layouts[layoutIdx]->scanRecords(predicate.startNumVotes, predicate.endNumVotes, predicate.startAvgRating,
+                                                    predicate.endAvgRating, useZoneMaps == 1);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        scanMs[useZoneMaps] = chrono::duration<double, milli>(end - start).count();
+      }
+      cout << "  " << labels[layoutIdx] << ": " << aggregate.totalRecords << " records, " << aggregate.dataBlocksSkipped << " of "
+           << aggregate.dataBlocksAccessed + aggregate.dataBlocksSkipped << " blocks skipped, scan " << scanMs[0] << "ms, with zone maps "
+           << scanMs[1] << "ms" << (aggregate.totalRecords == expected.totalRecords && fabs(aggregate.totalRating - expected.totalRating) < 1e-3
+                                    ? "" : ", RECORDS DIFFER") << endl;
+    }
+  }
+
+  for (auto layout: layouts) {
+    for (auto blockPtr: layout->__blocks) {
+      delete blockPtr;
+    }
+    delete layout;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Picks numVotes spread evenly from 0 to the largest numVotes on disk that no record has.
+ * 
+ * @param disk The storage holding the records.
+ * @param numberOfKeys Number of numVotes to try, those held by a record are left out.
+ * @return vector<int> The numVotes picked, in increasing order.
+ */
+vector<int> pickAbsentNumVotes(Storage* disk, uint numberOfKeys) {
+  set<int> presentNumVotes;
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      presentNumVotes.insert(record.__numVotes);
+    }
+  }
+  vector<int> absentNumVotes;
+  if (presentNumVotes.empty()) {
+    return absentNumVotes;
+  }
+  long long largestNumVotes = *presentNumVotes.rbegin();
+  for (uint i = 0; i < numberOfKeys; ++i) {
+    int key = (int) ((long long) i * (largestNumVotes + 1) / numberOfKeys);
+    if (presentNumVotes.count(key) == 0) {
+      absentNumVotes.push_back(key);
+    }
+  }
+  return absentNumVotes;
+}
+
+/**
+ * @brief Looks up every key in the tree and times it.
+ * 
+ * @param bPlusTree The numVotes index.
+ * @param keys The numVotes to look up.
+ * @param keysFound Set to the number of keys the tree holds.
+ * @return double Time taken per lookup in microseconds.
+ */
+double timeLookups(NumVotesIndex* bPlusTree, const vector<int>& keys, uint& keysFound) {
+  keysFound = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (int key: keys) {
+    keysFound += bPlusTree->getOverflowBlockOfKey(key) != nullptr;
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  return chrono::duration<double, micro>(end - start).count() / max((size_t) 1, keys.size());
+}
+
+void runLeafFilterBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Leaf Filter Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  vector<int> presentKeys = sampleNumVotes(disk, 100000);
+  vector<int> absentKeys = pickAbsentNumVotes(disk, 100000);
+  if (presentKeys.empty()) {
+    cout << "No records to index. Check that the data file exists." << endl;
+    return;
+  }
+  TreeStatistics treeStatistics = bPlusTree->getStatistics(blockSize);
+  uint presentKeysFound;
+  uint absentKeysFound;
+  double presentLookupUs = timeLookups(bPlusTree, presentKeys, presentKeysFound);
+  double absentLookupUs = timeLookups(bPlusTree, absentKeys, absentKeysFound);
+  cout << "No filters: " << treeStatistics.nodesPerLevel.back() << " leaves of up to " << treeStatistics.maxKeys << " keys, lookup of "
+       << presentKeys.size() << " present keys " << presentLookupUs << "us, of " << absentKeys.size() << " absent keys " << absentLookupUs << "us" << endl;
+
+  // the filters are rebuilt with more bits each time, the counters are read before and after the absent keys
+  for (uint bitsPerKey: {4, 8, LEAF_FILTER_BITS_PER_KEY, 16}) {
+    bPlusTree->enableLeafFilters(bitsPerKey);
+    uint filteredPresentKeysFound;
+    double filteredPresentLookupUs = timeLookups(bPlusTree, presentKeys, filteredPresentKeysFound);
+    LeafFilterStatistics before = bPlusTree->getLeafFilterStatistics();
+    uint filteredAbsentKeysFound;
+    double filteredAbsentLookupUs = timeLookups(bPlusTree, absentKeys, filteredAbsentKeysFound);
+    LeafFilterStatistics after = bPlusTree->getLeafFilterStatistics();
+    unsigned long long falsePositives = after.falsePositives - before.falsePositives;
+    cout << bitsPerKey << " bits per key, " << after.numberOfHashes << " hashes: filters take " << after.filterBytes << "B ("
+         << (double) after.filterBytes / treeStatistics.nodes.heapBytes * 100 << "% of the nodes), lookup of present keys "
+         << filteredPresentLookupUs << "us, of absent keys " << filteredAbsentLookupUs << "us (" << absentLookupUs / filteredAbsentLookupUs
+         << "x), " << falsePositives << " false positives (" << (double) falsePositives / max((size_t) 1, absentKeys.size()) * 100 << "%)"
+         << (filteredPresentKeysFound == presentKeysFound && filteredAbsentKeysFound == absentKeysFound ? "" : ", KEYS FOUND DIFFER") << endl;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+/**
+ * @brief Aggregates avgRating over the records matching a predicate with a loop over the records of every block,
+ * as code without the scan engine has to.
+ * 
+ * @param disk The storage holding the records.
+ * @param predicate The predicate.
+ * @return ScanAggregate The records matching, every block read.
+ */
+ScanAggregate scanRecordByRecord(Storage* disk, const ScanPredicate& predicate) {
+  ScanAggregate aggregate;
+  for (auto blockPtr: disk->__blocks) {
+    ++aggregate.dataBlocksAccessed;
+    for (auto& record: blockPtr->__records) {
+      if (predicate.matches(record)) {
+        aggregate.totalRating += record.__avgRating;
+        ++aggregate.totalRecords;
+      }
+    }
+  }
+  return aggregate;
+}
+
+void runPredicateScanBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint maxThreads) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Predicate Scan Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (disk->getNumberOfRecords() == 0) {
+    cout << "No records to scan. Check that the data file exists." << endl;
+    return;
+  }
+  if (maxThreads == 0) {
+    maxThreads = thread::hardware_concurrency() == 0 ? 1 : thread::hardware_concurrency();
+  }
+  cout << "Scanning " << disk->getNumberOfRecords() << " records in " << disk->getNumberOfBlocksInStorage() << " blocks, batches of "
+       << SCAN_BATCH_SIZE << " records, up to " << maxThreads << " threads" << endl;
+
+  struct NamedPredicate {
+    string description;
+    ScanPredicate predicate;
+  };
+  vector<NamedPredicate> predicates = {
+    {"numVotes 500", ScanPredicate(500, 500, -FLT_MAX, FLT_MAX)},
+    {"numVotes 30000 to 40000", ScanPredicate(30000, 40000, -FLT_MAX, FLT_MAX)},
+    {"numVotes 1000 to 100000 and avgRating from 7", ScanPredicate(1000, 100000, 7.0f, FLT_MAX)},
+    {"tConst from tt0012 and avgRating from 8", ScanPredicate(INT_MIN, INT_MAX, 8.0f, FLT_MAX, "tt0012")},
+    {"avgRating from 9.5", ScanPredicate(INT_MIN, INT_MAX, 9.5f, FLT_MAX)},
+  };
+  ThreadPool serialPool(1);
+  ThreadPool parallelPool(maxThreads);
+  ScanEngine serialEngine(disk, bPlusTree, serialPool);
+  ScanEngine parallelEngine(disk, bPlusTree, parallelPool);
+  uint repetitions = 5;
+  for (auto& namedPredicate: predicates) {
+    const ScanPredicate& predicate = namedPredicate.predicate;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ScanAggregate expected;
+    for (uint repetition = 0; repetition < repetitions; ++repetition) {
+      expected = scanRecordByRecord(disk, predicate);
+    }
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    double recordByRecordMs = chrono::duration<double, milli>(end - start).count() / repetitions;
+
+    // the same predicate through each path, the planner's choice last
+    vector<string> labels = {"vectorized scan, 1 thread", "vectorized scan, " + to_string(maxThreads) + (maxThreads == 1 ? " thread" : " threads"), "numVotes index"};
+    vector<ScanAggregate> aggregates(labels.size());
+    vector<double> elapsedMs(labels.size());
+    for (uint pathIdx = 0; pathIdx < labels.size(); ++pathIdx) {
+      start = chrono::steady_clock::now();
+      for (uint repetition = 0; repetition < repetitions; ++repetition) {
+        aggregates[pathIdx] = pathIdx == 0 ? serialEngine.aggregate(predicate, ACCESS_FULL_SCAN)
+                              : pathIdx == 1 ? parallelEngine.aggregate(predicate, ACCESS_FULL_SCAN)
+                              : parallelEngine.aggregate(predicate, ACCESS_INDEX_RANGE);
+      }
+      end = chrono::steady_clock::now();
+      elapsedMs[pathIdx] = chrono::duration<double, milli>(end - start).count() / repetitions;
+    }
+    start = chrono::steady_clock::now();
+    ScanPlan plan = parallelEngine.plan(predicate);
+    end = chrono::steady_clock::now();
+    double planUs = chrono::duration<double, micro>(end - start).count();
+    uint selectedRecords = parallelEngine.select(predicate).size();
+
+    cout << namedPredicate.description << ": " << expected.totalRecords << " records, record by record " << recordByRecordMs << "ms" << endl;
+    for (uint pathIdx = 0; pathIdx < labels.size(); ++pathIdx) {
+      bool isSame = aggregates[pathIdx].totalRecords == expected.totalRecords && fabs(aggregates[pathIdx].totalRating - expected.totalRating) < 1e-3;
+      cout << "  " << labels[pathIdx] << ": " << elapsedMs[pathIdx] << "ms (" << recordByRecordMs / elapsedMs[pathIdx] << "x), "
+           << aggregates[pathIdx].dataBlocksAccessed << " blocks read, " << aggregates[pathIdx].dataBlocksSkipped << " skipped"
+           << (isSame ? "" : ", RECORDS DIFFER") << endl;
+    }
+    cout << "  planner: " << (plan.accessPath == ACCESS_INDEX_RANGE ? "numVotes index" : "vectorized scan") << " in " << planUs
+         << "us, index cost " << plan.rangePlan.indexCost << " against scan cost " << plan.rangePlan.scanCost << ", estimated "
+         << plan.numVotesSelectivity * 100 << "% of the records in the numVotes range and " << plan.selectivity * 100 << "% matching from "
+         << plan.sampledRecords << " sampled" << (selectedRecords == expected.totalRecords ? "" : ", RECORDS DIFFER") << endl;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+}
+
+void runAccessPathBenchmark(Storage* disk, NumVotesIndex* bPlusTree) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Access Path Benchmark:" << NEWLINE << COUT_LINE_DELIMITER << endl;
+  if (disk->getNumberOfRecords() == 0) {
+    cout << "No records to scan. Check that the data file exists." << endl;
+    return;
+  }
+  QueryPlanner queryPlanner(disk, bPlusTree);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  queryPlanner.analyze();
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  KeyHistogram histogram = queryPlanner.getHistogram();
+  cout << "Histogram of " << histogram.numberOfKeys << " keys and " << histogram.numberOfRecords << " records in " << histogram.buckets.size()
+       << " buckets built in " << chrono::duration<double, milli>(end - start).count() << "ms, random block accesses cost "
+       << RANDOM_BLOCK_ACCESS_COST << " sequential ones" << endl;
+
+  // from a single key to every key, the planner should switch to the scan where the timings cross
+  vector<pair<int, int>> ranges = {make_pair(500, 500), make_pair(30000, 40000), make_pair(5000, 10000), make_pair(1000, 5000),
+                                   make_pair(2000, 2500), make_pair(1000, 2000), make_pair(500, 2000), make_pair(0, 1000),
+                                   make_pair(0, 100000), make_pair(0, INT_MAX)};
+  uint repetitions = 5;
+  uint fasterChoices = 0;
+  for (auto& range: ranges) {
+    RangePlan rangePlan = queryPlanner.planRange(range.first, range.second);
+    cout << rangePlan.explain();
+
+    start = chrono::steady_clock::now();
+    IndexAggregate indexAggregate;
+    for (uint repetition = 0; repetition < repetitions; ++repetition) {
+      indexAggregate = bPlusTree->rangeQueryAggregate(range.first, range.second);
+    }
+    end = chrono::steady_clock::now();
+    double indexMs = chrono::duration<double, milli>(end - start).count() / repetitions;
+    start = chrono::steady_clock::now();
+    ScanAggregate scanAggregate;
+    for (uint repetition = 0; repetition < repetitions; ++repetition) {
+      scanAggregate = disk->scanRecords(range.first, range.second, -FLT_MAX, FLT_MAX, false);
+    }
+    end = chrono::steady_clock::now();
+    double scanMs = chrono::duration<double, milli>(end - start).count() / repetitions;
+
+    bool isChoiceFaster = (rangePlan.accessPath == ACCESS_INDEX_RANGE) == (indexMs <= scanMs);
+    fasterChoices += isChoiceFaster;
+    cout << "  Actual: " << indexAggregate.totalRecords << " records, index " << indexAggregate.indexNodesAccessed + indexAggregate.overflowBlocksAccessed
+         << " node and overflow block accesses + " << indexAggregate.dataBlocksAccessed << " data blocks in " << indexMs << "ms, scan "
+         << scanAggregate.dataBlocksAccessed << " data blocks in " << scanMs << "ms, " << (isChoiceFaster ? "chose the faster path" : "chose the slower path")
+         << (indexAggregate.totalRecords == scanAggregate.totalRecords ? "" : ", RECORDS DIFFER") << endl;
+  }
+  cout << "The planner chose the faster path for " << fasterChoices << " of " << ranges.size() << " ranges" << endl;
+  cout << COUT_LINE_DELIMITER << endl;
+}
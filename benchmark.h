@@ -0,0 +1,180 @@
+#ifndef H_BENCHMARK
+#define H_BENCHMARK
+
+#include "storage.h"
+#include "bplustree.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+/**
+ * @brief Measures sustained insert throughput of a numVotes index built from the records on disk,
+ * inserting straight into the leaves against buffering the inserts in the internal nodes.
+ * 
+ * @param disk The storage holding the records to index, read in the order they were stored.
+ * @param blockSize User specified block size.
+ * @param maxKeys Maximum number of keys per tree node.
+ * @param maxBlkPtrs Maximum number of pointers per overflow block.
+ */
+void runInsertThroughputBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs);
+
+/**
+ * @brief Measures purging every title with fewer than a number of votes, one numVotes key at a time
+ * against a single range delete, on copies of the records on disk. Last, checks that range deletes from
+ * an index of 3 keys per node leave no node underfull.
+ * 
+ * @param disk The storage holding the records to copy, it is left untouched.
+ * @param blockSize User specified block size.
+ * @param maxKeys Maximum number of keys per tree node.
+ * @param maxBlkPtrs Maximum number of pointers per overflow block.
+ * @param maxRecords Maximum number of records per data block.
+ * @param minimumNumVotes Titles with fewer votes than this are purged.
+ */
+void runPurgeBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs, uint maxRecords, int minimumNumVotes);
+
+/**
+ * @brief Measures the latency of every single key delete when purging titles with fewer than a number
+ * of votes and then every other numVotes above, rebalancing right away against lazy deletes with a
+ * maintenance thread. Prints the longest a maintenance batch held the tree, and the fill of the lazily
+ * deleted tree before and after maintenance.
+ * 
+ * @param disk The storage holding the records to copy, it is left untouched.
+ * @param blockSize User specified block size.
+ * @param maxKeys Maximum number of keys per tree node.
+ * @param maxBlkPtrs Maximum number of pointers per overflow block.
+ * @param maxRecords Maximum number of records per data block.
+ * @param minimumNumVotes Titles with fewer votes than this are purged.
+ */
+void runDeleteLatencyBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs, uint maxRecords, int minimumNumVotes);
+
+/**
+ * @brief Counts instructions, branch misses, LLC misses and dTLB misses per operation with the
+ * hardware performance counters, around loops of insertKey, searchQuery and rangeQuery on a numVotes
+ * index built from the records on disk. Only the time is reported where the counters are unavailable.
+ * 
+ * @param disk The storage holding the records to index, it is left untouched.
+ * @param blockSize Block size the nodes of the index are sized for.
+ * @param maxKeys Maximum number of keys per tree node.
+ * @param maxBlkPtrs Maximum number of pointers per overflow block.
+ */
+void runHardwareCounterBenchmark(Storage* disk, uint blockSize, uint maxKeys, uint maxBlkPtrs);
+
+/**
+ * @brief Builds a numVotes index from the records on disk with every node size from 256B to 64KB and
+ * times inserts, point lookups and range scans, to find the node size that suits the cache and page
+ * sizes of this hardware, which are printed first.
+ * 
+ * @param disk The storage holding the records to index, it is left untouched.
+ */
+void runNodeSizeSweepBenchmark(Storage* disk);
+
+/**
+ * @brief Times avgRating aggregations over wide numVotes ranges of the index, scanned on one thread
+ * and then split into partitions scanned on thread pools of doubling size, and checks that every
+ * thread count adds up to the same records as the single threaded scan. Batches of point lookups
+ * are timed the same way, and the tasks each pool ran and stole are printed.
+ * 
+ * @param disk The storage the index was built from, to sample the keys looked up.
+ * @param bPlusTree The numVotes index to scan.
+ * @param maxThreads Largest thread pool to time, 0 for one thread per hardware thread.
+ */
+void runParallelRangeScanBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint maxThreads);
+
+/**
+ * @brief Builds learned indexes on numVotes from the records on disk with a maximum error of 4, 16
+ * and 64 positions, and compares the memory taken by their keys and models against the nodes of the
+ * index, and their point lookup and range scan latency, checking both find the same keys.
+ * 
+ * @param disk The storage the index was built from.
+ * @param bPlusTree The numVotes index to compare against.
+ * @param blockSize Size of the nodes of the index in bytes(B).
+ * @param maxBlkPtrs Block pointers per overflow block of the index.
+ */
+void runLearnedIndexBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize, uint maxBlkPtrs);
+
+/**
+ * @brief Times point lookups and range scans descending the nodes of the index against descending its
+ * internal levels frozen into one contiguous array, checking both find the same keys, and prints the
+ * memory the frozen levels take and whether they are backed by huge pages. The index is left frozen.
+ * 
+ * @param disk The storage the index was built from, to sample the keys looked up.
+ * @param bPlusTree The numVotes index to freeze.
+ * @param blockSize Size of the nodes of the index in bytes(B).
+ */
+void runFrozenLevelsBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize);
+
+/**
+ * @brief Builds a covering numVotes index with snapshots enabled, takes a snapshot and aggregates
+ * avgRating over every key of the snapshot over and over while another thread removes and inserts
+ * records, checking every scan adds up to what the index held when the snapshot was taken. Then
+ * prints what the change log retained and shows a snapshot expiring once the log outgrows its limit.
+ * 
+ * @param disk The storage holding the records to index, it is left untouched.
+ * @param maxKeys Keys per node of the index.
+ * @param maxBlkPtrs Block pointers per overflow block of the index.
+ */
+void runSnapshotScanBenchmark(Storage* disk, uint maxKeys, uint maxBlkPtrs);
+
+/**
+ * @brief Loads the records on disk into sharded indexes of 1 to 16 shards from several writer threads
+ * at once, then times avgRating aggregations over numVotes ranges fanned out across the shards and
+ * point lookups from the same threads, checking the ranges add up to the same records as the index.
+ * Last, the records are loaded into a single shard that splits whenever it outgrows an eighth of them.
+ * 
+ * @param disk The storage holding the records to load, it is left untouched.
+ * @param bPlusTree The numVotes index of the records, to check the ranges against.
+ * @param blockSize Size of the data blocks in bytes(B).
+ * @param maxRecordsInBlock Records per data block.
+ * @param maxKeys Keys per node of the indexes.
+ * @param maxBlkPtrs Block pointers per overflow block of the indexes.
+ * @param maxThreads Writer threads and threads of the pool the ranges fan out on, 0 for one per hardware thread.
+ */
+void runShardedIndexBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize, uint maxRecordsInBlock, uint maxKeys, uint maxBlkPtrs,
+                              uint maxThreads);
+
+/**
+ * @brief Stores the records on disk in the order they were loaded and sorted by numVotes, each with blocks
+ * holding the records as they are and packed, and prints the blocks each layout takes. Then times full scans
+ * aggregating avgRating over predicates on numVotes and avgRating with and without skipping blocks by their
+ * zone maps, checking every layout finds the same records.
+ * 
+ * @param disk The storage holding the records to scan, it is left untouched.
+ * @param blockSize Size of the data blocks in bytes(B).
+ * @param maxRecordsInBlock Records per data block stored as they are.
+ */
+void runZoneMapScanBenchmark(Storage* disk, uint blockSize, uint maxRecordsInBlock);
+
+/**
+ * @brief Times point lookups of numVotes held by records and of numVotes no record has, first reading
+ * the keys of every leaf reached, then with Bloom filters of 4 to 16 bits per key on the leaves, and prints
+ * the memory the filters take and their false positive rate over the absent keys. The filters are left enabled.
+ * 
+ * @param disk The storage the index was built from, to pick the keys looked up.
+ * @param bPlusTree The numVotes index to filter.
+ * @param blockSize Size of the nodes of the index in bytes(B).
+ */
+void runLeafFilterBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint blockSize);
+
+/**
+ * @brief Times predicates on numVotes, avgRating and tConst with a loop over the records of every block, then
+ * through the vectorized scan engine on one thread and on a pool, and through the numVotes index, checking every
+ * path finds the same records. Prints the access path the planner chooses for each with its estimates.
+ * 
+ * @param disk The storage holding the records to scan.
+ * @param bPlusTree The numVotes index attached to the storage.
+ * @param maxThreads Threads of the pool the block ranges are spread over, 0 for one per hardware thread.
+ */
+void runPredicateScanBenchmark(Storage* disk, NumVotesIndex* bPlusTree, uint maxThreads);
+
+/**
+ * @brief Builds the histogram of the numVotes index, then prints the plan of numVotes ranges from a single key to
+ * every key and times each through the index and with a scan of storage, counting the ranges where the planner
+ * chose the faster path.
+ * 
+ * @param disk The storage holding the records.
+ * @param bPlusTree The numVotes index attached to the storage.
+ */
+void runAccessPathBenchmark(Storage* disk, NumVotesIndex* bPlusTree);
+
+#endif
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cmath>
+#include <cfloat>
+#include <climits>
 #include <iostream>
 
 #include "block.h"
@@ -9,6 +12,19 @@ typedef unsigned int uint;
 
 #define DATA_SEPARATOR " | "
 
+ZoneMap::ZoneMap() : minNumVotes(INT_MAX), maxNumVotes(INT_MIN), minAvgRating(FLT_MAX), maxAvgRating(-FLT_MAX) {}
+
+void ZoneMap::addRecord(const Record& record) {
+    minNumVotes = min(minNumVotes, record.__numVotes);
+    maxNumVotes = max(maxNumVotes, record.__numVotes);
+    minAvgRating = min(minAvgRating, record.__avgRating);
+    maxAvgRating = max(maxAvgRating, record.__avgRating);
+}
+
+bool ZoneMap::overlaps(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating) const {
+    return minNumVotes <= endNumVotes && startNumVotes <= maxNumVotes && minAvgRating <= endAvgRating && startAvgRating <= maxAvgRating;
+}
+
 uint Block::getNumberOfRecordsInBlock() {
     return __records.size();
 }
@@ -23,8 +39,22 @@ bool Block::hasSpaceInBlock() {
     return currentNumberOfRecordsInBlock < maximumAllowableRecordsInBlock ? true : false;
 }
 
+bool Block::hasSpaceForRecord(const Record& record) {
+    if (__compressedBlockSize == 0) {
+        return hasSpaceInBlock();
+    }
+    return __compressionEstimate.getSizeWithRecord(record) <= __compressedBlockSize;
+}
+
 void Block::addRecordToBlock(Record record) {
     __records.push_back(record);
+    __zoneMap.addRecord(record);
+    if (__compressedBlockSize != 0) {
+        __compressionEstimate.addRecord(record);
+        if (!__compressedRecords.appendRecord(record)) {
+            __compressedRecords.encode(__records);
+        }
+    }
 }
 
 int Block::deleteRecord(int key) {
@@ -42,6 +72,9 @@ int Block::deleteRecord(int key) {
             ++recordsDeletedCounter;
         }
     }
+    if (recordsDeletedCounter > 0) {
+        refreshMetadata();
+    }
 
     return recordsDeletedCounter;
 
@@ -61,6 +94,39 @@ vector<Record> Block::getQueriedRecords(int key) {
     return queriedRecords;
 }
 
+void Block::refreshMetadata() {
+    __zoneMap = ZoneMap();
+    __compressionEstimate = CompressionEstimate();
+    for (auto& record: __records) {
+        __zoneMap.addRecord(record);
+        if (__compressedBlockSize != 0) {
+            __compressionEstimate.addRecord(record);
+        }
+    }
+    if (__compressedBlockSize != 0) {
+        __compressedRecords.encode(__records);
+    }
+}
+
+const ZoneMap& Block::getZoneMap() {
+    return __zoneMap;
+}
+
+bool Block::isCompressed() {
+    return __compressedBlockSize != 0;
+}
+
+uint Block::getRecordBytes() {
+    if (__compressedBlockSize == 0) {
+        return sizeof(Record) * __records.size();
+    }
+    return __compressionEstimate.getSize();
+}
+
+const CompressedRecords& Block::getCompressedRecords() {
+    return __compressedRecords;
+}
+
 void Block::printBlockContents() {
     cout << "{ ";
     uint i = 0;
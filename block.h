@@ -4,11 +4,51 @@
 #include <vector>
 
 #include "record.h"
+#include "blockcompression.h"
 
 using namespace std;
 
 typedef unsigned int uint;
 
+/**
+ * @brief The smallest and largest numVotes and avgRating of the records of a block, so a scan can skip
+ * a block none of whose records can match without reading them. The bounds are exact, as the block
+ * recomputes them from the records left after a delete.
+ * 
+ */
+struct ZoneMap {
+    public:
+        int minNumVotes; // smallest numVotes in the block
+        int maxNumVotes; // largest numVotes in the block
+        float minAvgRating; // lowest avgRating in the block
+        float maxAvgRating; // highest avgRating in the block
+
+        /**
+         * @brief Construct the zone map of an empty block, which overlaps nothing.
+         * 
+         */
+        ZoneMap();
+
+        /**
+         * @brief Widens the bounds to a record added to the block.
+         * 
+         * @param record The record added.
+         */
+        void addRecord(const Record& record);
+
+        /**
+         * @brief Checks if a record of the block may fall within the ranges given.
+         * 
+         * @param startNumVotes Smallest numVotes wanted (inclusive).
+         * @param endNumVotes Largest numVotes wanted (inclusive).
+         * @param startAvgRating Lowest avgRating wanted (inclusive).
+         * @param endAvgRating Highest avgRating wanted (inclusive).
+         * @return true If the bounds of the block overlap both ranges.
+         * @return false If no record of the block can be within both ranges, so the block can be skipped.
+         */
+        bool overlaps(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating) const;
+};
+
 /**
  * @brief A block size bounded by 200B/500B to simulate block access.
  * 
@@ -16,16 +56,33 @@ typedef unsigned int uint;
 struct Block {
     private:
         uint __maxAllowableRecordsInBlock;
+        uint __compressedBlockSize; // bytes the packed records may take, 0 when the records are stored as they are
+        ZoneMap __zoneMap; // bounds of the numVotes and avgRating of the records
+        CompressionEstimate __compressionEstimate; // size of the records once packed, only kept for a compressed block
+        CompressedRecords __compressedRecords; // the records packed, kept up to date on every insert and delete
 
     public:
-        vector<Record> __records; // array of records in a block
+        // array of records in a block. A compressed block keeps them unpacked as well, for the indexes, the
+        // deletes and the prints that read them; the packed copy is what the block size is charged for and
+        // what the scans decode.
+        vector<Record> __records;
 
         /**
          * @brief Construct a new Block object.
          * 
          * @param blockSize User specified block size.
          */
-        explicit Block(uint maxRecordsInBlock) : __maxAllowableRecordsInBlock(maxRecordsInBlock) {}
+        explicit Block(uint maxRecordsInBlock)
+            : __maxAllowableRecordsInBlock(maxRecordsInBlock), __compressedBlockSize(0) {}
+
+        /**
+         * @brief Construct a new Block object holding as many records as fit in the block once packed.
+         * 
+         * @param maxRecordsInBlock Records that fit in the block as they are.
+         * @param compressedBlockSize Bytes the packed records may take, 0 to store the records as they are.
+         */
+        Block(uint maxRecordsInBlock, uint compressedBlockSize)
+            : __maxAllowableRecordsInBlock(maxRecordsInBlock), __compressedBlockSize(compressedBlockSize) {}
 
         // Getters
         /**
@@ -51,6 +108,16 @@ struct Block {
          */
         bool hasSpaceInBlock();
 
+        /**
+         * @brief Checks if there is space in block for a record, which for a compressed block depends on
+         * how well the record packs with the others.
+         * 
+         * @param record The record to be added.
+         * @return true If the record can be added to block.
+         * @return false If the block size would be exceeded.
+         */
+        bool hasSpaceForRecord(const Record& record);
+
         /**
          * @brief Adds a new record to the vector of records in the current block.
          * 
@@ -74,6 +141,40 @@ struct Block {
          */
         vector<Record> getQueriedRecords(int key);
 
+        /**
+         * @brief Recomputes the zone map and packs the records again after records were removed from __records.
+         * 
+         */
+        void refreshMetadata();
+
+        /**
+         * @brief Get the bounds of the numVotes and avgRating of the records.
+         * 
+         * @return const ZoneMap& The zone map of the block.
+         */
+        const ZoneMap& getZoneMap();
+
+        /**
+         * @brief Checks if the block holds its records packed.
+         * 
+         * @return true If the block was constructed with a compressed block size.
+         */
+        bool isCompressed();
+
+        /**
+         * @brief Get the bytes the records take in the block, packed for a compressed block.
+         * 
+         * @return uint Size of the records in bytes(B).
+         */
+        uint getRecordBytes();
+
+        /**
+         * @brief Get the packed records, which always match __records.
+         * 
+         * @return const CompressedRecords& The packed records.
+         */
+        const CompressedRecords& getCompressedRecords();
+
         /**
          * @brief Prints the tConst(movieId) of all records in the block accessed.
          * 
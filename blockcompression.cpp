@@ -0,0 +1,298 @@
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "blockcompression.h"
+#include "keycompression.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// function declarations
+void packValue(vector<uint64_t>& words, uint index, uint bitWidth, uint64_t value);
+uint64_t unpackValue(const vector<uint64_t>& words, uint index, uint bitWidth);
+uint getPackedColumnSize(uint numberOfRecords, uint bitWidth);
+
+bool MovieIdPrefix::operator==(const MovieIdPrefix& other) const {
+  return hasSuffix == other.hasSuffix && prefix == other.prefix;
+}
+
+/**
+ * @brief Packs a value at a position of a bit-packed column sized for every record.
+ * 
+ * @param words The column.
+ * @param index Position of the value.
+ * @param bitWidth Bits per value.
+ * @param value The value, no wider than bitWidth.
+ */
+void packValue(vector<uint64_t>& words, uint index, uint bitWidth, uint64_t value) {
+  if (bitWidth == 0) {
+    return;
+  }
+  uint64_t bitOffset = (uint64_t) index * bitWidth;
+  uint wordIdx = bitOffset / 64;
+  uint shift = bitOffset % 64;
+  words[wordIdx] |= value << shift;
+  if (shift + bitWidth > 64) {
+    // value straddles two words, the high bits go to the next word
+    words[wordIdx + 1] |= value >> (64 - shift);
+  }
+}
+
+/**
+ * @brief Unpacks the value at a position of a bit-packed column.
+ * 
+ * @param words The column.
+ * @param index Position of the value.
+ * @param bitWidth Bits per value.
+ * @return uint64_t The value, 0 when the column takes no bits.
+ */
+uint64_t unpackValue(const vector<uint64_t>& words, uint index, uint bitWidth) {
+  if (bitWidth == 0) {
+    return 0;
+  }
+  uint64_t bitOffset = (uint64_t) index * bitWidth;
+  uint wordIdx = bitOffset / 64;
+  uint shift = bitOffset % 64;
+  uint64_t value = words[wordIdx] >> shift;
+  if (shift + bitWidth > 64) {
+    value |= words[wordIdx + 1] << (64 - shift);
+  }
+  return value & ((bitWidth == 64) ? ~0ULL : ((1ULL << bitWidth) - 1));
+}
+
+/**
+ * @brief Get the bytes of a bit-packed column rounded up to whole words.
+ * 
+ * @param numberOfRecords Values in the column.
+ * @param bitWidth Bits per value.
+ * @return uint Size of the column in bytes(B).
+ */
+uint getPackedColumnSize(uint numberOfRecords, uint bitWidth) {
+  return ((uint64_t) numberOfRecords * bitWidth + 63) / 64 * PACKED_WORD_SIZE;
+}
+
+void CompressedRecords::encode(const vector<Record>& records) {
+  CompressionEstimate estimate;
+  for (auto& record: records) {
+    estimate.addRecord(record);
+  }
+  numberOfRecords = records.size();
+  movieIdPrefixes = estimate.movieIdPrefixes;
+  prefixCodeBitWidth = movieIdPrefixes.empty() ? 0 : getBitWidthOfRange(movieIdPrefixes.size() - 1);
+  numVotesBase = estimate.minNumVotes;
+  numVotesBitWidth = getBitWidthOfRange((int64_t) estimate.maxNumVotes - (int64_t) estimate.minNumVotes);
+  isRatingScaled = estimate.isRatingScaled;
+  ratingBase = isRatingScaled ? estimate.minRating : 0;
+  ratingBitWidth = isRatingScaled ? getBitWidthOfRange(estimate.maxRating - estimate.minRating) : sizeof(float) * 8;
+
+  prefixCodes.assign(getPackedColumnSize(numberOfRecords, prefixCodeBitWidth) / PACKED_WORD_SIZE, 0);
+  suffixes.assign(getPackedColumnSize(numberOfRecords, estimate.hasSuffixes ? MOVIE_ID_SUFFIX_BIT_WIDTH : 0) / PACKED_WORD_SIZE, 0);
+  numVotes.assign(getPackedColumnSize(numberOfRecords, numVotesBitWidth) / PACKED_WORD_SIZE, 0);
+  ratings.assign(getPackedColumnSize(numberOfRecords, ratingBitWidth) / PACKED_WORD_SIZE, 0);
+  for (uint i = 0; i < numberOfRecords; ++i) {
+    const Record& record = records[i];
+    uint suffix;
+    MovieIdPrefix movieIdPrefix = splitMovieId(record.__movieId, suffix);
+    uint prefixCode = 0;
+    while (!(movieIdPrefixes[prefixCode] == movieIdPrefix)) {
+      ++prefixCode;
+    }
+    packValue(prefixCodes, i, prefixCodeBitWidth, prefixCode);
+    if (estimate.hasSuffixes) {
+      packValue(suffixes, i, MOVIE_ID_SUFFIX_BIT_WIDTH, suffix);
+    }
+    packValue(numVotes, i, numVotesBitWidth, (uint64_t) ((int64_t) record.__numVotes - (int64_t) numVotesBase));
+    if (isRatingScaled) {
+      int scaledRating;
+      scaleRating(record.__avgRating, scaledRating);
+      packValue(ratings, i, ratingBitWidth, scaledRating - ratingBase);
+    } else {
+      uint32_t ratingBits;
+      memcpy(&ratingBits, &record.__avgRating, sizeof(float));
+      packValue(ratings, i, ratingBitWidth, ratingBits);
+    }
+  }
+}
+
+bool CompressedRecords::appendRecord(const Record& record) {
+  if (numberOfRecords == 0) {
+    return false;
+  }
+  uint suffix;
+  MovieIdPrefix movieIdPrefix = splitMovieId(record.__movieId, suffix);
+  // without any suffix in the block the suffix column was left out
+  if (movieIdPrefix.hasSuffix && suffixes.empty()) {
+    return false;
+  }
+  uint prefixCode = movieIdPrefixes.size();
+  for (uint code = movieIdPrefixes.size(); code > 0 && prefixCode == movieIdPrefixes.size(); --code) {
+    if (movieIdPrefixes[code - 1] == movieIdPrefix) {
+      prefixCode = code - 1;
+    }
+  }
+  if (prefixCode == movieIdPrefixes.size() && getBitWidthOfRange(prefixCode) > prefixCodeBitWidth) {
+    return false;
+  }
+  if (record.__numVotes < numVotesBase || getBitWidthOfRange((int64_t) record.__numVotes - (int64_t) numVotesBase) > numVotesBitWidth) {
+    return false;
+  }
+  uint64_t packedRating;
+  if (isRatingScaled) {
+    int scaledRating;
+    if (!scaleRating(record.__avgRating, scaledRating) || scaledRating < ratingBase || getBitWidthOfRange(scaledRating - ratingBase) > ratingBitWidth) {
+      return false;
+    }
+    packedRating = scaledRating - ratingBase;
+  } else {
+    uint32_t ratingBits;
+    memcpy(&ratingBits, &record.__avgRating, sizeof(float));
+    packedRating = ratingBits;
+  }
+
+  if (prefixCode == movieIdPrefixes.size()) {
+    movieIdPrefixes.push_back(movieIdPrefix);
+  }
+  uint index = numberOfRecords++;
+  prefixCodes.resize(getPackedColumnSize(numberOfRecords, prefixCodeBitWidth) / PACKED_WORD_SIZE, 0);
+  numVotes.resize(getPackedColumnSize(numberOfRecords, numVotesBitWidth) / PACKED_WORD_SIZE, 0);
+  ratings.resize(getPackedColumnSize(numberOfRecords, ratingBitWidth) / PACKED_WORD_SIZE, 0);
+  packValue(prefixCodes, index, prefixCodeBitWidth, prefixCode);
+  if (!suffixes.empty()) {
+    suffixes.resize(getPackedColumnSize(numberOfRecords, MOVIE_ID_SUFFIX_BIT_WIDTH) / PACKED_WORD_SIZE, 0);
+    packValue(suffixes, index, MOVIE_ID_SUFFIX_BIT_WIDTH, suffix);
+  }
+  packValue(numVotes, index, numVotesBitWidth, (uint64_t) ((int64_t) record.__numVotes - (int64_t) numVotesBase));
+  packValue(ratings, index, ratingBitWidth, packedRating);
+  return true;
+}
+
+int CompressedRecords::decodeNumVotes(uint index) const {
+  return (int) ((int64_t) numVotesBase + (int64_t) unpackValue(numVotes, index, numVotesBitWidth));
+}
+
+float CompressedRecords::decodeAvgRating(uint index) const {
+  uint64_t packedRating = unpackValue(ratings, index, ratingBitWidth);
+  if (isRatingScaled) {
+    return (float) (ratingBase + (int) packedRating) / RATING_SCALE;
+  }
+  uint32_t ratingBits = (uint32_t) packedRating;
+  float avgRating;
+  memcpy(&avgRating, &ratingBits, sizeof(float));
+  return avgRating;
+}
+
+uint CompressedRecords::decodePrefixCode(uint index) const {
+  return unpackValue(prefixCodes, index, prefixCodeBitWidth);
+}
+
+void CompressedRecords::decodeMovieId(uint index, char* movieId) const {
+  memset(movieId, 0, TCONSTSIZE);
+  const MovieIdPrefix& movieIdPrefix = movieIdPrefixes[decodePrefixCode(index)];
+  memcpy(movieId, movieIdPrefix.prefix.data(), movieIdPrefix.prefix.size());
+  if (movieIdPrefix.hasSuffix) {
+    // the suffix is written back with its leading zeros
+    uint suffix = unpackValue(suffixes, index, MOVIE_ID_SUFFIX_BIT_WIDTH);
+    for (uint digit = MOVIE_ID_SUFFIX_DIGITS; digit > 0; --digit) {
+      movieId[movieIdPrefix.prefix.size() + digit - 1] = '0' + suffix % 10;
+      suffix /= 10;
+    }
+  }
+}
+
+Record CompressedRecords::decodeRecord(uint index) const {
+  Record record;
+  decodeMovieId(index, record.__movieId);
+  record.__numVotes = decodeNumVotes(index);
+  record.__avgRating = decodeAvgRating(index);
+  return record;
+}
+
+uint CompressedRecords::getSize() const {
+  uint dictionaryBytes = 0;
+  for (auto& movieIdPrefix: movieIdPrefixes) {
+    dictionaryBytes += 1 + movieIdPrefix.prefix.size();
+  }
+  return COMPRESSED_BLOCK_HEADER_SIZE + dictionaryBytes + (prefixCodes.size() + suffixes.size() + numVotes.size() + ratings.size()) * PACKED_WORD_SIZE;
+}
+
+void CompressionEstimate::addRecord(const Record& record) {
+  uint suffix;
+  MovieIdPrefix movieIdPrefix = splitMovieId(record.__movieId, suffix);
+  bool isInDictionary = false;
+  // records are usually stored in tConst order, so the prefix is most likely the last one added
+  for (auto it = movieIdPrefixes.rbegin(); it != movieIdPrefixes.rend() && !isInDictionary; ++it) {
+    isInDictionary = *it == movieIdPrefix;
+  }
+  if (!isInDictionary) {
+    dictionaryBytes += 1 + movieIdPrefix.prefix.size();
+    movieIdPrefixes.push_back(movieIdPrefix);
+  }
+  hasSuffixes = hasSuffixes || movieIdPrefix.hasSuffix;
+
+  int scaledRating;
+  isRatingScaled = scaleRating(record.__avgRating, scaledRating) && isRatingScaled;
+  if (numberOfRecords == 0) {
+    minNumVotes = maxNumVotes = record.__numVotes;
+    minRating = maxRating = scaledRating;
+  } else {
+    minNumVotes = min(minNumVotes, record.__numVotes);
+    maxNumVotes = max(maxNumVotes, record.__numVotes);
+    minRating = min(minRating, scaledRating);
+    maxRating = max(maxRating, scaledRating);
+  }
+  ++numberOfRecords;
+}
+
+uint CompressionEstimate::getSize() const {
+  uint prefixCodeBitWidth = movieIdPrefixes.empty() ? 0 : getBitWidthOfRange(movieIdPrefixes.size() - 1);
+  uint numVotesBitWidth = getBitWidthOfRange((int64_t) maxNumVotes - (int64_t) minNumVotes);
+  uint ratingBitWidth = isRatingScaled ? getBitWidthOfRange(maxRating - minRating) : sizeof(float) * 8;
+  return getCompressedBlockSize(numberOfRecords, dictionaryBytes, prefixCodeBitWidth, hasSuffixes, numVotesBitWidth, ratingBitWidth);
+}
+
+uint CompressionEstimate::getSizeWithRecord(const Record& record) const {
+  CompressionEstimate estimateWithRecord = *this;
+  estimateWithRecord.addRecord(record);
+  if (estimateWithRecord.movieIdPrefixes.size() > MAX_MOVIE_ID_PREFIXES) {
+    return UINT_MAX;
+  }
+  return estimateWithRecord.getSize();
+}
+
+MovieIdPrefix splitMovieId(const char* movieId, uint& suffix) {
+  // a tConst taking all TCONSTSIZE characters has no terminator
+  uint length = strnlen(movieId, TCONSTSIZE);
+  MovieIdPrefix movieIdPrefix;
+  movieIdPrefix.hasSuffix = length >= MOVIE_ID_SUFFIX_DIGITS;
+  suffix = 0;
+  for (uint i = length - (movieIdPrefix.hasSuffix ? MOVIE_ID_SUFFIX_DIGITS : 0); i < length; ++i) {
+    if (movieId[i] < '0' || movieId[i] > '9') {
+      movieIdPrefix.hasSuffix = false;
+      break;
+    }
+    suffix = suffix * 10 + (movieId[i] - '0');
+  }
+  if (!movieIdPrefix.hasSuffix) {
+    suffix = 0;
+  }
+  movieIdPrefix.prefix = string(movieId, movieIdPrefix.hasSuffix ? length - MOVIE_ID_SUFFIX_DIGITS : length);
+  return movieIdPrefix;
+}
+
+bool scaleRating(float avgRating, int& scaledRating) {
+  if (!(fabs(avgRating) < INT_MAX / RATING_SCALE)) {
+    scaledRating = 0;
+    return false; // too large for tenths to fit an integer, or not a number
+  }
+  scaledRating = (int) lround(avgRating * RATING_SCALE);
+  return (float) scaledRating / RATING_SCALE == avgRating;
+}
+
+uint getCompressedBlockSize(uint numberOfRecords, uint dictionaryBytes, uint prefixCodeBitWidth, bool hasSuffixes, uint numVotesBitWidth,
+                            uint ratingBitWidth) {
+  return COMPRESSED_BLOCK_HEADER_SIZE + dictionaryBytes + getPackedColumnSize(numberOfRecords, prefixCodeBitWidth) +
+         getPackedColumnSize(numberOfRecords, hasSuffixes ? MOVIE_ID_SUFFIX_BIT_WIDTH : 0) +
+         getPackedColumnSize(numberOfRecords, numVotesBitWidth) + getPackedColumnSize(numberOfRecords, ratingBitWidth);
+}
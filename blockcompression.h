@@ -0,0 +1,213 @@
+#ifndef H_BLOCKCOMPRESSION
+#define H_BLOCKCOMPRESSION
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "record.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+#define COMPRESSED_BLOCK_HEADER_SIZE 16 // number of records(4B) + numVotes base(4B) + avgRating base(4B) + bit widths(3B) + dictionary entries(1B)
+#define MAX_MOVIE_ID_PREFIXES 255 // dictionary entries a compressed block can count in its header
+#define MOVIE_ID_SUFFIX_DIGITS 3 // trailing digits of a tConst stored apart from its prefix
+#define MOVIE_ID_SUFFIX_BIT_WIDTH 10 // bits holding any suffix up to 999
+#define RATING_SCALE 10 // avgRating has a single decimal, so it is packed as an integer number of tenths
+
+/**
+ * @brief A tConst without its trailing digits, stored once in the dictionary of a compressed block.
+ * Consecutive tConsts share the prefix, so a record only keeps its code in the dictionary and its suffix.
+ * 
+ */
+struct MovieIdPrefix {
+  public:
+    string prefix; // leading characters of the tConst
+    bool hasSuffix; // whether MOVIE_ID_SUFFIX_DIGITS digits follow the prefix, false when the whole tConst is the prefix
+
+    /**
+     * @brief Checks if two prefixes encode the same tConsts.
+     * 
+     * @param other The other prefix.
+     * @return true If the prefix and whether a suffix follows are the same.
+     */
+    bool operator==(const MovieIdPrefix& other) const;
+};
+
+/**
+ * @brief The records of a block packed column by column: every tConst as a bit-packed code into a
+ * dictionary of prefixes and its trailing digits, numVotes as bit-packed deltas from the smallest
+ * numVotes of the block, and avgRating as bit-packed tenths above the lowest avgRating. A column
+ * can be decoded without the others, so a scan filtering on numVotes or avgRating never decodes a tConst.
+ * 
+ */
+struct CompressedRecords {
+  public:
+    uint numberOfRecords; // records packed
+    vector<MovieIdPrefix> movieIdPrefixes; // dictionary of the tConst prefixes of the block
+    uint prefixCodeBitWidth; // bits used by each code into the dictionary
+    int numVotesBase; // smallest numVotes of the block
+    uint numVotesBitWidth; // bits used by each numVotes delta
+    bool isRatingScaled; // whether every avgRating was a whole number of tenths, else the raw floats are packed
+    int ratingBase; // lowest avgRating in tenths, 0 when the raw floats are packed
+    uint ratingBitWidth; // bits used by each avgRating
+    vector<uint64_t> prefixCodes; // bit-packed dictionary codes
+    vector<uint64_t> suffixes; // bit-packed trailing digits, 0 for a tConst without a suffix
+    vector<uint64_t> numVotes; // bit-packed numVotes deltas
+    vector<uint64_t> ratings; // bit-packed avgRatings
+
+    /**
+     * @brief Construct an empty Compressed Records object.
+     * 
+     */
+    CompressedRecords() : numberOfRecords(0), prefixCodeBitWidth(0), numVotesBase(0), numVotesBitWidth(0), isRatingScaled(true),
+                          ratingBase(0), ratingBitWidth(0) {}
+
+    /**
+     * @brief Packs the records of a block, replacing the records packed before.
+     * 
+     * @param records The records of the block.
+     */
+    void encode(const vector<Record>& records);
+
+    /**
+     * @brief Packs one more record after the records packed, if it fits the dictionary, the bases and the
+     * bit widths they were packed with. The columns are then the same as if every record was packed again.
+     * 
+     * @param record The record added at the end of the block.
+     * @return true If the record was packed.
+     * @return false If the record needs wider columns, so the block has to be packed again with encode.
+     */
+    bool appendRecord(const Record& record);
+
+    /**
+     * @brief Decodes the numVotes of a record without decoding its other columns.
+     * 
+     * @param index Position of the record in the block.
+     * @return int The numVotes of the record.
+     */
+    int decodeNumVotes(uint index) const;
+
+    /**
+     * @brief Decodes the avgRating of a record without decoding its other columns.
+     * 
+     * @param index Position of the record in the block.
+     * @return float The avgRating of the record.
+     */
+    float decodeAvgRating(uint index) const;
+
+    /**
+     * @brief Decodes the code of the tConst prefix of a record into the dictionary.
+     * 
+     * @param index Position of the record in the block.
+     * @return uint Position of the prefix in movieIdPrefixes.
+     */
+    uint decodePrefixCode(uint index) const;
+
+    /**
+     * @brief Decodes the tConst of a record without decoding its other columns.
+     * 
+     * @param index Position of the record in the block.
+     * @param movieId Filled with the tConst, TCONSTSIZE characters padded with '\0'.
+     */
+    void decodeMovieId(uint index, char* movieId) const;
+
+    /**
+     * @brief Decodes every column of a record.
+     * 
+     * @param index Position of the record in the block.
+     * @return Record The record as it was stored.
+     */
+    Record decodeRecord(uint index) const;
+
+    /**
+     * @brief Get the bytes the packed records take in a block.
+     * 
+     * @return uint Size in bytes(B), header and dictionary included.
+     */
+    uint getSize() const;
+};
+
+/**
+ * @brief What a compressed block would need to pack its records, kept up to date record by record so
+ * a block can tell whether one more record still fits without packing it.
+ * 
+ */
+struct CompressionEstimate {
+  public:
+    uint numberOfRecords; // records counted
+    vector<MovieIdPrefix> movieIdPrefixes; // dictionary the records would be packed with
+    uint dictionaryBytes; // bytes the dictionary takes, a length byte and the characters per entry
+    bool hasSuffixes; // whether any tConst has trailing digits, else the suffix column is left out
+    int minNumVotes; // smallest numVotes counted
+    int maxNumVotes; // largest numVotes counted
+    bool isRatingScaled; // whether every avgRating counted is a whole number of tenths
+    int minRating; // lowest avgRating counted in tenths
+    int maxRating; // highest avgRating counted in tenths
+
+    /**
+     * @brief Construct an estimate of an empty block.
+     * 
+     */
+    CompressionEstimate() : numberOfRecords(0), dictionaryBytes(0), hasSuffixes(false), minNumVotes(0), maxNumVotes(0), isRatingScaled(true),
+                            minRating(0), maxRating(0) {}
+
+    /**
+     * @brief Counts one more record of the block.
+     * 
+     * @param record The record added to the block.
+     */
+    void addRecord(const Record& record);
+
+    /**
+     * @brief Get the bytes the records counted would take packed.
+     * 
+     * @return uint Size in bytes(B), header and dictionary included.
+     */
+    uint getSize() const;
+
+    /**
+     * @brief Get the bytes the records counted and one more would take packed.
+     * 
+     * @param record The record that may be added.
+     * @return uint Size in bytes(B), UINT_MAX if the dictionary would outgrow MAX_MOVIE_ID_PREFIXES.
+     */
+    uint getSizeWithRecord(const Record& record) const;
+};
+
+/**
+ * @brief Splits a tConst into the prefix kept in the dictionary and its trailing digits.
+ * 
+ * @param movieId The tConst.
+ * @param suffix Set to the value of the trailing digits, 0 if the tConst does not end with MOVIE_ID_SUFFIX_DIGITS digits.
+ * @return MovieIdPrefix The prefix.
+ */
+MovieIdPrefix splitMovieId(const char* movieId, uint& suffix);
+
+/**
+ * @brief Converts an avgRating into tenths, if no precision is lost.
+ * 
+ * @param avgRating The avgRating.
+ * @param scaledRating Set to the avgRating in tenths.
+ * @return true If the tenths convert back to the same avgRating.
+ * @return false If the avgRating has more than a single decimal.
+ */
+bool scaleRating(float avgRating, int& scaledRating);
+
+/**
+ * @brief Get the size of a compressed block: header, dictionary and every column rounded up to whole words.
+ * 
+ * @param numberOfRecords Records in the block.
+ * @param dictionaryBytes Bytes the dictionary takes.
+ * @param prefixCodeBitWidth Bits per dictionary code.
+ * @param hasSuffixes Whether the suffix column is stored.
+ * @param numVotesBitWidth Bits per numVotes delta.
+ * @param ratingBitWidth Bits per avgRating.
+ * @return uint Size of the block in bytes(B).
+ */
+uint getCompressedBlockSize(uint numberOfRecords, uint dictionaryBytes, uint prefixCodeBitWidth, bool hasSuffixes, uint numVotesBitWidth,
+                            uint ratingBitWidth);
+
+#endif
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cctype>
+
+#include "blocklayout.h"
+#include "record.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+uint getNodeLayoutSize(uint numberOfPointers, uint numberOfKeys, uint keySize, uint keyAlignment) {
+  uint pointersSize = numberOfPointers * sizeof(void *);
+  uint keysPadding = (keyAlignment - pointersSize % keyAlignment) % keyAlignment;
+  return pointersSize + keysPadding + numberOfKeys * keySize + sizeof(bool);
+}
+
+uint calulateMaximumKeysInBPTreeNode(uint blockSize, uint keySize, uint keyAlignment) {
+  // N keys take N+1 pointers, start from the keys that fit without padding and drop keys until the padding fits too
+  uint maxKeys = (blockSize - sizeof(void *) - sizeof(bool)) / (sizeof(void *) + keySize);
+  while (maxKeys > 0 && getNodeLayoutSize(maxKeys + 1, maxKeys, keySize, keyAlignment) > blockSize) {
+    --maxKeys;
+  }
+  return maxKeys;
+}
+
+uint getMaxBlkPtrsInOverflowBlock(uint blockSize) {
+  // blocksize minus 1 next pointer, the remaining space will be for blkPtrs
+  float numberOfBlocksInDecimal = float((float) (blockSize - float(sizeof(void *))) / float(sizeof(void *)));
+  uint maxBlkPtrs = floor(numberOfBlocksInDecimal);
+  return maxBlkPtrs;
+}
+
+uint getMaxAllowableRecordsInBlock(uint blockSize) {
+  uint recordSize = sizeof(Record);
+  uint maxAllowableRecords = floor(blockSize/recordSize);
+  return maxAllowableRecords;
+}
+
+uint parseBlockSize(const string& blockSizeText) {
+  uint digitsEnd = 0;
+  while (digitsEnd < blockSizeText.size() && isdigit(blockSizeText[digitsEnd])) {
+    ++digitsEnd;
+  }
+  string unit = blockSizeText.substr(digitsEnd);
+  for (char& character: unit) {
+    character = toupper(character);
+  }
+
+  // more than 9 digits is above any block size allowed, and would overflow
+  unsigned long long blockSize = 0;
+  if (digitsEnd > 0 && digitsEnd <= 9) {
+    blockSize = stoull(blockSizeText.substr(0, digitsEnd));
+  }
+  if (unit.compare("K") == 0 || unit.compare("KB") == 0 || unit.compare("KIB") == 0) {
+    blockSize *= KB;
+  } else if (!unit.empty() && unit.compare("B") != 0) {
+    blockSize = 0;
+  }
+
+  if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE) {
+    cout << "Invalid block size " << blockSizeText << ", expected " << MIN_BLOCK_SIZE << " to " << MAX_BLOCK_SIZE
+         << " bytes, e.g. 4096 or 4KB." << endl;
+    throw "Invalid block size";
+  }
+  return blockSize;
+}
@@ -0,0 +1,60 @@
+#ifndef H_BLOCKLAYOUT
+#define H_BLOCKLAYOUT
+
+#include <string>
+
+using namespace std;
+
+typedef unsigned int uint;
+
+#define MIN_BLOCK_SIZE 200 // smallest block the experiments were designed for
+#define MAX_BLOCK_SIZE 1048576 // 1MB, far above any page or cache size a node would be sized for
+#define KB 1024 // block sizes are given in binary kilobytes, so 4KB is a page
+
+/**
+ * @brief Get the bytes a tree node takes when laid out in a block: the pointers, then the keys aligned
+ * as their type requires, then the isLeaf flag. The flag goes last so it needs no padding.
+ *
+ * @param numberOfPointers Child pointers of an internal node, or record pointers and next pointer of a leaf.
+ * @param numberOfKeys Keys in the node.
+ * @param keySize Size of a key in bytes.
+ * @param keyAlignment Alignment of a key in bytes.
+ * @return uint Size of the node in bytes.
+ */
+uint getNodeLayoutSize(uint numberOfPointers, uint numberOfKeys, uint keySize, uint keyAlignment);
+
+/**
+ * @brief Calculate the maximum keys (N) in a tree node, the most keys whose node layout fits in a block.
+ *
+ * @param blockSize Block size specified by the user.
+ * @param keySize Size of a key in bytes, 4 for numVotes and avgRating, 10 for tConst.
+ * @param keyAlignment Alignment of a key in bytes.
+ * @return uint Parameter N
+ */
+uint calulateMaximumKeysInBPTreeNode(uint blockSize, uint keySize = sizeof(int), uint keyAlignment = alignof(int));
+
+/**
+ * @brief Get the Max Blk Ptrs In Overflow Block object.
+ *
+ * @param blockSize User specified blocksize.
+ * @return uint Maximum allowable block pointers in an overflow block.
+ */
+uint getMaxBlkPtrsInOverflowBlock(uint blockSize);
+
+/**
+ * @brief Get the Max Allowable Records In Block object.
+ *
+ * @param blockSize User specified block size.
+ * @return uint Maximum allowable records in a block.
+ */
+uint getMaxAllowableRecordsInBlock(uint blockSize);
+
+/**
+ * @brief Parses a block size given in bytes, e.g. 4096 or 4096B, or in kilobytes, e.g. 4KB or 4K.
+ *
+ * @param blockSizeText The block size as given on the command line or in a config file.
+ * @return uint The block size in bytes, between MIN_BLOCK_SIZE and MAX_BLOCK_SIZE.
+ */
+uint parseBlockSize(const string& blockSizeText);
+
+#endif
@@ -2,37 +2,71 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <set>
+#include <type_traits>
+#include <chrono>
 
 #include "bplustree.h"
 #include "node.h"
 #include "constants.h"
 #include "overflowblock.h"
+#include "indexkey.h"
+#include "keycompression.h"
+#include "instrumentation.h"
+#include "blocklayout.h"
+#include "epoch.h"
 
 using namespace std;
 
 typedef unsigned int uint;
 
 
-void BPlusTree::insertKey(int key, Block* blockPtr) {
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertKey(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns) {
+  INSTRUMENT_TREE_OPERATION(INSERT_KEY);
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  noteKeyChanged(key);
+  if (isBuffered && root != nullptr && !(*root).isLeaf) {
+    // the insert waits in the root buffer and is carried down together with the other buffered inserts
+    root->buffer.push_back(BufferedInsert<KeyType>(key, blockPtr, includedColumns));
+    ++bufferedInsertCounter;
+    if (root->buffer.size() > maxBufferedInserts) {
+      flushBuffer(root);
+    }
+    logChange(key, getIndexedAvgRating(key, includedColumns), true);
+    return;
+  }
+  insertKeyIntoTree(key, blockPtr, includedColumns);
+  // logged once inserted, as a unique index may turn the key down
+  logChange(key, getIndexedAvgRating(key, includedColumns), true);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertKeyIntoTree(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns) {
   if (root == nullptr) {
-    root = new Node();
+    root = new Node<KeyType>();
     ++nodeCounter;
+    ++leafCounter;
+    treeHeight = 1;
     (*root).isLeaf = true; // if root node is only node, it is a leaf node.
     (*root).keys.push_back(key);
+    refreshPackedKeys(root);
     OverflowBlock* overflowBlock = new OverflowBlock();
     ++overflowBlkCounter;
-    overflowBlock->blockPtrs.push_back(blockPtr); // dereference the overflowblock to get the object then push back the blkptr
+    addBlockPointerToOverflowBlock(overflowBlock, blockPtr, includedColumns);
     root->ptrs.push_back(overflowBlock); // add overflow block to pointers in node
   } else {
-    Node *parent = nullptr;
-    Node *cursor = root;
+    Node<KeyType>* parent = nullptr;
+    Node<KeyType>* cursor = root;
 
     // keep looping until we reach a leaf node
     while ((*cursor).isLeaf != true) {
+      INSTRUMENT_TREE_EVENT(NODE_VISIT);
       parent = cursor;
-      int ptrIdxToFollow = upper_bound((*cursor).keys.begin(), (*cursor).keys.end(), key) - (*cursor).keys.begin();
-      cursor = (Node *) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+      int ptrIdxToFollow = findChildIndex(cursor, key);
+      cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
     }
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
 
     // sanity check
     if (!(maxKeys >= (uint) (*cursor).keys.size())) {
@@ -42,35 +76,17 @@ void BPlusTree::insertKey(int key, Block* blockPtr) {
       int indexToInsert = 0;
       while (indexToInsert < (int)(*cursor).keys.size()) {
         // insert once you find a larger key
-        if (!((*cursor).keys[indexToInsert] == key) && key < (*cursor).keys[indexToInsert]) {
+        if (!keysEqual((*cursor).keys[indexToInsert], key) && keyCompare(key, (*cursor).keys[indexToInsert])) {
           break;
-        } else if ((*cursor).keys[indexToInsert] == key) {
+        } else if (keysEqual((*cursor).keys[indexToInsert], key)) {
+          if (isUnique) {
+            // a unique index can only ever point to a single record per key
+            cout << "Duplicate key cannot be inserted into a unique index." << endl;
+            throw "Duplicate key cannot be inserted into a unique index.";
+          }
           // if duplicate then you will be inserting at duplicate index in the overflow block
           // since duplicates are inserted in overflow blocks no new index key will be inserted.
-          OverflowBlock* currOverflowBlock = (OverflowBlock*) (*cursor).ptrs[indexToInsert];
-          if (currOverflowBlock->blockPtrs.size() < maxBlkPtrsInOverflowBlock) {
-            // if less than just insert
-            currOverflowBlock->blockPtrs.push_back(blockPtr);
-            return; // inserting duplicate simple case, once done can return
-          } else {
-            // if overflow block is full, keep checking until you can find an empty one.
-            while (currOverflowBlock->next != nullptr) {
-              currOverflowBlock = currOverflowBlock->next;
-              if (currOverflowBlock->blockPtrs.size() < maxBlkPtrsInOverflowBlock) {
-                // we found an empty space to insert in one of the overflow blocks
-                currOverflowBlock->blockPtrs.push_back(blockPtr);
-                return;
-              }
-            }
-          }
-
-          // if block is full and the next pointer = nullptr, means we need to create new overflow block
-          if (currOverflowBlock->blockPtrs.size() == maxBlkPtrsInOverflowBlock) {
-            OverflowBlock* newOverflowBlock = new OverflowBlock();
-            ++overflowBlkCounter;
-            currOverflowBlock->next = newOverflowBlock;
-            newOverflowBlock->blockPtrs.push_back(blockPtr);
-          }
+          addBlockPointerToOverflowChain((OverflowBlock*) (*cursor).ptrs[indexToInsert], blockPtr, includedColumns);
           return; // inserting duplicate simple case, once done return
         } else {
           ++indexToInsert; // if key is greater than all keys in array, the insertion index will be the current vector key size
@@ -84,48 +100,52 @@ void BPlusTree::insertKey(int key, Block* blockPtr) {
       
       // sufficient space to insert in current block
       // insert key into node, this is a brand new key since its not a duplicate
-      if (maxKeys > (*cursor).keys.size()) {
+      if (nodeHasSpaceForKey(cursor, key)) {
         // sufficient space to insert in current block
         // insert key into node, this is a brand new key since its not a duplicate
         (*cursor).keys.insert((*cursor).keys.begin() + indexToInsert, key);
+        refreshPackedKeys(cursor);
 
         OverflowBlock* overflowBlock = new OverflowBlock();
         ++overflowBlkCounter;
-        overflowBlock->blockPtrs.push_back(blockPtr);
+        addBlockPointerToOverflowBlock(overflowBlock, blockPtr, includedColumns);
         (*cursor).ptrs.insert((*cursor).ptrs.begin() + indexToInsert, overflowBlock);
         return;
       } else {
 
         // no space in current block (N+1) keys therefore, need to create new node for insertion 
         // current node already has maximum keys so need to split node (Remember to increment node counter)
-        Node* newLeafNode = new Node();
+        Node<KeyType>* newLeafNode = new Node<KeyType>();
         (*newLeafNode).isLeaf = true;
         ++nodeCounter;
+        ++leafCounter;
+        INSTRUMENT_TREE_EVENT(NODE_SPLIT);
 
         // create temporary holders and copy all elements into it
-        vector<int> tempKeys((*cursor).keys.begin(), (*cursor).keys.end());
+        vector<KeyType> tempKeys((*cursor).keys.begin(), (*cursor).keys.end());
         vector<void *> tempPtrs((*cursor).ptrs.begin(), (*cursor).ptrs.end());
 
         // insert key and pointer into temporary holders
         tempKeys.insert(tempKeys.begin() + indexToInsert, key);
         OverflowBlock* overflowBlock = new OverflowBlock();
         ++overflowBlkCounter;
-        overflowBlock->blockPtrs.push_back(blockPtr);
+        addBlockPointerToOverflowBlock(overflowBlock, blockPtr, includedColumns);
         tempPtrs.insert(tempPtrs.begin() + indexToInsert, overflowBlock);
 
         // split the temp vector into 2
         // we will build left bias tree as per lecture note definition
         // N+1 keys / 2, left node ceiling, right node floor.
-        float sizeOfLeftNodeInDecimal = (float)(maxKeys + 1)/(float)2;
+        // a compressed node can run out of space before N keys, so split on the keys actually held.
+        float sizeOfLeftNodeInDecimal = (float)tempKeys.size()/(float)2;
         int sizeOfLeftNode = ceil(sizeOfLeftNodeInDecimal);
         // float sizeOfRightNodeInDecimal = (float)(tempKeys.size()+1)/(float)2;
         // int sizeOfRightNode = floor(sizeOfRightNodeInDecimal);
 
-        vector<int> leftNodeKeys;
+        vector<KeyType> leftNodeKeys;
         for (int i = 0; i < sizeOfLeftNode; ++i) {
           leftNodeKeys.push_back(tempKeys[i]);
         }
-        vector<int> rightNodeKeys;
+        vector<KeyType> rightNodeKeys;
         for (uint i = sizeOfLeftNode; i < tempKeys.size(); ++i) {
           rightNodeKeys.push_back(tempKeys[i]);
         }
@@ -141,6 +161,8 @@ void BPlusTree::insertKey(int key, Block* blockPtr) {
 
         (*cursor).keys = leftNodeKeys;
         (*newLeafNode).keys = rightNodeKeys;
+        refreshPackedKeys(cursor);
+        refreshPackedKeys(newLeafNode);
 
         // update next pointer for left node
         leftNodePtrs.push_back((void*) newLeafNode); // cast it before pushing back
@@ -162,12 +184,14 @@ void BPlusTree::insertKey(int key, Block* blockPtr) {
         // if cursor is root node, means we need to create parent
         if (root == cursor) {
           // this happens when the cursor did not traverse (root == leaf)
-          Node* newRoot = new Node();
+          Node<KeyType>* newRoot = new Node<KeyType>();
           (*newRoot).isLeaf = false; // we are creating index node
           (*newRoot).keys.push_back((*newLeafNode).keys.front());
+          refreshPackedKeys(newRoot);
           (*newRoot).ptrs.push_back((void*) cursor);
           (*newRoot).ptrs.push_back((void*) newLeafNode);
           ++nodeCounter;
+          ++treeHeight;
           root = newRoot; // update the root of the B+ Tree
         } else {
           // if cursor is not root node means there is a parent above, so we need to go back to parent to update index
@@ -179,26 +203,238 @@ void BPlusTree::insertKey(int key, Block* blockPtr) {
   }
 }
 
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertBatch(const vector<pair<KeyType, Block*>>& batch) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (isCovering) {
+    cout << "A covering index needs the included columns of every record in the batch." << endl;
+    throw "A covering index needs the included columns of every record in the batch.";
+  }
+  vector<BufferedInsert<KeyType>> inserts;
+  inserts.reserve(batch.size());
+  for (auto& keyAndBlock: batch) {
+    noteKeyChanged(keyAndBlock.first);
+    inserts.push_back(BufferedInsert<KeyType>(keyAndBlock.first, keyAndBlock.second, IncludedColumns()));
+  }
+  insertBatchIntoTree(inserts);
+  for (auto& insert: inserts) {
+    logChange(insert.key, getIndexedAvgRating(insert.key, insert.includedColumns), true);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertBatch(vector<BufferedInsert<KeyType>> batch) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  for (auto& insert: batch) {
+    noteKeyChanged(insert.key);
+  }
+  insertBatchIntoTree(batch);
+  for (auto& insert: batch) {
+    logChange(insert.key, getIndexedAvgRating(insert.key, insert.includedColumns), true);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertBatchIntoTree(vector<BufferedInsert<KeyType>>& inserts) {
+  if (inserts.empty()) {
+    return;
+  }
+
+  // stable so the records of a key keep the order they were inserted in
+  KeyCompare compare = keyCompare;
+  stable_sort(inserts.begin(), inserts.end(), [compare](const BufferedInsert<KeyType>& first, const BufferedInsert<KeyType>& second) {
+    return compare(first.key, second.key);
+  });
+
+  if (isUnique) {
+    // reject the whole batch before any of it is inserted
+    for (uint i = 0; i < inserts.size(); ++i) {
+      if ((i > 0 && keysEqual(inserts[i - 1].key, inserts[i].key)) || containsKey(inserts[i].key)) {
+        cout << "Duplicate key cannot be inserted into a unique index." << endl;
+        throw "Duplicate key cannot be inserted into a unique index.";
+      }
+    }
+  }
+
+  if (root == nullptr) {
+    root = new Node<KeyType>();
+    (*root).isLeaf = true;
+    ++nodeCounter;
+    ++leafCounter;
+    treeHeight = 1;
+  }
+
+  uint runStart = 0;
+  while (runStart < inserts.size()) {
+    // descend once for the smallest remaining key, remembering the upper bound of the leaf reached
+    Node<KeyType>* cursor = root;
+    bool hasUpperBound = false;
+    KeyType upperBound = inserts[runStart].key;
+    while ((*cursor).isLeaf != true) {
+      INSTRUMENT_TREE_EVENT(NODE_VISIT);
+      int ptrIdxToFollow = findChildIndex(cursor, inserts[runStart].key);
+      if (ptrIdxToFollow < (int) (*cursor).keys.size()) {
+        hasUpperBound = true;
+        upperBound = (*cursor).keys[ptrIdxToFollow];
+      }
+      cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
+    }
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
+
+    // every key below the upper bound belongs to this leaf
+    uint runEnd = runStart + 1;
+    while (runEnd < inserts.size() && (!hasUpperBound || keyCompare(inserts[runEnd].key, upperBound))) {
+      ++runEnd;
+    }
+    insertRunIntoLeaf(cursor, inserts, runStart, runEnd);
+    runStart = runEnd;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertRunIntoLeaf(Node<KeyType>* cursor, const vector<BufferedInsert<KeyType>>& inserts, uint runStart, uint runEnd) {
+  // the last pointer of a leaf is the next leaf, unless it is the last leaf
+  bool hasNextLeaf = (*cursor).ptrs.size() > (*cursor).keys.size();
+  void* nextLeaf = hasNextLeaf ? (*cursor).ptrs.back() : nullptr;
+
+  // merge the keys of the leaf with the run, records of a key already in the leaf join its overflow chain
+  vector<KeyType> mergedKeys;
+  vector<void *> mergedPtrs;
+  mergedKeys.reserve((*cursor).keys.size() + runEnd - runStart);
+  mergedPtrs.reserve((*cursor).keys.size() + runEnd - runStart);
+  OverflowBlock* lastOverflowBlock = nullptr; // overflow block of the last merged key that the next pointer can go to
+  uint leafIdx = 0;
+  uint runIdx = runStart;
+  while (leafIdx < (*cursor).keys.size() || runIdx < runEnd) {
+    if (runIdx == runEnd || (leafIdx < (*cursor).keys.size() && !keyCompare(inserts[runIdx].key, (*cursor).keys[leafIdx]))) {
+      mergedKeys.push_back((*cursor).keys[leafIdx]);
+      mergedPtrs.push_back((*cursor).ptrs[leafIdx]);
+      lastOverflowBlock = (OverflowBlock*) (*cursor).ptrs[leafIdx];
+      ++leafIdx;
+      continue;
+    }
+    const BufferedInsert<KeyType>& bufferedInsert = inserts[runIdx];
+    ++runIdx;
+    if (!mergedKeys.empty() && keysEqual(mergedKeys.back(), bufferedInsert.key)) {
+      lastOverflowBlock = addBlockPointerToOverflowChain(lastOverflowBlock, bufferedInsert.blockPtr, bufferedInsert.includedColumns);
+    } else {
+      OverflowBlock* overflowBlock = new OverflowBlock();
+      ++overflowBlkCounter;
+      addBlockPointerToOverflowBlock(overflowBlock, bufferedInsert.blockPtr, bufferedInsert.includedColumns);
+      mergedKeys.push_back(bufferedInsert.key);
+      mergedPtrs.push_back(overflowBlock);
+      lastOverflowBlock = overflowBlock;
+    }
+  }
+
+  // split into the fewest leaves that hold the merged keys, left leaves take the extra key as in a single split
+  uint numberOfKeys = mergedKeys.size();
+  uint numberOfLeaves = (numberOfKeys + maxKeys - 1) / maxKeys;
+  vector<uint> leafStarts;
+  while (true) {
+    leafStarts.clear();
+    uint leafStart = 0;
+    bool allLeavesFit = true;
+    for (uint i = 0; i < numberOfLeaves; ++i) {
+      leafStarts.push_back(leafStart);
+      uint leafEnd = leafStart + numberOfKeys / numberOfLeaves + (i < numberOfKeys % numberOfLeaves ? 1 : 0);
+      allLeavesFit = allLeavesFit && keysFitInNode(mergedKeys, leafStart, leafEnd);
+      leafStart = leafEnd;
+    }
+    if (allLeavesFit) {
+      break;
+    }
+    ++numberOfLeaves; // a compressed leaf can run out of space before holding N keys
+  }
+  leafStarts.push_back(numberOfKeys);
+
+  vector<Node<KeyType>*> leaves;
+  leaves.push_back(cursor);
+  for (uint i = 1; i < numberOfLeaves; ++i) {
+    Node<KeyType>* newLeafNode = new Node<KeyType>();
+    (*newLeafNode).isLeaf = true;
+    ++nodeCounter;
+    ++leafCounter;
+    INSTRUMENT_TREE_EVENT(NODE_SPLIT);
+    leaves.push_back(newLeafNode);
+  }
+  for (uint i = 0; i < numberOfLeaves; ++i) {
+    Node<KeyType>* leaf = leaves[i];
+    (*leaf).keys.assign(mergedKeys.begin() + leafStarts[i], mergedKeys.begin() + leafStarts[i + 1]);
+    (*leaf).ptrs.assign(mergedPtrs.begin() + leafStarts[i], mergedPtrs.begin() + leafStarts[i + 1]);
+    if (i + 1 < numberOfLeaves) {
+      (*leaf).ptrs.push_back((void*) leaves[i + 1]);
+    } else if (hasNextLeaf) {
+      (*leaf).ptrs.push_back(nextLeaf);
+    }
+    refreshPackedKeys(leaf);
+  }
+
+  // link the new leaves into the tree, each goes right after the leaf before it
+  uint firstLeafToLink = 1;
+  if (numberOfLeaves > 1 && root == cursor) {
+    Node<KeyType>* newRoot = new Node<KeyType>();
+    (*newRoot).isLeaf = false;
+    (*newRoot).keys.push_back((*leaves[1]).keys.front());
+    (*newRoot).ptrs.push_back((void*) cursor);
+    (*newRoot).ptrs.push_back((void*) leaves[1]);
+    refreshPackedKeys(newRoot);
+    ++nodeCounter;
+    ++treeHeight;
+    root = newRoot;
+    firstLeafToLink = 2;
+  }
+  for (uint i = firstLeafToLink; i < numberOfLeaves; ++i) {
+    insertInternal(findParentByKey(leaves[i - 1], (*leaves[i - 1]).keys.front()), leaves[i], (*leaves[i]).keys.front());
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+Node<KeyType>* BPlusTree<KeyType, KeyCompare>::findParentByKey(Node<KeyType>* child, const KeyType& key) {
+  Node<KeyType>* cursor = root;
+  while (cursor != nullptr && (*cursor).isLeaf != true) {
+    Node<KeyType>* nextNode = (Node<KeyType>*) (*cursor).ptrs[findChildIndex(cursor, key)];
+    if (nextNode == child) {
+      return cursor;
+    }
+    cursor = nextNode;
+  }
+  return findParent(child, root);
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::keysFitInNode(const vector<KeyType>& keys, uint begin, uint end) {
+  uint numberOfKeys = end - begin;
+  if (numberOfKeys > maxKeys) {
+    return false;
+  } else if (!isCompressed || numberOfKeys == 0) {
+    return true;
+  }
+  return getCompressedNodeSizeOfRange(keys[begin], keys[end - 1], numberOfKeys) <= nodeBlockSize;
+}
+
 // parent node is now the cursor, child represents the new leaf node just created
-void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::insertInternal(Node<KeyType>* cursor, Node<KeyType>* child, KeyType key) {
 
   if (!(maxKeys >= (uint) (*cursor).keys.size())) {
     //sanity check, parent node cannot have more keys than allowable size.
     cout << "Node cannot more keys than allowable." << endl;
     throw "Node cannot more keys than allowable.";
-  } else if (maxKeys == (*cursor).keys.size()) {
+  } else if (!nodeHasSpaceForKey(cursor, key)) {
     // parent node already has maximum keys so need to split parent node into 2 internal nodes (N+2) child scenario
-    Node* newInternalNode = new Node();
+    Node<KeyType>* newInternalNode = new Node<KeyType>();
     (*newInternalNode).isLeaf = false;
     ++nodeCounter;
+    INSTRUMENT_TREE_EVENT(NODE_SPLIT);
     
     // temporary vectors to hold the keys and pointers in the parent node
-    vector<int> tempKeys((*cursor).keys.begin(), (*cursor).keys.end());
+    vector<KeyType> tempKeys((*cursor).keys.begin(), (*cursor).keys.end());
     vector<void *> tempPtrs((*cursor).ptrs);
 
     int indexToInsert = 0;
     while (indexToInsert < (int) tempKeys.size()) {
-      if (key < tempKeys[indexToInsert]) {
+      if (keyCompare(key, tempKeys[indexToInsert])) {
         break;
       } else {
         ++indexToInsert; // if the key is greater than all the keys in array, insert at the end
@@ -212,17 +448,17 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
 
     // split the temp vector into 2
     // we will build left bias tree as per lecture note definition
-    float sizeOfLeftNodeInDecimal = (float)(maxKeys+1)/(float)2;
+    float sizeOfLeftNodeInDecimal = (float)tempKeys.size()/(float)2;
     int sizeOfLeftNode = ceil(sizeOfLeftNodeInDecimal);
     // float sizeOfRightNodeInDecimal = (float)(tempKeys.size()+1)/(float)2;
     // int sizeOfRightNode = floor(sizeOfRightNodeInDecimal); //not used
 
     // update keys for then nodes that were split
-    vector<int> leftNodeKeys;
+    vector<KeyType> leftNodeKeys;
     for (int i = 0; i < sizeOfLeftNode; ++i) {
       leftNodeKeys.push_back(tempKeys[i]);
     }
-    vector<int> rightNodeKeys;
+    vector<KeyType> rightNodeKeys;
     // note it is sizeOfLeftNode + 1, because the key at that index will propagate upwards
     for (uint i = sizeOfLeftNode + 1; i < tempKeys.size(); ++i) {
       rightNodeKeys.push_back(tempKeys[i]);
@@ -239,13 +475,28 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
 
     (*cursor).keys = leftNodeKeys;
     (*newInternalNode).keys = rightNodeKeys;
+    refreshPackedKeys(cursor);
+    refreshPackedKeys(newInternalNode);
 
     (*cursor).ptrs = leftNodePtrs;
     (*newInternalNode).ptrs = rightNodePtrs;
 
     // this key was not inserted into both internal nodes, it will be inserted at higher level or new root.
     int indexOfNewKeyToInsert = sizeOfLeftNode;
-    int newIndexKeyToInsert = tempKeys[indexOfNewKeyToInsert];
+    KeyType newIndexKeyToInsert = tempKeys[indexOfNewKeyToInsert];
+
+    // buffered inserts follow the children they are routed to, keys from the new separator onwards go right
+    if (!(*cursor).buffer.empty()) {
+      vector<BufferedInsert<KeyType>> leftNodeBuffer;
+      for (auto& bufferedInsert: (*cursor).buffer) {
+        if (keyCompare(bufferedInsert.key, newIndexKeyToInsert)) {
+          leftNodeBuffer.push_back(bufferedInsert);
+        } else {
+          (*newInternalNode).buffer.push_back(bufferedInsert);
+        }
+      }
+      (*cursor).buffer.swap(leftNodeBuffer);
+    }
 
     // free up space after assignment
     tempKeys.clear();
@@ -258,12 +509,14 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
     if (root == cursor) {
       // this happens when the current parent is already the root
       // hence splitting the root node would require creation of a new root
-      Node* newRoot = new Node();
+      Node<KeyType>* newRoot = new Node<KeyType>();
       (*newRoot).isLeaf = false;
       (*newRoot).keys.push_back(newIndexKeyToInsert);
+      refreshPackedKeys(newRoot);
       (*newRoot).ptrs.push_back((void*) cursor);
       (*newRoot).ptrs.push_back((void*) newInternalNode);
       ++nodeCounter;
+      ++treeHeight;
       root = newRoot; // update the root of the B+ Tree
     } else {
       // if cursor is not root means that we need to further propagate upwards and find the parent of this new node
@@ -280,7 +533,7 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
 
     int indexToInsert = 0;
     while (indexToInsert < (int) (*cursor).keys.size()) {
-      if (key < (*cursor).keys[indexToInsert]) {
+      if (keyCompare(key, (*cursor).keys[indexToInsert])) {
         break;
       } else {
         ++indexToInsert; // if the key is greater than all the keys in array, insert at the end
@@ -288,6 +541,7 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
     }
     // insert key into node
     (*cursor).keys.insert((*cursor).keys.begin() + indexToInsert, key);
+    refreshPackedKeys(cursor);
     // insert pointer to child into node, note it is index + 1, due to the property of B+ Tree:
     // [Left key, right key)
     (*cursor).ptrs.insert((*cursor).ptrs.begin() + indexToInsert + 1, (void*) child);
@@ -296,13 +550,15 @@ void BPlusTree::insertInternal(Node* cursor, Node* child, int key) {
 
 // root becomes cursor top down approach to find parent
 // the cursor passed in is the node in which we want to find the parent for, so we reference it as child.
-Node* BPlusTree::findParent(Node* child, Node* cursor) {
-  Node* parent = nullptr;
+template <typename KeyType, typename KeyCompare>
+Node<KeyType>* BPlusTree<KeyType, KeyCompare>::findParent(Node<KeyType>* child, Node<KeyType>* cursor) {
+  INSTRUMENT_TREE_EVENT(FIND_PARENT_CALL);
+  Node<KeyType>* parent = nullptr;
   // if root is leaf, it has no parent, likewise if root points to a leaf node, then it has no parent
   if ((*cursor).isLeaf) {
     return nullptr;
   }
-  // } else if (((Node*) (cursor->ptrs.front()))->isLeaf) {
+  // } else if (((Node<KeyType>*) (cursor->ptrs.front()))->isLeaf) {
   //   return nullptr;
   // }
   for (uint i = 0; i < (*cursor).ptrs.size(); ++i) {
@@ -313,7 +569,7 @@ Node* BPlusTree::findParent(Node* child, Node* cursor) {
     } else {
       // recursively call find parent
       // essentially looping through every node until find the parent
-      parent = findParent(child, (Node*) (*cursor).ptrs[i]); // need to cast void pointer to pointer to node
+      parent = findParent(child, (Node<KeyType>*) (*cursor).ptrs[i]); // need to cast void pointer to pointer to node
       if (parent == nullptr) {
         continue;
       } else {
@@ -324,20 +580,19 @@ Node* BPlusTree::findParent(Node* child, Node* cursor) {
   return parent;
 }
 
-void BPlusTree::updateParentKey(Node* child, int key) {
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::updateParentKey(Node<KeyType>* child, KeyType key) {
   // find the parent of this child so we can update it.
-  Node *parent = findParent(child, root);
+  Node<KeyType>* parent = findParent(child, root);
   int indexOfPointerToChild = 0;
-  cout << parent->ptrs.size() << "size of parent." << endl;
   while (indexOfPointerToChild < (int) parent->ptrs.size()) {
-    if ((Node*) parent->ptrs[indexOfPointerToChild] == child) {
+    if ((Node<KeyType>*) parent->ptrs[indexOfPointerToChild] == child) {
       // we found the index of the pointer pointing to the child.
       break;
     } else {
       ++indexOfPointerToChild;
     }
   }
-  cout << "Inside parent key function." << endl;
   if (indexOfPointerToChild == 0) {
     // again in the parent its the 1st pointer. ("1st key")
     if (parent != root) {
@@ -345,48 +600,46 @@ void BPlusTree::updateParentKey(Node* child, int key) {
     } else {
       return;
     }
-  } else {
+  } else if (canReplaceKey(parent, indexOfPointerToChild - 1, key)) {
     parent->keys[indexOfPointerToChild - 1] = key; // if not just update the parent above with the approriate key.
+    refreshPackedKeys(parent);
   }
+  // otherwise the compressed parent has no room for the wider key, the old separator is still a valid lower bound of the child.
 }
 
-uint BPlusTree::deleteRecordByKey(int key) {
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::deleteRecordByKey(KeyType key) {
+  INSTRUMENT_TREE_OPERATION(DELETE_RECORD_BY_KEY);
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  noteKeyChanged(key);
 
   uint nodesDeletedCounter = 0;
 
+  // borrowing and merging moves children between internal nodes, so no insert may be left in a buffer
+  flushAllBuffers();
+  logRemovedOverflowChain(key, findOverflowBlockOfKey(key));
+
   if (root == nullptr) {
     cout << "Your B+ Tree is empty. Try inserting some elements first!" << endl;
     return nodesDeletedCounter;
   } else {
-    Node* parent;
-    Node* cursor = root;
-    int leftSiblingIdx, rightSiblingIdx;
+    Node<KeyType>* parent = nullptr; // stays nullptr when the root is the only leaf
+    Node<KeyType>* cursor = root;
 
     // loop until we find the leaf node which may potentially contain the key of the record to be deleted
     while ((*cursor).isLeaf != true) {
+      INSTRUMENT_TREE_EVENT(NODE_VISIT);
       parent = cursor;
-      int ptrIdxToFollow = upper_bound((*cursor).keys.begin(), (*cursor).keys.end(), key) - (*cursor).keys.begin();
-      cursor = (Node *)(*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
-      leftSiblingIdx = ptrIdxToFollow - 1;
-      rightSiblingIdx = ptrIdxToFollow + 1;
-    }
-
-    // at leaf level, we will see if this node has a left sibling or right sibling in case we need to borrow or merge
-    bool hasLeftSibling = false;
-    bool hasRightSibling = false;
-    if (leftSiblingIdx >= 0) {
-      hasLeftSibling = true;
-    }
-    if (rightSiblingIdx <= (int)parent->keys.size()) {
-      hasRightSibling = true;
+      int ptrIdxToFollow = findChildIndex(cursor, key);
+      cursor = (Node<KeyType>*)(*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
     }
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
 
     // now we are at leaf node which will potentially contain of the key we want to remove
     int indexToDelete = 0;
     while (indexToDelete < (int) (*cursor).keys.size()) {
-      if ( (*cursor).keys[indexToDelete] == key ) {
+      if (keysEqual((*cursor).keys[indexToDelete], key)) {
         break; // once key is found, break out optimise.
-        cout << "Index delete is:" << endl;
       } else {
         ++indexToDelete;
         if (indexToDelete == (int) (*cursor).keys.size()) {
@@ -396,222 +649,260 @@ uint BPlusTree::deleteRecordByKey(int key) {
         }
       }
     }
+    if ((*cursor).keys.empty()) {
+      // lazy deletes can leave a leaf without keys
+      cout << "The key " << key << "does not exist. Try deleting another key instead!" << endl;
+      return nodesDeletedCounter;
+    }
 
     // Case 1: Simple deletion, after deleting the node still has sufficient keys. floor(N+1 / 2).
 
     int overflowBlocksDeletedCounter = 0;
     int recordsDeletedCounter = 0;
     OverflowBlock* overflowBlockToDelete = (OverflowBlock*) (*cursor).ptrs[indexToDelete];
-    if (overflowBlockToDelete->blockPtrs.size() < maxBlkPtrsInOverflowBlock) {
-      // if less than means its the only overflow block, we just delete it and we are done.
-      ++overflowBlocksDeletedCounter;
-      for (auto blkPtr: overflowBlockToDelete->blockPtrs) {
-        recordsDeletedCounter += blkPtr->deleteRecord(key);
-      }
-      --overflowBlkCounter;
-      delete overflowBlockToDelete;
-    } else if (overflowBlockToDelete->blockPtrs.size() == maxBlkPtrsInOverflowBlock && overflowBlockToDelete->next == nullptr) {
-      // if it contains the maximum number of ptrs, and next ptr is null means only 1 block.
-      // simple deletion, delete and wer are done.
+    // walk the whole chain, removeBlockPointerFromKey can leave a partially filled block in front of a full one.
+    while (overflowBlockToDelete != nullptr) {
       ++overflowBlocksDeletedCounter;
       for (auto blkPtr: overflowBlockToDelete->blockPtrs) {
-        recordsDeletedCounter += blkPtr->deleteRecord(key);
+        recordsDeletedCounter += deleteRecordsWithKey(blkPtr, key);
       }
+      OverflowBlock* temp = overflowBlockToDelete->next;
       --overflowBlkCounter;
-      delete overflowBlockToDelete;
-    } else {
-      // if overflow block is full, keep checking until you can find an empty one.
-      while (overflowBlockToDelete != nullptr) {
-        ++overflowBlocksDeletedCounter;
-        for (auto blkPtr: overflowBlockToDelete->blockPtrs) {
-          recordsDeletedCounter += blkPtr->deleteRecord(key);
-        }
-        OverflowBlock* temp = overflowBlockToDelete->next;
-        --overflowBlkCounter;
-        delete overflowBlockToDelete;
-        overflowBlockToDelete = temp;
-      }
+      indexedRecordCounter -= overflowBlockToDelete->blockPtrs.size();
+      retire(overflowBlockToDelete);
+      overflowBlockToDelete = temp;
     }
 
     cout << "The number of overflow blocks deleted is: " << overflowBlocksDeletedCounter << endl;
     cout << "The number of records deleted is: " << recordsDeletedCounter << endl;
 
-    (*cursor).keys.erase((*cursor).keys.begin() + indexToDelete);
-    (*cursor).ptrs.erase((*cursor).ptrs.begin() + indexToDelete); // remove pointer from the array of ptrs
+    nodesDeletedCounter += removeKeyFromLeaf(cursor, parent, indexToDelete);
+    return nodesDeletedCounter;
+  }
+}
 
-    // if our cursor is root(LEAF IS ROOT), no upper level index nodes to delete
-    if (cursor == root && (*cursor).keys.empty()) {
-      // if keys vector is empty, means no more keys in node, delete it.
-        --nodeCounter; // decrement number of nodes in tree
-        ++nodesDeletedCounter; // increment the counter of nodes deleted
-        root = nullptr; // tree becomes empty
-        cout << "Tree is now empty." << endl;
-        delete cursor;
-        return nodesDeletedCounter;
-    } else if (cursor == root && !((*cursor).keys.empty())) {
-      // root node has no restriction on minimum number of keys hence, don't need to check
-      // deleting at root level without deleting root means you won't have any nodes deleted.
-      return nodesDeletedCounter; // should be 0.
-    }
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::removeKeyFromLeaf(Node<KeyType>* cursor, Node<KeyType>* parent, int indexToDelete) {
 
-    // if you are deleting the first key of leaf node, need to propogate upwards and check to remove any instances of this key.
-    if (indexToDelete == 0) {
-      updateParentKey(cursor, (*cursor).keys.front());
-    }
+  uint nodesDeletedCounter = 0;
 
-    // when doing integer division, the result would always floor since our result will always be POSITIVE
-    uint minimumKeysInLeafNode = floor((maxKeys + 1) / 2);
-    if ((*cursor).keys.size() >= minimumKeysInLeafNode) {
-      // Case 1: Simple deletion, after deleting the node still has sufficient keys. floor(N+1 / 2).
-      return nodesDeletedCounter; //control flow tested.
-    }
+  // only noted as it drops below the minimum, a leaf already underfull is noted already
+  if (isLazyDeleting && cursor != root && (*cursor).keys.size() == minimumLeafKeys) {
+    underfullLeafKeys.push_back((*cursor).keys[indexToDelete]);
+  }
+  (*cursor).keys.erase((*cursor).keys.begin() + indexToDelete);
+  (*cursor).ptrs.erase((*cursor).ptrs.begin() + indexToDelete); // remove pointer from the array of ptrs
+  refreshPackedKeys(cursor);
 
-    // Case 2: Deletion result in insufficient keys, try to borrow from sibling nodes.
-    // Always borrow from left if possible, if cannot, then borrow from right.
-    // check if left sibling exists
-    if (hasLeftSibling) {
-      Node* leftSiblingNode = (Node*) parent->ptrs[leftSiblingIdx];
+  if (isLazyDeleting) {
+    // the leaf may stay underfull or even empty until the maintenance thread merges it
+    ++lazyDeleteCounter;
+    return nodesDeletedCounter;
+  }
 
-      // Assuming we borrow, then number of keys in left sibling node will -1,
-      // These number of nodes after borrowing MUST still be >= minimumKeysInLeafNode
-      if (((*leftSiblingNode).keys.size() - 1) >= minimumKeysInLeafNode) {
+  // if our cursor is root(LEAF IS ROOT), no upper level index nodes to delete
+  if (cursor == root && (*cursor).keys.empty()) {
+    // if keys vector is empty, means no more keys in node, delete it.
+      --nodeCounter; // decrement number of nodes in tree
+      --leafCounter;
+      ++nodesDeletedCounter; // increment the counter of nodes deleted
+      root = nullptr; // tree becomes empty
+      treeHeight = 0;
+      cout << "Tree is now empty." << endl;
+      retire(cursor);
+      return nodesDeletedCounter;
+  } else if (cursor == root && !((*cursor).keys.empty())) {
+    // root node has no restriction on minimum number of keys hence, don't need to check
+    // deleting at root level without deleting root means you won't have any nodes deleted.
+    return nodesDeletedCounter; // should be 0.
+  }
 
-        // since we can borrow left node, we will transfer left sibling's last key and pointer to data block
-        
-        // insert last key of left sibling into cursor
-        (*cursor).keys.insert((*cursor).keys.begin(), (*leftSiblingNode).keys[(*leftSiblingNode).keys.size() - 1]); // insert to front of cursor
+  // if you are deleting the first key of leaf node, need to propogate upwards and check to remove any instances of this key.
+  if (indexToDelete == 0 && !(*cursor).keys.empty()) {
+    updateParentKey(cursor, (*cursor).keys.front());
+  }
 
-        // insert 2nd last pointer of left sibling into cursor
-        // if there is left sibling, means that the left sibling has a "nextLeafPtr"
-        // Hence, note it is pts.size() - 2,so the pointer we are extracting will be that for data NOT the nextptr.
-        (*cursor).ptrs.insert((*cursor).ptrs.begin(), (*leftSiblingNode).ptrs[(*leftSiblingNode).ptrs.size() - 2]); // insert to front of cursor
+  // when doing integer division, the result would always floor since our result will always be POSITIVE
+  uint minimumKeysInLeafNode = floor((maxKeys + 1) / 2);
+  if ((*cursor).keys.size() >= minimumKeysInLeafNode) {
+    // Case 1: Simple deletion, after deleting the node still has sufficient keys. floor(N+1 / 2).
+    return nodesDeletedCounter; //control flow tested.
+  }
 
-        // removing the last key
-        (*leftSiblingNode).keys.erase((*leftSiblingNode).keys.begin() + ((*leftSiblingNode).keys.size()-1));
+  // at leaf level, we will see if this node has a left sibling or right sibling in case we need to borrow or merge
+  int cursorIdx = 0;
+  while ((Node<KeyType>*) parent->ptrs[cursorIdx] != cursor) {
+    ++cursorIdx;
+  }
+  int leftSiblingIdx = cursorIdx - 1;
+  int rightSiblingIdx = cursorIdx + 1;
+  bool hasLeftSibling = false;
+  bool hasRightSibling = false;
+  if (leftSiblingIdx >= 0) {
+    hasLeftSibling = true;
+  }
+  if (rightSiblingIdx <= (int)parent->keys.size()) {
+    hasRightSibling = true;
+  }
 
-        // removing the 2nd last pointer
-        (*leftSiblingNode).ptrs.erase((*leftSiblingNode).ptrs.begin() + ((*leftSiblingNode).ptrs.size() - 2));
+  // Case 2: Deletion result in insufficient keys, try to borrow from sibling nodes.
+  // Always borrow from left if possible, if cannot, then borrow from right.
+  // check if left sibling exists
+  if (hasLeftSibling) {
+    Node<KeyType>* leftSiblingNode = (Node<KeyType>*) parent->ptrs[leftSiblingIdx];
 
-        // since we update the first key of cursor, set the left bound of this pointer in parent node to new the new key
-        parent->keys[leftSiblingIdx] = (*cursor).keys.front();
-        
-        // note when we borrow no nodes are deleted.
-        return nodesDeletedCounter; //control flow tested. leaf level borrow from left
-      }
+    // Assuming we borrow, then number of keys in left sibling node will -1,
+    // These number of nodes after borrowing MUST still be >= minimumKeysInLeafNode
+    if (((*leftSiblingNode).keys.size() - 1) >= minimumKeysInLeafNode
+        && nodeHasSpaceForKey(cursor, (*leftSiblingNode).keys.back())
+        && canReplaceKey(parent, leftSiblingIdx, (*leftSiblingNode).keys.back())) {
 
-    }
+      // since we can borrow left node, we will transfer left sibling's last key and pointer to data block
+      INSTRUMENT_TREE_EVENT(NODE_BORROW);
+      
+      // insert last key of left sibling into cursor
+      (*cursor).keys.insert((*cursor).keys.begin(), (*leftSiblingNode).keys[(*leftSiblingNode).keys.size() - 1]); // insert to front of cursor
 
-    // if we can't borrow from left sibling, check if right sibling exists.
-    if (hasRightSibling) {
-      Node* rightSiblingNode = (Node*) parent->ptrs[rightSiblingIdx];
+      // insert 2nd last pointer of left sibling into cursor
+      // if there is left sibling, means that the left sibling has a "nextLeafPtr"
+      // Hence, note it is pts.size() - 2,so the pointer we are extracting will be that for data NOT the nextptr.
+      (*cursor).ptrs.insert((*cursor).ptrs.begin(), (*leftSiblingNode).ptrs[(*leftSiblingNode).ptrs.size() - 2]); // insert to front of cursor
 
-      // Assuming we borrow, then number of keys in right sibling node will -1,
-      // These number of nodes after borrowing MUST still be >= minimumKeysInLeafNode
-      if (((*rightSiblingNode).keys.size() - 1) >= minimumKeysInLeafNode) {
+      // removing the last key
+      (*leftSiblingNode).keys.erase((*leftSiblingNode).keys.begin() + ((*leftSiblingNode).keys.size()-1));
 
-        // since we can borrow from right node, we will transfer right sibling's first key and pointer to data block
+      // removing the 2nd last pointer
+      (*leftSiblingNode).ptrs.erase((*leftSiblingNode).ptrs.begin() + ((*leftSiblingNode).ptrs.size() - 2));
 
-        (*cursor).keys.push_back((*rightSiblingNode).keys.front()); // insert key to back of cursor
+      // since we update the first key of cursor, set the left bound of this pointer in parent node to new the new key
+      parent->keys[leftSiblingIdx] = (*cursor).keys.front();
+      refreshPackedKeys(cursor);
+      refreshPackedKeys(leftSiblingNode);
+      refreshPackedKeys(parent);
+      
+      // note when we borrow no nodes are deleted.
+      return nodesDeletedCounter; //control flow tested. leaf level borrow from left
+    }
 
-        // if we can borrow from right sibling means, the ptrs array in cursor has a nextPtr
-        // hence we need to insert the ptr before the nextPtr (2nd last element)
-        (*cursor).ptrs.insert((*cursor).ptrs.begin() + (*cursor).ptrs.size()-1, (*rightSiblingNode).ptrs.front()); // insert pointer to last key position
+  }
 
-        // removing the first key from right sibling
-        (*rightSiblingNode).keys.erase((*rightSiblingNode).keys.begin());
-        // removing first pointer from right sibling
-        (*rightSiblingNode).ptrs.erase((*rightSiblingNode).ptrs.begin());
+  // if we can't borrow from left sibling, check if right sibling exists.
+  if (hasRightSibling) {
+    Node<KeyType>* rightSiblingNode = (Node<KeyType>*) parent->ptrs[rightSiblingIdx];
 
-        // borrow from right sibling means, we need to update the key before right sibling pointer(LEFT BOUND) 
-        // with the new 1st key of the right sibling node!
-        parent->keys[rightSiblingIdx-1] = (*rightSiblingNode).keys.front();
-        
-        // note when we borrow no nodes are deleted.
-        cout << "Number of nodes deleted: " << nodesDeletedCounter << endl;
-        cout << "Number of nodes in tree: " << nodeCounter << endl;
-        return nodesDeletedCounter; //control flow tested
-      }
+    // Assuming we borrow, then number of keys in right sibling node will -1,
+    // These number of nodes after borrowing MUST still be >= minimumKeysInLeafNode
+    if (((*rightSiblingNode).keys.size() - 1) >= minimumKeysInLeafNode
+        && nodeHasSpaceForKey(cursor, (*rightSiblingNode).keys.front())
+        && canReplaceKey(parent, rightSiblingIdx - 1, (*rightSiblingNode).keys[1])) {
+
+      // since we can borrow from right node, we will transfer right sibling's first key and pointer to data block
+      INSTRUMENT_TREE_EVENT(NODE_BORROW);
+
+      (*cursor).keys.push_back((*rightSiblingNode).keys.front()); // insert key to back of cursor
+
+      // if we can borrow from right sibling means, the ptrs array in cursor has a nextPtr
+      // hence we need to insert the ptr before the nextPtr (2nd last element)
+      (*cursor).ptrs.insert((*cursor).ptrs.begin() + (*cursor).ptrs.size()-1, (*rightSiblingNode).ptrs.front()); // insert pointer to last key position
+
+      // removing the first key from right sibling
+      (*rightSiblingNode).keys.erase((*rightSiblingNode).keys.begin());
+      // removing first pointer from right sibling
+      (*rightSiblingNode).ptrs.erase((*rightSiblingNode).ptrs.begin());
+
+      // borrow from right sibling means, we need to update the key before right sibling pointer(LEFT BOUND) 
+      // with the new 1st key of the right sibling node!
+      parent->keys[rightSiblingIdx-1] = (*rightSiblingNode).keys.front();
+      refreshPackedKeys(cursor);
+      refreshPackedKeys(rightSiblingNode);
+      refreshPackedKeys(parent);
+      
+      // note when we borrow no nodes are deleted.
+      return nodesDeletedCounter; //control flow tested
     }
+  }
 
-    // we cant borrow from both left sibling or right sibling, thus we for sure can merge.
-    // Our algo will always try to merge the one on the left first
+  // we cant borrow from both left sibling or right sibling, thus we for sure can merge.
+  // Our algo will always try to merge the one on the left first
 
-    // if left sibling exist, DEFINITELY can merge.
-    if (hasLeftSibling) {
-      Node* leftSiblingNode = (Node*) parent->ptrs[leftSiblingIdx];
+  // if left sibling exist, DEFINITELY can merge, unless the packed keys of a compressed node would not fit.
+  if (hasLeftSibling && canMergeNodes((Node<KeyType>*) parent->ptrs[leftSiblingIdx], cursor, nullptr)) {
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    Node<KeyType>* leftSiblingNode = (Node<KeyType>*) parent->ptrs[leftSiblingIdx];
 
-      // remove the nextptr of the left sibling since we are merging with it
-      (*leftSiblingNode).ptrs.pop_back();
-      
-      // we will keep the left sibling node so add all elements from cursor to left sibling
-      // Optimization: easier to push_back then to insert at front because inserting at front involves shifting.
-      for (uint i = 0; i < (*cursor).keys.size(); ++i) {
-        (*leftSiblingNode).keys.push_back((*cursor).keys[i]);
-      }
-      for (uint i = 0; i < (*cursor).ptrs.size(); ++i) {
-        (*leftSiblingNode).ptrs.push_back((*cursor).ptrs[i]); //the nextptr of cursor will also be added to the left sibling node.
-      }
+    // remove the nextptr of the left sibling since we are merging with it
+    (*leftSiblingNode).ptrs.pop_back();
+    
+    // we will keep the left sibling node so add all elements from cursor to left sibling
+    // Optimization: easier to push_back then to insert at front because inserting at front involves shifting.
+    for (uint i = 0; i < (*cursor).keys.size(); ++i) {
+      (*leftSiblingNode).keys.push_back((*cursor).keys[i]);
+    }
+    for (uint i = 0; i < (*cursor).ptrs.size(); ++i) {
+      (*leftSiblingNode).ptrs.push_back((*cursor).ptrs[i]); //the nextptr of cursor will also be added to the left sibling node.
+    }
+    refreshPackedKeys(leftSiblingNode);
 
-      ++nodesDeletedCounter; // // when we merge it is equivalent of deleting a node.
-      --nodeCounter; // decrement number of tree nodes
-      cout << "Key to pass to internal to delete is: " << parent->keys[leftSiblingIdx] << endl;
-      // we will be removing cursor, thus we need to delete the key of LEFT BOUND of the pointer to cursor.
-      // this is the key of the left sibling ptr index.
-      nodesDeletedCounter += removeInternal(parent, cursor, parent->keys[leftSiblingIdx]);
-      // delete cursor;
-      cout << "Number of nodes deleted after merging with left: " << nodesDeletedCounter << endl;
-      cout << "Number of nodes in tree: " << nodeCounter << endl;
-      return nodesDeletedCounter;
-    } else if (hasRightSibling) {
-      // if left sibling don't exist then we will need to merge with right sibling. 
-      // NOTE: If right sibling exist, DEFINITELY can merge. A node will definitely have a sibling unless it is root.
-      Node* rightSiblingNode = (Node*) parent->ptrs[rightSiblingIdx];
-
-      // remove the nextptr of the cursor since we are merging with right sibling
-      (*cursor).ptrs.pop_back();
-
-      // we will keep the cursor so add all elements from right sibling to cursor
-      // Optimization: easier to push_back then to insert at front because inserting at front involves shifting.
-      for (uint i = 0; i < (*rightSiblingNode).keys.size(); ++i) {
-        (*cursor).keys.push_back((*rightSiblingNode).keys[i]);
-      }
-      for (uint i = 0; i < (*rightSiblingNode).ptrs.size(); ++i) {
-        (*cursor).ptrs.push_back((*rightSiblingNode).ptrs[i]);
-      }
+    ++nodesDeletedCounter; // // when we merge it is equivalent of deleting a node.
+    --nodeCounter; // decrement number of tree nodes
+    --leafCounter;
+    // we will be removing cursor, thus we need to delete the key of LEFT BOUND of the pointer to cursor.
+    // this is the key of the left sibling ptr index.
+    nodesDeletedCounter += removeInternal(parent, cursor, parent->keys[leftSiblingIdx]);
+    return nodesDeletedCounter;
+  } else if (hasRightSibling && canMergeNodes(cursor, (Node<KeyType>*) parent->ptrs[rightSiblingIdx], nullptr)) {
+    // if left sibling don't exist then we will need to merge with right sibling. 
+    // NOTE: If right sibling exist, DEFINITELY can merge. A node will definitely have a sibling unless it is root.
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    Node<KeyType>* rightSiblingNode = (Node<KeyType>*) parent->ptrs[rightSiblingIdx];
+
+    // remove the nextptr of the cursor since we are merging with right sibling
+    (*cursor).ptrs.pop_back();
+
+    // we will keep the cursor so add all elements from right sibling to cursor
+    // Optimization: easier to push_back then to insert at front because inserting at front involves shifting.
+    for (uint i = 0; i < (*rightSiblingNode).keys.size(); ++i) {
+      (*cursor).keys.push_back((*rightSiblingNode).keys[i]);
+    }
+    for (uint i = 0; i < (*rightSiblingNode).ptrs.size(); ++i) {
+      (*cursor).ptrs.push_back((*rightSiblingNode).ptrs[i]);
+    }
+    refreshPackedKeys(cursor);
 
-      ++nodesDeletedCounter; // deleting either one of the sibling, merging will ALWAYS result in at least 1 node being removed.
-      --nodeCounter;
+    ++nodesDeletedCounter; // deleting either one of the sibling, merging will ALWAYS result in at least 1 node being removed.
+    --nodeCounter;
+    --leafCounter;
+
+    // we will destroy the right sibling node.
+    // hence in the parent we need to update the LEFT BOUND KEY for the right sibling pointer
+    // this happens to be the KEY at position of rightsiblingidx - 1 (to the left.)
+    nodesDeletedCounter += removeInternal(parent, rightSiblingNode, parent->keys[rightSiblingIdx-1]);
+    return nodesDeletedCounter;
 
-      cout << "Key to pass to internal to delete is: " << parent->keys[rightSiblingIdx-1] << endl;
-      // we will destroy the right sibling node.
-      // hence in the parent we need to update the LEFT BOUND KEY for the right sibling pointer
-      // this happens to be the KEY at position of rightsiblingidx - 1 (to the left.)
-      nodesDeletedCounter += removeInternal(parent, rightSiblingNode, parent->keys[rightSiblingIdx-1]);
-      cout << "Number of nodes deleted after merging with right leaf: " << nodesDeletedCounter << endl;
-      cout << "Number of nodes in tree: " << nodeCounter << endl;
-      return nodesDeletedCounter;
-    }
   }
+  // a compressed leaf that can neither borrow nor merge stays underfull until a later delete frees space.
   return nodesDeletedCounter;
 }
 
 // key is the key to delete in the upper level, the parent node becomes the new cursor(because move one level up)
 // if we merge with left sibling(we will keep left sibling and delete prev cursor, child is the node to be deleted.)
 // if we merge with right sibling(we will keep cursor and delete right sibling, child will be right sibling)
-uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::removeInternal(Node<KeyType>* cursor, Node<KeyType>* child, KeyType key) {
 
   uint nodesDeletedCounter = 0;
   
   if (cursor == root && (((*cursor).keys.size() - 1) == 0)) {
     if ((*cursor).ptrs.front() == child || (*cursor).ptrs[1] == child) {
-      root = (*cursor).ptrs.front() == child ? (Node*) (*cursor).ptrs[1] : (Node*) (*cursor).ptrs.front();
+      root = (*cursor).ptrs.front() == child ? (Node<KeyType>*) (*cursor).ptrs[1] : (Node<KeyType>*) (*cursor).ptrs.front();
       --nodeCounter;
+      --treeHeight;
       ++nodesDeletedCounter; // only increment by 1, we account for deletion of root here. previously when merge the counter incremented above.
-      // delete child
-      delete child;
+      // retire child, readers that reached it before it was unlinked may still be reading it
+      retire(child);
 
-      // delete old root
-      delete cursor;
+      // retire old root
+      retire(cursor);
       return nodesDeletedCounter;
     }
   }
@@ -619,8 +910,9 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
   // Delete key from parent (it may still be root at this point, just that when we delete from root it will still have sufficient keys)
   int keyIndexToDelete = 0;
   while (keyIndexToDelete < (int) (*cursor).keys.size()) {
-    if ((*cursor).keys[keyIndexToDelete] == key) {
+    if (keysEqual((*cursor).keys[keyIndexToDelete], key)) {
       (*cursor).keys.erase((*cursor).keys.begin() + keyIndexToDelete);
+      refreshPackedKeys(cursor);
       break;
     } else {
       ++keyIndexToDelete;
@@ -628,9 +920,11 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
   }
   int pointerIndexToDelete = 0;
   while (pointerIndexToDelete < (int) (*cursor).ptrs.size()) {
-    if (((Node*) (*cursor).ptrs[pointerIndexToDelete]) == child) {
+    if (((Node<KeyType>*) (*cursor).ptrs[pointerIndexToDelete]) == child) {
       // we want to delete this pointer
       (*cursor).ptrs.erase((*cursor).ptrs.begin() + pointerIndexToDelete);
+      // the child was merged into a sibling and is unreachable from here on
+      retire(child);
       break;
     } else {
       ++pointerIndexToDelete;
@@ -651,14 +945,14 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
   // if cant borrow from both sibling, try to merge with left, then merge with right.
 
   // find parent of cursor (current node which has underflowed.)
-  Node* parent = findParent(cursor, root);
+  Node<KeyType>* parent = findParent(cursor, root);
 
   // find left sibling and right sibling of cursor
   int cursorIdx = -1;
   int leftSiblingIdx = -1; 
   int rightSiblingIdx = parent->ptrs.size() + 1; //index of the pointers
   for (uint i = 0; i < parent->ptrs.size(); ++i) {
-    if (((Node*) parent->ptrs[i]) == cursor) {
+    if (((Node<KeyType>*) parent->ptrs[i]) == cursor) {
       cursorIdx = i;
       rightSiblingIdx = i + 1;
       leftSiblingIdx = i - 1;
@@ -677,13 +971,16 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
 
   // try to borrow from left sibling
   if (hasLeftSibling) {
-    Node* leftSiblingNode = (Node*) parent->ptrs[leftSiblingIdx];
+    Node<KeyType>* leftSiblingNode = (Node<KeyType>*) parent->ptrs[leftSiblingIdx];
 
     // Assuming we borrow, then number of keys in left sibling node will -1,
     // These number of nodes after borrowing MUST still be >= minimumKeysInLeafNode
-    if ((int) (leftSiblingNode->keys.size()- 1) >= minimumKeysInInternalNode) {
+    if ((int) (leftSiblingNode->keys.size()- 1) >= minimumKeysInInternalNode
+        && nodeHasSpaceForKey(cursor, parent->keys[leftSiblingIdx])
+        && canReplaceKey(parent, leftSiblingIdx, leftSiblingNode->keys.back())) {
 
       // there is a left sibling to borrow from
+      INSTRUMENT_TREE_EVENT(NODE_BORROW);
 
       // transfer last pointer from left sibling node to the right node(cursor), insert at the front
       // node internal nodes doesn't have nextPtr so we will just take the last.
@@ -700,6 +997,9 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
       // remove last key and pointer from left sibling node.
       leftSiblingNode->ptrs.pop_back();
       leftSiblingNode->keys.pop_back();
+      refreshPackedKeys(cursor);
+      refreshPackedKeys(leftSiblingNode);
+      refreshPackedKeys(parent);
 
       return nodesDeletedCounter;
     }
@@ -707,10 +1007,13 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
   
   // try to borrow from right sibling
   if (hasRightSibling) {
-    Node* rightSiblingNode = (Node*) parent->ptrs[rightSiblingIdx];
+    Node<KeyType>* rightSiblingNode = (Node<KeyType>*) parent->ptrs[rightSiblingIdx];
 
-    if ((int) (rightSiblingNode->keys.size() - 1) >= minimumKeysInInternalNode) {
+    if ((int) (rightSiblingNode->keys.size() - 1) >= minimumKeysInInternalNode
+        && nodeHasSpaceForKey(cursor, parent->keys[cursorIdx])
+        && canReplaceKey(parent, cursorIdx, rightSiblingNode->keys.front())) {
       //can borrow from right sibling
+      INSTRUMENT_TREE_EVENT(NODE_BORROW);
 
       // transfer pointer from right sibling to cursor(left node)
       (*cursor).ptrs.push_back(rightSiblingNode->ptrs.front());
@@ -726,15 +1029,19 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
 
       // delete the transferred pointer from right sibling 
       rightSiblingNode->ptrs.erase(rightSiblingNode->ptrs.begin());
+      refreshPackedKeys(cursor);
+      refreshPackedKeys(rightSiblingNode);
+      refreshPackedKeys(parent);
 
       return nodesDeletedCounter;
     }
   }
 
   // if cannot borrow try to merge with left node then right node
-  // check if have left sibling, if cannot transfer means CONFIRM can MERGE.
-  if (hasLeftSibling) {
-    Node* leftSiblingNode = (Node*) parent->ptrs[leftSiblingIdx];
+  // check if have left sibling, if cannot transfer means CONFIRM can MERGE, unless compressed keys would not fit.
+  if (hasLeftSibling && canMergeNodes((Node<KeyType>*) parent->ptrs[leftSiblingIdx], cursor, &parent->keys[leftSiblingIdx])) {
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    Node<KeyType>* leftSiblingNode = (Node<KeyType>*) parent->ptrs[leftSiblingIdx];
 
     // transfer parent key to left sibling since a merge is to occur
     leftSiblingNode->keys.push_back(parent->keys[leftSiblingIdx]);
@@ -746,14 +1053,16 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
     for (uint i = 0; i < (*cursor).ptrs.size(); ++i) {
       leftSiblingNode->ptrs.push_back((*cursor).ptrs[i]);
     }
+    refreshPackedKeys(leftSiblingNode);
 
     --nodeCounter; // since we are going to delete the cursor(right node)
     ++nodesDeletedCounter;
     nodesDeletedCounter += removeInternal(parent, cursor, parent->keys[leftSiblingIdx]);
     return nodesDeletedCounter;
-  } else if (hasRightSibling) {
+  } else if (hasRightSibling && canMergeNodes(cursor, (Node<KeyType>*) parent->ptrs[rightSiblingIdx], &parent->keys[rightSiblingIdx-1])) {
     // if cant borrow from right CONFIRM can MERGE with right sibling.
-    Node* rightSiblingNode = (Node*) parent->ptrs[rightSiblingIdx];
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    Node<KeyType>* rightSiblingNode = (Node<KeyType>*) parent->ptrs[rightSiblingIdx];
 
     // when merging with right sibling, we will keep cursor and delete the right sibling
     (*cursor).keys.push_back(parent->keys[rightSiblingIdx-1]);
@@ -764,6 +1073,7 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
     for (uint i = 0; i < rightSiblingNode->ptrs.size(); ++i) {
       (*cursor).ptrs.push_back(rightSiblingNode->ptrs[i]);
     }
+    refreshPackedKeys(cursor);
 
     --nodeCounter;
     ++nodesDeletedCounter;
@@ -776,142 +1086,657 @@ uint BPlusTree::removeInternal(Node* cursor, Node *child, int key) {
   return nodesDeletedCounter;
 }
 
-OverflowBlock* BPlusTree::searchQuery(int key) {
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::removeBlockPointerFromKey(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  noteKeyChanged(key);
+  flushAllBuffers();
   if (root == nullptr) {
-    cout << "No indexes in B+ Tree. Try inserting some records first!" << endl;
-    return {};
+    return 0;
   }
 
-  uint indexNodesAccessedCounter = 0;
-  Node* cursor = root;
-
+  Node<KeyType>* parent = nullptr;
+  Node<KeyType>* cursor = root;
   while ((*cursor).isLeaf != true) {
-    ++indexNodesAccessedCounter; // non leaf node index accessed
-
-    // according to project specification we will only print max first 5 index nodes
-    if (canPrintNode(indexNodesAccessedCounter)) {
-      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
-      printContentOfNode(cursor);
-    }
-
-    // find the correct range to follow.
-    int ptrIdxToFollow = upper_bound((*cursor).keys.begin(), (*cursor).keys.end(), key) - (*cursor).keys.begin();
-    cursor = (Node *) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+    parent = cursor;
+    int ptrIdxToFollow = findChildIndex(cursor, key);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
   }
-  
-  // arrive at leaf node, now need to find pointer to correct overflow block
-  ++indexNodesAccessedCounter;
-  uint keysInLeaf = (*cursor).keys.size();
 
-  // print the node if its still within the specified 5 index nodes limit
-  if (canPrintNode(indexNodesAccessedCounter)) {
-    cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
-    printContentOfNode(cursor);
+  int indexOfKey = findKeyIndex(cursor, key);
+  if (indexOfKey == (int) (*cursor).keys.size() || !keysEqual((*cursor).keys[indexOfKey], key)) {
+    return 0; // key is not indexed, nothing to remove
   }
 
-  uint currKeyIndex = 0;
-  while (currKeyIndex < keysInLeaf) {
-    if ((*cursor).keys[currKeyIndex] < key) {
-      ++currKeyIndex; // search next key
-    } else if ((*cursor).keys[currKeyIndex] == key) {
-      
-      // logic to get the block here and return.
-      // array containing pointers to all blocks with records matching the key.
-      OverflowBlock* overflowBlock = (OverflowBlock*) ((*cursor).ptrs[currKeyIndex]);
-      cout << "Number of Index Nodes Accessed: " << indexNodesAccessedCounter << endl;
-      return overflowBlock; // found already return early termination, all duplicates will be IN this block. no need to search further
-    } else {
+  // walk the overflow chain of the key and remove the first occurrence of the block pointer.
+  // each record inserted adds one occurrence, so removing one occurrence un-indexes exactly one record.
+  OverflowBlock* headOverflowBlock = (OverflowBlock*) (*cursor).ptrs[indexOfKey];
+  OverflowBlock* prevOverflowBlock = nullptr;
+  OverflowBlock* currOverflowBlock = headOverflowBlock;
+  while (currOverflowBlock != nullptr) {
+    uint entryIdx = 0;
+    while (entryIdx < currOverflowBlock->blockPtrs.size()) {
+      // a covering index also has to match the included columns, a block can hold several records of the key
+      if (currOverflowBlock->blockPtrs[entryIdx] == blockPtr &&
+          (!isCovering || currOverflowBlock->includedColumns[entryIdx].__avgRating == includedColumns.__avgRating)) {
+        break;
+      }
+      ++entryIdx;
+    }
+    if (entryIdx < currOverflowBlock->blockPtrs.size()) {
+      logChange(key, getIndexedAvgRating(key, isCovering ? currOverflowBlock->includedColumns[entryIdx] : includedColumns), false);
+      if (isCovering) {
+        // included columns are stored parallel to the block pointers
+        currOverflowBlock->includedColumns.erase(currOverflowBlock->includedColumns.begin() + entryIdx);
+      }
+      currOverflowBlock->blockPtrs.erase(currOverflowBlock->blockPtrs.begin() + entryIdx);
+      --indexedRecordCounter;
       break;
     }
+    prevOverflowBlock = currOverflowBlock;
+    currOverflowBlock = currOverflowBlock->next;
   }
-  // when we finish the loop means we cannot find the relevant key
-  cout << "Number of Index Nodes Accessed: " << indexNodesAccessedCounter << endl;
-  cout << "No records contain the search key." << endl;
-  return {}; //empty block, no key found
-}
 
-vector<pair<int, OverflowBlock*>> BPlusTree::rangeQuery(int startKey, int endKey) {
-
-  // vector<pair<int, vector<Block*>*>> keyAndPtrToPtrOfBlks;
-  vector<pair<int, OverflowBlock*>> keyAndOverflowBlkPair;
-
-  // sanity check, Tree cannot be empty
-  if (root == nullptr) {
-    cout << "No indexes in B+ Tree. Try inserting some records first!" << endl;
-    return {};
-  } else if(endKey == startKey) {
-    cout << "This is not a range query but a search query." << endl;
-    return {};
+  if (currOverflowBlock == nullptr || !currOverflowBlock->blockPtrs.empty()) {
+    return 0; // block pointer was not found, or the overflow block still holds other block pointers
   }
-  else if (!(endKey > startKey)) {
-    // sanity check, END must be greater than start 
-    cout << "Cannot search invalid range. Try again, start should be less than end" << endl;
-    return {};
+
+  // the overflow block is now empty, unlink it from the chain
+  if (prevOverflowBlock != nullptr) {
+    prevOverflowBlock->next = currOverflowBlock->next;
+    --overflowBlkCounter;
+    retire(currOverflowBlock);
+    return 0;
+  } else if (currOverflowBlock->next != nullptr) {
+    // the head is empty but the chain continues, so the next overflow block becomes the head
+    (*cursor).ptrs[indexOfKey] = currOverflowBlock->next;
+    --overflowBlkCounter;
+    retire(currOverflowBlock);
+    return 0;
   }
 
-  // initialize nodes accessed counter for range query
-  uint indexNodesAccessedCounter = 0; // includes leaf and non leaf nodes
-  
-  Node* cursor = root; //start from the root and follow pointer according to the range of indexes
+  // no more records are indexed by this key, so the key itself is removed from the tree
+  --overflowBlkCounter;
+  retire(currOverflowBlock);
+  return removeKeyFromLeaf(cursor, parent, indexOfKey);
+}
 
-  while ((*cursor).isLeaf != true) {
-    ++indexNodesAccessedCounter; // non leaf node index accessed
+template <typename KeyType, typename KeyCompare>
+DeleteSummary BPlusTree<KeyType, KeyCompare>::deleteRange(KeyType startKey, KeyType endKey) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  DeleteSummary summary;
+  flushAllBuffers();
+  if (root == nullptr || keyCompare(endKey, startKey)) {
+    return summary;
+  }
 
-    // according to project specification we will only print max first 5 index nodes
-    if (canPrintNode(indexNodesAccessedCounter)) {
-      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
-      printContentOfNode(cursor);
+  vector<vector<Node<KeyType>*>> affectedPaths;
+  set<Block*> emptiedBlocks;
+  KeyType nextKey = startKey;
+  while (true) {
+    // descend once per leaf, the upper bound of the leaf is where the next descent starts
+    vector<Node<KeyType>*> path;
+    Node<KeyType>* cursor = root;
+    bool hasUpperBound = false;
+    KeyType upperBound = nextKey;
+    while ((*cursor).isLeaf != true) {
+      path.push_back(cursor);
+      int ptrIdxToFollow = findChildIndex(cursor, nextKey);
+      if (ptrIdxToFollow < (int) (*cursor).keys.size()) {
+        hasUpperBound = true;
+        upperBound = (*cursor).keys[ptrIdxToFollow];
+      }
+      cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
     }
+    path.push_back(cursor);
 
-    // find the correct range to follow.
-    int ptrIdxToFollow = upper_bound((*cursor).keys.begin(), (*cursor).keys.end(), startKey) - (*cursor).keys.begin();
-    cursor = (Node *) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+    vector<uint> entryIndexes;
+    for (uint i = findKeyIndex(cursor, startKey); i < (*cursor).keys.size() && !keyCompare(endKey, (*cursor).keys[i]); ++i) {
+      entryIndexes.push_back(i);
+    }
+    if (!entryIndexes.empty()) {
+      deleteEntriesFromLeaf(cursor, entryIndexes, summary, emptiedBlocks);
+      affectedPaths.push_back(path);
+    }
+
+    if (!hasUpperBound || keyCompare(endKey, upperBound)) {
+      break; // the next leaf only holds keys past the range
+    }
+    nextKey = upperBound;
   }
 
-  // now we are at the leaf level
+  rebalanceAfterDeletes(affectedPaths, (maxKeys + 1) / 2, maxKeys / 2, summary);
+  summary.dataBlocksFreed = emptiedBlocks.size();
+  return summary;
+}
 
-  bool endRangeFound = false;
-  bool noMoreLeafNodes = false;
+template <typename KeyType, typename KeyCompare>
+DeleteSummary BPlusTree<KeyType, KeyCompare>::deleteBatch(vector<KeyType> keys) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  DeleteSummary summary;
+  flushAllBuffers();
+  if (root == nullptr || keys.empty()) {
+    return summary;
+  }
 
-  // the range query only stops in 2 cases:
-  // 1: We found the end range.
-  // 2: There are no more leaf nodes to explore.
-  // Note: If the end range happens to be the last key of the current index node, since our B+ Tree has no duplicates
-  // We will terminate search and NOT follow the nextptr because the next key will be bigger. (efficiency)
-  while ((endRangeFound == true || noMoreLeafNodes == true) != true) {
-    ++indexNodesAccessedCounter; // counter incrementing leaf level nodes.
-    uint keysInLeaf = (*cursor).keys.size(); // number of keys in current leaf node to explore
+  KeyCompare compare = keyCompare;
+  sort(keys.begin(), keys.end(), compare);
+  keys.erase(unique(keys.begin(), keys.end(), [compare](const KeyType& first, const KeyType& second) {
+    return !compare(first, second) && !compare(second, first);
+  }), keys.end());
+
+  vector<vector<Node<KeyType>*>> affectedPaths;
+  set<Block*> emptiedBlocks;
+  uint batchIdx = 0;
+  while (batchIdx < keys.size()) {
+    // descend once for the smallest remaining key, every key below the upper bound is in this leaf
+    vector<Node<KeyType>*> path;
+    Node<KeyType>* cursor = root;
+    bool hasUpperBound = false;
+    KeyType upperBound = keys[batchIdx];
+    while ((*cursor).isLeaf != true) {
+      path.push_back(cursor);
+      int ptrIdxToFollow = findChildIndex(cursor, keys[batchIdx]);
+      if (ptrIdxToFollow < (int) (*cursor).keys.size()) {
+        hasUpperBound = true;
+        upperBound = (*cursor).keys[ptrIdxToFollow];
+      }
+      cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
+    }
+    path.push_back(cursor);
 
-    // print the node if its still within the specified 5 index nodes limit
-    if (canPrintNode(indexNodesAccessedCounter)) {
-      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
-      printContentOfNode(cursor);
+    vector<uint> entryIndexes;
+    uint leafIdx = findKeyIndex(cursor, keys[batchIdx]);
+    while (batchIdx < keys.size() && (!hasUpperBound || keyCompare(keys[batchIdx], upperBound))) {
+      while (leafIdx < (*cursor).keys.size() && keyCompare((*cursor).keys[leafIdx], keys[batchIdx])) {
+        ++leafIdx;
+      }
+      if (leafIdx < (*cursor).keys.size() && keysEqual((*cursor).keys[leafIdx], keys[batchIdx])) {
+        entryIndexes.push_back(leafIdx);
+      }
+      ++batchIdx;
+    }
+    if (!entryIndexes.empty()) {
+      deleteEntriesFromLeaf(cursor, entryIndexes, summary, emptiedBlocks);
+      affectedPaths.push_back(path);
     }
+  }
 
-    uint currKeyIndex = 0;
-    while (currKeyIndex < keysInLeaf) {
-      if ((*cursor).keys[currKeyIndex] > endKey) {
-        endRangeFound = true;
-        break;
-      } else if ((*cursor).keys[currKeyIndex] >= startKey) {
+  rebalanceAfterDeletes(affectedPaths, (maxKeys + 1) / 2, maxKeys / 2, summary);
+  summary.dataBlocksFreed = emptiedBlocks.size();
+  return summary;
+}
 
-        if ((*cursor).keys[currKeyIndex] == endKey) {
-          endRangeFound = true; // but don't break cause we WANT this key, so we will add it to our array of pairs
-        }
-        // pair of key: ptr to ptrs to block(which contains all the blocks that stores records of this particular key)
-        pair<int, OverflowBlock*> newPair = make_pair(
-          (*cursor).keys[currKeyIndex], // extract key
-          (OverflowBlock*) cursor->ptrs[currKeyIndex] // extract the relevant block of keys
-        );
-        keyAndOverflowBlkPair.push_back(newPair);
-        
-      }
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::getOverflowBlockOfKey(KeyType key) {
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  vector<BufferedInsert<KeyType>> pendingInserts = getBufferedInsertsOfRange(key, key);
+  return mergeBufferedInsertsOfKey(key, findOverflowBlockOfKey(key), pendingInserts, 0, pendingInserts.size());
+}
 
-      // if number of ptrs = number of keys in leaf node means no more leaf node to search already. (No nextptr)
-      // if end range is not found yet AND there are more pointers than keys(means there nexptr) AND we are last key of this node.
+template <typename KeyType, typename KeyCompare>
+vector<OverflowBlock*> BPlusTree<KeyType, KeyCompare>::searchBatch(const vector<KeyType>& keys, ThreadPool& threadPool) {
+  // the workers take no lock of their own, holding it here keeps maintenance out until all are done
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  vector<OverflowBlock*> overflowBlocks(keys.size(), nullptr);
+
+  // several chunks per thread, so a thread whose keys descend slowly takes on fewer of them
+  uint numberOfChunks = min((uint) keys.size(), threadPool.getNumberOfThreads() * 4);
+  TaskGroup chunks;
+  for (uint chunk = 0; chunk < numberOfChunks; ++chunk) {
+    threadPool.submit([this, chunk, numberOfChunks, &keys, &overflowBlocks]() {
+      EpochGuard epochGuard;
+      uint chunkEnd = (unsigned long long) (chunk + 1) * keys.size() / numberOfChunks;
+      for (uint i = (unsigned long long) chunk * keys.size() / numberOfChunks; i < chunkEnd; ++i) {
+        overflowBlocks[i] = findOverflowBlockOfKey(keys[i]);
+      }
+    }, &chunks);
+  }
+  threadPool.waitForGroup(chunks);
+
+  // the buffers are read once for every key looked up, and merged into the chains found on the calling thread
+  if (bufferedInsertCounter > 0 && !keys.empty()) {
+    KeyType smallestKey = *min_element(keys.begin(), keys.end(), keyCompare);
+    KeyType largestKey = *max_element(keys.begin(), keys.end(), keyCompare);
+    vector<BufferedInsert<KeyType>> pendingInserts = getBufferedInsertsOfRange(smallestKey, largestKey);
+    KeyCompare compare = keyCompare;
+    for (uint i = 0; i < keys.size() && !pendingInserts.empty(); ++i) {
+      auto runStart = lower_bound(pendingInserts.begin(), pendingInserts.end(), keys[i], [compare](const BufferedInsert<KeyType>& bufferedInsert, const KeyType& key) {
+        return compare(bufferedInsert.key, key);
+      });
+      auto runEnd = upper_bound(runStart, pendingInserts.end(), keys[i], [compare](const KeyType& key, const BufferedInsert<KeyType>& bufferedInsert) {
+        return compare(key, bufferedInsert.key);
+      });
+      overflowBlocks[i] = mergeBufferedInsertsOfKey(keys[i], overflowBlocks[i], pendingInserts, runStart - pendingInserts.begin(), runEnd - pendingInserts.begin());
+    }
+  }
+  return overflowBlocks;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::attachQueryCache(QueryCache<KeyType, KeyCompare>* cache) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  queryCache = cache;
+}
+
+template <typename KeyType, typename KeyCompare>
+CachedQueryResult BPlusTree<KeyType, KeyCompare>::getRecordsOfKey(KeyType key) {
+  CachedQueryResult result;
+  ull readVersion = 0; // stamped before the tree is read, so a change to any key while it is read keeps the result out of the cache
+  if (queryCache != nullptr && queryCache->lookupKey(key, result, readVersion)) {
+    return result;
+  }
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  vector<BufferedInsert<KeyType>> pendingInserts = getBufferedInsertsOfRange(key, key);
+  OverflowBlock* overflowBlock = findOverflowBlockOfKey(key);
+  // the chain is only walked here, so the inserts are merged into a copy of our own rather than one kept in the tree
+  OverflowBlock* mergedOverflowBlock = pendingInserts.empty() ? nullptr : copyOverflowChainWithInserts(overflowBlock, pendingInserts, 0, pendingInserts.size());
+  if (mergedOverflowBlock != nullptr) {
+    overflowBlock = mergedOverflowBlock;
+  }
+  result.keysFound = overflowBlock != nullptr;
+  set<Block*> visitedBlocks; // a block holding several records of the key appears once per record
+  for (; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+    for (auto blkPtr: overflowBlock->blockPtrs) {
+      if (!visitedBlocks.insert(blkPtr).second) {
+        continue;
+      }
+      for (auto &record: blkPtr->__records) {
+        if (recordHasKey(record, key, keyCompare)) {
+          result.records.push_back(record);
+          result.totalRating += record.__avgRating;
+          ++result.numberOfRecords;
+        }
+      }
+    }
+  }
+  deleteOverflowChainCopy(mergedOverflowBlock);
+  // keys without records are cached too
+  if (queryCache != nullptr) {
+    queryCache->storeKey(key, result, readVersion);
+  }
+  return result;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::enableSnapshots(uint maxRetainedChanges) {
+  if (!isCovering && !KeyCoversAvgRating<KeyType>::value) {
+    cout << "Snapshots need the avgRating in the index, make the index covering." << endl;
+    throw "Snapshots need the avgRating in the index, make the index covering.";
+  }
+  unique_lock<recursive_mutex> treeLock(treeMutex);
+  isSnapshotEnabled = true;
+  snapshotStatistics.maxRetainedChanges = maxRetainedChanges;
+}
+
+template <typename KeyType, typename KeyCompare>
+ull BPlusTree<KeyType, KeyCompare>::takeSnapshot() {
+  if (!isSnapshotEnabled) {
+    cout << "Snapshots are not enabled on this index." << endl;
+    throw "Snapshots are not enabled on this index.";
+  }
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  openSnapshots.insert(currentVersion);
+  ++snapshotStatistics.snapshotsTaken;
+  return currentVersion;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::releaseSnapshot(ull snapshot) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  auto openSnapshot = openSnapshots.find(snapshot);
+  if (openSnapshot != openSnapshots.end()) {
+    openSnapshots.erase(openSnapshot);
+    reclaimChanges();
+  } else if (expiredSnapshots.find(snapshot) != expiredSnapshots.end()) {
+    expiredSnapshots.erase(expiredSnapshots.find(snapshot));
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+IndexAggregate BPlusTree<KeyType, KeyCompare>::snapshotRangeQueryAggregate(ull snapshot, KeyType startKey, KeyType endKey) {
+  IndexAggregate aggregate;
+  aggregate.isIndexOnly = true;
+  if (keyCompare(endKey, startKey)) {
+    return aggregate;
+  }
+
+  KeyType stepStartKey = startKey;
+  bool isStepStartIncluded = true;
+  bool isLastStep = false;
+  while (!isLastStep) {
+    EpochGuard epochGuard;
+    unique_lock<recursive_mutex> treeLock = lockTree();
+    if (openSnapshots.find(snapshot) == openSnapshots.end()) {
+      cout << "Snapshot " << snapshot << " is too old, the changes it needs were reclaimed." << endl;
+      throw "Snapshot is too old";
+    }
+    ++snapshotStatistics.scanSteps;
+
+    // records and rating of every key of the step, as the tree holds them now
+    map<KeyType, pair<int, double>, KeyCompare> keyTotals(keyCompare);
+    KeyType stepEndKey = endKey;
+    isLastStep = true;
+    Node<KeyType>* leaf = root != nullptr ? findLeaf(stepStartKey) : nullptr;
+    // a step ends with the first leaf holding a key of the range, leaves emptied by lazy deletes or holding only the start are passed
+    while (leaf != nullptr) {
+      ++aggregate.indexNodesAccessed;
+      bool isEndReached = false;
+      for (uint i = 0; i < (*leaf).keys.size() && !isEndReached; ++i) {
+        const KeyType& key = (*leaf).keys[i];
+        if (keyCompare(key, stepStartKey) || (!isStepStartIncluded && !keyCompare(stepStartKey, key))) {
+          continue;
+        } else if (keyCompare(endKey, key)) {
+          isEndReached = true;
+          continue;
+        }
+        pair<int, double>& totals = keyTotals[key];
+        for (OverflowBlock* overflowBlock = (OverflowBlock*) (*leaf).ptrs[i]; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+          ++aggregate.overflowBlocksAccessed;
+          for (uint j = 0; j < overflowBlock->blockPtrs.size(); ++j) {
+            ++totals.first;
+            totals.second += getIndexedAvgRating(key, isCovering ? overflowBlock->includedColumns[j] : IncludedColumns());
+          }
+        }
+      }
+      Node<KeyType>* nextLeaf = (*leaf).ptrs.size() > (*leaf).keys.size() ? (Node<KeyType>*) (*leaf).ptrs.back() : nullptr;
+      if (isEndReached || nextLeaf == nullptr) {
+        break;
+      } else if (!keyTotals.empty()) {
+        // keys past the last key of this leaf are read by the next step
+        isLastStep = false;
+        stepEndKey = (*leaf).keys.back();
+        break;
+      }
+      leaf = nextLeaf;
+    }
+
+    // inserts still buffered are already logged, so they are counted like the records in the leaves
+    for (auto& bufferedInsert: getBufferedInsertsOfRange(stepStartKey, stepEndKey)) {
+      if (isStepStartIncluded || keyCompare(stepStartKey, bufferedInsert.key)) {
+        pair<int, double>& totals = keyTotals[bufferedInsert.key];
+        ++totals.first;
+        totals.second += getIndexedAvgRating(bufferedInsert.key, bufferedInsert.includedColumns);
+      }
+    }
+
+    // undo the changes made to the keys of the step since the snapshot was taken
+    auto change = isStepStartIncluded ? changesByKey.lower_bound(stepStartKey) : changesByKey.upper_bound(stepStartKey);
+    for (; change != changesByKey.end() && !keyCompare(stepEndKey, change->first); ++change) {
+      if (change->second.version <= snapshot) {
+        continue;
+      }
+      pair<int, double>& totals = keyTotals[change->first];
+      int sign = change->second.isInsert ? -1 : 1;
+      totals.first += sign;
+      totals.second += sign * change->second.avgRating;
+    }
+    for (auto& keyTotal: keyTotals) {
+      if (keyTotal.second.first > 0) {
+        ++aggregate.keysFound;
+        aggregate.totalRecords += keyTotal.second.first;
+        aggregate.totalRating += keyTotal.second.second;
+      }
+    }
+    stepStartKey = stepEndKey;
+    isStepStartIncluded = false;
+  }
+  return aggregate;
+}
+
+template <typename KeyType, typename KeyCompare>
+SnapshotStatistics BPlusTree<KeyType, KeyCompare>::getSnapshotStatistics() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  SnapshotStatistics statistics = snapshotStatistics;
+  statistics.openSnapshots = openSnapshots.size();
+  statistics.changesRetained = changesByVersion.size();
+  // a map node holds the key and change with three pointers and a colour, and the deque an iterator per change
+  statistics.bytesRetained = (ull) changesByVersion.size()
+      * (sizeof(pair<const KeyType, IndexChange>) + 4 * sizeof(void*) + sizeof(typename multimap<KeyType, IndexChange, KeyCompare>::iterator));
+  return statistics;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::freezeInternalLevels() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  // the copy holds no buffers, so every pending insert has to be in the leaves first
+  flushAllBuffers();
+  frozenLevels.freeze(root);
+  isFrozenLevelsFresh = true;
+}
+
+template <typename KeyType, typename KeyCompare>
+FrozenLevels<KeyType, KeyCompare>* BPlusTree<KeyType, KeyCompare>::getFrozenLevels() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  return isFrozenLevelsFresh ? &frozenLevels : nullptr;
+}
+
+template <typename KeyType, typename KeyCompare>
+QueryCache<KeyType, KeyCompare>* BPlusTree<KeyType, KeyCompare>::getQueryCache() {
+  return queryCache;
+}
+
+template <typename KeyType, typename KeyCompare>
+CachedQueryResult BPlusTree<KeyType, KeyCompare>::getAggregateOfRange(KeyType startKey, KeyType endKey) {
+  CachedQueryResult result;
+  ull readVersion = 0; // stamped before the tree is read, so a change to any key while it is read keeps the result out of the cache
+  if (queryCache != nullptr && queryCache->lookupRange(startKey, endKey, result, readVersion)) {
+    return result;
+  }
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  IndexAggregate aggregate = rangeQueryAggregate(startKey, endKey);
+  result.totalRating = aggregate.totalRating;
+  result.numberOfRecords = aggregate.totalRecords;
+  result.keysFound = aggregate.keysFound;
+  if (queryCache != nullptr) {
+    queryCache->storeRange(startKey, endKey, result, readVersion);
+  }
+  return result;
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::containsKey(KeyType key) {
+  return getOverflowBlockOfKey(key) != nullptr;
+}
+
+template <typename KeyType, typename KeyCompare>
+vector<pair<KeyType, OverflowBlock*>> BPlusTree<KeyType, KeyCompare>::getOverflowBlocksOfRange(KeyType startKey, KeyType endKey) {
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  vector<pair<KeyType, OverflowBlock*>> keyAndOverflowBlkPair;
+  if (root == nullptr || keyCompare(endKey, startKey)) {
+    return keyAndOverflowBlkPair;
+  }
+
+  Node<KeyType>* cursor = findLeaf(startKey);
+  uint keyIdx = findKeyIndex(cursor, startKey);
+  bool endRangeFound = false;
+  while (cursor != nullptr && !endRangeFound) {
+    for (; keyIdx < (*cursor).keys.size(); ++keyIdx) {
+      if (keyCompare(endKey, (*cursor).keys[keyIdx])) {
+        endRangeFound = true;
+        break;
+      }
+      keyAndOverflowBlkPair.push_back(make_pair((*cursor).keys[keyIdx], (OverflowBlock*) (*cursor).ptrs[keyIdx]));
+    }
+    cursor = (*cursor).ptrs.size() > (*cursor).keys.size() ? (Node<KeyType>*) (*cursor).ptrs.back() : nullptr;
+    keyIdx = 0;
+  }
+  mergeBufferedInsertsOfRange(keyAndOverflowBlkPair, getBufferedInsertsOfRange(startKey, endKey));
+  return keyAndOverflowBlkPair;
+}
+
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::searchQuery(KeyType key) {
+  INSTRUMENT_TREE_OPERATION(SEARCH_QUERY);
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (root == nullptr) {
+    cout << "No indexes in B+ Tree. Try inserting some records first!" << endl;
+    return {};
+  }
+
+  uint indexNodesAccessedCounter = 0;
+  Node<KeyType>* cursor = root;
+
+  while ((*cursor).isLeaf != true) {
+    ++indexNodesAccessedCounter; // non leaf node index accessed
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
+
+    // according to project specification we will only print max first 5 index nodes
+    if (canPrintNode(indexNodesAccessedCounter)) {
+      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
+      printContentOfNode(cursor);
+    }
+
+    // find the correct range to follow.
+    int ptrIdxToFollow = findChildIndex(cursor, key);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+  }
+  
+  // arrive at leaf node, now need to find pointer to correct overflow block
+  ++indexNodesAccessedCounter;
+  INSTRUMENT_TREE_EVENT(NODE_VISIT);
+  uint keysInLeaf = (*cursor).keys.size();
+
+  // print the node if its still within the specified 5 index nodes limit
+  if (canPrintNode(indexNodesAccessedCounter)) {
+    cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
+    printContentOfNode(cursor);
+  }
+
+  // the filter rules out most absent keys before the keys of the leaf are scanned
+  uint currKeyIndex = leafMayContainKey(cursor, key) ? 0 : keysInLeaf;
+  bool isKeyScanned = currKeyIndex == 0;
+  while (currKeyIndex < keysInLeaf) {
+    if (keyCompare((*cursor).keys[currKeyIndex], key)) {
+      ++currKeyIndex; // search next key
+    } else if (keysEqual((*cursor).keys[currKeyIndex], key)) {
+      
+      // logic to get the block here and return.
+      // array containing pointers to all blocks with records matching the key.
+      OverflowBlock* overflowBlock = (OverflowBlock*) ((*cursor).ptrs[currKeyIndex]);
+      cout << "Number of Index Nodes Accessed: " << indexNodesAccessedCounter << endl;
+      vector<BufferedInsert<KeyType>> pendingInserts = getBufferedInsertsOfRange(key, key);
+      return mergeBufferedInsertsOfKey(key, overflowBlock, pendingInserts, 0, pendingInserts.size()); // found already return early termination, all duplicates will be IN this block. no need to search further
+    } else {
+      break;
+    }
+  }
+  // when we finish the loop means we cannot find the relevant key
+  if (isLeafFiltered && isKeyScanned) {
+    ++leafFilterFalsePositives;
+  }
+  cout << "Number of Index Nodes Accessed: " << indexNodesAccessedCounter << endl;
+  // the key may only be waiting in the buffers so far
+  vector<BufferedInsert<KeyType>> pendingInserts = getBufferedInsertsOfRange(key, key);
+  if (!pendingInserts.empty()) {
+    return mergeBufferedInsertsOfKey(key, nullptr, pendingInserts, 0, pendingInserts.size());
+  }
+  cout << "No records contain the search key." << endl;
+  return {}; //empty block, no key found
+}
+
+template <typename KeyType, typename KeyCompare>
+vector<pair<KeyType, OverflowBlock*>> BPlusTree<KeyType, KeyCompare>::rangeQuery(KeyType startKey, KeyType endKey) {
+  INSTRUMENT_TREE_OPERATION(RANGE_QUERY);
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+
+  // vector<pair<int, vector<Block*>*>> keyAndPtrToPtrOfBlks;
+  vector<pair<KeyType, OverflowBlock*>> keyAndOverflowBlkPair;
+
+  // sanity check, Tree cannot be empty
+  if (root == nullptr) {
+    cout << "No indexes in B+ Tree. Try inserting some records first!" << endl;
+    return {};
+  } else if(keysEqual(endKey, startKey)) {
+    cout << "This is not a range query but a search query." << endl;
+    return {};
+  }
+  else if (!keyCompare(startKey, endKey)) {
+    // sanity check, END must be greater than start 
+    cout << "Cannot search invalid range. Try again, start should be less than end" << endl;
+    return {};
+  }
+
+  // initialize nodes accessed counter for range query
+  uint indexNodesAccessedCounter = 0; // includes leaf and non leaf nodes
+  
+  Node<KeyType>* cursor = root; //start from the root and follow pointer according to the range of indexes
+
+  while ((*cursor).isLeaf != true) {
+    ++indexNodesAccessedCounter; // non leaf node index accessed
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
+
+    // according to project specification we will only print max first 5 index nodes
+    if (canPrintNode(indexNodesAccessedCounter)) {
+      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
+      printContentOfNode(cursor);
+    }
+
+    // find the correct range to follow.
+    int ptrIdxToFollow = findChildIndex(cursor, startKey);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+  }
+
+  // now we are at the leaf level
+
+  bool endRangeFound = false;
+  bool noMoreLeafNodes = false;
+
+  // the range query only stops in 2 cases:
+  // 1: We found the end range.
+  // 2: There are no more leaf nodes to explore.
+  // Note: If the end range happens to be the last key of the current index node, since our B+ Tree has no duplicates
+  // We will terminate search and NOT follow the nextptr because the next key will be bigger. (efficiency)
+  while ((endRangeFound == true || noMoreLeafNodes == true) != true) {
+    ++indexNodesAccessedCounter; // counter incrementing leaf level nodes.
+    INSTRUMENT_TREE_EVENT(NODE_VISIT);
+    uint keysInLeaf = (*cursor).keys.size(); // number of keys in current leaf node to explore
+
+    // print the node if its still within the specified 5 index nodes limit
+    if (canPrintNode(indexNodesAccessedCounter)) {
+      cout << "Index node number " << indexNodesAccessedCounter << " accessed contains: ";
+      printContentOfNode(cursor);
+    }
+
+    if (keysInLeaf == 0) {
+      // a leaf emptied by lazy deletes, move on to the next leaf if there is one
+      if ((*cursor).ptrs.empty()) {
+        noMoreLeafNodes = true;
+      } else {
+        cursor = (Node<KeyType>*) (*cursor).ptrs.back();
+      }
+      continue;
+    }
+
+    uint currKeyIndex = 0;
+    while (currKeyIndex < keysInLeaf) {
+      if (keyCompare(endKey, (*cursor).keys[currKeyIndex])) {
+        endRangeFound = true;
+        break;
+      } else if (!keyCompare((*cursor).keys[currKeyIndex], startKey)) {
+
+        if (keysEqual((*cursor).keys[currKeyIndex], endKey)) {
+          endRangeFound = true; // but don't break cause we WANT this key, so we will add it to our array of pairs
+        }
+        // pair of key: ptr to ptrs to block(which contains all the blocks that stores records of this particular key)
+        pair<KeyType, OverflowBlock*> newPair = make_pair(
+          (*cursor).keys[currKeyIndex], // extract key
+          (OverflowBlock*) cursor->ptrs[currKeyIndex] // extract the relevant block of keys
+        );
+        keyAndOverflowBlkPair.push_back(newPair);
+        
+      }
+
+      // if number of ptrs = number of keys in leaf node means no more leaf node to search already. (No nextptr)
+      // if end range is not found yet AND there are more pointers than keys(means there nexptr) AND we are last key of this node.
       if ( (!endRangeFound) && ((*cursor).keys.size() < (*cursor).ptrs.size()) && (currKeyIndex == (*cursor).keys.size() - 1) ) {
         // go to the next leaf node
-        cursor = (Node *) (*cursor).ptrs[(*cursor).ptrs.size()-1]; // last pointer of leaf node is always next leaf.
+        cursor = (Node<KeyType>*) (*cursor).ptrs[(*cursor).ptrs.size()-1]; // last pointer of leaf node is always next leaf.
         break;
       } else if ( !(currKeyIndex == (*cursor).keys.size() - 1) ) {
         // we are not yet at the last key of the current leaf node, yet so continue to explore current node
@@ -927,103 +1752,1434 @@ vector<pair<int, OverflowBlock*>> BPlusTree::rangeQuery(int startKey, int endKey
 
   cout << "Number of Index Nodes Accessed: " << indexNodesAccessedCounter << endl;
 
+  mergeBufferedInsertsOfRange(keyAndOverflowBlkPair, getBufferedInsertsOfRange(startKey, endKey));
   return keyAndOverflowBlkPair;
 }
 
-uint BPlusTree::getMaxKeys() {
-  return maxKeys;
-}
+template <typename KeyType, typename KeyCompare>
+IndexAggregate BPlusTree<KeyType, KeyCompare>::rangeQueryAggregate(KeyType startKey, KeyType endKey) {
+  EpochGuard epochGuard;
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  IndexAggregate aggregate;
+  aggregate.isIndexOnly = isCovering || KeyCoversAvgRating<KeyType>::value;
 
-Node* BPlusTree::getRootOfTree() {
-  return root;
-}
+  if (root == nullptr || keyCompare(endKey, startKey)) {
+    return aggregate; // empty tree or empty range, nothing to aggregate
+  }
 
-uint BPlusTree::getNumberOfNodesInTree() {
-  return nodeCounter;
-}
+  Node<KeyType>* cursor = root;
+  while ((*cursor).isLeaf != true) {
+    ++aggregate.indexNodesAccessed;
+    int ptrIdxToFollow = findChildIndex(cursor, startKey);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
+  }
 
-uint BPlusTree::getTreeHeight() {
-  uint treeHeight = 0;
-  if (root == nullptr) {
-    return treeHeight;
-  } else {
-    Node* cursor = root;
-    // keep looping until we reach a leaf node
-    while ((*cursor).isLeaf != true) {
-      ++treeHeight;
-      int ptrIdxToFollow = 0; //depth first search until leaf
-      cursor = (Node *) (*cursor).ptrs[ptrIdxToFollow]; // will be pointing to child node so we cast it accordingly
+  // walk the leaves from the start of the range until a key past the end is found
+  bool endRangeFound = false;
+  while (cursor != nullptr && !endRangeFound) {
+    ++aggregate.indexNodesAccessed;
+    for (uint i = 0; i < (*cursor).keys.size(); ++i) {
+      if (keyCompare(endKey, (*cursor).keys[i])) {
+        endRangeFound = true;
+        break;
+      } else if (!keyCompare((*cursor).keys[i], startKey)) {
+        addOverflowChainToAggregate((*cursor).keys[i], (OverflowBlock*) (*cursor).ptrs[i], aggregate);
+      }
     }
+    // the last pointer of a leaf is the next leaf, if there are as many pointers as keys this is the last leaf
+    cursor = (*cursor).ptrs.size() > (*cursor).keys.size() ? (Node<KeyType>*) (*cursor).ptrs.back() : nullptr;
   }
-  ++treeHeight; // increment tree height by 1 more to include leaf level
-  return treeHeight;
+
+  addBufferedInsertsToAggregate(getBufferedInsertsOfRange(startKey, endKey), aggregate);
+  return aggregate;
 }
 
-uint BPlusTree::getSizeOfBPlusTree(uint blockSize) {
-  uint numberOfIndexNodes = getNumberOfNodesInTree();
-  uint sizeOfBPlusTreeIndex = numberOfIndexNodes * blockSize;
-  return sizeOfBPlusTreeIndex;
+template <typename KeyType, typename KeyCompare>
+IndexAggregate BPlusTree<KeyType, KeyCompare>::parallelRangeQueryAggregate(KeyType startKey, KeyType endKey, ThreadPool& threadPool) {
+  // the workers take no lock of their own, holding it here keeps maintenance out until all are done
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  IndexAggregate aggregate;
+  aggregate.isIndexOnly = isCovering || KeyCoversAvgRating<KeyType>::value;
+
+  if (root == nullptr || keyCompare(endKey, startKey)) {
+    return aggregate; // empty tree or empty range, nothing to aggregate
+  }
+
+  // several partitions per thread, so a thread whose partitions hold few records takes on more of them
+  vector<Node<KeyType>*> subtrees;
+  vector<KeyType> splitKeys;
+  aggregate.indexNodesAccessed = partitionRange(startKey, endKey, threadPool.getNumberOfThreads() * 4, subtrees, splitKeys);
+
+  vector<IndexAggregate> partialAggregates(subtrees.size());
+  TaskGroup partitions;
+  for (uint i = 0; i < subtrees.size(); ++i) {
+    threadPool.submit([this, i, startKey, endKey, &subtrees, &splitKeys, &partialAggregates]() {
+      EpochGuard epochGuard;
+      bool isLastPartition = i == subtrees.size() - 1;
+      aggregateRangePartition(subtrees[i], i == 0 ? startKey : splitKeys[i - 1], isLastPartition ? endKey : splitKeys[i],
+                              isLastPartition, partialAggregates[i]);
+    }, &partitions);
+  }
+  threadPool.waitForGroup(partitions);
+
+  for (auto& partialAggregate: partialAggregates) {
+    aggregate.totalRating += partialAggregate.totalRating;
+    aggregate.totalRecords += partialAggregate.totalRecords;
+    aggregate.indexNodesAccessed += partialAggregate.indexNodesAccessed;
+    aggregate.overflowBlocksAccessed += partialAggregate.overflowBlocksAccessed;
+    aggregate.dataBlocksAccessed += partialAggregate.dataBlocksAccessed;
+    aggregate.keysFound += partialAggregate.keysFound;
+  }
+  addBufferedInsertsToAggregate(getBufferedInsertsOfRange(startKey, endKey), aggregate);
+  return aggregate;
 }
 
-uint BPlusTree::getNumberOfOverflowBlocks() {
-  return overflowBlkCounter;
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::enableKeyCompression(uint blockSize) {
+  if (!is_same<KeyType, int>::value) {
+    cout << "Only integer keys can be compressed." << endl;
+    throw "Only integer keys can be compressed.";
+  } else if (root != nullptr) {
+    cout << "Key compression has to be enabled before inserting into the tree." << endl;
+    throw "Key compression has to be enabled before inserting into the tree.";
+  }
+  isCompressed = true;
+  nodeBlockSize = blockSize;
+  // the fixed key count becomes an upper bound, the packed size decides when a node is full
+  maxKeys = getMaximumKeysInCompressedNode(blockSize);
 }
 
-uint BPlusTree::getSizeOfOverflowBlocks(uint blockSize) {
-  uint numberOfOverflowblocks = getNumberOfOverflowBlocks();
-  uint sizeOfOverFlowBlocks = numberOfOverflowblocks * blockSize;
-  return sizeOfOverFlowBlocks;
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::isKeyCompressionEnabled() {
+  return isCompressed;
 }
 
-bool BPlusTree::canPrintNode(uint indexNodesPrintedCount) {
-  bool toPrint = indexNodesPrintedCount > MAX_INDEX_NODES_TO_PRINT ? false : true;
-  return toPrint;
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::enableLeafFilters(uint bitsPerKey) {
+  if (bitsPerKey == 0) {
+    cout << "A leaf filter needs at least 1 bit per key." << endl;
+    throw "A leaf filter needs at least 1 bit per key.";
+  }
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  isLeafFiltered = true;
+  leafFilterBitsPerKey = bitsPerKey;
+  if (root != nullptr) {
+    buildLeafFilters(root);
+  }
 }
 
-void BPlusTree::printContentOfNode(Node* cursor) {
-  if (cursor == nullptr) {
-    cout << "Node is empty." << endl;
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::isLeafFilterEnabled() {
+  return isLeafFiltered;
+}
+
+template <typename KeyType, typename KeyCompare>
+LeafFilterStatistics BPlusTree<KeyType, KeyCompare>::getLeafFilterStatistics() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  LeafFilterStatistics statistics;
+  if (!isLeafFiltered) {
+    return statistics;
   }
-  cout << "{ ";
-  uint i = 0;
-  while (i < (*cursor).keys.size()) {
-    cout << (*cursor).keys[i++];
-    if (i == (*cursor).keys.size()) {
-      cout << " }" << endl;
-      return;
-    } else {
-      cout << KEY_SEPARATOR;
-    }
+  statistics.bitsPerKey = leafFilterBitsPerKey;
+  statistics.numberOfHashes = getNumberOfFilterHashes(leafFilterBitsPerKey);
+  statistics.lookups = leafFilterLookups;
+  statistics.negatives = leafFilterNegatives;
+  statistics.falsePositives = leafFilterFalsePositives;
+  // the leftmost leaf starts the chain of every leaf
+  Node<KeyType>* cursor = root;
+  while (cursor != nullptr && !(*cursor).isLeaf) {
+    cursor = (Node<KeyType>*) (*cursor).ptrs[0];
   }
-  return;
+  while (cursor != nullptr) {
+    ++statistics.numberOfFilters;
+    statistics.filterBytes += (*cursor).filter.bits.capacity() * sizeof(uint64_t);
+    cursor = (*cursor).ptrs.size() > (*cursor).keys.size() ? (Node<KeyType>*) (*cursor).ptrs.back() : nullptr;
+  }
+  return statistics;
 }
 
-void BPlusTree::printRootContent() {
-  if (root == nullptr) {
-    cout << "The tree is empty, there is no root node." << endl;
-    return;
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::enableBufferedInserts(uint maxBufferedInserts) {
+  if (isUnique) {
+    // a duplicate would only be detected when its insert reaches the leaf, long after insertKey returned
+    cout << "Buffered inserts cannot be used on a unique index." << endl;
+    throw "Buffered inserts cannot be used on a unique index.";
   }
-  printContentOfNode(root);
-  return;
+  isBuffered = true;
+  this->maxBufferedInserts = maxBufferedInserts;
 }
 
-void BPlusTree::printFirstChildContent() {
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::flushAllBuffers() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  // buffers are flushed top down, so nodes created by splits below never receive buffered inserts
+  while (bufferedInsertCounter > 0) {
+    flushSubtree(root);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfBufferedInserts() {
+  return bufferedInsertCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::enableLazyDeletes(double minimumLeafFill, double minimumInternalFill, uint maintenanceIntervalMs, ThreadPool& scheduler) {
+  if (isLazyDeleting) {
+    cout << "Lazy deletes are already enabled." << endl;
+    throw "Lazy deletes are already enabled.";
+  }
+  // an empty node is always merged, and rebalancing never aims above the B+ Tree minimum
+  minimumLeafKeys = max(1u, min((uint) ceil(minimumLeafFill * maxKeys), (maxKeys + 1) / 2));
+  minimumInternalKeys = max(1u, min((uint) ceil(minimumInternalFill * maxKeys), maxKeys / 2));
+  this->maintenanceIntervalMs = maintenanceIntervalMs;
+  isLazyDeleting = true;
+  maintenanceScheduler = &scheduler;
+  isMaintenanceRunning = true; // set before the first pass is scheduled, so its own operations lock the tree too
+  lock_guard<mutex> maintenanceLock(maintenanceMutex);
+  isMaintenanceStopping = false;
+  maintenancePassesInFlight = 1;
+  scheduledMaintenanceId = maintenanceScheduler->submitAfter(maintenanceIntervalMs, [this]() { runScheduledMaintenance(); });
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::disableLazyDeletes() {
+  if (!isLazyDeleting) {
+    return;
+  }
+  stopMaintenance();
+
+  // deletes that rebalance right away expect every node to be at least at the B+ Tree minimum
+  isLazyDeleting = false;
+  minimumLeafKeys = (maxKeys + 1) / 2;
+  minimumInternalKeys = maxKeys / 2;
+  runMaintenance();
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::runMaintenance() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  DeleteSummary summary;
+  if (root == nullptr) {
+    return summary.nodesDeleted;
+  }
+  // merging moves children between internal nodes, so no insert may be left in a buffer
+  flushAllBuffers();
+  isFrozenLevelsFresh = false;
+
+  vector<Node<KeyType>*> path;
+  vector<vector<Node<KeyType>*>> underfullPaths;
+  collectUnderfullPaths(root, path, underfullPaths);
+  // nodes at or above the minimums set for lazy deletes are left as they are, even on the paths of underfull nodes
+  rebalanceAfterDeletes(underfullPaths, minimumLeafKeys, minimumInternalKeys, summary);
+  lazyDeleteCounter = 0;
+  underfullLeafKeys.clear();
+  return summary.nodesDeleted;
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::runMaintenanceBatch(uint maxLeaves) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (root == nullptr) {
+    underfullLeafKeys.clear();
+  }
+  if (underfullLeafKeys.empty()) {
+    lazyDeleteCounter = 0;
+    return false;
+  }
+  // merging moves children between internal nodes, so no insert may be left in a buffer
+  flushAllBuffers();
+
+  vector<KeyType> leafKeys;
+  while (!underfullLeafKeys.empty() && leafKeys.size() < maxLeaves) {
+    leafKeys.push_back(underfullLeafKeys.front());
+    underfullLeafKeys.pop_front();
+  }
+  // lazy deletes leave the separators alone, so a key still leads to its leaf or to the leaf it was merged into.
+  // sorted, the paths are left to right as rebalanceAfterDeletes expects, and a leaf noted twice comes up twice in a row
+  sort(leafKeys.begin(), leafKeys.end(), keyCompare);
+  vector<vector<Node<KeyType>*>> underfullPaths;
+  for (auto& key: leafKeys) {
+    vector<Node<KeyType>*> path;
+    Node<KeyType>* cursor = root;
+    while ((*cursor).isLeaf != true) {
+      path.push_back(cursor);
+      cursor = (Node<KeyType>*) (*cursor).ptrs[findChildIndex(cursor, key)];
+    }
+    path.push_back(cursor);
+    bool isNotedAlready = !underfullPaths.empty() && underfullPaths.back().back() == cursor;
+    if (cursor != root && (*cursor).keys.size() < minimumLeafKeys && !isNotedAlready) {
+      underfullPaths.push_back(path);
+    }
+  }
+  if (!underfullPaths.empty()) {
+    DeleteSummary summary;
+    isFrozenLevelsFresh = false;
+    rebalanceAfterDeletes(underfullPaths, minimumLeafKeys, minimumInternalKeys, summary);
+  }
+  if (underfullLeafKeys.empty()) {
+    lazyDeleteCounter = 0;
+    return false;
+  }
+  return true;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfLazyDeletes() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  return lazyDeleteCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::printMaintenanceBatches() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  cout << "Maintenance batches of up to " << MAINTENANCE_BATCH_LEAVES << " leaves: " << maintenanceBatchCounter
+       << ", longest held the tree for " << longestMaintenanceBatchUs << "us" << endl;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::printTreeHealth() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  vector<uint> leafFill(10, 0);
+  vector<uint> internalFill(10, 0);
+  if (root != nullptr) {
+    addNodeFillToHistogram(root, leafFill, internalFill);
+  }
+
+  cout << "Fill of " << nodeCounter << " nodes holding up to " << maxKeys << " keys:" << endl;
+  cout << "Keys deleted since the last maintenance pass: " << lazyDeleteCounter << endl;
+  for (uint bucket = 0; bucket < 10; ++bucket) {
+    cout << "  " << bucket * 10 << "-" << (bucket == 9 ? 100 : bucket * 10 + 9) << "%: "
+         << leafFill[bucket] << " leaves, " << internalFill[bucket] << " internal nodes" << endl;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfUnderfullNodes() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (root == nullptr) {
+    return 0;
+  }
+  vector<Node<KeyType>*> path;
+  vector<vector<Node<KeyType>*>> underfullPaths;
+  collectUnderfullPaths(root, path, underfullPaths);
+  return underfullPaths.size();
+}
+
+template <typename KeyType, typename KeyCompare>
+TreeStatistics BPlusTree<KeyType, KeyCompare>::getStatistics(uint blockSize) {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  TreeStatistics statistics;
+  statistics.maxKeys = maxKeys;
+  statistics.numberOfBufferedInserts = bufferedInsertCounter;
+  statistics.hasQueryCache = queryCache != nullptr;
+  statistics.hasSnapshots = isSnapshotEnabled;
+  if (isSnapshotEnabled) {
+    statistics.snapshots = getSnapshotStatistics();
+  }
+  statistics.hasLeafFilters = isLeafFiltered;
+  if (isLeafFiltered) {
+    statistics.leafFilters = getLeafFilterStatistics();
+  }
+  if (queryCache != nullptr) {
+    statistics.queryCache = queryCache->getStatistics();
+  }
+  statistics.leafOccupancy.assign(maxKeys + 1, 0);
+  statistics.internalOccupancy.assign(maxKeys + 1, 0);
+  if (root == nullptr) {
+    return statistics;
+  }
+
+  vector<uint> recordsOfKeys;
+  addNodeToStatistics(root, 0, blockSize, statistics, recordsOfKeys);
+  statistics.height = statistics.nodesPerLevel.size();
+  statistics.numberOfKeys = recordsOfKeys.size();
+
+  uint leafKeys = 0;
+  uint numberOfLeaves = 0;
+  uint internalKeys = 0;
+  uint numberOfInternalNodes = 0;
+  for (uint keysInNode = 0; keysInNode <= maxKeys; ++keysInNode) {
+    leafKeys += keysInNode * statistics.leafOccupancy[keysInNode];
+    numberOfLeaves += statistics.leafOccupancy[keysInNode];
+    internalKeys += keysInNode * statistics.internalOccupancy[keysInNode];
+    numberOfInternalNodes += statistics.internalOccupancy[keysInNode];
+  }
+  statistics.leafFillFactor = numberOfLeaves == 0 ? 0.0 : (double) leafKeys / ((double) numberOfLeaves * maxKeys);
+  statistics.internalFillFactor = numberOfInternalNodes == 0 ? 0.0 : (double) internalKeys / ((double) numberOfInternalNodes * maxKeys);
+
+  // duplicates per key in power of two buckets, and the share of the records held by the most duplicated keys
+  if (!recordsOfKeys.empty()) {
+    for (auto records: recordsOfKeys) {
+      uint bucket = 1;
+      while (bucket * 2 <= records) {
+        bucket *= 2;
+      }
+      ++statistics.recordsPerKey[bucket];
+    }
+    sort(recordsOfKeys.begin(), recordsOfKeys.end(), greater<uint>());
+    statistics.maxRecordsPerKey = recordsOfKeys.front();
+    statistics.meanRecordsPerKey = (double) statistics.numberOfRecords / recordsOfKeys.size();
+    uint numberOfTopKeys = max((uint) 1, (uint) recordsOfKeys.size() / 100);
+    uint recordsOfTopKeys = 0;
+    for (uint i = 0; i < numberOfTopKeys; ++i) {
+      recordsOfTopKeys += recordsOfKeys[i];
+    }
+    statistics.topKeysRecordShare = statistics.numberOfRecords == 0 ? 0.0 : (double) recordsOfTopKeys / statistics.numberOfRecords;
+  }
+  return statistics;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getMaxKeys() {
+  return maxKeys;
+}
+
+template <typename KeyType, typename KeyCompare>
+Node<KeyType>* BPlusTree<KeyType, KeyCompare>::getRootOfTree() {
+  return root;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfNodesInTree() {
+  return nodeCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfLeavesInTree() {
+  return leafCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getTreeHeight() {
+  return treeHeight;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfRecordsIndexed() {
+  return indexedRecordCounter + bufferedInsertCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getSizeOfBPlusTree(uint blockSize) {
+  uint numberOfIndexNodes = getNumberOfNodesInTree();
+  uint sizeOfBPlusTreeIndex = numberOfIndexNodes * blockSize;
+  return sizeOfBPlusTreeIndex;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getNumberOfOverflowBlocks() {
+  return overflowBlkCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::getSizeOfOverflowBlocks(uint blockSize) {
+  uint numberOfOverflowblocks = getNumberOfOverflowBlocks();
+  uint sizeOfOverFlowBlocks = numberOfOverflowblocks * blockSize;
+  return sizeOfOverFlowBlocks;
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::canPrintNode(uint indexNodesPrintedCount) {
+  bool toPrint = indexNodesPrintedCount > MAX_INDEX_NODES_TO_PRINT ? false : true;
+  return toPrint;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::printContentOfNode(Node<KeyType>* cursor) {
+  if (cursor == nullptr) {
+    cout << "Node is empty." << endl;
+  }
+  cout << "{ ";
+  if ((*cursor).keys.empty()) {
+    cout << "}" << endl;
+    return;
+  }
+  uint i = 0;
+  while (i < (*cursor).keys.size()) {
+    cout << (*cursor).keys[i++];
+    if (i == (*cursor).keys.size()) {
+      cout << " }" << endl;
+      return;
+    } else {
+      cout << KEY_SEPARATOR;
+    }
+  }
+  return;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::printRootContent() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (root == nullptr) {
+    cout << "The tree is empty, there is no root node." << endl;
+    return;
+  }
+  printContentOfNode(root);
+  return;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::printFirstChildContent() {
+  unique_lock<recursive_mutex> treeLock = lockTree();
+  if (root == nullptr) {
+    cout << "The tree is empty, there is no root node." << endl;
+    return;
+  }
   if (root->isLeaf == true) {
     cout << "This tree only has a root node with no child." << endl;
     return;
   }
-  printContentOfNode((Node*) (*root).ptrs.front());
+  printContentOfNode((Node<KeyType>*) (*root).ptrs.front());
   return;
 }
 
-void BPlusTree::display(Node *cursor) {
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::display(Node<KeyType>* cursor) {
   if (cursor != nullptr) {
     printContentOfNode(cursor);
     if ((*cursor).isLeaf!= true) {
       for (uint i = 0; i < (*cursor).keys.size() + 1; i++) {
-        display((Node*) (*cursor).ptrs[i]);
+        display((Node<KeyType>*) (*cursor).ptrs[i]);
+      }
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::keysEqual(const KeyType& firstKey, const KeyType& secondKey) {
+  return !keyCompare(firstKey, secondKey) && !keyCompare(secondKey, firstKey);
+}
+
+template <typename KeyType, typename KeyCompare>
+int BPlusTree<KeyType, KeyCompare>::deleteRecordsWithKey(Block* blockPtr, KeyType key) {
+  int recordsDeletedCounter = 0;
+  for (uint i = 0; i < blockPtr->__records.size(); ++i) {
+    if (recordHasKey(blockPtr->__records[i], key, keyCompare)) {
+      blockPtr->__records.erase(blockPtr->__records.begin() + i);
+      --i; // if you delete go backwards because element was shifted
+      ++recordsDeletedCounter;
+    }
+  }
+  if (recordsDeletedCounter > 0) {
+    blockPtr->refreshMetadata(); // the zone map and packed size of the block shrink with its records
+  }
+  return recordsDeletedCounter;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::addBlockPointerToOverflowBlock(OverflowBlock* overflowBlock, Block* blockPtr, const IncludedColumns& includedColumns) {
+  overflowBlock->blockPtrs.push_back(blockPtr);
+  ++indexedRecordCounter;
+  if (isCovering) {
+    overflowBlock->includedColumns.push_back(includedColumns);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::deleteEntriesFromLeaf(Node<KeyType>* leaf, const vector<uint>& entryIndexes, DeleteSummary& summary, set<Block*>& emptiedBlocks) {
+  for (auto entryIdx: entryIndexes) {
+    noteKeyChanged((*leaf).keys[entryIdx]);
+    logRemovedOverflowChain((*leaf).keys[entryIdx], (OverflowBlock*) (*leaf).ptrs[entryIdx]);
+    OverflowBlock* overflowBlockToDelete = (OverflowBlock*) (*leaf).ptrs[entryIdx];
+    while (overflowBlockToDelete != nullptr) {
+      for (auto blkPtr: overflowBlockToDelete->blockPtrs) {
+        summary.recordsDeleted += deleteRecordsWithKey(blkPtr, (*leaf).keys[entryIdx]);
+        if (blkPtr->__records.empty()) {
+          emptiedBlocks.insert(blkPtr);
+        }
+      }
+      OverflowBlock* temp = overflowBlockToDelete->next;
+      --overflowBlkCounter;
+      indexedRecordCounter -= overflowBlockToDelete->blockPtrs.size();
+      ++summary.overflowBlocksDeleted;
+      retire(overflowBlockToDelete);
+      overflowBlockToDelete = temp;
+    }
+  }
+
+  // compact the remaining entries in one pass, the next leaf pointer stays last
+  uint entriesKept = 0;
+  uint nextEntryToDelete = 0;
+  for (uint i = 0; i < (*leaf).keys.size(); ++i) {
+    if (nextEntryToDelete < entryIndexes.size() && entryIndexes[nextEntryToDelete] == i) {
+      ++nextEntryToDelete;
+      continue;
+    }
+    (*leaf).keys[entriesKept] = (*leaf).keys[i];
+    (*leaf).ptrs[entriesKept] = (*leaf).ptrs[i];
+    ++entriesKept;
+  }
+  bool hasNextLeaf = (*leaf).ptrs.size() > (*leaf).keys.size();
+  if (hasNextLeaf) {
+    (*leaf).ptrs[entriesKept] = (*leaf).ptrs.back();
+  }
+  (*leaf).keys.resize(entriesKept);
+  (*leaf).ptrs.resize(entriesKept + (hasNextLeaf ? 1 : 0));
+  refreshPackedKeys(leaf);
+  summary.keysDeleted += entryIndexes.size();
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceAfterDeletes(const vector<vector<Node<KeyType>*>>& affectedPaths, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary) {
+  if (!affectedPaths.empty()) {
+    // paths of maintenance can end at an internal node, so they are not all as long as the tree is high
+    uint leafDepth = 0;
+    for (auto& path: affectedPaths) {
+      leafDepth = max(leafDepth, (uint) path.size() - 1);
+    }
+    for (int depth = leafDepth; depth >= 1; --depth) {
+      // paths are left to right, so the nodes at a depth are too and repeats are next to each other
+      vector<Node<KeyType>*> nodesAtDepth;
+      vector<Node<KeyType>*> parentsOfNodes;
+      for (auto& path: affectedPaths) {
+        if ((int) path.size() <= depth) {
+          continue;
+        }
+        if (nodesAtDepth.empty() || nodesAtDepth.back() != path[depth]) {
+          nodesAtDepth.push_back(path[depth]);
+          parentsOfNodes.push_back(path[depth - 1]);
+        }
+      }
+      for (int i = (int) nodesAtDepth.size() - 1; i >= 0; --i) {
+        rebalanceNode(nodesAtDepth[i], parentsOfNodes[i], minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
       }
     }
   }
+
+  // a root left with a single child is replaced by the child, an empty root leaf empties the tree
+  while (root != nullptr && (*root).isLeaf != true && (*root).keys.empty()) {
+    Node<KeyType>* oldRoot = root;
+    root = (Node<KeyType>*) (*oldRoot).ptrs.front();
+    retire(oldRoot);
+    --nodeCounter;
+    --treeHeight;
+    ++summary.nodesDeleted;
+  }
+  if (root != nullptr && (*root).isLeaf && (*root).keys.empty()) {
+    retire(root);
+    root = nullptr;
+    --nodeCounter;
+    --leafCounter;
+    treeHeight = 0;
+    ++summary.nodesDeleted;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceNode(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary) {
+  // checking an underfull node again may merge away a sibling still waiting to be checked. it is gone from
+  // the parent and may already be freed, its keys are in a node that was checked.
+  if (find(parent->ptrs.begin(), parent->ptrs.end(), (void*) cursor) == parent->ptrs.end()) {
+    return;
+  }
+  if ((*cursor).isLeaf) {
+    rebalanceLeaf(cursor, parent, minimumKeysInLeafNode, summary);
+  } else {
+    rebalanceInternal(cursor, parent, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceLeaf(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, DeleteSummary& summary) {
+  if ((*cursor).keys.size() >= minimumKeysInLeafNode) {
+    return;
+  }
+
+  int cursorIdx = 0;
+  while ((Node<KeyType>*) parent->ptrs[cursorIdx] != cursor) {
+    ++cursorIdx;
+  }
+
+  // merge into the left sibling, or take in the right sibling, the left node is always kept so
+  // the next pointer of the leaf before it stays valid
+  Node<KeyType>* leftNode = nullptr;
+  Node<KeyType>* rightNode = nullptr;
+  if (cursorIdx > 0 && canMergeNodes((Node<KeyType>*) parent->ptrs[cursorIdx - 1], cursor, nullptr)) {
+    leftNode = (Node<KeyType>*) parent->ptrs[cursorIdx - 1];
+    rightNode = cursor;
+  } else if (cursorIdx + 1 < (int) parent->ptrs.size() && canMergeNodes(cursor, (Node<KeyType>*) parent->ptrs[cursorIdx + 1], nullptr)) {
+    leftNode = cursor;
+    rightNode = (Node<KeyType>*) parent->ptrs[cursorIdx + 1];
+  }
+  if (leftNode != nullptr) {
+    int separatorIdx = leftNode == cursor ? cursorIdx : cursorIdx - 1;
+    (*leftNode).ptrs.pop_back(); // the next pointer of the left node was the right node
+    (*leftNode).keys.insert((*leftNode).keys.end(), (*rightNode).keys.begin(), (*rightNode).keys.end());
+    (*leftNode).ptrs.insert((*leftNode).ptrs.end(), (*rightNode).ptrs.begin(), (*rightNode).ptrs.end());
+    refreshPackedKeys(leftNode);
+    parent->keys.erase(parent->keys.begin() + separatorIdx);
+    parent->ptrs.erase(parent->ptrs.begin() + separatorIdx + 1);
+    refreshPackedKeys(parent);
+    retire(rightNode);
+    --nodeCounter;
+    --leafCounter;
+    ++summary.nodesDeleted;
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    return;
+  }
+
+  // the siblings are too full to merge with, so the keys are shared evenly with one of them
+  for (int separatorIdx = cursorIdx - 1; separatorIdx <= cursorIdx; ++separatorIdx) {
+    if (separatorIdx < 0 || separatorIdx + 1 >= (int) parent->ptrs.size()) {
+      continue;
+    }
+    leftNode = (Node<KeyType>*) parent->ptrs[separatorIdx];
+    rightNode = (Node<KeyType>*) parent->ptrs[separatorIdx + 1];
+    vector<KeyType> keys((*leftNode).keys);
+    keys.insert(keys.end(), (*rightNode).keys.begin(), (*rightNode).keys.end());
+    vector<void *> ptrs((*leftNode).ptrs.begin(), (*leftNode).ptrs.end() - 1);
+    ptrs.insert(ptrs.end(), (*rightNode).ptrs.begin(), (*rightNode).ptrs.end());
+    uint keysInLeftNode = (keys.size() + 1) / 2;
+    if (!keysFitInNode(keys, 0, keysInLeftNode) || !keysFitInNode(keys, keysInLeftNode, keys.size())
+        || !canReplaceKey(parent, separatorIdx, keys[keysInLeftNode])) {
+      continue;
+    }
+    (*leftNode).keys.assign(keys.begin(), keys.begin() + keysInLeftNode);
+    (*leftNode).ptrs.assign(ptrs.begin(), ptrs.begin() + keysInLeftNode);
+    (*leftNode).ptrs.push_back((void*) rightNode);
+    (*rightNode).keys.assign(keys.begin() + keysInLeftNode, keys.end());
+    (*rightNode).ptrs.assign(ptrs.begin() + keysInLeftNode, ptrs.end());
+    parent->keys[separatorIdx] = (*rightNode).keys.front();
+    refreshPackedKeys(leftNode);
+    refreshPackedKeys(rightNode);
+    refreshPackedKeys(parent);
+    INSTRUMENT_TREE_EVENT(NODE_BORROW);
+    return;
+  }
+  // a compressed leaf whose keys fit nowhere stays underfull
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceInternal(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary) {
+  if ((*cursor).keys.size() >= minimumKeysInInternalNode) {
+    return;
+  }
+
+  int cursorIdx = 0;
+  while ((Node<KeyType>*) parent->ptrs[cursorIdx] != cursor) {
+    ++cursorIdx;
+  }
+
+  // buffers were flushed before deleting, so children move between nodes without buffered inserts
+  Node<KeyType>* leftNode = nullptr;
+  Node<KeyType>* rightNode = nullptr;
+  if (cursorIdx > 0 && canMergeNodes((Node<KeyType>*) parent->ptrs[cursorIdx - 1], cursor, &parent->keys[cursorIdx - 1])) {
+    leftNode = (Node<KeyType>*) parent->ptrs[cursorIdx - 1];
+    rightNode = cursor;
+  } else if (cursorIdx + 1 < (int) parent->ptrs.size() && canMergeNodes(cursor, (Node<KeyType>*) parent->ptrs[cursorIdx + 1], &parent->keys[cursorIdx])) {
+    leftNode = cursor;
+    rightNode = (Node<KeyType>*) parent->ptrs[cursorIdx + 1];
+  }
+  if (leftNode != nullptr) {
+    // the separator is pulled down between the keys of the two nodes
+    int separatorIdx = leftNode == cursor ? cursorIdx : cursorIdx - 1;
+    (*leftNode).keys.push_back(parent->keys[separatorIdx]);
+    (*leftNode).keys.insert((*leftNode).keys.end(), (*rightNode).keys.begin(), (*rightNode).keys.end());
+    (*leftNode).ptrs.insert((*leftNode).ptrs.end(), (*rightNode).ptrs.begin(), (*rightNode).ptrs.end());
+    refreshPackedKeys(leftNode);
+    parent->keys.erase(parent->keys.begin() + separatorIdx);
+    parent->ptrs.erase(parent->ptrs.begin() + separatorIdx + 1);
+    refreshPackedKeys(parent);
+    retire(rightNode);
+    --nodeCounter;
+    ++summary.nodesDeleted;
+    INSTRUMENT_TREE_EVENT(NODE_MERGE);
+    rebalanceChildrenAndNode(leftNode, parent, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+    return;
+  }
+
+  // share the children evenly with a sibling, the middle key moves up as the new separator
+  for (int separatorIdx = cursorIdx - 1; separatorIdx <= cursorIdx; ++separatorIdx) {
+    if (separatorIdx < 0 || separatorIdx + 1 >= (int) parent->ptrs.size()) {
+      continue;
+    }
+    leftNode = (Node<KeyType>*) parent->ptrs[separatorIdx];
+    rightNode = (Node<KeyType>*) parent->ptrs[separatorIdx + 1];
+    vector<KeyType> keys((*leftNode).keys);
+    keys.push_back(parent->keys[separatorIdx]);
+    keys.insert(keys.end(), (*rightNode).keys.begin(), (*rightNode).keys.end());
+    vector<void *> ptrs((*leftNode).ptrs);
+    ptrs.insert(ptrs.end(), (*rightNode).ptrs.begin(), (*rightNode).ptrs.end());
+    uint keysInLeftNode = keys.size() / 2;
+    if (!keysFitInNode(keys, 0, keysInLeftNode) || !keysFitInNode(keys, keysInLeftNode + 1, keys.size())
+        || !canReplaceKey(parent, separatorIdx, keys[keysInLeftNode])) {
+      continue;
+    }
+    (*leftNode).keys.assign(keys.begin(), keys.begin() + keysInLeftNode);
+    (*leftNode).ptrs.assign(ptrs.begin(), ptrs.begin() + keysInLeftNode + 1);
+    (*rightNode).keys.assign(keys.begin() + keysInLeftNode + 1, keys.end());
+    (*rightNode).ptrs.assign(ptrs.begin() + keysInLeftNode + 1, ptrs.end());
+    parent->keys[separatorIdx] = keys[keysInLeftNode];
+    refreshPackedKeys(leftNode);
+    refreshPackedKeys(rightNode);
+    refreshPackedKeys(parent);
+    INSTRUMENT_TREE_EVENT(NODE_BORROW);
+    // the right node may merge into the left one, which is never freed by rebalancing the right one
+    rebalanceChildrenAndNode(rightNode, parent, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+    rebalanceChildrenAndNode(leftNode, parent, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+    return;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceChildren(Node<KeyType>* node, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary) {
+  // right to left, so a merge only frees the child being checked or a right sibling already checked
+  vector<void *> children(node->ptrs);
+  for (int i = (int) children.size() - 1; i >= 0; --i) {
+    rebalanceNode((Node<KeyType>*) children[i], node, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::rebalanceChildrenAndNode(Node<KeyType>* node, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary) {
+  uint keysBefore = (*node).keys.size();
+  rebalanceChildren(node, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+  // every merge below took a separator out of the node, so it may have become underfull after it was checked.
+  // only checked again if it lost keys, so a node that could not be rebalanced is not tried forever.
+  if ((*node).keys.size() < keysBefore) {
+    rebalanceInternal(node, parent, minimumKeysInLeafNode, minimumKeysInInternalNode, summary);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+unique_lock<recursive_mutex> BPlusTree<KeyType, KeyCompare>::lockTree() {
+  if (isMaintenanceRunning || isSnapshotEnabled) {
+    return unique_lock<recursive_mutex>(treeMutex);
+  }
+  return unique_lock<recursive_mutex>(treeMutex, defer_lock);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::collectUnderfullPaths(Node<KeyType>* cursor, vector<Node<KeyType>*>& path, vector<vector<Node<KeyType>*>>& underfullPaths) {
+  path.push_back(cursor);
+  // the root has no minimum, it only shrinks once it is left with a single child
+  uint minimumKeys = (*cursor).isLeaf ? minimumLeafKeys : minimumInternalKeys;
+  if (cursor != root && (*cursor).keys.size() < minimumKeys) {
+    underfullPaths.push_back(path);
+  }
+  if ((*cursor).isLeaf != true) {
+    for (auto child: (*cursor).ptrs) {
+      collectUnderfullPaths((Node<KeyType>*) child, path, underfullPaths);
+    }
+  }
+  path.pop_back();
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::addNodeFillToHistogram(Node<KeyType>* cursor, vector<uint>& leafFill, vector<uint>& internalFill) {
+  uint bucket = min(9u, (uint) ((*cursor).keys.size() * 10 / maxKeys));
+  if ((*cursor).isLeaf) {
+    ++leafFill[bucket];
+    return;
+  }
+  ++internalFill[bucket];
+  for (auto child: (*cursor).ptrs) {
+    addNodeFillToHistogram((Node<KeyType>*) child, leafFill, internalFill);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::addNodeToStatistics(Node<KeyType>* cursor, uint level, uint blockSize, TreeStatistics& statistics, vector<uint>& recordsOfKeys) {
+  if (statistics.nodesPerLevel.size() <= level) {
+    statistics.nodesPerLevel.push_back(0);
+  }
+  ++statistics.nodesPerLevel[level];
+
+  // laid out as the pointers, the keys (bit-packed when compressed) and the isLeaf flag
+  uint keysInNode = (*cursor).keys.size();
+  ++statistics.nodes.numberOfBlocks;
+  statistics.nodes.bytesAllocated += blockSize;
+  if (isCompressed) {
+    statistics.nodes.bytesUsed += keysInNode == 0 ? COMPRESSED_NODE_HEADER_SIZE
+        : getCompressedNodeSizeOfRange((*cursor).keys.front(), (*cursor).keys.back(), keysInNode);
+  } else {
+    statistics.nodes.bytesUsed += getNodeLayoutSize((*cursor).ptrs.size(), keysInNode, sizeof(KeyType), alignof(KeyType));
+  }
+  statistics.nodes.bytesUsed += (*cursor).buffer.size() * (sizeof(KeyType) + SIZE_OF_POINTER);
+  statistics.nodes.heapBytes += sizeof(Node<KeyType>) + (*cursor).keys.capacity() * sizeof(KeyType)
+      + (*cursor).ptrs.capacity() * sizeof(void *) + (*cursor).buffer.capacity() * sizeof(BufferedInsert<KeyType>)
+      + (*cursor).packedKeys.words.capacity() * sizeof(uint64_t) + (*cursor).filter.bits.capacity() * sizeof(uint64_t);
+
+  if ((*cursor).isLeaf != true) {
+    ++statistics.internalOccupancy[min(keysInNode, maxKeys)];
+    for (auto child: (*cursor).ptrs) {
+      addNodeToStatistics((Node<KeyType>*) child, level + 1, blockSize, statistics, recordsOfKeys);
+    }
+    return;
+  }
+
+  ++statistics.leafOccupancy[min(keysInNode, maxKeys)];
+  for (uint keyIdx = 0; keyIdx < keysInNode; ++keyIdx) {
+    uint chainLength = 0;
+    uint records = 0;
+    for (OverflowBlock* overflowBlock = (OverflowBlock*) (*cursor).ptrs[keyIdx]; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+      ++chainLength;
+      records += overflowBlock->blockPtrs.size();
+      ++statistics.overflowBlocks.numberOfBlocks;
+      statistics.overflowBlocks.bytesAllocated += blockSize;
+      statistics.overflowBlocks.bytesUsed += SIZE_OF_POINTER * (overflowBlock->blockPtrs.size() + 1)
+          + sizeof(IncludedColumns) * overflowBlock->includedColumns.size();
+      statistics.overflowBlocks.heapBytes += sizeof(OverflowBlock) + overflowBlock->blockPtrs.capacity() * sizeof(Block*)
+          + overflowBlock->includedColumns.capacity() * sizeof(IncludedColumns);
+    }
+    ++statistics.overflowChainLengths[chainLength];
+    statistics.numberOfRecords += records;
+    recordsOfKeys.push_back(records);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::runScheduledMaintenance() {
+  // a batch at a time, a delete that takes the tree between two batches ends the pass until the next interval
+  bool hasMoreLeaves = true;
+  while (hasMoreLeaves) {
+    unique_lock<recursive_mutex> treeLock(treeMutex, try_to_lock);
+    if (!treeLock.owns_lock()) {
+      break;
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    hasMoreLeaves = runMaintenanceBatch(MAINTENANCE_BATCH_LEAVES);
+    ++maintenanceBatchCounter;
+    longestMaintenanceBatchUs = max(longestMaintenanceBatchUs, chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    treeLock.unlock();
+    this_thread::yield();
+  }
+  lock_guard<mutex> maintenanceLock(maintenanceMutex);
+  if (isMaintenanceStopping) {
+    maintenancePassesInFlight = 0;
+    maintenanceSignal.notify_all();
+  } else {
+    scheduledMaintenanceId = maintenanceScheduler->submitAfter(maintenanceIntervalMs, [this]() { runScheduledMaintenance(); });
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::stopMaintenance() {
+  if (!isMaintenanceRunning) {
+    return;
+  }
+  unique_lock<mutex> maintenanceLock(maintenanceMutex);
+  isMaintenanceStopping = true;
+  // a pass that already started finishes and tells us, one that has not is cancelled
+  if (maintenanceScheduler->cancel(scheduledMaintenanceId)) {
+    maintenancePassesInFlight = 0;
+  }
+  maintenanceSignal.wait(maintenanceLock, [this]() { return maintenancePassesInFlight == 0; });
+  isMaintenanceRunning = false;
+}
+
+template <typename KeyType, typename KeyCompare>
+BPlusTree<KeyType, KeyCompare>::~BPlusTree() {
+  stopMaintenance();
+  // no reader is left to walk the merged chains, so they are freed rather than retired
+  for (auto& mergedOverflowChain: mergedOverflowChains) {
+    deleteOverflowChainCopy(mergedOverflowChain.second);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::addBlockPointerToOverflowChain(OverflowBlock* overflowBlock, Block* blockPtr, const IncludedColumns& includedColumns) {
+  // if overflow block is full, keep checking until you can find an empty one.
+  while (overflowBlock->blockPtrs.size() >= maxBlkPtrsInOverflowBlock && overflowBlock->next != nullptr) {
+    overflowBlock = overflowBlock->next;
+  }
+  // if block is full and the next pointer = nullptr, means we need to create new overflow block
+  if (overflowBlock->blockPtrs.size() >= maxBlkPtrsInOverflowBlock) {
+    OverflowBlock* newOverflowBlock = new OverflowBlock();
+    ++overflowBlkCounter;
+    overflowBlock->next = newOverflowBlock;
+    overflowBlock = newOverflowBlock;
+  }
+  addBlockPointerToOverflowBlock(overflowBlock, blockPtr, includedColumns);
+  return overflowBlock;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::addOverflowChainToAggregate(KeyType key, OverflowBlock* overflowBlock, IndexAggregate& aggregate) {
+  set<Block*> visitedBlocks; // a block holding several records of the key appears once per record
+  aggregate.keysFound += overflowBlock != nullptr;
+  while (overflowBlock != nullptr) {
+    ++aggregate.overflowBlocksAccessed;
+    for (uint i = 0; i < overflowBlock->blockPtrs.size(); ++i) {
+      if (isCovering) {
+        // the rating is stored next to the block pointer in the leaf
+        aggregate.totalRating += overflowBlock->includedColumns[i].__avgRating;
+        ++aggregate.totalRecords;
+      } else if (KeyCoversAvgRating<KeyType>::value) {
+        // every block pointer is one record, and the rating is part of the key
+        aggregate.totalRating += KeyCoversAvgRating<KeyType>::avgRating(key);
+        ++aggregate.totalRecords;
+      } else {
+        // the index does not carry the rating, so the data block has to be read
+        Block* blkPtr = overflowBlock->blockPtrs[i];
+        if (!visitedBlocks.insert(blkPtr).second) {
+          continue;
+        }
+        ++aggregate.dataBlocksAccessed;
+        for (auto &record: blkPtr->__records) {
+          if (recordHasKey(record, key, keyCompare)) {
+            aggregate.totalRating += record.__avgRating;
+            ++aggregate.totalRecords;
+          }
+        }
+      }
+    }
+    overflowBlock = overflowBlock->next;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+uint BPlusTree<KeyType, KeyCompare>::partitionRange(const KeyType& startKey, const KeyType& endKey, uint targetPartitions, vector<Node<KeyType>*>& subtrees, vector<KeyType>& splitKeys) {
+  uint internalNodesAccessed = 0;
+  subtrees.assign(1, root);
+  splitKeys.clear();
+  // every level of the tree is at the same depth, so either all subtrees are leaves or none is
+  while (!subtrees.front()->isLeaf && subtrees.size() < targetPartitions) {
+    vector<Node<KeyType>*> childSubtrees;
+    vector<KeyType> childSplitKeys;
+    for (uint i = 0; i < subtrees.size(); ++i) {
+      Node<KeyType>* node = subtrees[i];
+      ++internalNodesAccessed;
+      // the children from the one holding the start of the range to the one holding its end, and the separators between them
+      int firstChild = findChildIndex(node, startKey);
+      int lastChild = findChildIndex(node, endKey);
+      for (int child = firstChild; child <= lastChild; ++child) {
+        childSubtrees.push_back((Node<KeyType>*) (*node).ptrs[child]);
+        if (child < lastChild) {
+          childSplitKeys.push_back((*node).keys[child]);
+        }
+      }
+      // the separator between two subtrees still separates the last child of one from the first of the next
+      if (i < splitKeys.size()) {
+        childSplitKeys.push_back(splitKeys[i]);
+      }
+    }
+    subtrees.swap(childSubtrees);
+    splitKeys.swap(childSplitKeys);
+  }
+  return internalNodesAccessed;
+}
+
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::findOverflowBlockOfKey(const KeyType& key) {
+  Node<KeyType>* cursor = findLeaf(key);
+  if (cursor == nullptr) {
+    return nullptr;
+  }
+  if (!leafMayContainKey(cursor, key)) {
+    return nullptr;
+  }
+  int indexOfKey = findKeyIndex(cursor, key);
+  if (indexOfKey == (int) (*cursor).keys.size() || !keysEqual((*cursor).keys[indexOfKey], key)) {
+    if (isLeafFiltered) {
+      ++leafFilterFalsePositives;
+    }
+    return nullptr;
+  }
+  return (OverflowBlock*) (*cursor).ptrs[indexOfKey];
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::noteKeyChanged(const KeyType& key) {
+  if (isBuffered) {
+    dropMergedOverflowChain(key);
+  }
+  if (queryCache != nullptr) {
+    queryCache->invalidateKey(key);
+  }
+  isFrozenLevelsFresh = false;
+}
+
+template <typename KeyType, typename KeyCompare>
+float BPlusTree<KeyType, KeyCompare>::getIndexedAvgRating(const KeyType& key, const IncludedColumns& includedColumns) {
+  return isCovering ? includedColumns.__avgRating : KeyCoversAvgRating<KeyType>::avgRating(key);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::logChange(const KeyType& key, float avgRating, bool isInsert) {
+  if (openSnapshots.empty()) {
+    return; // no snapshot can see the state before the change
+  }
+  auto change = changesByKey.insert(make_pair(key, IndexChange{++currentVersion, avgRating, isInsert}));
+  changesByVersion.push_back(change);
+  ++snapshotStatistics.changesLogged;
+  snapshotStatistics.peakChangesRetained = max(snapshotStatistics.peakChangesRetained, (uint) changesByVersion.size());
+  // the oldest snapshots need the most changes, so they expire first
+  while (changesByVersion.size() > snapshotStatistics.maxRetainedChanges && !openSnapshots.empty()) {
+    expiredSnapshots.insert(*openSnapshots.begin());
+    openSnapshots.erase(openSnapshots.begin());
+    ++snapshotStatistics.snapshotsExpired;
+    reclaimChanges();
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::logRemovedOverflowChain(const KeyType& key, OverflowBlock* overflowBlock) {
+  for (; overflowBlock != nullptr && !openSnapshots.empty(); overflowBlock = overflowBlock->next) {
+    for (uint i = 0; i < overflowBlock->blockPtrs.size(); ++i) {
+      logChange(key, getIndexedAvgRating(key, isCovering ? overflowBlock->includedColumns[i] : IncludedColumns()), false);
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::reclaimChanges() {
+  // a snapshot sees the changes made after its version, so the older changes are of no use to any
+  ull oldestSnapshot = openSnapshots.empty() ? currentVersion : *openSnapshots.begin();
+  while (!changesByVersion.empty() && changesByVersion.front()->second.version <= oldestSnapshot) {
+    changesByKey.erase(changesByVersion.front());
+    changesByVersion.pop_front();
+    ++snapshotStatistics.changesReclaimed;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+Node<KeyType>* BPlusTree<KeyType, KeyCompare>::findLeaf(const KeyType& key) {
+  if (isFrozenLevelsFresh) {
+    return frozenLevels.findLeaf(key);
+  } else if (root == nullptr) {
+    return nullptr;
+  }
+  Node<KeyType>* cursor = root;
+  while ((*cursor).isLeaf != true) {
+    int ptrIdxToFollow = findChildIndex(cursor, key);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
+  }
+  return cursor;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::aggregateRangePartition(Node<KeyType>* subtree, KeyType lowKey, KeyType highKey, bool isHighKeyIncluded, IndexAggregate& aggregate) {
+  Node<KeyType>* cursor = subtree;
+  while ((*cursor).isLeaf != true) {
+    ++aggregate.indexNodesAccessed;
+    int ptrIdxToFollow = findChildIndex(cursor, lowKey);
+    cursor = (Node<KeyType>*) (*cursor).ptrs[ptrIdxToFollow];
+  }
+
+  uint keyIdx = findKeyIndex(cursor, lowKey);
+  while (cursor != nullptr) {
+    ++aggregate.indexNodesAccessed;
+    for (; keyIdx < (*cursor).keys.size(); ++keyIdx) {
+      const KeyType& key = (*cursor).keys[keyIdx];
+      bool isPastPartition = isHighKeyIncluded ? keyCompare(highKey, key) : !keyCompare(key, highKey);
+      if (isPastPartition) {
+        return;
+      }
+      addOverflowChainToAggregate(key, (OverflowBlock*) (*cursor).ptrs[keyIdx], aggregate);
+    }
+    // the last pointer of a leaf is the next leaf, if there are as many pointers as keys this is the last leaf
+    cursor = (*cursor).ptrs.size() > (*cursor).keys.size() ? (Node<KeyType>*) (*cursor).ptrs.back() : nullptr;
+    keyIdx = 0;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::flushBuffer(Node<KeyType>* node) {
+  vector<BufferedInsert<KeyType>> bufferedInserts;
+  bufferedInserts.swap(node->buffer);
+  bufferedInsertCounter -= bufferedInserts.size();
+
+  if (((Node<KeyType>*) node->ptrs.front())->isLeaf) {
+    // the children are leaves, so the inserts reach their final position a leaf at a time.
+    // a read of the key now finds them in its chain, the copy merged with them would never be used again
+    for (auto& bufferedInsert: bufferedInserts) {
+      dropMergedOverflowChain(bufferedInsert.key);
+    }
+    insertBatchIntoTree(bufferedInserts);
+    return;
+  }
+
+  // route every insert to the buffer of its child, then flush the children that overflowed.
+  // flushing a child may split this node, but the children themselves stay valid.
+  vector<Node<KeyType>*> childrenToFlush;
+  for (auto& bufferedInsert: bufferedInserts) {
+    Node<KeyType>* child = (Node<KeyType>*) node->ptrs[findChildIndex(node, bufferedInsert.key)];
+    child->buffer.push_back(bufferedInsert);
+    ++bufferedInsertCounter;
+    if (child->buffer.size() == maxBufferedInserts + 1) {
+      childrenToFlush.push_back(child);
+    }
+  }
+  for (auto child: childrenToFlush) {
+    flushBuffer(child);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::flushSubtree(Node<KeyType>* node) {
+  if (node == nullptr || node->isLeaf) {
+    return;
+  }
+  if (!node->buffer.empty()) {
+    flushBuffer(node);
+  }
+  // copy the children, flushing below may split this node
+  vector<void*> children(node->ptrs);
+  for (auto child: children) {
+    flushSubtree((Node<KeyType>*) child);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::collectBufferedInserts(Node<KeyType>* node, const KeyType& startKey, const KeyType& endKey, vector<BufferedInsert<KeyType>>& pendingInserts) {
+  if (node->isLeaf) {
+    return;
+  }
+  // only the children whose key range overlaps the range can hold buffered inserts in it
+  int lastChildIdx = findChildIndex(node, endKey);
+  for (int i = findChildIndex(node, startKey); i <= lastChildIdx; ++i) {
+    collectBufferedInserts((Node<KeyType>*) node->ptrs[i], startKey, endKey, pendingInserts);
+  }
+  for (auto& bufferedInsert: node->buffer) {
+    if (!keyCompare(bufferedInsert.key, startKey) && !keyCompare(endKey, bufferedInsert.key)) {
+      pendingInserts.push_back(bufferedInsert);
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+vector<BufferedInsert<KeyType>> BPlusTree<KeyType, KeyCompare>::getBufferedInsertsOfRange(const KeyType& startKey, const KeyType& endKey) {
+  vector<BufferedInsert<KeyType>> pendingInserts;
+  if (bufferedInsertCounter == 0 || root == nullptr || keyCompare(endKey, startKey)) {
+    return pendingInserts;
+  }
+  collectBufferedInserts(root, startKey, endKey, pendingInserts);
+  // stable so the records of a key keep the order they were inserted in
+  KeyCompare compare = keyCompare;
+  stable_sort(pendingInserts.begin(), pendingInserts.end(), [compare](const BufferedInsert<KeyType>& first, const BufferedInsert<KeyType>& second) {
+    return compare(first.key, second.key);
+  });
+  return pendingInserts;
+}
+
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::copyOverflowChainWithInserts(OverflowBlock* overflowBlock, const vector<BufferedInsert<KeyType>>& pendingInserts, uint runStart, uint runEnd) {
+  OverflowBlock* firstOverflowBlock = new OverflowBlock();
+  OverflowBlock* lastOverflowBlock = firstOverflowBlock;
+  // built without addBlockPointerToOverflowChain, the copy is not part of the tree and leaves its counters alone
+  auto addBlockPointer = [this, &lastOverflowBlock](Block* blockPtr, const IncludedColumns& includedColumns) {
+    if (lastOverflowBlock->blockPtrs.size() >= maxBlkPtrsInOverflowBlock) {
+      lastOverflowBlock->next = new OverflowBlock();
+      lastOverflowBlock = lastOverflowBlock->next;
+    }
+    lastOverflowBlock->blockPtrs.push_back(blockPtr);
+    if (isCovering) {
+      lastOverflowBlock->includedColumns.push_back(includedColumns);
+    }
+  };
+  for (; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+    for (uint i = 0; i < overflowBlock->blockPtrs.size(); ++i) {
+      addBlockPointer(overflowBlock->blockPtrs[i], isCovering ? overflowBlock->includedColumns[i] : IncludedColumns());
+    }
+  }
+  for (uint i = runStart; i < runEnd; ++i) {
+    addBlockPointer(pendingInserts[i].blockPtr, pendingInserts[i].includedColumns);
+  }
+  return firstOverflowBlock;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::deleteOverflowChainCopy(OverflowBlock* overflowBlock) {
+  while (overflowBlock != nullptr) {
+    OverflowBlock* nextOverflowBlock = overflowBlock->next;
+    delete overflowBlock;
+    overflowBlock = nextOverflowBlock;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+OverflowBlock* BPlusTree<KeyType, KeyCompare>::mergeBufferedInsertsOfKey(const KeyType& key, OverflowBlock* overflowBlock, const vector<BufferedInsert<KeyType>>& pendingInserts,
+                                                                         uint runStart, uint runEnd) {
+  if (runStart == runEnd) {
+    return overflowBlock;
+  }
+  // every change to the key drops its copy, so a copy still kept holds the key as it is now
+  lock_guard<mutex> mergedOverflowChainsLock(mergedOverflowChainsMutex);
+  auto mergedOverflowChain = mergedOverflowChains.find(key);
+  if (mergedOverflowChain != mergedOverflowChains.end()) {
+    return mergedOverflowChain->second;
+  }
+  OverflowBlock* mergedOverflowBlock = copyOverflowChainWithInserts(overflowBlock, pendingInserts, runStart, runEnd);
+  mergedOverflowChains[key] = mergedOverflowBlock;
+  return mergedOverflowBlock;
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::mergeBufferedInsertsOfRange(vector<pair<KeyType, OverflowBlock*>>& keyAndOverflowBlocks, const vector<BufferedInsert<KeyType>>& pendingInserts) {
+  if (pendingInserts.empty()) {
+    return;
+  }
+  vector<pair<KeyType, OverflowBlock*>> mergedKeyAndOverflowBlocks;
+  mergedKeyAndOverflowBlocks.reserve(keyAndOverflowBlocks.size() + pendingInserts.size());
+  uint keyIdx = 0;
+  uint runStart = 0;
+  while (keyIdx < keyAndOverflowBlocks.size() || runStart < pendingInserts.size()) {
+    if (runStart == pendingInserts.size() || (keyIdx < keyAndOverflowBlocks.size() && keyCompare(keyAndOverflowBlocks[keyIdx].first, pendingInserts[runStart].key))) {
+      mergedKeyAndOverflowBlocks.push_back(keyAndOverflowBlocks[keyIdx]);
+      ++keyIdx;
+      continue;
+    }
+    // the inserts of the next buffered key, merged with its chain if the leaves hold the key too
+    const KeyType& key = pendingInserts[runStart].key;
+    uint runEnd = runStart + 1;
+    while (runEnd < pendingInserts.size() && keysEqual(pendingInserts[runEnd].key, key)) {
+      ++runEnd;
+    }
+    OverflowBlock* overflowBlock = nullptr;
+    if (keyIdx < keyAndOverflowBlocks.size() && keysEqual(keyAndOverflowBlocks[keyIdx].first, key)) {
+      overflowBlock = keyAndOverflowBlocks[keyIdx].second;
+      ++keyIdx;
+    }
+    mergedKeyAndOverflowBlocks.push_back(make_pair(key, mergeBufferedInsertsOfKey(key, overflowBlock, pendingInserts, runStart, runEnd)));
+    runStart = runEnd;
+  }
+  keyAndOverflowBlocks.swap(mergedKeyAndOverflowBlocks);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::addBufferedInsertsToAggregate(const vector<BufferedInsert<KeyType>>& pendingInserts, IndexAggregate& aggregate) {
+  uint runStart = 0;
+  while (runStart < pendingInserts.size()) {
+    const KeyType& key = pendingInserts[runStart].key;
+    uint runEnd = runStart + 1;
+    while (runEnd < pendingInserts.size() && keysEqual(pendingInserts[runEnd].key, key)) {
+      ++runEnd;
+    }
+    // the aggregate counted the chain of the key in the leaves, it is swapped for the chain merged with the inserts
+    OverflowBlock* overflowBlock = findOverflowBlockOfKey(key);
+    IndexAggregate leafAggregate;
+    addOverflowChainToAggregate(key, overflowBlock, leafAggregate);
+    OverflowBlock* mergedOverflowBlock = copyOverflowChainWithInserts(overflowBlock, pendingInserts, runStart, runEnd);
+    IndexAggregate mergedAggregate;
+    addOverflowChainToAggregate(key, mergedOverflowBlock, mergedAggregate);
+    deleteOverflowChainCopy(mergedOverflowBlock);
+
+    aggregate.totalRating += mergedAggregate.totalRating - leafAggregate.totalRating;
+    aggregate.totalRecords += mergedAggregate.totalRecords - leafAggregate.totalRecords;
+    aggregate.overflowBlocksAccessed += mergedAggregate.overflowBlocksAccessed - leafAggregate.overflowBlocksAccessed;
+    aggregate.dataBlocksAccessed += mergedAggregate.dataBlocksAccessed - leafAggregate.dataBlocksAccessed;
+    aggregate.keysFound += mergedAggregate.keysFound - leafAggregate.keysFound;
+    runStart = runEnd;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::dropMergedOverflowChain(const KeyType& key) {
+  lock_guard<mutex> mergedOverflowChainsLock(mergedOverflowChainsMutex);
+  auto mergedOverflowChain = mergedOverflowChains.find(key);
+  if (mergedOverflowChain == mergedOverflowChains.end()) {
+    return;
+  }
+  // a reader may still walk the copy, so it is retired like a chain removed from the tree
+  for (OverflowBlock* overflowBlock = mergedOverflowChain->second; overflowBlock != nullptr;) {
+    OverflowBlock* nextOverflowBlock = overflowBlock->next;
+    retire(overflowBlock);
+    overflowBlock = nextOverflowBlock;
+  }
+  mergedOverflowChains.erase(mergedOverflowChain);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::refreshPackedKeys(Node<KeyType>* node) {
+  if (isCompressed) {
+    packNodeKeys(node->packedKeys, node->keys);
+  }
+  refreshLeafFilter(node);
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::refreshLeafFilter(Node<KeyType>* node) {
+  if (!isLeafFiltered || !node->isLeaf) {
+    return;
+  }
+  // a Bloom filter cannot forget a key, so the filter is rebuilt from the keys left after a merge, split or delete
+  node->filter.reset(maxKeys, leafFilterBitsPerKey);
+  for (auto& key: node->keys) {
+    node->filter.addHash(KeyHash<KeyType>::hash(key));
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void BPlusTree<KeyType, KeyCompare>::buildLeafFilters(Node<KeyType>* cursor) {
+  if ((*cursor).isLeaf) {
+    refreshLeafFilter(cursor);
+    return;
+  }
+  for (auto child: (*cursor).ptrs) {
+    buildLeafFilters((Node<KeyType>*) child);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::leafMayContainKey(Node<KeyType>* leaf, const KeyType& key) {
+  if (!isLeafFiltered) {
+    return true;
+  }
+  ++leafFilterLookups;
+  if (!leaf->filter.mayContainHash(KeyHash<KeyType>::hash(key))) {
+    ++leafFilterNegatives;
+    return false;
+  }
+  return true;
+}
+
+template <typename KeyType, typename KeyCompare>
+int BPlusTree<KeyType, KeyCompare>::findChildIndex(Node<KeyType>* node, const KeyType& key) {
+  if (isCompressed) {
+    return packedUpperBound(node->packedKeys, key);
+  }
+  return upper_bound(node->keys.begin(), node->keys.end(), key, keyCompare) - node->keys.begin();
+}
+
+template <typename KeyType, typename KeyCompare>
+int BPlusTree<KeyType, KeyCompare>::findKeyIndex(Node<KeyType>* node, const KeyType& key) {
+  if (isCompressed) {
+    return packedLowerBound(node->packedKeys, key);
+  }
+  return lower_bound(node->keys.begin(), node->keys.end(), key, keyCompare) - node->keys.begin();
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::nodeHasSpaceForKey(Node<KeyType>* node, const KeyType& key) {
+  if (node->keys.size() >= maxKeys) {
+    return false;
+  } else if (!isCompressed || node->keys.empty()) {
+    return true;
+  }
+  // the packed width depends on the distance between the smallest and largest key after inserting
+  const KeyType& smallestKey = keyCompare(key, node->keys.front()) ? key : node->keys.front();
+  const KeyType& largestKey = keyCompare(node->keys.back(), key) ? key : node->keys.back();
+  return getCompressedNodeSizeOfRange(smallestKey, largestKey, node->keys.size() + 1) <= nodeBlockSize;
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::canReplaceKey(Node<KeyType>* node, int index, const KeyType& key) {
+  if (!isCompressed) {
+    return true;
+  }
+  // replacing a key keeps the keys sorted, only the first and last key can change the range
+  const KeyType& smallestKey = index == 0 ? key : node->keys.front();
+  const KeyType& largestKey = index == (int) node->keys.size() - 1 ? key : node->keys.back();
+  return getCompressedNodeSizeOfRange(smallestKey, largestKey, node->keys.size()) <= nodeBlockSize;
+}
+
+template <typename KeyType, typename KeyCompare>
+bool BPlusTree<KeyType, KeyCompare>::canMergeNodes(Node<KeyType>* leftNode, Node<KeyType>* rightNode, const KeyType* separator) {
+  uint numberOfKeys = leftNode->keys.size() + rightNode->keys.size() + (separator != nullptr ? 1 : 0);
+  if (numberOfKeys > maxKeys) {
+    return false;
+  } else if (!isCompressed || numberOfKeys == 0) {
+    return true;
+  }
+  const KeyType& smallestKey = !leftNode->keys.empty() ? leftNode->keys.front() : (separator != nullptr ? *separator : rightNode->keys.front());
+  const KeyType& largestKey = !rightNode->keys.empty() ? rightNode->keys.back() : (separator != nullptr ? *separator : leftNode->keys.back());
+  return getCompressedNodeSizeOfRange(smallestKey, largestKey, numberOfKeys) <= nodeBlockSize;
 }
 
+// the tree is compiled once for every column type that can be indexed
+template class BPlusTree<int>;
+template class BPlusTree<float>;
+template class BPlusTree<MovieIdKey, MovieIdKeyCompare>;
+template class BPlusTree<VotesRatingKey, VotesRatingKeyCompare>;
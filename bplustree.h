@@ -1,28 +1,651 @@
 #ifndef H_BPLUSTREE
 #define H_BPLUSTREE
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
 #include "node.h"
 #include "block.h"
 #include "overflowblock.h"
+#include "indexkey.h"
+#include "statistics.h"
+#include "atomiccounter.h"
+#include "threadpool.h"
+#include "querycache.h"
+#include "frozenlevels.h"
+
+#define MAINTENANCE_BATCH_LEAVES 16 // underfull leaves a maintenance pass rebalances before letting go of the tree
 
 using namespace std;
 
 typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief Result of aggregating avgRating over a range of keys, with the accesses needed to compute it.
+ * 
+ */
+struct IndexAggregate {
+  public:
+    double totalRating; // sum of avgRating of the records in range
+    uint totalRecords; // number of records in range
+    uint indexNodesAccessed; // internal and leaf nodes accessed
+    uint overflowBlocksAccessed; // overflow blocks accessed
+    uint dataBlocksAccessed; // data blocks accessed, zero when answered index-only
+    bool isIndexOnly; // whether the index carried the rating so no data block had to be read
+    uint keysFound; // distinct keys in range
+
+    /**
+     * @brief Construct an empty Index Aggregate object.
+     * 
+     */
+    IndexAggregate() : totalRating(0.0), totalRecords(0), indexNodesAccessed(0), overflowBlocksAccessed(0), dataBlocksAccessed(0), isIndexOnly(false), keysFound(0) {}
+};
+
+/**
+ * @brief What a range or batch delete removed and freed.
+ * 
+ */
+struct DeleteSummary {
+  public:
+    uint keysDeleted; // keys removed from the leaves
+    uint recordsDeleted; // records removed from the data blocks
+    uint overflowBlocksDeleted; // overflow blocks freed
+    uint nodesDeleted; // tree nodes freed by merging and shrinking the tree
+    uint dataBlocksFreed; // data blocks left without records
+
+    /**
+     * @brief Construct an empty Delete Summary object.
+     * 
+     */
+    DeleteSummary() : keysDeleted(0), recordsDeleted(0), overflowBlocksDeleted(0), nodesDeleted(0), dataBlocksFreed(0) {}
+};
+
+/**
+ * @brief A record pointer added to or removed from a key while a snapshot was open, logged so the
+ * snapshot can undo it.
+ * 
+ */
+struct IndexChange {
+  public:
+    ull version; // version of the tree the change made
+    float avgRating; // rating of the record the pointer is for
+    bool isInsert; // whether the pointer was added rather than removed
+};
 
 /**
  * @brief The B Plus Tree which will be used to index the relational data.
+ * Nodes and overflow blocks removed from the tree are retired rather than deleted, and freed once
+ * every reader that was in an epoch when they were removed has left it. The lookups enter an epoch
+ * for as long as they read, a caller walking the overflow blocks they return while other threads
+ * delete holds an EpochGuard around the lookup and the walk.
  * 
+ * @tparam KeyType The type of the indexed column (int for numVotes, float for avgRating, MovieIdKey for tConst).
+ * @tparam KeyCompare Strict weak ordering of the keys, two keys are equal when neither orders before the other.
  */
+template <typename KeyType, typename KeyCompare = less<KeyType>>
 class BPlusTree {
 
     private:
-        Node *root; // root of the B+ Tree
+        Node<KeyType> *root; // root of the B+ Tree
         uint maxKeys;    // max number of keys in a tree node
-        uint nodeCounter; // counts the number of nodes the BPTree
+        AtomicCounter<uint> nodeCounter; // counts the number of nodes the BPTree
+        AtomicCounter<uint> leafCounter; // counts the leaf nodes among them
         uint maxBlkPtrsInOverflowBlock; // total block pointers that can be stored in overflow block excluding the nextPtr
-        uint overflowBlkCounter; // counts the number of overflow blocks that is linked to the B+ Tree
+        AtomicCounter<uint> overflowBlkCounter; // counts the number of overflow blocks that is linked to the B+ Tree
+        AtomicCounter<uint> treeHeight; // levels in the tree, kept up to date whenever the root changes
+        AtomicCounter<uint> indexedRecordCounter; // block pointers in the overflow chains, one per record indexed
+        bool isUnique; // a unique index rejects a second record with the same key
+        bool isCovering; // a covering index stores the included columns of every record next to its block pointer
+        KeyCompare keyCompare; // orders the keys in the tree
+        bool isCompressed; // whether node keys are stored frame-of-reference bit-packed, so a node fits as many keys as its block allows
+        uint nodeBlockSize; // size of the block a compressed node has to fit in
+        bool isBuffered; // whether inserts are buffered in internal nodes and flushed down in batches
+        uint maxBufferedInserts; // inserts an internal node buffers before flushing them to its children
+        AtomicCounter<uint> bufferedInsertCounter; // inserts waiting in the buffers of the tree
+        map<KeyType, OverflowBlock*, KeyCompare> mergedOverflowChains; // chains handed out by reads of keys with buffered inserts, dropped when the key changes or its inserts are flushed
+        mutex mergedOverflowChainsMutex; // guards mergedOverflowChains, reads add to it without holding the tree
+        bool isLazyDeleting; // whether deletes leave leaves underfull for maintenance to merge
+        uint minimumLeafKeys; // leaves with fewer keys are merged by maintenance
+        uint minimumInternalKeys; // internal nodes with fewer keys are merged by maintenance
+        uint lazyDeleteCounter; // keys deleted without rebalancing since the last maintenance pass
+        deque<KeyType> underfullLeafKeys; // a key of every leaf lazy deletes took below the minimum, for maintenance to find it by
+        uint maintenanceBatchCounter; // maintenance batches run since lazy deletes were enabled
+        double longestMaintenanceBatchUs; // longest a maintenance batch held the tree, in microseconds
+        uint maintenanceIntervalMs; // time between maintenance passes
+        ThreadPool* maintenanceScheduler; // runs the maintenance passes in the background while deletes are lazy
+        ull scheduledMaintenanceId; // delayed task of the next maintenance pass
+        uint maintenancePassesInFlight; // maintenance passes scheduled or running, 0 or 1
+        mutex maintenanceMutex; // guards isMaintenanceStopping, scheduledMaintenanceId and maintenancePassesInFlight
+        condition_variable maintenanceSignal; // wakes stopMaintenance when the last maintenance pass returns
+        bool isMaintenanceStopping; // tells the maintenance passes not to schedule the next one
+        bool isMaintenanceRunning; // whether maintenance was scheduled and not yet stopped
+        recursive_mutex treeMutex; // held by every operation on the nodes while maintenance runs
+        QueryCache<KeyType, KeyCompare>* queryCache; // results of the hot keys and ranges, nullptr if no cache is attached
+        FrozenLevels<KeyType, KeyCompare> frozenLevels; // contiguous read-only copy of the internal levels, for lookups while it is fresh
+        bool isFrozenLevelsFresh; // whether the tree is unchanged since its internal levels were frozen
+        bool isSnapshotEnabled; // whether snapshots can be taken, every operation then holds treeMutex
+        ull currentVersion; // version of the last change logged
+        multiset<ull> openSnapshots; // versions of the snapshots taken and not yet released
+        multiset<ull> expiredSnapshots; // snapshots expired to bound the version log and not yet released
+        multimap<KeyType, IndexChange, KeyCompare> changesByKey; // changes made since the oldest open snapshot, by key
+        deque<typename multimap<KeyType, IndexChange, KeyCompare>::iterator> changesByVersion; // the same changes, oldest first
+        SnapshotStatistics snapshotStatistics; // counters of the snapshots and of the version log
+        bool isLeafFiltered; // whether every leaf keeps a Bloom filter of its keys, so lookups of absent keys skip the leaf keys
+        uint leafFilterBitsPerKey; // bits of a leaf filter per key a leaf can hold
+        AtomicCounter<ull> leafFilterLookups; // point lookups that probed the filter of their leaf
+        AtomicCounter<ull> leafFilterNegatives; // lookups the filter answered without reading the leaf keys
+        AtomicCounter<ull> leafFilterFalsePositives; // lookups the filter let through to a leaf without the key
+
+        /**
+         * @brief Checks if two keys are equal under the comparator of the tree.
+         * 
+         * @return true If neither key orders before the other.
+         */
+        bool keysEqual(const KeyType& firstKey, const KeyType& secondKey);
+
+        /**
+         * @brief Delete all records in a block whose indexed column matches the key.
+         * 
+         * @param blockPtr The data block to delete from.
+         * @param key The key of the records to delete.
+         * @return int The number of records deleted.
+         */
+        int deleteRecordsWithKey(Block* blockPtr, KeyType key);
+
+        /**
+         * @brief Removes an entry from a leaf node and rebalances the tree by borrowing or merging if the leaf underflows.
+         * 
+         * @param cursor The leaf node containing the entry.
+         * @param parent The parent of the leaf node, nullptr if the leaf is the root.
+         * @param indexToDelete The index of the key and pointer to remove from the leaf.
+         * @return uint The number of nodes deleted.
+         */
+        uint removeKeyFromLeaf(Node<KeyType>* cursor, Node<KeyType>* parent, int indexToDelete);
+
+        /**
+         * @brief Adds a block pointer to an overflow block, along with the included columns if the index is covering.
+         * 
+         * @param overflowBlock The overflow block with space for another pointer.
+         * @param blockPtr The block the record is stored in.
+         * @param includedColumns The included columns of the record.
+         */
+        void addBlockPointerToOverflowBlock(OverflowBlock* overflowBlock, Block* blockPtr, const IncludedColumns& includedColumns);
+
+        /**
+         * @brief Deletes the entries of a leaf along with their overflow chains and the records they point to.
+         * 
+         * @param leaf The leaf to delete from.
+         * @param entryIndexes Ascending positions of the entries to delete.
+         * @param summary Counts what was deleted.
+         * @param emptiedBlocks Collects the data blocks left without records.
+         */
+        void deleteEntriesFromLeaf(Node<KeyType>* leaf, const vector<uint>& entryIndexes, DeleteSummary& summary, set<Block*>& emptiedBlocks);
+
+        /**
+         * @brief Rebalances the nodes on the paths to the leaves a range or batch delete removed entries from,
+         * or to the underfull nodes maintenance found. Level by level from the leaves up, every node is checked
+         * once, right to left, so a merge only ever frees the node being checked or a right sibling already
+         * checked. The root is shrunk last. Deletes pass the B+ Tree minimums, maintenance the minimums set
+         * for lazy deletes.
+         * 
+         * @param affectedPaths Root to leaf paths of the affected leaves, left to right.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced.
+         * @param minimumKeysInInternalNode Internal nodes with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceAfterDeletes(const vector<vector<Node<KeyType>*>>& affectedPaths, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary);
+
+        /**
+         * @brief Rebalances a leaf or internal node if its parent still holds it.
+         * 
+         * @param cursor The node to rebalance.
+         * @param parent The parent of the node.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced.
+         * @param minimumKeysInInternalNode Internal nodes with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceNode(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary);
+
+        /**
+         * @brief Brings an underfull leaf back to minimum occupancy by merging it with a sibling, or if the
+         * merged leaf would not fit, by sharing the keys of both evenly.
+         * 
+         * @param cursor The leaf to rebalance.
+         * @param parent The parent of the leaf.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceLeaf(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, DeleteSummary& summary);
+
+        /**
+         * @brief Brings an underfull internal node back to minimum occupancy by merging it with a sibling
+         * and the separator between them, or if that would not fit, by sharing the children evenly.
+         * 
+         * @param cursor The internal node to rebalance.
+         * @param parent The parent of the node.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced, for the children of the node.
+         * @param minimumKeysInInternalNode Internal nodes with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceInternal(Node<KeyType>* cursor, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary);
+
+        /**
+         * @brief Rebalances the children of an internal node that just took in children of a sibling. A
+         * child whose parent had no other child could not be rebalanced before, now it has siblings.
+         * 
+         * @param node The internal node.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced.
+         * @param minimumKeysInInternalNode Internal nodes with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceChildren(Node<KeyType>* node, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary);
+
+        /**
+         * @brief Rebalances the children of an internal node that just merged or borrowed, then the node
+         * itself again if merging its children left it underfull. Its parent is checked by the caller.
+         * 
+         * @param node The internal node.
+         * @param parent The parent of the node.
+         * @param minimumKeysInLeafNode Leaves with fewer keys are rebalanced.
+         * @param minimumKeysInInternalNode Internal nodes with fewer keys are rebalanced.
+         * @param summary Counts the nodes freed.
+         */
+        void rebalanceChildrenAndNode(Node<KeyType>* node, Node<KeyType>* parent, uint minimumKeysInLeafNode, uint minimumKeysInInternalNode, DeleteSummary& summary);
+
+        /**
+         * @brief Locks the tree against the maintenance passes. Without maintenance the tree is
+         * only used by one thread and the lock is left unlocked.
+         * 
+         * @return unique_lock<recursive_mutex> The lock, released when it goes out of scope.
+         */
+        unique_lock<recursive_mutex> lockTree();
+
+        /**
+         * @brief Collects the path from the root to every node with fewer keys than the maintenance minimum.
+         * 
+         * @param cursor The current node traversed.
+         * @param path The nodes from the root to the cursor.
+         * @param underfullPaths The paths of the underfull nodes, from left to right and top down.
+         */
+        void collectUnderfullPaths(Node<KeyType>* cursor, vector<Node<KeyType>*>& path, vector<vector<Node<KeyType>*>>& underfullPaths);
+
+        /**
+         * @brief Rebalances the next few leaves lazy deletes took below the minimum, found by the keys noted
+         * for them, and the ancestors left underfull by their merges. The rest of the tree is not walked.
+         * 
+         * @param maxLeaves Noted leaves to rebalance at most.
+         * @return true More leaves are noted for the next batch.
+         * @return false Every noted leaf was rebalanced.
+         */
+        bool runMaintenanceBatch(uint maxLeaves);
+
+        /**
+         * @brief Counts every node below the cursor in the bucket of its fill, in tenths of the maximum keys.
+         * 
+         * @param cursor The current node traversed.
+         * @param leafFill Number of leaves per bucket.
+         * @param internalFill Number of internal nodes per bucket.
+         */
+        void addNodeFillToHistogram(Node<KeyType>* cursor, vector<uint>& leafFill, vector<uint>& internalFill);
+
+        /**
+         * @brief Runs one maintenance pass on the scheduler and schedules the next one unless told to
+         * stop. The pass rebalances the noted leaves a batch at a time and lets go of the tree between
+         * batches, so a delete waits for one batch at most. A pass finding the tree locked skips to the next
+         * interval instead of waiting, so it never holds a worker that a parallel scan holding the lock is waiting for.
+         * 
+         */
+        void runScheduledMaintenance();
+
+        /**
+         * @brief Adds a node, and every node and overflow block below it, to the statistics of the tree.
+         * 
+         * @param cursor The current node traversed.
+         * @param level Level of the cursor, the root is at level 0.
+         * @param blockSize Size of a tree node and of an overflow block in bytes(B).
+         * @param statistics The statistics collected so far.
+         * @param recordsOfKeys Records indexed by every key seen so far.
+         */
+        void addNodeToStatistics(Node<KeyType>* cursor, uint level, uint blockSize, TreeStatistics& statistics, vector<uint>& recordsOfKeys);
+
+        /**
+         * @brief Cancels the next maintenance pass, or waits for it to finish if it already started.
+         * 
+         */
+        void stopMaintenance();
+
+        /**
+         * @brief Adds a block pointer to the first overflow block of a chain with space, extending the chain if all are full.
+         * 
+         * @param overflowBlock The overflow block to start looking for space from.
+         * @param blockPtr The block the record is stored in.
+         * @param includedColumns The included columns of the record.
+         * @return OverflowBlock* The overflow block the pointer was added to, later pointers of the key can start from it.
+         */
+        OverflowBlock* addBlockPointerToOverflowChain(OverflowBlock* overflowBlock, Block* blockPtr, const IncludedColumns& includedColumns);
+
+        /**
+         * @brief Adds the records of one key to an aggregate, reading the data blocks only if the index does not carry the rating.
+         * 
+         * @param key The key the overflow chain belongs to.
+         * @param overflowBlock The head of the overflow chain of the key.
+         * @param aggregate The aggregate to add to.
+         */
+        void addOverflowChainToAggregate(KeyType key, OverflowBlock* overflowBlock, IndexAggregate& aggregate);
+
+        /**
+         * @brief Splits a range into partitions at the separator keys of the internal nodes covering it,
+         * descending a level at a time until there are enough partitions or the next level is the leaves.
+         * Every partition is the part of the range below the root of one subtree.
+         * 
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @param targetPartitions Number of partitions to stop splitting at.
+         * @param subtrees Collects the root of the subtree of every partition, left to right.
+         * @param splitKeys Collects the first key of every partition but the first, left to right.
+         * @return uint The internal nodes accessed.
+         */
+        uint partitionRange(const KeyType& startKey, const KeyType& endKey, uint targetPartitions, vector<Node<KeyType>*>& subtrees, vector<KeyType>& splitKeys);
+
+        /**
+         * @brief Aggregates one partition of a range, descending from the root of its subtree and walking
+         * the leaves until a key past the partition. Takes no lock, the caller holds the tree lock.
+         * 
+         * @param subtree Root of the subtree the partition lies under.
+         * @param lowKey First key of the partition (inclusive).
+         * @param highKey Last key of the partition.
+         * @param isHighKeyIncluded Whether the high key belongs to the partition, only for the last partition of the range.
+         * @param aggregate The aggregate to add to.
+         */
+        void aggregateRangePartition(Node<KeyType>* subtree, KeyType lowKey, KeyType highKey, bool isHighKeyIncluded, IndexAggregate& aggregate);
+
+        /**
+         * @brief Descends to the leaf of a key and gets its overflow block. Takes no lock, the caller holds
+         * the tree lock. Buffered inserts of the key are not included.
+         * 
+         * @param key The key to look up.
+         * @return OverflowBlock* The overflow block of the key, nullptr if the key is not in the tree.
+         */
+        OverflowBlock* findOverflowBlockOfKey(const KeyType& key);
+
+        /**
+         * @brief Drops what a change to a key makes stale: the cached results of the key, if a cache is
+         * attached, and the frozen internal levels, as the change may split or merge nodes.
+         * 
+         * @param key The key changed.
+         */
+        void noteKeyChanged(const KeyType& key);
+
+        /**
+         * @brief Get the avgRating of a record pointer as the index stores it, next to the pointer or in the key.
+         * 
+         * @param key The key of the record.
+         * @param includedColumns The columns stored next to the pointer.
+         * @return float The avgRating of the record.
+         */
+        float getIndexedAvgRating(const KeyType& key, const IncludedColumns& includedColumns);
+
+        /**
+         * @brief Logs a record pointer added to or removed from a key, if a snapshot is open to see it.
+         * Expires the oldest snapshots once the log holds more changes than allowed.
+         * 
+         * @param key The key changed.
+         * @param avgRating Rating of the record.
+         * @param isInsert Whether the pointer was added rather than removed.
+         */
+        void logChange(const KeyType& key, float avgRating, bool isInsert);
+
+        /**
+         * @brief Logs the removal of every record pointer of an overflow chain, if a snapshot is open to see it.
+         * 
+         * @param key The key of the chain.
+         * @param overflowBlock The head of the chain.
+         */
+        void logRemovedOverflowChain(const KeyType& key, OverflowBlock* overflowBlock);
+
+        /**
+         * @brief Drops the logged changes every open snapshot was taken after, all of them if none is open.
+         * 
+         */
+        void reclaimChanges();
+
+        /**
+         * @brief Finds the leaf a key belongs in through the frozen internal levels while they are fresh,
+         * otherwise by descending the nodes from the root.
+         * 
+         * @param key The key to look up.
+         * @return Node<KeyType>* The leaf, nullptr if the tree is empty.
+         */
+        Node<KeyType>* findLeaf(const KeyType& key);
+
+        /**
+         * @brief Inserts a key straight into its leaf, bypassing the buffers of the internal nodes.
+         * 
+         * @param key The index the tree is built on, e.g. numVotes.
+         * @param blockPtr Pointer to the record.
+         * @param includedColumns Columns of the record to store in the leaf, only kept by a covering index.
+         */
+        void insertKeyIntoTree(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns);
+
+        /**
+         * @brief Sorts a batch of inserts and inserts them a leaf at a time. Each leaf is found with a
+         * single descent and receives every insert up to its upper bound in one merge.
+         * 
+         * @param inserts The inserts, sorted in place by key.
+         */
+        void insertBatchIntoTree(vector<BufferedInsert<KeyType>>& inserts);
+
+        /**
+         * @brief Merges a sorted run of inserts into a leaf, splitting the leaf into as many leaves as the
+         * merged keys need in one pass and linking the new leaves into their parents.
+         * 
+         * @param cursor The leaf every insert of the run belongs to.
+         * @param inserts The sorted inserts.
+         * @param runStart Index of the first insert of the run.
+         * @param runEnd Index past the last insert of the run.
+         */
+        void insertRunIntoLeaf(Node<KeyType>* cursor, const vector<BufferedInsert<KeyType>>& inserts, uint runStart, uint runEnd);
+
+        /**
+         * @brief Finds the parent of a node by descending with a key the node holds, falling back to searching the whole tree.
+         * 
+         * @param child The node to find the parent of.
+         * @param key A key routed to the node, e.g. its first key.
+         * @return Node<KeyType>* The parent node, nullptr if the child is the root.
+         */
+        Node<KeyType>* findParentByKey(Node<KeyType>* child, const KeyType& key);
+
+        /**
+         * @brief Checks if a run of sorted keys fits in a single node.
+         * 
+         * @param keys The sorted keys.
+         * @param begin Index of the first key of the run.
+         * @param end Index past the last key of the run.
+         * @return true If one node can hold the keys.
+         */
+        bool keysFitInNode(const vector<KeyType>& keys, uint begin, uint end);
+
+        /**
+         * @brief Moves the buffered inserts of an internal node one level down. Children whose buffer
+         * overflows are flushed in turn, buffered inserts above the leaves are inserted into the leaves.
+         * 
+         * @param node The internal node to flush.
+         */
+        void flushBuffer(Node<KeyType>* node);
+
+        /**
+         * @brief Flushes every buffer in a subtree, parents before children.
+         * 
+         * @param node The root of the subtree.
+         */
+        void flushSubtree(Node<KeyType>* node);
+
+        /**
+         * @brief Copies the buffered inserts within a range out of the buffers of a subtree, leaving the
+         * buffers as they are. Buffers below hold older inserts, so they are copied first.
+         * 
+         * @param node The root of the subtree.
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @param pendingInserts Collects the buffered inserts in range.
+         */
+        void collectBufferedInserts(Node<KeyType>* node, const KeyType& startKey, const KeyType& endKey, vector<BufferedInsert<KeyType>>& pendingInserts);
+
+        /**
+         * @brief Get the buffered inserts within a range, so queries can merge them into their results
+         * without flushing them into the leaves.
+         * 
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @return vector<BufferedInsert<KeyType>> The inserts sorted by key, the inserts of a key in the order they were made. Empty if the tree is not buffered.
+         */
+        vector<BufferedInsert<KeyType>> getBufferedInsertsOfRange(const KeyType& startKey, const KeyType& endKey);
+
+        /**
+         * @brief Copies the overflow chain of a key followed by a run of its buffered inserts into a new
+         * chain, which is not counted as part of the tree.
+         * 
+         * @param overflowBlock The overflow chain of the key in the tree, nullptr if the key is only buffered.
+         * @param pendingInserts The buffered inserts sorted by key.
+         * @param runStart Index of the first insert of the key.
+         * @param runEnd Index past the last insert of the key.
+         * @return OverflowBlock* The first overflow block of the new chain.
+         */
+        OverflowBlock* copyOverflowChainWithInserts(OverflowBlock* overflowBlock, const vector<BufferedInsert<KeyType>>& pendingInserts, uint runStart, uint runEnd);
+
+        /**
+         * @brief Frees a chain made by copyOverflowChainWithInserts that no other reader was given.
+         * 
+         * @param overflowBlock The first overflow block of the copy, may be nullptr.
+         */
+        void deleteOverflowChainCopy(OverflowBlock* overflowBlock);
+
+        /**
+         * @brief Get the overflow chain a read returns for a key, merging its buffered inserts into a copy of its
+         * chain in the tree. The copy is kept until the key changes or its inserts are flushed to the leaves, so it stays
+         * valid as long as a chain of the tree would. Reads that only walk the chain make their own copy instead.
+         * 
+         * @param key The key.
+         * @param overflowBlock The overflow chain of the key in the tree, nullptr if the key is not in the leaves.
+         * @param pendingInserts The buffered inserts sorted by key.
+         * @param runStart Index of the first insert of the key.
+         * @param runEnd Index past the last insert of the key, runStart if the key has none.
+         * @return OverflowBlock* The chain of the tree if the key has no buffered inserts, the merged copy otherwise.
+         */
+        OverflowBlock* mergeBufferedInsertsOfKey(const KeyType& key, OverflowBlock* overflowBlock, const vector<BufferedInsert<KeyType>>& pendingInserts,
+                                                 uint runStart, uint runEnd);
+
+        /**
+         * @brief Merges buffered inserts into the keys and overflow chains a range read found in the leaves.
+         * 
+         * @param keyAndOverflowBlocks The keys in range with their chains in the tree, in increasing order.
+         * @param pendingInserts The buffered inserts in range sorted by key.
+         */
+        void mergeBufferedInsertsOfRange(vector<pair<KeyType, OverflowBlock*>>& keyAndOverflowBlocks, const vector<BufferedInsert<KeyType>>& pendingInserts);
+
+        /**
+         * @brief Adds buffered inserts to an aggregate of the leaves, replacing what was counted for each of their
+         * keys by what its chain merged with its inserts holds.
+         * 
+         * @param pendingInserts The buffered inserts in range sorted by key.
+         * @param aggregate The aggregate of the keys in range as the leaves hold them.
+         */
+        void addBufferedInsertsToAggregate(const vector<BufferedInsert<KeyType>>& pendingInserts, IndexAggregate& aggregate);
+
+        /**
+         * @brief Frees the merged chain a read handed out for a key, once no reader can hold it. Safe to call
+         * while other reads merge the buffered inserts of their keys.
+         * 
+         * @param key The key that changed.
+         */
+        void dropMergedOverflowChain(const KeyType& key);
+
+        /**
+         * @brief Re-packs the keys of a node after they changed, and rebuilds the filter of a leaf. Does nothing
+         * if neither key compression nor leaf filters are enabled.
+         * 
+         * @param node The node whose keys changed.
+         */
+        void refreshPackedKeys(Node<KeyType>* node);
+
+        /**
+         * @brief Rebuilds the filter of a leaf from its keys. Does nothing for an internal node or if leaf filters are disabled.
+         * 
+         * @param node The node whose keys changed.
+         */
+        void refreshLeafFilter(Node<KeyType>* node);
+
+        /**
+         * @brief Builds the filter of every leaf under a node.
+         * 
+         * @param cursor The node to start from.
+         */
+        void buildLeafFilters(Node<KeyType>* cursor);
+
+        /**
+         * @brief Checks the filter of a leaf for a key, counting the lookup.
+         * 
+         * @param leaf The leaf the key would be in.
+         * @param key The key looked up.
+         * @return true If the leaf may hold the key, or leaf filters are disabled.
+         * @return false If the leaf surely does not hold the key.
+         */
+        bool leafMayContainKey(Node<KeyType>* leaf, const KeyType& key);
+
+        /**
+         * @brief Finds the child pointer to follow for a key in an internal node, searching the packed keys if compressed.
+         * 
+         * @param node The internal node.
+         * @param key The search key.
+         * @return int Index of the first key greater than the search key.
+         */
+        int findChildIndex(Node<KeyType>* node, const KeyType& key);
+
+        /**
+         * @brief Finds the position of a key in a leaf node, searching the packed keys if compressed.
+         * 
+         * @param node The leaf node.
+         * @param key The search key.
+         * @return int Index of the first key not less than the search key.
+         */
+        int findKeyIndex(Node<KeyType>* node, const KeyType& key);
+
+        /**
+         * @brief Checks if one more key fits in a node. A compressed node is also limited by the packed size of its keys.
+         * 
+         * @param node The node to insert into.
+         * @param key The key to insert.
+         * @return true If the key can be inserted without splitting the node.
+         */
+        bool nodeHasSpaceForKey(Node<KeyType>* node, const KeyType& key);
+
+        /**
+         * @brief Checks if a node still fits after one of its keys is replaced. A separator may widen the
+         * range of the packed keys when it is replaced at either end of a compressed node.
+         * 
+         * @param node The node whose key is replaced.
+         * @param index Position of the key to replace.
+         * @param key The new key.
+         * @return true If the node fits with the new key.
+         */
+        bool canReplaceKey(Node<KeyType>* node, int index, const KeyType& key);
+
+        /**
+         * @brief Checks if two sibling nodes, and the separator pulled down between them for internal nodes, fit in one node.
+         * 
+         * @param leftNode The left sibling.
+         * @param rightNode The right sibling.
+         * @param separator The parent key pulled down between the siblings, nullptr for leaf nodes.
+         * @return true If the merged node fits.
+         */
+        bool canMergeNodes(Node<KeyType>* leftNode, Node<KeyType>* rightNode, const KeyType* separator);
 
     public:
         /**
@@ -30,21 +653,197 @@ class BPlusTree {
          * 
          * @param maxKeys Maximum number of trees per node in tree.
          * @param maxBlkPtrs Maximum number of pointers per overflow block linked to tree.
+         * @param isUnique Whether every key may only index a single record.
+         * @param isCovering Whether the included columns of every record are stored in the leaves.
          */
-        explicit BPlusTree(uint maxKeys, uint maxBlkPtrs) : maxKeys(maxKeys), maxBlkPtrsInOverflowBlock(maxBlkPtrs) {
+        explicit BPlusTree(uint maxKeys, uint maxBlkPtrs, bool isUnique = false, bool isCovering = false)
+            : maxKeys(maxKeys), maxBlkPtrsInOverflowBlock(maxBlkPtrs), isUnique(isUnique), isCovering(isCovering) {
             root = nullptr; // when tree has no indexes default it is a nullptr
             nodeCounter = 0; // initialize the number of nodes in tree to zero
+            leafCounter = 0;
+            overflowBlkCounter = 0; // initialize the number of overflow blocks to zero
+            treeHeight = 0;
+            indexedRecordCounter = 0;
+            isCompressed = false; // keys are stored uncompressed by default
+            nodeBlockSize = 0;
+            isBuffered = false; // inserts go straight to the leaves by default
+            maxBufferedInserts = 0;
+            bufferedInsertCounter = 0;
+            isLazyDeleting = false; // deletes rebalance right away by default
+            minimumLeafKeys = (maxKeys + 1) / 2; // the B+ Tree minimums until lazy deletes set their own
+            minimumInternalKeys = maxKeys / 2;
+            lazyDeleteCounter = 0;
+            maintenanceBatchCounter = 0;
+            longestMaintenanceBatchUs = 0;
+            maintenanceIntervalMs = 0;
+            maintenanceScheduler = nullptr;
+            scheduledMaintenanceId = 0;
+            maintenancePassesInFlight = 0;
+            queryCache = nullptr; // results are not cached by default
+            isFrozenLevelsFresh = false; // nothing is frozen until asked for
+            isSnapshotEnabled = false; // no change is logged by default
+            currentVersion = 0;
+            isMaintenanceStopping = false;
+            isMaintenanceRunning = false;
+            isLeafFiltered = false; // lookups read the leaf keys by default
+            leafFilterBitsPerKey = 0;
+            leafFilterLookups = 0;
+            leafFilterNegatives = 0;
+            leafFilterFalsePositives = 0;
         }
 
+        /**
+         * @brief Stores the keys of every node frame-of-reference bit-packed, so that a node holds as many
+         * keys as fit in the block instead of a fixed count. Only integer keys can be compressed and it
+         * has to be enabled before the first key is inserted.
+         * 
+         * @param blockSize The size of a tree node in bytes(B).
+         */
+        void enableKeyCompression(uint blockSize);
+
+        /**
+         * @brief Checks if the keys of the tree are compressed.
+         * 
+         * @return true If the keys are bit-packed.
+         */
+        bool isKeyCompressionEnabled();
+
+        /**
+         * @brief Keeps a Bloom filter of the keys of every leaf, rebuilt whenever the keys of the leaf change, so that
+         * a point lookup of a key that is not indexed usually returns once it reaches the leaf, without reading its keys.
+         * The filters of the leaves already in the tree are built right away.
+         * 
+         * @param bitsPerKey Bits of a filter per key a leaf can hold, more bits give fewer false positives.
+         */
+        void enableLeafFilters(uint bitsPerKey = LEAF_FILTER_BITS_PER_KEY);
+
+        /**
+         * @brief Checks if the leaves of the tree keep filters of their keys.
+         * 
+         * @return true If leaf filters are enabled.
+         */
+        bool isLeafFilterEnabled();
+
+        /**
+         * @brief Get the counters of the leaf filters and the memory they take.
+         * 
+         * @return LeafFilterStatistics The counters, empty if leaf filters are not enabled.
+         */
+        LeafFilterStatistics getLeafFilterStatistics();
+
+        /**
+         * @brief Makes the tree write-optimized in the style of a B-epsilon tree. Inserts are appended to
+         * the buffer of the root and flushed down a level at a time once a buffer overflows, so many
+         * inserts share a descent. Queries merge the buffered inserts of the range they read into their
+         * results without changing the tree, and deletes flush every buffer first. Cannot be used on a unique index.
+         * 
+         * @param maxBufferedInserts Inserts an internal node buffers before flushing.
+         */
+        void enableBufferedInserts(uint maxBufferedInserts);
+
+        /**
+         * @brief Flushes every buffered insert down to the leaves.
+         * 
+         */
+        void flushAllBuffers();
+
+        /**
+         * @brief Get the number of inserts waiting in the buffers of the tree.
+         * 
+         * @return uint The number of buffered inserts.
+         */
+        uint getNumberOfBufferedInserts();
+
+        /**
+         * @brief Makes deletes only remove the key from its leaf, leaving the leaf underfull or even empty,
+         * so no delete waits on borrowing or merging. A delete taking a leaf below the minimum fill notes
+         * it, and a maintenance pass on the scheduler merges the noted leaves every interval, a few at a
+         * time. A fill above the B+ Tree minimum is capped at the minimum.
+         * 
+         * @param minimumLeafFill Fraction of the maximum keys below which a leaf is merged.
+         * @param minimumInternalFill Fraction of the maximum keys below which an internal node is merged.
+         * @param maintenanceIntervalMs Time between maintenance passes in milliseconds.
+         * @param scheduler The thread pool the maintenance passes run on, it must outlive the lazy deletes.
+         */
+        void enableLazyDeletes(double minimumLeafFill, double minimumInternalFill, uint maintenanceIntervalMs, ThreadPool& scheduler);
+
+        /**
+         * @brief Stops the maintenance passes and rebalances every node to the B+ Tree minimum, so deletes
+         * rebalance right away again.
+         * 
+         */
+        void disableLazyDeletes();
+
+        /**
+         * @brief Merges every node below the minimum fill with a sibling, or shares keys with it.
+         * 
+         * @return uint The number of nodes deleted.
+         */
+        uint runMaintenance();
+
+        /**
+         * @brief Get the number of keys deleted since the last maintenance pass.
+         * 
+         * @return uint Keys deleted without rebalancing.
+         */
+        uint getNumberOfLazyDeletes();
+
+        /**
+         * @brief Prints how many maintenance batches ran and the longest any of them held the tree, which
+         * is the longest a delete waited for maintenance.
+         * 
+         */
+        void printMaintenanceBatches();
+
+        /**
+         * @brief Prints how full the leaves and internal nodes are, in tenths of the maximum keys.
+         * 
+         */
+        void printTreeHealth();
+
+        /**
+         * @brief Counts the nodes other than the root holding fewer keys than rebalancing brings them back
+         * to, the B+ Tree minimum or the minimum set for lazy deletes.
+         * 
+         * @return uint The underfull nodes.
+         */
+        uint getNumberOfUnderfullNodes();
+
+        /**
+         * @brief Walks every node and overflow block to describe the shape of the tree: nodes per level,
+         * key occupancy, overflow chain lengths, how skewed the duplicates are, and the bytes used against
+         * the bytes allocated.
+         * 
+         * @param blockSize Size of a tree node and of an overflow block in bytes(B).
+         * @return TreeStatistics The statistics of the tree, which can be exported as JSON.
+         */
+        TreeStatistics getStatistics(uint blockSize);
+
         // insertion and deletion functions
 
         /**
          * @brief Inserts a record indexed by the key and a pointer to that record inserted.
          * 
-         * @param key The index the tree is built on, in this case numVotes.
+         * @param key The index the tree is built on, e.g. numVotes.
          * @param blockPtr Pointer to the record.
+         * @param includedColumns Columns of the record to store in the leaf, only kept by a covering index.
          */
-        void insertKey(int key, Block* blockPtr);
+        void insertKey(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns = IncludedColumns());
+
+        /**
+         * @brief Inserts a batch of records. The batch is sorted and the leaves are filled left to right,
+         * so every leaf is descended to and split once no matter how many of the records it receives.
+         * 
+         * @param batch Pairs of the key and the block the record is stored in.
+         */
+        void insertBatch(const vector<pair<KeyType, Block*>>& batch);
+
+        /**
+         * @brief Inserts a batch of records along with their included columns, needed by a covering index.
+         * 
+         * @param batch The key, block and included columns of every record.
+         */
+        void insertBatch(vector<BufferedInsert<KeyType>> batch);
 
         /**
          * @brief Updates the index of internal nodes when overflow occurs at leaf node level.
@@ -53,7 +852,7 @@ class BPlusTree {
          * @param child The child represents the new leaf node created.
          * @param key The index key to insert higher up the tree.
          */
-        void insertInternal(Node* parent, Node* child, int key);
+        void insertInternal(Node<KeyType>* parent, Node<KeyType>* child, KeyType key);
 
         /**
          * @brief Uses a top down approach to find the parent node of a node.
@@ -62,7 +861,7 @@ class BPlusTree {
          * @param root The root node of the tree.
          * @return Node* The parent node of the child.
          */
-        Node* findParent(Node* child, Node*root);
+        Node<KeyType>* findParent(Node<KeyType>* child, Node<KeyType>* root);
         
         /**
          * @brief If the key deleted at the leaf is the first key, we need to find
@@ -72,7 +871,7 @@ class BPlusTree {
          * @param child The child node where we want to find the parent for to update the parent's index.
          * @param key The key to be removed from higher levels of the B+ Tree.
          */
-        void updateParentKey(Node* child, int key);
+        void updateParentKey(Node<KeyType>* child, KeyType key);
 
         /**
          * @brief Deletes a record that matches the indexed key specified.
@@ -80,7 +879,38 @@ class BPlusTree {
          * @param key The index key and corresponding record to delete.
          * @return uint The number of nodes deleted.
          */
-        uint deleteRecordByKey(int key);
+        uint deleteRecordByKey(KeyType key);
+
+        /**
+         * @brief Un-indexes a single record by removing one occurrence of its block pointer from the key.
+         * The record itself is left in the data block. If it was the last record of the key, the key is
+         * removed from the tree.
+         * 
+         * @param key The key the record is indexed by.
+         * @param blockPtr The block the record is stored in.
+         * @param includedColumns The included columns of the record, used by a covering index to find its entry.
+         * @return uint The number of nodes deleted.
+         */
+        uint removeBlockPointerFromKey(KeyType key, Block* blockPtr, const IncludedColumns& includedColumns = IncludedColumns());
+
+        /**
+         * @brief Deletes every record with a key within the range specified(inclusively). The entries are
+         * removed a leaf at a time and every affected node is rebalanced once afterwards.
+         * 
+         * @param startKey The starting range (inclusive) of the delete.
+         * @param endKey The ending range (inclusive) of the delete.
+         * @return DeleteSummary The keys, records, overflow blocks, tree nodes and data blocks freed.
+         */
+        DeleteSummary deleteRange(KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Deletes every record with any of the keys. The keys are sorted, each leaf is descended
+         * to once and every affected node is rebalanced once afterwards.
+         * 
+         * @param keys The keys to delete, keys not in the tree are ignored.
+         * @return DeleteSummary The keys, records, overflow blocks, tree nodes and data blocks freed.
+         */
+        DeleteSummary deleteBatch(vector<KeyType> keys);
 
         /**
          * @brief When underflow occurs in the leaf due to deletion. We need to update the parent index.
@@ -90,7 +920,7 @@ class BPlusTree {
          * @param key The key to delete higher up the B+ Tree.
          * @return uint 
          */
-        uint removeInternal(Node* cursor, Node *child, int key); 
+        uint removeInternal(Node<KeyType>* cursor, Node<KeyType>* child, KeyType key); 
         
         // searching
 
@@ -100,17 +930,175 @@ class BPlusTree {
          * @param key The key to search for which equals numVotes.
          * @return OverflowBlock* The overflow block which contains the pointers to all the records matching the key.
          */
-        OverflowBlock* searchQuery(int key);
+        OverflowBlock* searchQuery(KeyType key);
+
+        /**
+         * @brief Get the overflow block of a key without printing the nodes accessed.
+         * 
+         * @param key The key to look up.
+         * @return OverflowBlock* The overflow block of the key, nullptr if the key is not in the tree.
+         */
+        OverflowBlock* getOverflowBlockOfKey(KeyType key);
+
+        /**
+         * @brief Get the overflow blocks of every key within the range specified(inclusively) without printing the nodes accessed.
+         * 
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @return vector<pair<KeyType, OverflowBlock*>> Every key in range with its overflow block.
+         */
+        vector<pair<KeyType, OverflowBlock*>> getOverflowBlocksOfRange(KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Caches the records of the keys and the aggregates of the ranges read through
+         * getRecordsOfKey and getAggregateOfRange. Every insert and delete drops the cached results of
+         * the keys it changes, and a result read while a key changed is not cached.
+         * 
+         * @param cache The cache, nullptr to stop caching. It must outlive the tree or be detached first.
+         */
+        void attachQueryCache(QueryCache<KeyType, KeyCompare>* cache);
+
+        /**
+         * @brief Copies the internal levels into one contiguous array in the style of a CSB+ Tree, see
+         * FrozenLevels, for read-only serving after loading. getOverflowBlockOfKey, getRecordsOfKey,
+         * getOverflowBlocksOfRange and searchBatch descend through the copy until the tree changes, and
+         * through the nodes again from then on, until it is frozen again.
+         * 
+         */
+        void freezeInternalLevels();
+
+        /**
+         * @brief Get the frozen internal levels, if the tree is unchanged since they were frozen.
+         * 
+         * @return FrozenLevels<KeyType, KeyCompare>* The frozen levels, nullptr if never frozen or stale.
+         */
+        FrozenLevels<KeyType, KeyCompare>* getFrozenLevels();
+
+        /**
+         * @brief Lets snapshots be taken. From then on every operation holds the tree lock, so that a
+         * snapshot scan can read one leaf at a time while other threads insert and delete in between.
+         * Must be called before other threads use the tree. Snapshots need the rating in the index, so the
+         * index has to be covering or its key has to carry avgRating.
+         * 
+         * @param maxRetainedChanges Changes the version log may keep for the open snapshots before the
+         * oldest snapshots expire, which bounds its memory.
+         */
+        void enableSnapshots(uint maxRetainedChanges);
+
+        /**
+         * @brief Takes a snapshot of the records indexed, which snapshotRangeQueryAggregate reads as they are
+         * now however the tree changes, until it is released. While a snapshot is open, every record
+         * pointer added or removed is logged with the version of the tree it made.
+         * 
+         * @return ull The snapshot, the version of the tree it sees.
+         */
+        ull takeSnapshot();
+
+        /**
+         * @brief Releases a snapshot, dropping the logged changes no open snapshot needs anymore.
+         * 
+         * @param snapshot The snapshot, expired or not.
+         */
+        void releaseSnapshot(ull snapshot);
+
+        /**
+         * @brief Aggregate avgRating of all records with keys within the range specified(inclusively), as they
+         * were when the snapshot was taken. The leaves are read one at a time, each under the tree lock
+         * only while it is read, resuming after the last key read so the changes made in between cannot
+         * make the scan skip or repeat keys, and the logged changes made after the snapshot are undone
+         * for the keys of every leaf. Throws if the snapshot expired.
+         * 
+         * @param snapshot The snapshot to read.
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @return IndexAggregate The records in range at the snapshot, with the sum of their avgRating.
+         */
+        IndexAggregate snapshotRangeQueryAggregate(ull snapshot, KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Get the counters of the snapshots and of the version log.
+         * 
+         * @return SnapshotStatistics The counters, empty if snapshots are not enabled.
+         */
+        SnapshotStatistics getSnapshotStatistics();
+
+        /**
+         * @brief Get the query cache attached to the tree.
+         * 
+         * @return QueryCache<KeyType, KeyCompare>* The cache, nullptr if none is attached.
+         */
+        QueryCache<KeyType, KeyCompare>* getQueryCache();
+
+        /**
+         * @brief Get the records with a key without printing the nodes accessed, from the query cache if
+         * it holds them, otherwise from the data blocks the overflow chain of the key points to.
+         * 
+         * @param key The key to look up.
+         * @return CachedQueryResult The records of the key with the sum of their avgRating, none if the key is not in the tree.
+         */
+        CachedQueryResult getRecordsOfKey(KeyType key);
+
+        /**
+         * @brief Get the avgRating aggregate of every record with a key within the range specified(inclusively),
+         * from the query cache if it holds it, otherwise through rangeQueryAggregate.
+         * 
+         * @param startKey The starting range (inclusive).
+         * @param endKey The ending range (inclusive).
+         * @return CachedQueryResult The total rating, number of records and keys in range, without the records.
+         */
+        CachedQueryResult getAggregateOfRange(KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Checks if the key is indexed by the tree.
+         * 
+         * @param key The key to look up.
+         * @return true If at least one record is indexed by the key.
+         */
+        bool containsKey(KeyType key);
 
         /**
          * @brief Search for all records that have numVotes within the range specified(inclusively).
          * 
          * @param startKey The starting range (inclusive) of the search.
          * @param endKey The ending range (inclusive) of the search.
-         * @return vector<pair<int, OverflowBlock*>> A vector of pairs: 
+         * @return vector<pair<KeyType, OverflowBlock*>> A vector of pairs: 
          * within each is pair is a key and overflow block which contains pointers containing the key.
          */
-        vector<pair<int, OverflowBlock*>> rangeQuery(int startKey, int endKey);
+        vector<pair<KeyType, OverflowBlock*>> rangeQuery(KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Aggregate avgRating of all records with keys within the range specified(inclusively).
+         * If the index is covering or its key carries avgRating, the aggregate is answered from the
+         * index alone without accessing any data block.
+         * 
+         * @param startKey The starting range (inclusive) of the aggregation.
+         * @param endKey The ending range (inclusive) of the aggregation.
+         * @return IndexAggregate The total rating, number of records and the accesses made.
+         */
+        IndexAggregate rangeQueryAggregate(KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Aggregates avgRating over a range like rangeQueryAggregate, with the range split at the
+         * separator keys of the internal nodes into several partitions per thread. The partitions and the
+         * data blocks they point to are scanned on the thread pool and their aggregates summed. Waits for
+         * its partitions, so it must not be called from a task of the same pool.
+         * 
+         * @param startKey The starting range (inclusive) of the aggregation.
+         * @param endKey The ending range (inclusive) of the aggregation.
+         * @param threadPool The threads to scan the partitions on.
+         * @return IndexAggregate The total rating, number of records and the accesses made by all threads.
+         */
+        IndexAggregate parallelRangeQueryAggregate(KeyType startKey, KeyType endKey, ThreadPool& threadPool);
+
+        /**
+         * @brief Looks up a batch of keys without printing the nodes accessed, in chunks of keys run as
+         * tasks on the thread pool.
+         * 
+         * @param keys The keys to look up.
+         * @param threadPool The threads to look up the chunks on.
+         * @return vector<OverflowBlock*> The overflow block of every key in the order of the keys, nullptr for a key not in the tree.
+         */
+        vector<OverflowBlock*> searchBatch(const vector<KeyType>& keys, ThreadPool& threadPool);
 
         // getters
         /**
@@ -123,9 +1111,9 @@ class BPlusTree {
         /**
          * @brief Get the Root Of the B+ Tree.
          * 
-         * @return Node* Root of the B+ Tree.
+         * @return Node<KeyType>* Root of the B+ Tree.
          */
-        Node* getRootOfTree();
+        Node<KeyType>* getRootOfTree();
 
         /**
          * @brief Get the Number Of tree nodes in the B+ Tree.
@@ -135,12 +1123,27 @@ class BPlusTree {
         uint getNumberOfNodesInTree();
 
         /**
-         * @brief Get the height of the B+ Tree.
+         * @brief Get the Number Of leaf nodes in the B+ Tree.
+         * 
+         * @return uint The number of leaf nodes in the B+ Tree.
+         */
+        uint getNumberOfLeavesInTree();
+
+        /**
+         * @brief Get the height of the B+ Tree, kept up to date as the root changes so it is safe to poll
+         * from another thread while the tree is used.
          * 
          * @return uint Height of the B+ Tree.
          */
         uint getTreeHeight();
 
+        /**
+         * @brief Get the number of records indexed, buffered inserts included. Safe to poll from another thread.
+         * 
+         * @return uint The number of records indexed.
+         */
+        uint getNumberOfRecordsIndexed();
+
         /**
          * @brief Get the Size Of B Plus Tree in bytes.
          * 
@@ -181,7 +1184,7 @@ class BPlusTree {
          * 
          * @param cursor The current node traversed.
          */
-        void printContentOfNode(Node* cursor);
+        void printContentOfNode(Node<KeyType>* cursor);
 
         /**
          * @brief Print the content of the root if it exists.
@@ -200,14 +1203,20 @@ class BPlusTree {
          * 
          * @param cursor The root node.
          */
-        void display(Node *cursor);
+        void display(Node<KeyType>* cursor);
 
         /**
-         * @brief Destroy the BPlusTree object
+         * @brief Destroy the BPlusTree object, stopping the maintenance passes if they run.
          * 
          */
-        ~BPlusTree() = default; 
+        ~BPlusTree(); 
 
 };
 
+typedef BPlusTree<int> NumVotesIndex; // index on numVotes
+typedef QueryCache<int> NumVotesQueryCache; // query cache of the index on numVotes
+typedef BPlusTree<float> AvgRatingIndex; // index on avgRating
+typedef BPlusTree<MovieIdKey, MovieIdKeyCompare> MovieIdIndex; // unique index on tConst
+typedef BPlusTree<VotesRatingKey, VotesRatingKeyCompare> VotesRatingIndex; // composite index on (numVotes, avgRating)
+
 #endif
@@ -0,0 +1,54 @@
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "config.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// function declarations
+string trimWhitespace(const string& text);
+
+/**
+ * @brief Removes the spaces and tabs around a text.
+ *
+ * @param text The text to trim.
+ * @return string The text without leading and trailing whitespace.
+ */
+string trimWhitespace(const string& text) {
+  size_t start = text.find_first_not_of(" \t\r");
+  if (start == string::npos) {
+    return "";
+  }
+  size_t end = text.find_last_not_of(" \t\r");
+  return text.substr(start, end - start + 1);
+}
+
+map<string, string> readConfigFile(const string& filePath) {
+  ifstream configFile(filePath);
+  if (!configFile.is_open()) {
+    cout << "Unable to open config file " << filePath << endl;
+    throw "Unable to open config file";
+  }
+
+  map<string, string> settings;
+  string line;
+  uint lineNumber = 0;
+  while (getline(configFile, line)) {
+    ++lineNumber;
+    line = trimWhitespace(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    size_t separator = line.find('=');
+    if (separator == string::npos) {
+      cout << "Line " << lineNumber << " of " << filePath << " is not a name = value setting: " << line << endl;
+      throw "Invalid config file";
+    }
+    settings[trimWhitespace(line.substr(0, separator))] = trimWhitespace(line.substr(separator + 1));
+  }
+  return settings;
+}
@@ -0,0 +1,18 @@
+#ifndef H_CONFIG
+#define H_CONFIG
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+/**
+ * @brief Reads the settings of a config file, one `name = value` per line. Text after a # is a comment
+ * and blank lines are skipped.
+ *
+ * @param filePath Path of the config file.
+ * @return map<string, string> Value of every setting, by name.
+ */
+map<string, string> readConfigFile(const string& filePath);
+
+#endif
@@ -12,10 +12,11 @@
 #define COUT_LINE_DELIMITER "==================================================================="
 #define MB 1000000
 #define SIZE_OF_POINTER 8 // by default size of pointer in 64 bit systems are 8 bytes
-#define BOOLEAN_PADDING 7 // by default boolean takes up 1 byte but will be padded by 3 bytes for data structure alignment
 #define MAX_DATABLOCKS_TO_PRINT 5
 #define MAX_INDEX_NODES_TO_PRINT 5 
 #define KEY_SEPARATOR " | "
+#define CACHE_LINE_SIZE 64 // bytes per cache line on x86-64 and most ARM cores
+#define HUGE_PAGE_SIZE 2097152 // 2MB transparent huge pages on x86-64
 
 
 #endif
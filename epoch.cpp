@@ -0,0 +1,110 @@
+#include <algorithm>
+
+#include "epoch.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+mutex epochThreadStatesMutex; // guards epochThreadStates
+vector<EpochThreadState*> epochThreadStates; // state of every thread that entered an epoch or retired an object, never freed
+thread_local EpochThreadState* epochThreadState = nullptr; // state of the calling thread
+
+atomic<ull> globalEpoch(0); // advanced once every thread in an epoch has seen it
+atomic<ull> objectsRetired(0); // objects retired by every thread
+atomic<ull> objectsReclaimed(0); // retired objects freed
+
+EpochGuard::EpochGuard() : state(getEpochThreadState()) {
+  if ((*state).nesting++ > 0) {
+    return;
+  }
+  // announcing an epoch the global epoch has already left would let it advance twice without this thread
+  ull epoch = globalEpoch.load();
+  while (true) {
+    (*state).announcedEpoch.store(epoch);
+    ull currentEpoch = globalEpoch.load();
+    if (currentEpoch == epoch) {
+      break;
+    }
+    epoch = currentEpoch;
+  }
+}
+
+EpochGuard::~EpochGuard() {
+  if (--(*state).nesting == 0) {
+    (*state).announcedEpoch.store(QUIESCENT_EPOCH, memory_order_release);
+  }
+}
+
+EpochThreadState* getEpochThreadState() {
+  if (epochThreadState == nullptr) {
+    epochThreadState = new EpochThreadState();
+    lock_guard<mutex> statesLock(epochThreadStatesMutex);
+    epochThreadStates.push_back(epochThreadState);
+  }
+  return epochThreadState;
+}
+
+void retireObject(void* object, void (*deleteObject)(void*)) {
+  EpochThreadState* state = getEpochThreadState();
+  {
+    lock_guard<mutex> retiredLock((*state).retiredMutex);
+    (*state).retiredObjects.push_back(RetiredObject{object, deleteObject, globalEpoch.load()});
+  }
+  objectsRetired.fetch_add(1, memory_order_relaxed);
+  if (++(*state).retiredSinceReclaim >= RETIRED_OBJECTS_PER_RECLAIM) {
+    (*state).retiredSinceReclaim = 0;
+    reclaimRetiredObjects();
+  }
+}
+
+uint reclaimRetiredObjects() {
+  vector<RetiredObject> objectsToFree;
+  {
+    lock_guard<mutex> statesLock(epochThreadStatesMutex);
+    ull epoch = globalEpoch.load();
+    bool canAdvance = true;
+    for (auto state: epochThreadStates) {
+      ull announcedEpoch = (*state).announcedEpoch.load();
+      if (announcedEpoch != QUIESCENT_EPOCH && announcedEpoch != epoch) {
+        canAdvance = false; // a reader may still hold what was retired in the epoch it announced
+        break;
+      }
+    }
+    if (canAdvance) {
+      globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+      epoch = globalEpoch.load();
+    }
+
+    // a reader in an epoch entered it at most one epoch behind the global epoch, so two epochs on nothing it holds is retired
+    for (auto state: epochThreadStates) {
+      lock_guard<mutex> retiredLock((*state).retiredMutex);
+      vector<RetiredObject>& retiredObjects = (*state).retiredObjects;
+      auto firstKept = find_if(retiredObjects.begin(), retiredObjects.end(),
+                               [epoch](const RetiredObject& retiredObject) { return retiredObject.epoch + 2 > epoch; });
+      objectsToFree.insert(objectsToFree.end(), retiredObjects.begin(), firstKept);
+      retiredObjects.erase(retiredObjects.begin(), firstKept);
+    }
+  }
+  // freed outside the locks, so a destructor retiring more objects cannot deadlock
+  for (auto& retiredObject: objectsToFree) {
+    retiredObject.deleteObject(retiredObject.object);
+  }
+  objectsReclaimed.fetch_add(objectsToFree.size(), memory_order_relaxed);
+  return objectsToFree.size();
+}
+
+EpochStatistics getEpochStatistics() {
+  EpochStatistics statistics;
+  lock_guard<mutex> statesLock(epochThreadStatesMutex);
+  statistics.globalEpoch = globalEpoch.load();
+  statistics.threadsRegistered = epochThreadStates.size();
+  for (auto state: epochThreadStates) {
+    lock_guard<mutex> retiredLock((*state).retiredMutex);
+    statistics.objectsPending += (*state).retiredObjects.size();
+  }
+  statistics.objectsRetired = objectsRetired.load(memory_order_relaxed);
+  statistics.objectsReclaimed = objectsReclaimed.load(memory_order_relaxed);
+  return statistics;
+}
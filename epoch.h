@@ -0,0 +1,118 @@
+#ifndef H_EPOCH
+#define H_EPOCH
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "statistics.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+#define QUIESCENT_EPOCH (~0ULL) // epoch announced by a thread outside any epoch
+#define RETIRED_OBJECTS_PER_RECLAIM 64 // objects a thread retires before it tries to reclaim
+
+/**
+ * @brief An object unlinked from a structure that readers may still hold, kept until it is safe to free.
+ * 
+ */
+struct RetiredObject {
+  public:
+    void* object; // the object
+    void (*deleteObject)(void*); // frees the object as its own type
+    ull epoch; // global epoch when the object was retired
+};
+
+/**
+ * @brief The epoch a thread announced and the objects it retired. States outlive their threads,
+ * so objects retired by a finished thread are still reclaimed by the others.
+ * 
+ */
+struct EpochThreadState {
+  public:
+    atomic<ull> announcedEpoch; // global epoch seen when the thread entered, QUIESCENT_EPOCH outside any epoch
+    uint nesting; // epochs the thread has entered and not exited, only the outermost announces
+    mutex retiredMutex; // guards retiredObjects, taken by the thread itself and by a thread reclaiming for all
+    vector<RetiredObject> retiredObjects; // objects retired by the thread and not yet freed, oldest first
+    uint retiredSinceReclaim; // objects retired since the thread last tried to reclaim
+
+    /**
+     * @brief Construct the state of a thread outside any epoch.
+     * 
+     */
+    EpochThreadState() : announcedEpoch(QUIESCENT_EPOCH), nesting(0), retiredSinceReclaim(0) {}
+};
+
+/**
+ * @brief Enters an epoch from construction to destruction, so no object reachable when it was
+ * constructed is freed while it lives. Guards nest, only the outermost announces the epoch.
+ * 
+ */
+class EpochGuard {
+  private:
+    EpochThreadState* state; // state of the calling thread
+
+  public:
+    /**
+     * @brief Enters an epoch on the calling thread.
+     * 
+     */
+    EpochGuard();
+
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+
+    /**
+     * @brief Exits the epoch entered.
+     * 
+     */
+    ~EpochGuard();
+};
+
+/**
+ * @brief Get the epoch state of the calling thread, registering it on first use.
+ * 
+ * @return EpochThreadState* The state of the thread.
+ */
+EpochThreadState* getEpochThreadState();
+
+/**
+ * @brief Hands an object unlinked from every structure to the retire list of the calling thread,
+ * to be freed once every thread that was in an epoch when it was retired has exited that epoch.
+ * Every RETIRED_OBJECTS_PER_RECLAIM objects the thread tries to reclaim.
+ * 
+ * @param object The object to free.
+ * @param deleteObject Frees the object as its own type.
+ */
+void retireObject(void* object, void (*deleteObject)(void*));
+
+/**
+ * @brief Frees an object of type T once no reader may hold it, in place of delete.
+ * 
+ * @tparam T Type of the object.
+ * @param object The object unlinked from every structure.
+ */
+template <typename T>
+void retire(T* object) {
+  retireObject(object, [](void* objectToDelete) { delete static_cast<T*>(objectToDelete); });
+}
+
+/**
+ * @brief Advances the global epoch if every thread in an epoch has seen the current one, then frees the
+ * objects of every retire list retired two epochs or more ago, which no reader can still hold.
+ * 
+ * @return uint The objects freed.
+ */
+uint reclaimRetiredObjects();
+
+/**
+ * @brief Get the objects retired and reclaimed so far.
+ * 
+ * @return EpochStatistics The statistics.
+ */
+EpochStatistics getEpochStatistics();
+
+#endif
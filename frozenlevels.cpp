@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "frozenlevels.h"
+#include "indexkey.h"
+#include "constants.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+template <typename KeyType, typename KeyCompare>
+FrozenLevels<KeyType, KeyCompare>::FrozenLevels()
+    : slots(nullptr), slotSize(0), numberOfSlots(0), numberOfLevels(0), allocatedBytes(0), isHugePageBacked(false) {}
+
+template <typename KeyType, typename KeyCompare>
+FrozenNodeHeader* FrozenLevels<KeyType, KeyCompare>::getHeader(uint slot) {
+  return (FrozenNodeHeader*) (slots + (ull) slot * slotSize);
+}
+
+template <typename KeyType, typename KeyCompare>
+KeyType* FrozenLevels<KeyType, KeyCompare>::getKeys(uint slot) {
+  // the keys start after the header, aligned as their type requires
+  uint keysOffset = (sizeof(FrozenNodeHeader) + alignof(KeyType) - 1) / alignof(KeyType) * alignof(KeyType);
+  return (KeyType*) (slots + (ull) slot * slotSize + keysOffset);
+}
+
+template <typename KeyType, typename KeyCompare>
+void FrozenLevels<KeyType, KeyCompare>::freeze(Node<KeyType>* root) {
+  clear();
+  if (root == nullptr) {
+    return;
+  }
+
+  // list the nodes level by level, so the children of every node end up next to each other
+  vector<vector<Node<KeyType>*>> levels(1, vector<Node<KeyType>*>(1, root));
+  while (!(*levels.back().front()).isLeaf) {
+    vector<Node<KeyType>*> children;
+    for (auto node: levels.back()) {
+      // a leaf keeps the next leaf as its last pointer, an internal node one child more than its keys
+      for (uint i = 0; i <= (*node).keys.size(); ++i) {
+        children.push_back((Node<KeyType>*) (*node).ptrs[i]);
+      }
+    }
+    levels.push_back(children);
+  }
+  leaves = levels.back();
+  levels.pop_back();
+  numberOfLevels = levels.size();
+  if (numberOfLevels == 0) {
+    return; // the root is a leaf
+  }
+
+  // a compressed node may hold more keys than the tree's maximum, so the slots are sized by the fullest node
+  uint maxKeys = 0;
+  for (auto& level: levels) {
+    numberOfSlots += level.size();
+    for (auto node: level) {
+      maxKeys = max(maxKeys, (uint) (*node).keys.size());
+    }
+  }
+  uint keysOffset = (sizeof(FrozenNodeHeader) + alignof(KeyType) - 1) / alignof(KeyType) * alignof(KeyType);
+  slotSize = (keysOffset + maxKeys * sizeof(KeyType) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+  allocatedBytes = (ull) numberOfSlots * slotSize;
+  // an array of a huge page or more is aligned to one, so the pages it spans can each be a huge page
+  ull alignment = allocatedBytes >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : CACHE_LINE_SIZE;
+  allocatedBytes = (allocatedBytes + alignment - 1) / alignment * alignment;
+  void* allocation = nullptr;
+  if (posix_memalign(&allocation, alignment, allocatedBytes) != 0) {
+    cout << "Unable to allocate " << allocatedBytes << "B to freeze the internal levels" << endl;
+    throw "Unable to allocate frozen levels";
+  }
+  slots = (char*) allocation;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  isHugePageBacked = alignment == HUGE_PAGE_SIZE && madvise(slots, allocatedBytes, MADV_HUGEPAGE) == 0;
+#endif
+
+  uint slot = 0;
+  uint nextLevelFirstSlot = levels[0].size(); // slots of the children of the next node, counted in leaves below the last level
+  for (uint level = 0; level < numberOfLevels; ++level) {
+    uint firstChild = level + 1 == numberOfLevels ? 0 : nextLevelFirstSlot;
+    for (auto node: levels[level]) {
+      FrozenNodeHeader* header = getHeader(slot);
+      header->numberOfKeys = (*node).keys.size();
+      header->firstChild = firstChild;
+      copy((*node).keys.begin(), (*node).keys.end(), getKeys(slot));
+      firstChild += (*node).keys.size() + 1;
+      ++slot;
+    }
+    if (level + 1 < numberOfLevels) {
+      nextLevelFirstSlot += levels[level + 1].size();
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void FrozenLevels<KeyType, KeyCompare>::clear() {
+  free(slots);
+  slots = nullptr;
+  slotSize = 0;
+  numberOfSlots = 0;
+  numberOfLevels = 0;
+  allocatedBytes = 0;
+  isHugePageBacked = false;
+  leaves.clear();
+}
+
+template <typename KeyType, typename KeyCompare>
+Node<KeyType>* FrozenLevels<KeyType, KeyCompare>::findLeaf(const KeyType& key) {
+  if (leaves.empty()) {
+    return nullptr;
+  }
+  uint child = 0;
+  for (uint level = 0; level < numberOfLevels; ++level) {
+    uint slot = child;
+    FrozenNodeHeader* header = getHeader(slot);
+    KeyType* keys = getKeys(slot);
+    child = header->firstChild + (upper_bound(keys, keys + header->numberOfKeys, key, keyCompare) - keys);
+  }
+  return leaves[child];
+}
+
+template <typename KeyType, typename KeyCompare>
+uint FrozenLevels<KeyType, KeyCompare>::getNumberOfLevels() {
+  return numberOfLevels;
+}
+
+template <typename KeyType, typename KeyCompare>
+ull FrozenLevels<KeyType, KeyCompare>::getSizeInBytes() {
+  return allocatedBytes + leaves.capacity() * sizeof(Node<KeyType>*);
+}
+
+template <typename KeyType, typename KeyCompare>
+bool FrozenLevels<KeyType, KeyCompare>::isHugePageBackingEnabled() {
+  return isHugePageBacked;
+}
+
+template <typename KeyType, typename KeyCompare>
+FrozenLevels<KeyType, KeyCompare>::~FrozenLevels() {
+  clear();
+}
+
+// the frozen levels are compiled once for every column type that can be indexed
+template class FrozenLevels<int>;
+template class FrozenLevels<float>;
+template class FrozenLevels<MovieIdKey, MovieIdKeyCompare>;
+template class FrozenLevels<VotesRatingKey, VotesRatingKeyCompare>;
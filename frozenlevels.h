@@ -0,0 +1,122 @@
+#ifndef H_FROZENLEVELS
+#define H_FROZENLEVELS
+
+#include <functional>
+#include <vector>
+
+#include "node.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief What a frozen internal node holds besides its keys, which follow it in the same slot.
+ * 
+ */
+struct FrozenNodeHeader {
+  public:
+    uint numberOfKeys; // keys in the node
+    uint firstChild; // slot of the first child, or index of the first leaf for the last internal level; the others follow it
+};
+
+/**
+ * @brief A read-only copy of the internal levels of a B+ Tree laid out in the style of a CSB+ Tree:
+ * the nodes are stored level by level in one contiguous array of fixed size slots, so the children
+ * of a node are stored next to each other and a node keeps the position of its first child instead
+ * of a pointer per key. Every slot starts on a cache line and the array is backed by huge pages where
+ * the system allows, so a lookup touches few cache lines and TLB entries. The leaves are not copied,
+ * the last internal level points to the leaves of the tree, so the copy goes stale once the tree changes.
+ * 
+ * @tparam KeyType The type of the column the tree is indexing.
+ * @tparam KeyCompare Strict weak ordering of the keys.
+ */
+template <typename KeyType, typename KeyCompare = less<KeyType>>
+class FrozenLevels {
+  private:
+    char* slots; // internal nodes level by level, a header then the keys, each slot sized for the fullest node, nullptr if the tree is a single leaf or empty
+    uint slotSize; // bytes per slot, a whole number of cache lines
+    uint numberOfSlots; // internal nodes copied
+    uint numberOfLevels; // internal levels copied, 0 if the root is a leaf
+    ull allocatedBytes; // bytes allocated for the slots
+    bool isHugePageBacked; // whether the slots were advised to be backed by huge pages
+    vector<Node<KeyType>*> leaves; // leaves of the tree in order, the children of the last internal level
+    KeyCompare keyCompare; // orders the keys
+
+    /**
+     * @brief Get the header of a slot.
+     * 
+     * @param slot Position of the slot.
+     * @return FrozenNodeHeader* The header at the start of the slot.
+     */
+    FrozenNodeHeader* getHeader(uint slot);
+
+    /**
+     * @brief Get the keys of a slot.
+     * 
+     * @param slot Position of the slot.
+     * @return KeyType* The first key of the slot, after its header.
+     */
+    KeyType* getKeys(uint slot);
+
+  public:
+    /**
+     * @brief Construct an empty Frozen Levels object.
+     * 
+     */
+    FrozenLevels();
+
+    FrozenLevels(const FrozenLevels&) = delete;
+    FrozenLevels& operator=(const FrozenLevels&) = delete;
+
+    /**
+     * @brief Copies the internal levels of a tree, replacing what was copied before.
+     * 
+     * @param root The root of the tree, nullptr if the tree is empty.
+     */
+    void freeze(Node<KeyType>* root);
+
+    /**
+     * @brief Frees the copy.
+     * 
+     */
+    void clear();
+
+    /**
+     * @brief Finds the leaf of the tree a key belongs in, as descending the tree from the root would.
+     * 
+     * @param key The key to look up.
+     * @return Node<KeyType>* The leaf, nullptr if the tree was empty when frozen.
+     */
+    Node<KeyType>* findLeaf(const KeyType& key);
+
+    /**
+     * @brief Get the number of internal levels copied.
+     * 
+     * @return uint The levels, 0 if the root is a leaf.
+     */
+    uint getNumberOfLevels();
+
+    /**
+     * @brief Get the memory taken by the copy.
+     * 
+     * @return ull The bytes allocated for the slots and the leaf pointers.
+     */
+    ull getSizeInBytes();
+
+    /**
+     * @brief Checks if the slots were advised to be backed by huge pages.
+     * 
+     * @return true If huge pages were asked for.
+     */
+    bool isHugePageBackingEnabled();
+
+    /**
+     * @brief Destroy the Frozen Levels object and free the copy.
+     * 
+     */
+    ~FrozenLevels();
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef H_INDEXKEY
+#define H_INDEXKEY
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "record.h"
+
+using namespace std;
+
+/**
+ * @brief Fixed width key used to index the tConst(movieId) column.
+ * 
+ */
+struct MovieIdKey {
+  public:
+    char __movieId[TCONSTSIZE]; // same width as the column in the record
+
+    /**
+     * @brief Construct an empty Movie Id Key object.
+     * 
+     */
+    MovieIdKey() {
+      memset(__movieId, 0, TCONSTSIZE);
+    }
+
+    /**
+     * @brief Construct a new Movie Id Key object from a tConst.
+     * 
+     * @param movieId The tConst of the movie, only the first TCONSTSIZE characters are kept.
+     */
+    explicit MovieIdKey(const char* movieId) {
+      memset(__movieId, 0, TCONSTSIZE);
+      memcpy(__movieId, movieId, strnlen(movieId, TCONSTSIZE));
+    }
+};
+
+/**
+ * @brief Orders movie id keys by comparing the raw characters of the tConst.
+ * 
+ */
+struct MovieIdKeyCompare {
+  bool operator()(const MovieIdKey& firstKey, const MovieIdKey& secondKey) const {
+    return strncmp(firstKey.__movieId, secondKey.__movieId, TCONSTSIZE) < 0;
+  }
+};
+
+inline ostream& operator<<(ostream& out, const MovieIdKey& key) {
+  return out << string(key.__movieId, strnlen(key.__movieId, TCONSTSIZE));
+}
+
+/**
+ * @brief Composite key of (numVotes, avgRating), ordered by numVotes first and avgRating second.
+ * 
+ */
+struct VotesRatingKey {
+  public:
+    int __numVotes;
+    float __avgRating;
+
+    /**
+     * @brief Construct a new Votes Rating Key object.
+     * 
+     */
+    VotesRatingKey() : __numVotes(0), __avgRating(0.0f) {}
+
+    /**
+     * @brief Construct a new Votes Rating Key object.
+     * 
+     * @param numVotes The first column of the key.
+     * @param avgRating The second column of the key.
+     */
+    VotesRatingKey(int numVotes, float avgRating) : __numVotes(numVotes), __avgRating(avgRating) {}
+
+    /**
+     * @brief The smallest key with the given numVotes, used as the start of a numVotes range.
+     * 
+     */
+    static VotesRatingKey lowestWithNumVotes(int numVotes) {
+      return VotesRatingKey(numVotes, numeric_limits<float>::lowest());
+    }
+
+    /**
+     * @brief The largest key with the given numVotes, used as the end of a numVotes range.
+     * 
+     */
+    static VotesRatingKey highestWithNumVotes(int numVotes) {
+      return VotesRatingKey(numVotes, numeric_limits<float>::max());
+    }
+};
+
+/**
+ * @brief Orders composite keys lexicographically, numVotes then avgRating.
+ * 
+ */
+struct VotesRatingKeyCompare {
+  bool operator()(const VotesRatingKey& firstKey, const VotesRatingKey& secondKey) const {
+    if (firstKey.__numVotes != secondKey.__numVotes) {
+      return firstKey.__numVotes < secondKey.__numVotes;
+    }
+    return firstKey.__avgRating < secondKey.__avgRating;
+  }
+};
+
+inline ostream& operator<<(ostream& out, const VotesRatingKey& key) {
+  return out << "(" << key.__numVotes << ", " << key.__avgRating << ")";
+}
+
+/**
+ * @brief Columns stored next to every block pointer in the leaves of a covering index,
+ * so queries that only need these columns never read the data blocks.
+ * 
+ */
+struct IncludedColumns {
+  public:
+    float __avgRating;
+
+    /**
+     * @brief Construct an empty Included Columns object.
+     * 
+     */
+    IncludedColumns() : __avgRating(0.0f) {}
+
+    /**
+     * @brief Construct the included columns of a record.
+     * 
+     * @param record The record being indexed.
+     */
+    explicit IncludedColumns(const Record& record) : __avgRating(record.__avgRating) {}
+};
+
+/**
+ * @brief Maps an index key type to the column of the record it is built on.
+ * int indexes numVotes, float indexes avgRating and MovieIdKey indexes tConst.
+ * 
+ * @tparam KeyType The type of the key in the index.
+ */
+template <typename KeyType>
+struct RecordKey;
+
+template <>
+struct RecordKey<int> {
+  static int extract(const Record& record) {
+    return record.__numVotes;
+  }
+};
+
+template <>
+struct RecordKey<float> {
+  static float extract(const Record& record) {
+    return record.__avgRating;
+  }
+};
+
+template <>
+struct RecordKey<MovieIdKey> {
+  static MovieIdKey extract(const Record& record) {
+    return MovieIdKey(record.__movieId);
+  }
+};
+
+template <>
+struct RecordKey<VotesRatingKey> {
+  static VotesRatingKey extract(const Record& record) {
+    return VotesRatingKey(record.__numVotes, record.__avgRating);
+  }
+};
+
+/**
+ * @brief Hashes an index key to 64 bits for the filters of the leaves. Keys the index treats as
+ * equal hash the same: a tConst is hashed up to its terminator and -0.0 as 0.0.
+ * 
+ * @tparam KeyType The type of the key in the index.
+ */
+template <typename KeyType>
+struct KeyHash;
+
+template <>
+struct KeyHash<int> {
+  static uint64_t hash(const int& key) {
+    return (uint64_t) (uint32_t) key;
+  }
+};
+
+template <>
+struct KeyHash<float> {
+  static uint64_t hash(const float& key) {
+    float normalizedKey = key == 0.0f ? 0.0f : key;
+    uint32_t keyBits;
+    memcpy(&keyBits, &normalizedKey, sizeof(float));
+    return keyBits;
+  }
+};
+
+template <>
+struct KeyHash<MovieIdKey> {
+  static uint64_t hash(const MovieIdKey& key) {
+    // FNV-1a over the characters strncmp compares
+    uint64_t keyHash = 14695981039346656037ULL;
+    for (unsigned int i = 0; i < TCONSTSIZE && key.__movieId[i] != '\0'; ++i) {
+      keyHash = (keyHash ^ (unsigned char) key.__movieId[i]) * 1099511628211ULL;
+    }
+    return keyHash;
+  }
+};
+
+template <>
+struct KeyHash<VotesRatingKey> {
+  static uint64_t hash(const VotesRatingKey& key) {
+    return KeyHash<int>::hash(key.__numVotes) << 32 | KeyHash<float>::hash(key.__avgRating);
+  }
+};
+
+/**
+ * @brief Whether the key itself carries avgRating, so an index on it can aggregate ratings
+ * without reading the data blocks.
+ * 
+ * @tparam KeyType The type of the key in the index.
+ */
+template <typename KeyType>
+struct KeyCoversAvgRating {
+  static const bool value = false;
+  static float avgRating(const KeyType&) {
+    return 0.0f;
+  }
+};
+
+template <>
+struct KeyCoversAvgRating<float> {
+  static const bool value = true;
+  static float avgRating(const float& key) {
+    return key;
+  }
+};
+
+template <>
+struct KeyCoversAvgRating<VotesRatingKey> {
+  static const bool value = true;
+  static float avgRating(const VotesRatingKey& key) {
+    return key.__avgRating;
+  }
+};
+
+/**
+ * @brief Checks whether the indexed column of a record is equal to the key under the comparator of the index.
+ * 
+ * @param record The record to check.
+ * @param key The key to compare against.
+ * @param keyCompare The strict weak ordering used by the index.
+ * @return true If neither key orders before the other.
+ * @return false If the record holds a different key.
+ */
+template <typename KeyType, typename KeyCompare>
+bool recordHasKey(const Record& record, const KeyType& key, const KeyCompare& keyCompare) {
+  KeyType recordKey = RecordKey<KeyType>::extract(record);
+  return !keyCompare(recordKey, key) && !keyCompare(key, recordKey);
+}
+
+#endif
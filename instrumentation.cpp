@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "instrumentation.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+// function declarations
+double getPercentileOfCounts(const vector<ull>& bucketCounts, ull numberOfValues, double percentile);
+vector<ThreadProfile*> getThreadProfiles();
+
+const char* TREE_OPERATION_NAMES[NUMBER_OF_TREE_OPERATIONS] = {"insertKey", "searchQuery", "rangeQuery", "deleteRecordByKey"};
+const char* TREE_EVENT_NAMES[NUMBER_OF_TREE_EVENTS] = {"nodeVisits", "splits", "merges", "borrows", "findParentCalls"};
+
+mutex threadProfilesMutex; // guards threadProfiles
+vector<ThreadProfile*> threadProfiles; // profile of every thread that called a tree operation, never freed
+thread_local ThreadProfile* threadProfile = nullptr; // profile of the calling thread
+
+atomic<bool> isTraceRecording(false); // if timed calls are kept for the Chrome trace
+chrono::steady_clock::time_point traceStart; // when tracing started, set before isTraceRecording
+
+void LatencyHistogram::recordValue(ull value) {
+  ++bucketCounts[getBucketIndex(value)];
+  ++numberOfValues;
+  if (value > maxValue) {
+    maxValue = value;
+  }
+}
+
+uint LatencyHistogram::getBucketIndex(ull value) {
+  if (value < LATENCY_SUB_BUCKETS) {
+    return value;
+  }
+  uint magnitude = 63 - __builtin_clzll(value); // position of the highest bit set
+  if (magnitude >= LATENCY_MAX_MAGNITUDE) {
+    return LATENCY_BUCKETS - 1;
+  }
+  uint shift = magnitude - LATENCY_SUB_BUCKET_BITS;
+  // the top bits are in [16, 32), so each magnitude takes the 16 buckets after the previous one
+  return shift * LATENCY_SUB_BUCKETS + (value >> shift);
+}
+
+double LatencyHistogram::getBucketValue(uint bucketIndex) {
+  if (bucketIndex < LATENCY_SUB_BUCKETS) {
+    return bucketIndex;
+  }
+  uint shift = bucketIndex / LATENCY_SUB_BUCKETS - 1;
+  ull topBits = bucketIndex % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+  ull bucketWidth = 1ULL << shift;
+  return (topBits << shift) + bucketWidth / 2.0;
+}
+
+OperationTimer::OperationTimer(TreeOperation operation) : profile(getThreadProfile()), operation(operation) {
+  outerOperation = (*profile).activeOperation;
+  (*profile).activeOperation = operation;
+  for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+    startEventCounts[event] = (*profile).eventCounts[operation][event];
+  }
+  start = chrono::steady_clock::now();
+}
+
+OperationTimer::~OperationTimer() {
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  (*profile).latencies[operation].recordValue(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+  (*profile).activeOperation = outerOperation;
+
+  if (isTraceRecording.load(memory_order_acquire)) {
+    TraceEvent traceEvent;
+    traceEvent.operation = operation;
+    traceEvent.startUs = chrono::duration<double, micro>(start - traceStart).count();
+    traceEvent.durationUs = chrono::duration<double, micro>(end - start).count();
+    for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+      traceEvent.eventCounts[event] = (*profile).eventCounts[operation][event] - startEventCounts[event];
+    }
+    (*profile).traceEvents.push_back(traceEvent);
+  }
+}
+
+ThreadProfile* getThreadProfile() {
+  if (threadProfile == nullptr) {
+    lock_guard<mutex> profilesLock(threadProfilesMutex);
+    threadProfile = new ThreadProfile(threadProfiles.size());
+    threadProfiles.push_back(threadProfile);
+  }
+  return threadProfile;
+}
+
+void recordTreeEvent(TreeEvent event) {
+  ThreadProfile* profile = getThreadProfile();
+  if ((*profile).activeOperation >= 0) {
+    ++(*profile).eventCounts[(*profile).activeOperation][event];
+  }
+}
+
+bool isInstrumentationCompiled() {
+#ifdef BPLUSTREE_INSTRUMENTATION
+  return true;
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Get a copy of the list of thread profiles, so they can be read without holding the lock.
+ * 
+ * @return vector<ThreadProfile*> The profiles of the threads.
+ */
+vector<ThreadProfile*> getThreadProfiles() {
+  lock_guard<mutex> profilesLock(threadProfilesMutex);
+  return threadProfiles;
+}
+
+/**
+ * @brief Get the latency below which a share of the latencies counted in a histogram fall.
+ * 
+ * @param bucketCounts Number of latencies in every bucket.
+ * @param numberOfValues Latencies counted.
+ * @param percentile Share of the latencies, in (0, 1].
+ * @return double The latency in nanoseconds, 0 if none were counted.
+ */
+double getPercentileOfCounts(const vector<ull>& bucketCounts, ull numberOfValues, double percentile) {
+  if (numberOfValues == 0) {
+    return 0;
+  }
+  ull rank = max(1ULL, (ull) ceil(percentile * numberOfValues));
+  ull valuesSeen = 0;
+  for (uint bucketIndex = 0; bucketIndex < bucketCounts.size(); ++bucketIndex) {
+    valuesSeen += bucketCounts[bucketIndex];
+    if (valuesSeen >= rank) {
+      return LatencyHistogram::getBucketValue(bucketIndex);
+    }
+  }
+  return LatencyHistogram::getBucketValue(bucketCounts.size() - 1);
+}
+
+void startTraceRecording() {
+  traceStart = chrono::steady_clock::now();
+  isTraceRecording.store(true, memory_order_release);
+}
+
+void writeChromeTrace(const string& filePath) {
+  ofstream traceFile(filePath);
+  if (!traceFile) {
+    cout << "Unable to open " << filePath << " for writing" << endl;
+    throw "Unable to open trace file";
+  }
+
+  uint numberOfEvents = 0;
+  traceFile << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (ThreadProfile* profile: getThreadProfiles()) {
+    for (TraceEvent& traceEvent: (*profile).traceEvents) {
+      traceFile << (numberOfEvents == 0 ? "" : ",") << "\n{\"name\":\"" << TREE_OPERATION_NAMES[traceEvent.operation]
+                << "\",\"cat\":\"bplustree\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (*profile).threadId
+                << fixed << setprecision(3) << ",\"ts\":" << traceEvent.startUs << ",\"dur\":" << traceEvent.durationUs
+                << ",\"args\":{";
+      for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+        traceFile << (event == 0 ? "" : ",") << "\"" << TREE_EVENT_NAMES[event] << "\":" << traceEvent.eventCounts[event];
+      }
+      traceFile << "}}";
+      ++numberOfEvents;
+    }
+  }
+  traceFile << "\n]}\n";
+  cout << "Wrote " << numberOfEvents << " trace events to " << filePath << endl;
+}
+
+void printLatencyReport() {
+  vector<ThreadProfile*> profiles = getThreadProfiles();
+  cout << "Latency of the B+ Tree operations over " << profiles.size() << " thread(s), in microseconds" << endl;
+  cout << left << setw(20) << "operation" << right << setw(10) << "calls" << setw(10) << "p50" << setw(10) << "p99"
+       << setw(10) << "p999" << setw(10) << "max";
+  for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+    cout << setw(17) << TREE_EVENT_NAMES[event];
+  }
+  cout << endl;
+
+  for (uint operation = 0; operation < NUMBER_OF_TREE_OPERATIONS; ++operation) {
+    vector<ull> bucketCounts(LATENCY_BUCKETS, 0);
+    vector<ull> eventCounts(NUMBER_OF_TREE_EVENTS, 0);
+    ull maxLatency = 0;
+    for (ThreadProfile* profile: profiles) {
+      LatencyHistogram& latencies = (*profile).latencies[operation];
+      for (uint bucketIndex = 0; bucketIndex < LATENCY_BUCKETS; ++bucketIndex) {
+        bucketCounts[bucketIndex] += latencies.bucketCounts[bucketIndex];
+      }
+      for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+        eventCounts[event] += (*profile).eventCounts[operation][event];
+      }
+      maxLatency = max(maxLatency, (ull) latencies.maxValue);
+    }
+    // calls are counted from the buckets, which other threads may still be recording into, so the percentiles stay consistent
+    ull numberOfCalls = 0;
+    for (ull bucketCount: bucketCounts) {
+      numberOfCalls += bucketCount;
+    }
+
+    cout << left << setw(20) << TREE_OPERATION_NAMES[operation] << right << setw(10) << numberOfCalls << fixed << setprecision(2);
+    // a bucket stands for the middle of its latencies, which can be above the slowest one recorded
+    cout << setw(10) << min(getPercentileOfCounts(bucketCounts, numberOfCalls, 0.5), (double) maxLatency) / 1000
+         << setw(10) << min(getPercentileOfCounts(bucketCounts, numberOfCalls, 0.99), (double) maxLatency) / 1000
+         << setw(10) << min(getPercentileOfCounts(bucketCounts, numberOfCalls, 0.999), (double) maxLatency) / 1000
+         << setw(10) << maxLatency / 1000.0;
+    for (uint event = 0; event < NUMBER_OF_TREE_EVENTS; ++event) {
+      cout << setw(17) << (numberOfCalls == 0 ? 0.0 : (double) eventCounts[event] / numberOfCalls);
+    }
+    cout << endl;
+  }
+  cout.unsetf(ios::fixed);
+  cout << setprecision(6);
+}
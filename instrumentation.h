@@ -0,0 +1,195 @@
+#ifndef H_INSTRUMENTATION
+#define H_INSTRUMENTATION
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "atomiccounter.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+#define LATENCY_SUB_BUCKET_BITS 4 // every power of two is split in 16 linear buckets, so a latency is kept within 6.25%
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_MAGNITUDE 48 // latencies are counted up to 2^48ns
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS * (LATENCY_MAX_MAGNITUDE - LATENCY_SUB_BUCKET_BITS + 1))
+
+// compile with -DBPLUSTREE_INSTRUMENTATION to time the tree operations and count what they do,
+// otherwise the hooks compile to nothing
+#ifdef BPLUSTREE_INSTRUMENTATION
+#define INSTRUMENT_TREE_OPERATION(operation) OperationTimer operationTimer(operation)
+#define INSTRUMENT_TREE_EVENT(event) recordTreeEvent(event)
+#else
+#define INSTRUMENT_TREE_OPERATION(operation)
+#define INSTRUMENT_TREE_EVENT(event)
+#endif
+
+/**
+ * @brief The tree operations that are timed.
+ * 
+ */
+enum TreeOperation {
+  INSERT_KEY,
+  SEARCH_QUERY,
+  RANGE_QUERY,
+  DELETE_RECORD_BY_KEY,
+  NUMBER_OF_TREE_OPERATIONS
+};
+
+/**
+ * @brief What a tree operation does that is counted per call.
+ * 
+ */
+enum TreeEvent {
+  NODE_VISIT,
+  NODE_SPLIT,
+  NODE_MERGE,
+  NODE_BORROW,
+  FIND_PARENT_CALL,
+  NUMBER_OF_TREE_EVENTS
+};
+
+/**
+ * @brief Latencies counted in log-linear buckets in the style of an HDR histogram: exact below 16ns,
+ * then every power of two split in 16 buckets. Written by a single thread, readable from any thread.
+ * 
+ */
+struct LatencyHistogram {
+  public:
+    AtomicCounter<ull> bucketCounts[LATENCY_BUCKETS]; // number of latencies in every bucket
+    AtomicCounter<ull> numberOfValues; // latencies recorded
+    AtomicCounter<ull> maxValue; // slowest latency recorded in nanoseconds
+
+    /**
+     * @brief Counts a latency in its bucket.
+     * 
+     * @param value The latency in nanoseconds.
+     */
+    void recordValue(ull value);
+
+    /**
+     * @brief Get the bucket a latency is counted in.
+     * 
+     * @param value The latency in nanoseconds.
+     * @return uint Index of the bucket.
+     */
+    static uint getBucketIndex(ull value);
+
+    /**
+     * @brief Get the latency a bucket stands for, the middle of the latencies it counts.
+     * 
+     * @param bucketIndex Index of the bucket.
+     * @return double The latency in nanoseconds.
+     */
+    static double getBucketValue(uint bucketIndex);
+};
+
+/**
+ * @brief One call of a tree operation, kept for the Chrome trace.
+ * 
+ */
+struct TraceEvent {
+  public:
+    TreeOperation operation; // operation called
+    double startUs; // start of the call in microseconds since the trace started
+    double durationUs; // duration of the call in microseconds
+    ull eventCounts[NUMBER_OF_TREE_EVENTS]; // what the call did
+};
+
+/**
+ * @brief Latencies and event counts of the tree operations called by one thread. Profiles outlive
+ * their threads, so the samples of a finished thread stay in the report.
+ * 
+ */
+struct ThreadProfile {
+  public:
+    uint threadId; // order in which the thread first called a tree operation
+    LatencyHistogram latencies[NUMBER_OF_TREE_OPERATIONS]; // latencies of every operation
+    AtomicCounter<ull> eventCounts[NUMBER_OF_TREE_OPERATIONS][NUMBER_OF_TREE_EVENTS]; // events of every operation, summed over its calls
+    int activeOperation; // innermost operation running on the thread, -1 if none, events are counted against it
+    vector<TraceEvent> traceEvents; // calls recorded while tracing
+
+    /**
+     * @brief Construct an empty Thread Profile object.
+     * 
+     * @param threadId Order in which the thread first called a tree operation.
+     */
+    explicit ThreadProfile(uint threadId) : threadId(threadId), activeOperation(-1) {}
+};
+
+/**
+ * @brief Times a tree operation from construction to destruction and counts the events of the call.
+ * 
+ */
+class OperationTimer {
+  private:
+    ThreadProfile* profile; // profile of the calling thread
+    TreeOperation operation; // operation timed
+    int outerOperation; // operation that was running when this one started
+    ull startEventCounts[NUMBER_OF_TREE_EVENTS]; // event counts when the call started, for the trace
+    chrono::steady_clock::time_point start; // start of the call
+
+  public:
+    /**
+     * @brief Starts timing a call.
+     * 
+     * @param operation The operation called.
+     */
+    explicit OperationTimer(TreeOperation operation);
+
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    /**
+     * @brief Stops timing the call and records its latency.
+     * 
+     */
+    ~OperationTimer();
+};
+
+/**
+ * @brief Get the profile of the calling thread, creating it on the first call.
+ * 
+ * @return ThreadProfile* The profile of the thread.
+ */
+ThreadProfile* getThreadProfile();
+
+/**
+ * @brief Counts an event against the operation running on the calling thread.
+ * 
+ * @param event What the operation did.
+ */
+void recordTreeEvent(TreeEvent event);
+
+/**
+ * @brief Checks if the build times the tree operations.
+ * 
+ * @return true If compiled with BPLUSTREE_INSTRUMENTATION.
+ */
+bool isInstrumentationCompiled();
+
+/**
+ * @brief Keeps every timed call from now on, to be written as a Chrome trace.
+ * 
+ */
+void startTraceRecording();
+
+/**
+ * @brief Writes the calls recorded since tracing started in the Chrome trace event format, which
+ * chrome://tracing and Perfetto open. Call it once the threads using the trees are idle.
+ * 
+ * @param filePath Path of the JSON file, overwritten if it exists.
+ */
+void writeChromeTrace(const string& filePath);
+
+/**
+ * @brief Prints the p50, p99, p999 and maximum latency of every operation over all threads, and the
+ * events per call.
+ * 
+ */
+void printLatencyReport();
+
+#endif
@@ -0,0 +1,109 @@
+#include "keycompression.h"
+#include "constants.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+void PackedKeys::encode(const vector<int>& keys) {
+  numberOfKeys = keys.size();
+  words.clear();
+  if (keys.empty()) {
+    base = 0;
+    bitWidth = 0;
+    return;
+  }
+
+  // keys are sorted, so the first key is the frame of reference and the last key the largest delta
+  base = keys.front();
+  bitWidth = getBitWidthOfRange((int64_t) keys.back() - (int64_t) base);
+  if (bitWidth == 0) {
+    return; // every key equals the base, nothing to pack
+  }
+
+  words.assign((numberOfKeys * bitWidth + 63) / 64, 0);
+  for (uint i = 0; i < numberOfKeys; ++i) {
+    uint64_t delta = (uint64_t) ((int64_t) keys[i] - (int64_t) base);
+    uint64_t bitOffset = (uint64_t) i * bitWidth;
+    uint wordIdx = bitOffset / 64;
+    uint shift = bitOffset % 64;
+    words[wordIdx] |= delta << shift;
+    if (shift + bitWidth > 64) {
+      // delta straddles two words, the high bits go to the next word
+      words[wordIdx + 1] |= delta >> (64 - shift);
+    }
+  }
+}
+
+int PackedKeys::decodeKey(uint index) const {
+  if (bitWidth == 0) {
+    return base;
+  }
+  uint64_t bitOffset = (uint64_t) index * bitWidth;
+  uint wordIdx = bitOffset / 64;
+  uint shift = bitOffset % 64;
+  uint64_t delta = words[wordIdx] >> shift;
+  if (shift + bitWidth > 64) {
+    delta |= words[wordIdx + 1] << (64 - shift);
+  }
+  delta &= (bitWidth == 64) ? ~0ULL : ((1ULL << bitWidth) - 1);
+  return (int) ((int64_t) base + (int64_t) delta);
+}
+
+uint PackedKeys::upperBound(int key) const {
+  if (numberOfKeys == 0 || key < base) {
+    return 0;
+  }
+  // binary search decoding only the probed keys
+  uint low = 0;
+  uint high = numberOfKeys;
+  while (low < high) {
+    uint mid = low + (high - low) / 2;
+    if (decodeKey(mid) <= key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+uint PackedKeys::lowerBound(int key) const {
+  if (numberOfKeys == 0 || key <= base) {
+    return 0;
+  }
+  uint low = 0;
+  uint high = numberOfKeys;
+  while (low < high) {
+    uint mid = low + (high - low) / 2;
+    if (decodeKey(mid) < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+uint getBitWidthOfRange(uint64_t range) {
+  uint bitWidth = 0;
+  while (range > 0) {
+    ++bitWidth;
+    range >>= 1;
+  }
+  return bitWidth;
+}
+
+uint getCompressedNodeSize(uint numberOfKeys, uint bitWidth) {
+  uint packedWords = ((uint64_t) numberOfKeys * bitWidth + 63) / 64;
+  return COMPRESSED_NODE_HEADER_SIZE + packedWords * PACKED_WORD_SIZE + SIZE_OF_POINTER * (numberOfKeys + 1);
+}
+
+uint getMaximumKeysInCompressedNode(uint blockSize) {
+  uint numberOfKeys = 0;
+  // keys spaced 1 apart need a single bit each, which is the densest a node can be packed
+  while (getCompressedNodeSize(numberOfKeys + 1, getBitWidthOfRange(numberOfKeys)) <= blockSize) {
+    ++numberOfKeys;
+  }
+  return numberOfKeys;
+}
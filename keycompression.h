@@ -0,0 +1,127 @@
+#ifndef H_KEYCOMPRESSION
+#define H_KEYCOMPRESSION
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+typedef unsigned int uint;
+
+#define COMPRESSED_NODE_HEADER_SIZE 8 // frame of reference base(4B) + number of keys(2B) + bit width(1B) + isLeaf(1B)
+#define PACKED_WORD_SIZE 8 // keys are bit-packed into 64 bit words
+#define MAX_KEY_BIT_WIDTH 32 // an integer key never needs more than 32 bits
+
+/**
+ * @brief Integer keys of a node stored as frame-of-reference deltas that are bit-packed at the
+ * smallest width able to hold the largest delta. The keys of a node are sorted and usually close
+ * together, so the deltas need far fewer bits than a full integer.
+ * 
+ */
+struct PackedKeys {
+  public:
+    int base; // smallest key of the node, every key is stored as its distance to the base
+    uint bitWidth; // bits used by each packed delta
+    uint numberOfKeys; // number of keys packed
+    vector<uint64_t> words; // packed deltas
+
+    /**
+     * @brief Construct an empty Packed Keys object.
+     * 
+     */
+    PackedKeys() : base(0), bitWidth(0), numberOfKeys(0) {}
+
+    /**
+     * @brief Packs a sorted array of keys, replacing the keys packed before.
+     * 
+     * @param keys The sorted keys of the node.
+     */
+    void encode(const vector<int>& keys);
+
+    /**
+     * @brief Decodes a single key without unpacking the rest of the node.
+     * 
+     * @param index Position of the key in the node.
+     * @return int The key at the position.
+     */
+    int decodeKey(uint index) const;
+
+    /**
+     * @brief Finds the first key strictly greater than the key, which is the child pointer to follow in an internal node.
+     * 
+     * @param key The search key.
+     * @return uint Index of the first greater key, numberOfKeys if there is none.
+     */
+    uint upperBound(int key) const;
+
+    /**
+     * @brief Finds the first key greater than or equal to the key, which is the position of the key in a leaf node.
+     * 
+     * @param key The search key.
+     * @return uint Index of the first key not less than the search key, numberOfKeys if there is none.
+     */
+    uint lowerBound(int key) const;
+};
+
+/**
+ * @brief Get the number of bits needed to store every delta up to the range.
+ * 
+ * @param range Distance between the smallest and largest key.
+ * @return uint Bits per packed key.
+ */
+uint getBitWidthOfRange(uint64_t range);
+
+/**
+ * @brief Get the size of a compressed node: header, packed keys rounded up to whole words and N+1 pointers.
+ * 
+ * @param numberOfKeys Keys in the node.
+ * @param bitWidth Bits per packed key.
+ * @return uint Size of the node in bytes(B).
+ */
+uint getCompressedNodeSize(uint numberOfKeys, uint bitWidth);
+
+/**
+ * @brief Get the most keys a compressed node of the block size can hold, reached when all keys are equally spaced by 1.
+ * 
+ * @param blockSize Block size specified by the user.
+ * @return uint Upper bound on the keys in a compressed node.
+ */
+uint getMaximumKeysInCompressedNode(uint blockSize);
+
+// Only integer keys can be packed, the tree only calls these for other key types when compression is disabled.
+
+template <typename KeyType>
+void packNodeKeys(PackedKeys&, const vector<KeyType>&) {}
+
+inline void packNodeKeys(PackedKeys& packedKeys, const vector<int>& keys) {
+  packedKeys.encode(keys);
+}
+
+template <typename KeyType>
+uint packedUpperBound(const PackedKeys&, const KeyType&) {
+  return 0;
+}
+
+inline uint packedUpperBound(const PackedKeys& packedKeys, const int& key) {
+  return packedKeys.upperBound(key);
+}
+
+template <typename KeyType>
+uint packedLowerBound(const PackedKeys&, const KeyType&) {
+  return 0;
+}
+
+inline uint packedLowerBound(const PackedKeys& packedKeys, const int& key) {
+  return packedKeys.lowerBound(key);
+}
+
+template <typename KeyType>
+uint getCompressedNodeSizeOfRange(const KeyType&, const KeyType&, uint numberOfKeys) {
+  return getCompressedNodeSize(numberOfKeys, MAX_KEY_BIT_WIDTH);
+}
+
+inline uint getCompressedNodeSizeOfRange(const int& smallestKey, const int& largestKey, uint numberOfKeys) {
+  return getCompressedNodeSize(numberOfKeys, getBitWidthOfRange((int64_t) largestKey - (int64_t) smallestKey));
+}
+
+#endif
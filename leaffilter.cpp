@@ -0,0 +1,75 @@
+#include <cmath>
+
+#include "leaffilter.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// function declarations
+uint64_t mixKeyHash(uint64_t keyHash);
+uint getFilterBit(uint32_t bitHash, uint numberOfBits);
+
+/**
+ * @brief Spreads the bits of a key hash, so keys that differ in a few low bits set unrelated filter bits.
+ * 
+ * @param keyHash The key hashed to 64 bits.
+ * @return uint64_t The mixed hash, the finalizer of splitmix64.
+ */
+uint64_t mixKeyHash(uint64_t keyHash) {
+  keyHash ^= keyHash >> 30;
+  keyHash *= 0xbf58476d1ce4e5b9ULL;
+  keyHash ^= keyHash >> 27;
+  keyHash *= 0x94d049bb133111ebULL;
+  return keyHash ^ (keyHash >> 31);
+}
+
+/**
+ * @brief Maps a 32 bit hash onto a bit of the filter with a multiply and a shift, which is cheaper than a modulo.
+ * 
+ * @param bitHash The hash of the bit.
+ * @param numberOfBits Bits of the filter.
+ * @return uint The bit, below numberOfBits.
+ */
+uint getFilterBit(uint32_t bitHash, uint numberOfBits) {
+  return ((uint64_t) bitHash * numberOfBits) >> 32;
+}
+
+void LeafFilter::reset(uint maxKeys, uint bitsPerKey) {
+  numberOfBits = (maxKeys == 0 ? 1 : maxKeys) * bitsPerKey;
+  numberOfHashes = getNumberOfFilterHashes(bitsPerKey);
+  bits.assign((numberOfBits + 63) / 64, 0);
+}
+
+void LeafFilter::addHash(uint64_t keyHash) {
+  // double hashing, the i-th bit of a key is h1 + i * h2
+  uint64_t mixedHash = mixKeyHash(keyHash);
+  uint32_t firstHash = (uint32_t) mixedHash;
+  uint32_t secondHash = (uint32_t) (mixedHash >> 32) | 1;
+  for (uint i = 0; i < numberOfHashes; ++i) {
+    uint bit = getFilterBit(firstHash + i * secondHash, numberOfBits);
+    bits[bit / 64] |= 1ULL << (bit % 64);
+  }
+}
+
+bool LeafFilter::mayContainHash(uint64_t keyHash) const {
+  if (bits.empty()) {
+    return true;
+  }
+  uint64_t mixedHash = mixKeyHash(keyHash);
+  uint32_t firstHash = (uint32_t) mixedHash;
+  uint32_t secondHash = (uint32_t) (mixedHash >> 32) | 1;
+  for (uint i = 0; i < numberOfHashes; ++i) {
+    uint bit = getFilterBit(firstHash + i * secondHash, numberOfBits);
+    if ((bits[bit / 64] & (1ULL << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint getNumberOfFilterHashes(uint bitsPerKey) {
+  // k = bits per key * ln 2 minimizes the false positive rate of a full filter
+  uint numberOfHashes = (uint) lround(bitsPerKey * log(2.0));
+  return numberOfHashes == 0 ? 1 : numberOfHashes;
+}
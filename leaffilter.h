@@ -0,0 +1,63 @@
+#ifndef H_LEAFFILTER
+#define H_LEAFFILTER
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+typedef unsigned int uint;
+
+#define LEAF_FILTER_BITS_PER_KEY 10 // bits of a leaf filter per key the leaf can hold, about a 1% false positive rate when full
+
+/**
+ * @brief A Bloom filter over the keys of a leaf, so a lookup of a key the leaf does not hold can
+ * usually return without reading its keys. It never misses a key it was built with.
+ * 
+ */
+struct LeafFilter {
+  public:
+    vector<uint64_t> bits; // the filter, empty until it is built
+    uint numberOfBits; // bits used, sized for the most keys a leaf can hold
+    uint numberOfHashes; // bits set per key
+
+    /**
+     * @brief Construct a filter that is not built, which may contain any key.
+     * 
+     */
+    LeafFilter() : numberOfBits(0), numberOfHashes(0) {}
+
+    /**
+     * @brief Clears the filter and sizes it, replacing the keys added before.
+     * 
+     * @param maxKeys Most keys the leaf can hold.
+     * @param bitsPerKey Bits per key the leaf can hold.
+     */
+    void reset(uint maxKeys, uint bitsPerKey);
+
+    /**
+     * @brief Adds a key to the filter.
+     * 
+     * @param keyHash The key hashed to 64 bits.
+     */
+    void addHash(uint64_t keyHash);
+
+    /**
+     * @brief Checks if the leaf may hold a key.
+     * 
+     * @param keyHash The key hashed to 64 bits.
+     * @return true If the key was added, or a false positive, or the filter is not built.
+     * @return false If the key was surely not added.
+     */
+    bool mayContainHash(uint64_t keyHash) const;
+};
+
+/**
+ * @brief Get the bits to set per key that give the fewest false positives for the bits per key.
+ * 
+ * @param bitsPerKey Bits of the filter per key.
+ * @return uint Bits set per key, at least 1.
+ */
+uint getNumberOfFilterHashes(uint bitsPerKey);
+
+#endif
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "learnedindex.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+LearnedIndex::LearnedIndex(uint maxError, uint maxAllowableBlkPtrsInOverflowBlock)
+    : maxError(maxError), maxAllowableBlkPtrsInOverflowBlock(maxAllowableBlkPtrsInOverflowBlock) {}
+
+vector<LinearSegment> LearnedIndex::fitSegments(const vector<int>& sortedKeys) {
+  vector<LinearSegment> segments;
+  uint firstPosition = 0;
+  while (firstPosition < sortedKeys.size()) {
+    // every key added narrows the slopes that keep all the keys of the segment within maxError
+    double lowestSlope = 0;
+    double highestSlope = INFINITY;
+    uint position = firstPosition + 1;
+    for (; position < sortedKeys.size(); ++position) {
+      double keyDistance = (double) sortedKeys[position] - sortedKeys[firstPosition];
+      double positionDistance = position - firstPosition;
+      double lowestSlopeWithKey = max(lowestSlope, (positionDistance - maxError) / keyDistance);
+      double highestSlopeWithKey = min(highestSlope, (positionDistance + maxError) / keyDistance);
+      if (lowestSlopeWithKey > highestSlopeWithKey) {
+        break;
+      }
+      lowestSlope = lowestSlopeWithKey;
+      highestSlope = highestSlopeWithKey;
+    }
+    LinearSegment segment;
+    segment.firstKey = sortedKeys[firstPosition];
+    segment.firstPosition = firstPosition;
+    segment.lastPosition = position - 1;
+    segment.slope = position == firstPosition + 1 ? 0 : (lowestSlope + highestSlope) / 2;
+    segments.push_back(segment);
+    firstPosition = position;
+  }
+  return segments;
+}
+
+int LearnedIndex::findLastNotGreater(const vector<int>& sortedKeys, const LinearSegment& segment, int key, uint& keysProbed) {
+  double predictedPosition = segment.firstPosition + segment.slope * ((double) key - segment.firstKey);
+  // a key between two indexed keys is predicted between their predictions, so one more position each way is enough
+  double lowestPosition = floor(predictedPosition) - maxError - 1;
+  double highestPosition = ceil(predictedPosition) + maxError + 1;
+  uint low = max((double) segment.firstPosition, min((double) segment.lastPosition, lowestPosition));
+  uint high = min((double) segment.lastPosition, max((double) low, highestPosition));
+
+  // binary search for the first key greater than the key within [low, high]
+  uint firstGreater = low;
+  uint keysLeft = high - low + 1;
+  while (keysLeft > 0) {
+    uint halfOfKeysLeft = keysLeft / 2;
+    ++keysProbed;
+    if (sortedKeys[firstGreater + halfOfKeysLeft] <= key) {
+      firstGreater += halfOfKeysLeft + 1;
+      keysLeft -= halfOfKeysLeft + 1;
+    } else {
+      keysLeft = halfOfKeysLeft;
+    }
+  }
+  return (int) firstGreater - 1;
+}
+
+int LearnedIndex::findPosition(int key, uint& keysProbed) {
+  if (keys.empty()) {
+    return -1;
+  }
+  const LinearSegment* segment = &levels.back()[0];
+  for (uint level = levels.size() - 1; level > 0; --level) {
+    int segmentIdx = findLastNotGreater(levelKeys[level - 1], *segment, key, keysProbed);
+    if (segmentIdx < 0) {
+      return -1; // smaller than the first key
+    }
+    segment = &levels[level - 1][segmentIdx];
+  }
+  return findLastNotGreater(keys, *segment, key, keysProbed);
+}
+
+void LearnedIndex::clear() {
+  for (auto overflowBlock: overflowBlocks) {
+    while (overflowBlock != nullptr) {
+      OverflowBlock* nextOverflowBlock = overflowBlock->next;
+      delete overflowBlock;
+      overflowBlock = nextOverflowBlock;
+    }
+  }
+  keys.clear();
+  overflowBlocks.clear();
+  levels.clear();
+  levelKeys.clear();
+}
+
+void LearnedIndex::build(Storage* disk) {
+  clear();
+  vector<pair<int, Block*>> keysAndBlocks;
+  for (auto blockPtr: disk->__blocks) {
+    for (auto& record: blockPtr->__records) {
+      keysAndBlocks.push_back(make_pair(record.__numVotes, blockPtr));
+    }
+  }
+  // stable so the blocks of a key are chained in the order they are stored
+  stable_sort(keysAndBlocks.begin(), keysAndBlocks.end(),
+              [](const pair<int, Block*>& a, const pair<int, Block*>& b) { return a.first < b.first; });
+
+  OverflowBlock* lastOverflowBlock = nullptr;
+  for (auto& keyAndBlock: keysAndBlocks) {
+    if (keys.empty() || keys.back() != keyAndBlock.first) {
+      lastOverflowBlock = new OverflowBlock();
+      keys.push_back(keyAndBlock.first);
+      overflowBlocks.push_back(lastOverflowBlock);
+    } else if ((*lastOverflowBlock).blockPtrs.size() >= maxAllowableBlkPtrsInOverflowBlock) {
+      (*lastOverflowBlock).next = new OverflowBlock();
+      lastOverflowBlock = (*lastOverflowBlock).next;
+    }
+    // one pointer per record, as in the B+ Tree
+    (*lastOverflowBlock).blockPtrs.push_back(keyAndBlock.second);
+  }
+  // read-only from here on, so the spare capacity left by growing the vectors is given back
+  keys.shrink_to_fit();
+  overflowBlocks.shrink_to_fit();
+  if (keys.empty()) {
+    return;
+  }
+
+  // fit levels until a single segment covers the level below
+  levels.push_back(fitSegments(keys));
+  while (true) {
+    vector<int> firstKeys;
+    for (auto& segment: levels.back()) {
+      firstKeys.push_back(segment.firstKey);
+    }
+    levelKeys.push_back(firstKeys);
+    if (levels.back().size() == 1) {
+      break;
+    }
+    levels.push_back(fitSegments(levelKeys.back()));
+  }
+}
+
+OverflowBlock* LearnedIndex::searchQuery(int key) {
+  if (keys.empty()) {
+    cout << "No indexes in the learned index. Try building it from some records first!" << endl;
+    return nullptr;
+  }
+  uint keysProbed = 0;
+  int position = findPosition(key, keysProbed);
+  cout << "Model levels accessed: " << levels.size() << ", keys probed: " << keysProbed << endl;
+  if (position >= 0 && keys[position] == key) {
+    return overflowBlocks[position];
+  }
+  cout << "No records contain the search key." << endl;
+  return nullptr;
+}
+
+OverflowBlock* LearnedIndex::getOverflowBlockOfKey(int key) {
+  uint keysProbed = 0;
+  int position = findPosition(key, keysProbed);
+  return position >= 0 && keys[position] == key ? overflowBlocks[position] : nullptr;
+}
+
+vector<pair<int, OverflowBlock*>> LearnedIndex::rangeQuery(int startKey, int endKey) {
+  if (keys.empty()) {
+    cout << "No indexes in the learned index. Try building it from some records first!" << endl;
+    return {};
+  } else if (endKey == startKey) {
+    cout << "This is not a range query but a search query." << endl;
+    return {};
+  } else if (endKey < startKey) {
+    cout << "Cannot search invalid range. Try again, start should be less than end" << endl;
+    return {};
+  }
+  vector<pair<int, OverflowBlock*>> keyAndOverflowBlkPair;
+  uint keysProbed = 0;
+  int position = findPosition(startKey, keysProbed);
+  uint keyIdx = position >= 0 && keys[position] == startKey ? position : position + 1;
+  for (; keyIdx < keys.size() && keys[keyIdx] <= endKey; ++keyIdx) {
+    keyAndOverflowBlkPair.push_back(make_pair(keys[keyIdx], overflowBlocks[keyIdx]));
+  }
+  cout << "Model levels accessed: " << levels.size() << ", keys probed: " << keysProbed << ", keys scanned: "
+       << keyAndOverflowBlkPair.size() << endl;
+  return keyAndOverflowBlkPair;
+}
+
+vector<pair<int, OverflowBlock*>> LearnedIndex::getOverflowBlocksOfRange(int startKey, int endKey) {
+  vector<pair<int, OverflowBlock*>> keyAndOverflowBlkPair;
+  if (keys.empty() || endKey < startKey) {
+    return keyAndOverflowBlkPair;
+  }
+  uint keysProbed = 0;
+  int position = findPosition(startKey, keysProbed);
+  // the position found holds the start key or the last key before it
+  uint keyIdx = position >= 0 && keys[position] == startKey ? position : position + 1;
+  for (; keyIdx < keys.size() && keys[keyIdx] <= endKey; ++keyIdx) {
+    keyAndOverflowBlkPair.push_back(make_pair(keys[keyIdx], overflowBlocks[keyIdx]));
+  }
+  return keyAndOverflowBlkPair;
+}
+
+uint LearnedIndex::getNumberOfKeys() {
+  return keys.size();
+}
+
+vector<uint> LearnedIndex::getSegmentsPerLevel() {
+  vector<uint> segmentsPerLevel;
+  for (auto& level: levels) {
+    segmentsPerLevel.push_back(level.size());
+  }
+  return segmentsPerLevel;
+}
+
+ull LearnedIndex::getIndexSizeInBytes() {
+  ull sizeInBytes = sizeof(LearnedIndex) + keys.capacity() * sizeof(int) + overflowBlocks.capacity() * sizeof(OverflowBlock*);
+  for (uint level = 0; level < levels.size(); ++level) {
+    sizeInBytes += levels[level].capacity() * sizeof(LinearSegment) + levelKeys[level].capacity() * sizeof(int);
+  }
+  return sizeInBytes;
+}
+
+ull LearnedIndex::getOverflowBlocksSizeInBytes() {
+  ull sizeInBytes = 0;
+  for (auto overflowBlock: overflowBlocks) {
+    for (; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+      sizeInBytes += sizeof(OverflowBlock) + (*overflowBlock).blockPtrs.capacity() * sizeof(Block*)
+                     + (*overflowBlock).includedColumns.capacity() * sizeof(IncludedColumns);
+    }
+  }
+  return sizeInBytes;
+}
+
+LearnedIndex::~LearnedIndex() {
+  clear();
+}
@@ -0,0 +1,172 @@
+#ifndef H_LEARNEDINDEX
+#define H_LEARNEDINDEX
+
+#include <utility>
+#include <vector>
+
+#include "block.h"
+#include "overflowblock.h"
+#include "storage.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief A line predicting the position of every key from its first key up to the first key of the
+ * next segment, off by at most the error of the index.
+ * 
+ */
+struct LinearSegment {
+  public:
+    int firstKey; // smallest key the segment covers
+    uint firstPosition; // position of firstKey
+    uint lastPosition; // position of the largest key the segment covers
+    double slope; // positions per unit of key, never negative
+};
+
+/**
+ * @brief A read-only learned index on numVotes in the style of the PGM-index. The distinct keys are
+ * stored in order, like the leaves of a B+ Tree packed end to end, and a stack of piecewise linear
+ * models maps a key straight to its position: the bottom level is fitted over the keys, every level
+ * above over the first keys of the segments below, up to a single segment. Every prediction is off by
+ * at most maxError positions, so each level costs one short binary search. Built from the records of
+ * a storage, and rebuilt to see any change made to the records afterwards.
+ * 
+ */
+class LearnedIndex {
+  private:
+    uint maxError; // largest distance between a predicted position and the actual one
+    uint maxAllowableBlkPtrsInOverflowBlock; // block pointers per overflow block, as in the B+ Tree
+    vector<int> keys; // distinct numVotes in ascending order
+    vector<OverflowBlock*> overflowBlocks; // overflow chain of each key, parallel to keys
+    vector<vector<LinearSegment>> levels; // levels[0] is fitted over keys, every level over the first keys of the one below, the last is a single segment
+    vector<vector<int>> levelKeys; // first keys of the segments of every level, parallel to levels
+
+    /**
+     * @brief Fits the fewest segments a single pass can find over sorted keys, shrinking the range of
+     * slopes that keeps every key within maxError of its position until the next key does not fit.
+     * 
+     * @param sortedKeys Distinct keys in ascending order.
+     * @return vector<LinearSegment> The segments, ordered by their first key.
+     */
+    vector<LinearSegment> fitSegments(const vector<int>& sortedKeys);
+
+    /**
+     * @brief Finds the position of the last key not greater than a key, among the positions a segment
+     * predicts for it.
+     * 
+     * @param sortedKeys The keys the segment was fitted over.
+     * @param segment The segment covering the key.
+     * @param key The key to look up.
+     * @param keysProbed Incremented by the keys compared.
+     * @return int The position, -1 if every key covered is greater.
+     */
+    int findLastNotGreater(const vector<int>& sortedKeys, const LinearSegment& segment, int key, uint& keysProbed);
+
+    /**
+     * @brief Descends the levels of segments to the position of the last key not greater than a key.
+     * 
+     * @param key The key to look up.
+     * @param keysProbed Incremented by the keys compared.
+     * @return int The position in keys, -1 if the key is smaller than every key or the index is empty.
+     */
+    int findPosition(int key, uint& keysProbed);
+
+    /**
+     * @brief Frees the overflow chains and empties the index.
+     * 
+     */
+    void clear();
+
+  public:
+    /**
+     * @brief Construct an empty Learned Index object.
+     * 
+     * @param maxError Largest distance in positions between where a key is predicted and where it is.
+     * @param maxAllowableBlkPtrsInOverflowBlock Block pointers per overflow block.
+     */
+    LearnedIndex(uint maxError, uint maxAllowableBlkPtrsInOverflowBlock);
+
+    LearnedIndex(const LearnedIndex&) = delete;
+    LearnedIndex& operator=(const LearnedIndex&) = delete;
+
+    /**
+     * @brief Indexes every record of a storage by numVotes and fits the models, replacing what was indexed before.
+     * 
+     * @param disk The storage to index.
+     */
+    void build(Storage* disk);
+
+    /**
+     * @brief Search for all records that have numVotes equal to the key specified.
+     * 
+     * @param key The key to search for which equals numVotes.
+     * @return OverflowBlock* The overflow block which contains the pointers to all the records matching the key.
+     */
+    OverflowBlock* searchQuery(int key);
+
+    /**
+     * @brief Get the overflow block of a key without printing the model accesses.
+     * 
+     * @param key The key to look up.
+     * @return OverflowBlock* The overflow block of the key, nullptr if the key is not indexed.
+     */
+    OverflowBlock* getOverflowBlockOfKey(int key);
+
+    /**
+     * @brief Search for all records that have numVotes within the range specified(inclusively).
+     * 
+     * @param startKey The starting range (inclusive) of the search.
+     * @param endKey The ending range (inclusive) of the search.
+     * @return vector<pair<int, OverflowBlock*>> Every key in range with its overflow block.
+     */
+    vector<pair<int, OverflowBlock*>> rangeQuery(int startKey, int endKey);
+
+    /**
+     * @brief Get the overflow blocks of every key within the range specified(inclusively) without printing the model accesses.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @return vector<pair<int, OverflowBlock*>> Every key in range with its overflow block.
+     */
+    vector<pair<int, OverflowBlock*>> getOverflowBlocksOfRange(int startKey, int endKey);
+
+    /**
+     * @brief Get the number of distinct keys indexed.
+     * 
+     * @return uint The number of keys.
+     */
+    uint getNumberOfKeys();
+
+    /**
+     * @brief Get the number of segments of every level, the bottom level first.
+     * 
+     * @return vector<uint> Segments per level.
+     */
+    vector<uint> getSegmentsPerLevel();
+
+    /**
+     * @brief Get the memory taken by the keys, their pointers and the models, the part of the index a
+     * B+ Tree keeps in its nodes.
+     * 
+     * @return ull The bytes taken, including the spare capacity of the vectors.
+     */
+    ull getIndexSizeInBytes();
+
+    /**
+     * @brief Get the memory taken by the overflow blocks of the keys.
+     * 
+     * @return ull The bytes taken, including the spare capacity of the vectors.
+     */
+    ull getOverflowBlocksSizeInBytes();
+
+    /**
+     * @brief Destroy the Learned Index object and free its overflow chains.
+     * 
+     */
+    ~LearnedIndex();
+};
+
+#endif
@@ -5,6 +5,11 @@
 #include <sstream>
 #include <cmath>
 #include <cstring>
+#include <cfloat>
+#include <set>
+#include <map>
+#include <climits>
+#include <stdexcept>
 
 #include "record.h"
 #include "storage.h"
@@ -12,46 +17,213 @@
 #include "bplustree.h"
 #include "constants.h"
 #include "overflowblock.h"
+#include "benchmark.h"
+#include "instrumentation.h"
+#include "blocklayout.h"
+#include "config.h"
+#include "queryrunner.h"
+#include "threadpool.h"
+#include "epoch.h"
+#include "queryplanner.h"
 
 using namespace std;
 
 typedef unsigned int uint;
 
 // function declarations
-uint getMaxBlkPtrsInOverflowBlock(uint blockSize);
-uint calulateMaximumKeysInBPTreeNode(uint blockSize);
-uint getMaxAllowableRecordsInBlock(uint blockSize);
-void printExperiment1Results(Storage *disk, uint blockSize, BPlusTree *bPlusTree);
-void printExperiment2Results(BPlusTree *bPlusTree);
-void printExperiment3Results(BPlusTree *BPlusTree);
-void printExperiment4Results(BPlusTree *BPlusTree);
-void printExperiment5Results(BPlusTree *BPlusTree);
+void printExperiment1Results(Storage *disk, uint blockSize, NumVotesIndex *bPlusTree);
+void printExperiment2Results(NumVotesIndex *bPlusTree);
+void printExperiment3Results(NumVotesIndex *BPlusTree);
+void printExperiment4Results(Storage *disk, NumVotesIndex *BPlusTree, QueryPlanner *queryPlanner);
+void printExperiment5Results(Storage *disk, NumVotesIndex *BPlusTree);
+void printIndexOnlyAggregationResults(NumVotesIndex *bPlusTree, VotesRatingIndex *votesRatingIndex);
 bool canPrintBlock(uint dataBlocksPrintedCount);
 double calculateAvgRating(double totalRating, uint totalRecords);
 pair<double, uint> getSearchQueryTotalRatingsAndRecords(OverflowBlock* overflowBlock, int key);
 pair<double, uint> getRangeQueryTotalRatingsAndRecords(vector<pair<int, OverflowBlock*>>& recordBlockPtrsArray);
+pair<double, uint> getScanTotalRatingsAndRecords(Storage *disk, int startKey, int endKey);
+pair<double, uint> getPlannedRangeTotalRatingsAndRecords(Storage *disk, NumVotesIndex *bPlusTree, QueryPlanner *queryPlanner, int startKey, int endKey);
+void writeStatisticsJson(const string& filePath, Storage *disk, uint blockSize, NumVotesIndex *bPlusTree, AvgRatingIndex *avgRatingIndex,
+                         MovieIdIndex *movieIdIndex, VotesRatingIndex *votesRatingIndex);
+void printInstrumentationResults(const string& traceFilePath);
+bool parsePositiveNumber(const string& text, uint& number);
+bool parseRecord(const string& row, Record& record);
+void loadRecords(ifstream& tsvData, Storage* disk, ThreadPool& scheduler);
 
 // main entry point
-int main()
+// pass --block-size <size> to size blocks and nodes in bytes or kilobytes from 200B to 1MB, e.g. 4096, 16KB or 64KB, instead of the menu
+// pass --config <file> to read settings from a config file, one name = value per line with # starting a comment,
+//   e.g. block_size = 16KB or data_path = <file>, flags on the command line win
+// pass --data <file> to read the records from another tsv file than ./data/data.tsv, or set data_path in the config file
+// pass --queries <file> to run a file of queries instead of the experiments, needs a block size. One query per line,
+//   search <numVotes>, range <start> <end> or delete <numVotes>, with # starting a comment
+// pass --results <file> to choose where --queries writes its results as JSON Lines, results.jsonl by default. Every query
+//   writes the records found or deleted, their average rating and its latency, and a summary ends with the p50, p99 and slowest latency
+// pass --cache <KB> to cache the results of hot numVotes searches and ranges in that many kilobytes (at least 1), reported by --queries and --stats.
+//   The least recently used results are evicted first, and inserts and deletes drop the results of the keys they change
+// pass --compress-keys to store the numVotes index with bit-packed keys
+// pass --compress-blocks to pack the records of the data blocks, so every block holds more records
+// pass --leaf-filters to keep a Bloom filter of the keys of every leaf of the numVotes index, for lookups of absent keys,
+//   10 bits per key and rebuilt whenever the keys of a leaf change
+// pass --benchmark-inserts to compare insert throughput of the buffered tree instead of running the experiments
+// pass --benchmark-deletes to compare purging titles with few votes key by key against a range delete, and lazy deletes
+// pass --benchmark-node-sizes to sweep node sizes from 256B to 64KB and find the fastest for this hardware
+// pass --benchmark-counters to count cache misses, dTLB misses and branch misses per operation with 200B and 500B nodes,
+//   only timed where perf_event_paranoid or a virtual machine hides the hardware counters
+// pass --benchmark-parallel-scan to time avgRating aggregations over wide numVotes ranges split across thread pools
+// pass --benchmark-learned-index to compare the memory and lookup latency of learned indexes on numVotes against the B+ Tree
+// pass --benchmark-frozen-levels to time lookups through the internal levels of the numVotes index frozen into one array against its nodes
+// pass --benchmark-snapshots to check scans of a snapshot of a covering numVotes index stay the same while another thread writes to it
+// pass --benchmark-shards to load, scan and look up numVotes sharded over 1 to 16 storages and indexes from several threads
+// pass --benchmark-zone-maps to time full scans on numVotes and avgRating skipping blocks by their zone maps, with and without compression
+// pass --benchmark-leaf-filters to time lookups of present and absent numVotes with Bloom filters of 4 to 16 bits per key on the leaves
+// pass --benchmark-predicate-scan to time predicates on numVotes, avgRating and tConst scanned in vectorized batches against the index
+// pass --benchmark-access-paths to print the plans of numVotes ranges choosing between the index and a scan, and time both
+// pass --freeze to freeze the internal levels of the numVotes index after loading, for read-only serving with --queries,
+//   lookups go through the nodes again once the index changes
+// pass --threads <n> to set the threads of the scheduler and cap those --benchmark-parallel-scan times, at least 1, one per hardware thread by default
+// pass --stats <file> to write the statistics of the data blocks and every index as JSON instead of running the experiments,
+//   with the nodes and blocks retired, reclaimed and still pending under reclamation
+// pass --trace <file> to write the tree operations run after loading as a Chrome trace for chrome://tracing or Perfetto,
+//   needs a build with -DBPLUSTREE_INSTRUMENTATION, which also prints the p50, p99 and p999 latency of every tree operation
+int main(int argc, char* argv[])
 {
-  uint BLOCK_SIZE;
-  string userSelection=" ";
-  do {
-  cout << "Select Block Size (Enter 1 or 2): " << NEWLINE << "1. 200B" << NEWLINE << "2. 500B" << endl;
-  cin >> userSelection;
-  } while (userSelection.compare("2") != 0 && userSelection.compare("1") != 0);
-  switch (stoi(userSelection)) {
-  case 1:
-    BLOCK_SIZE = 200;
-    break;
-  case 2:
-    BLOCK_SIZE = 500;
-    break;
+  bool compressKeys = false;
+  bool compressBlocks = false;
+  bool filterLeaves = false;
+  bool benchmarkInserts = false;
+  bool benchmarkDeletes = false;
+  bool benchmarkCounters = false;
+  bool benchmarkNodeSizes = false;
+  bool benchmarkParallelScan = false;
+  bool benchmarkLearnedIndex = false;
+  bool benchmarkFrozenLevels = false;
+  bool benchmarkSnapshots = false;
+  bool benchmarkShards = false;
+  bool benchmarkZoneMaps = false;
+  bool benchmarkLeafFilters = false;
+  bool benchmarkPredicateScan = false;
+  bool benchmarkAccessPaths = false;
+  bool freezeIndex = false;
+  uint maxThreads = 0;
+  uint cacheKb = 0;
+  string blockSizeText = "";
+  string configFilePath = "";
+  string dataFilePath = "";
+  string queryFilePath = "";
+  string resultsFilePath = "results.jsonl";
+  string statisticsFilePath = "";
+  string traceFilePath = "";
+  for (int i = 1; i < argc; ++i) {
+    if (string(argv[i]).compare("--compress-keys") == 0) {
+      compressKeys = true;
+    } else if (string(argv[i]).compare("--compress-blocks") == 0) {
+      compressBlocks = true;
+    } else if (string(argv[i]).compare("--leaf-filters") == 0) {
+      filterLeaves = true;
+    } else if (string(argv[i]).compare("--benchmark-inserts") == 0) {
+      benchmarkInserts = true;
+    } else if (string(argv[i]).compare("--benchmark-deletes") == 0) {
+      benchmarkDeletes = true;
+    } else if (string(argv[i]).compare("--benchmark-counters") == 0) {
+      benchmarkCounters = true;
+    } else if (string(argv[i]).compare("--benchmark-node-sizes") == 0) {
+      benchmarkNodeSizes = true;
+    } else if (string(argv[i]).compare("--benchmark-parallel-scan") == 0) {
+      benchmarkParallelScan = true;
+    } else if (string(argv[i]).compare("--benchmark-learned-index") == 0) {
+      benchmarkLearnedIndex = true;
+    } else if (string(argv[i]).compare("--benchmark-frozen-levels") == 0) {
+      benchmarkFrozenLevels = true;
+    } else if (string(argv[i]).compare("--benchmark-snapshots") == 0) {
+      benchmarkSnapshots = true;
+    } else if (string(argv[i]).compare("--benchmark-shards") == 0) {
+      benchmarkShards = true;
+    } else if (string(argv[i]).compare("--benchmark-zone-maps") == 0) {
+      benchmarkZoneMaps = true;
+    } else if (string(argv[i]).compare("--benchmark-leaf-filters") == 0) {
+      benchmarkLeafFilters = true;
+    } else if (string(argv[i]).compare("--benchmark-predicate-scan") == 0) {
+      benchmarkPredicateScan = true;
+    } else if (string(argv[i]).compare("--benchmark-access-paths") == 0) {
+      benchmarkAccessPaths = true;
+    } else if (string(argv[i]).compare("--freeze") == 0) {
+      freezeIndex = true;
+    } else if (string(argv[i]).compare("--threads") == 0 && i + 1 < argc) {
+      if (!parsePositiveNumber(argv[++i], maxThreads)) {
+        cout << "Invalid --threads " << argv[i] << ", usage: --threads <n> with n a whole number of at least 1." << endl;
+        return 1;
+      }
+    } else if (string(argv[i]).compare("--block-size") == 0 && i + 1 < argc) {
+      blockSizeText = argv[++i];
+    } else if (string(argv[i]).compare("--config") == 0 && i + 1 < argc) {
+      configFilePath = argv[++i];
+    } else if (string(argv[i]).compare("--data") == 0 && i + 1 < argc) {
+      dataFilePath = argv[++i];
+    } else if (string(argv[i]).compare("--queries") == 0 && i + 1 < argc) {
+      queryFilePath = argv[++i];
+    } else if (string(argv[i]).compare("--results") == 0 && i + 1 < argc) {
+      resultsFilePath = argv[++i];
+    } else if (string(argv[i]).compare("--cache") == 0 && i + 1 < argc) {
+      if (!parsePositiveNumber(argv[++i], cacheKb)) {
+        cout << "Invalid --cache " << argv[i] << ", usage: --cache <KB> with KB a whole number of at least 1." << endl;
+        return 1;
+      }
+    } else if (string(argv[i]).compare("--stats") == 0 && i + 1 < argc) {
+      statisticsFilePath = argv[++i];
+    } else if (string(argv[i]).compare("--trace") == 0 && i + 1 < argc) {
+      traceFilePath = argv[++i];
+    }
   }
-  cout << "Your selected block size is: " << BLOCK_SIZE << "B" << endl;
 
-  // Allocate a fraction of main memory for disk storage
-  Storage disk;
+  uint BLOCK_SIZE = 0;
+  string configDataFilePath = FILEPATH;
+  if (!configFilePath.empty()) {
+    map<string, string> settings = readConfigFile(configFilePath);
+    for (auto& setting: settings) {
+      if (setting.first.compare("block_size") == 0) {
+        BLOCK_SIZE = parseBlockSize(setting.second);
+      } else if (setting.first.compare("data_path") == 0) {
+        configDataFilePath = setting.second;
+      } else {
+        cout << "Ignoring unknown setting " << setting.first << " in " << configFilePath << endl;
+      }
+    }
+  }
+  if (!blockSizeText.empty()) {
+    BLOCK_SIZE = parseBlockSize(blockSizeText);
+  }
+  if (dataFilePath.empty()) {
+    dataFilePath = configDataFilePath;
+  }
+
+  // queries run unattended, so read them before loading and never wait on the menu
+  vector<Query> queries;
+  if (!queryFilePath.empty()) {
+    if (BLOCK_SIZE == 0) {
+      cout << "--queries needs a block size, pass --block-size or set block_size in the config file." << endl;
+      return 1;
+    }
+    queries = readQueryFile(queryFilePath);
+  }
+
+  // without a size from the command line or the config file, ask for one of the sizes of the experiments
+  if (BLOCK_SIZE == 0) {
+    string userSelection=" ";
+    do {
+    cout << "Select Block Size (Enter 1 or 2): " << NEWLINE << "1. 200B" << NEWLINE << "2. 500B" << endl;
+    cin >> userSelection;
+    } while (userSelection.compare("2") != 0 && userSelection.compare("1") != 0);
+    switch (stoi(userSelection)) {
+    case 1:
+      BLOCK_SIZE = 200;
+      break;
+    case 2:
+      BLOCK_SIZE = 500;
+      break;
+    }
+  }
+  cout << "Your selected block size is: " << BLOCK_SIZE << "B" << endl;
 
   uint maxAllowableRecordsInBlock =  getMaxAllowableRecordsInBlock(BLOCK_SIZE);
   uint maxAllowableKeysInBlock = calulateMaximumKeysInBPTreeNode(BLOCK_SIZE);
@@ -59,149 +231,160 @@ int main()
   cout << "Total keys: " << maxAllowableKeysInBlock << endl;
   cout << "Max overflow block ptrs: " << maxAllowableBlkPtrsInOverflowBlock << endl;
 
+  // runs the work split across threads, declared before the storage and indexes so it outlives them
+  ThreadPool scheduler(maxThreads);
 
-  Block* firstBlockPtr = new Block(maxAllowableRecordsInBlock); //pointer to block
-  disk.addBlockToStorage(firstBlockPtr);
-  uint indexOfLastBlockInStorage = disk.getNumberOfBlocksInStorage() - 1;
-  
-  BPlusTree bPlusTree(maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock);
+  // results of hot numVotes keys, declared before the index so it outlives it
+  NumVotesQueryCache queryCache((ull) cacheKb * KB);
+
+  // Allocate a fraction of main memory for disk storage
+  Storage disk(BLOCK_SIZE, DISK_CAPACITY, maxAllowableRecordsInBlock);
+
+  // primary index on numVotes, secondary indexes on avgRating and the unique tConst
+  NumVotesIndex bPlusTree(maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock);
+  AvgRatingIndex avgRatingIndex(calulateMaximumKeysInBPTreeNode(BLOCK_SIZE, sizeof(float), alignof(float)), maxAllowableBlkPtrsInOverflowBlock);
+  MovieIdIndex movieIdIndex(calulateMaximumKeysInBPTreeNode(BLOCK_SIZE, sizeof(MovieIdKey), alignof(MovieIdKey)), maxAllowableBlkPtrsInOverflowBlock, true);
+  // composite index whose key carries avgRating, so rating aggregations over numVotes never read the data blocks
+  VotesRatingIndex votesRatingIndex(calulateMaximumKeysInBPTreeNode(BLOCK_SIZE, sizeof(VotesRatingKey), alignof(VotesRatingKey)), maxAllowableBlkPtrsInOverflowBlock);
+  if (compressKeys) {
+    bPlusTree.enableKeyCompression(BLOCK_SIZE);
+    cout << "Key compression enabled, up to " << bPlusTree.getMaxKeys() << " keys per node." << endl;
+  }
+  if (compressBlocks) {
+    disk.enableBlockCompression();
+    cout << "Block compression enabled, blocks hold as many records as fit packed." << endl;
+  }
+  if (filterLeaves) {
+    bPlusTree.enableLeafFilters();
+    cout << "Leaf filters enabled, " << LEAF_FILTER_BITS_PER_KEY << " bits per key." << endl;
+  }
+  disk.attachNumVotesIndex(&bPlusTree);
+  disk.attachAvgRatingIndex(&avgRatingIndex);
+  disk.attachMovieIdIndex(&movieIdIndex);
+  disk.attachVotesRatingIndex(&votesRatingIndex);
 
-  cout << COUT_LINE_DELIMITER << NEWLINE << "READING IN DATA FROM FILE: data.tsv" << NEWLINE << "Please wait..." << endl;
-  ifstream tsvData(FILEPATH); //read data
+  cout << COUT_LINE_DELIMITER << NEWLINE << "READING IN DATA FROM FILE: " << dataFilePath << NEWLINE << "Please wait..." << endl;
+  ifstream tsvData(dataFilePath); //read data
   
 
   if (tsvData.is_open())
   {
-    string row;
-    
-    // remove the row of column headers.
-    getline(tsvData,row);
-
-    while (getline(tsvData, row))
-    {
-      Record record;
-      stringstream linestream(row); //linestream is an object of stringstream that references the string of each row 
-      string data; // column data of each record
-
-      // store movie id in record struct
-      getline(linestream, data, ROW_DELIMITER);
-      strcpy(record.__movieId, data.c_str());
-
-      // store average rating in record struct
-      getline(linestream, data, ROW_DELIMITER);
-      record.__avgRating = stof(data);
-
-      // store number of votes in record struct
-      getline(linestream, data, ROW_DELIMITER);
-      record.__numVotes = stoi(data);
-
-      //insert record into database
-      Block* blockPtrOfRecord;
-      if (!(*disk.__blocks[indexOfLastBlockInStorage]).hasSpaceInBlock()) {
-        //check if storage has space else just throw exception
-        if (!disk.hasStorageSpace(BLOCK_SIZE, DISK_CAPACITY)) {
-          cout << "No space please increase disk capacity" << endl;
-          throw "No space in disk.";
-        }
-        blockPtrOfRecord = new Block(maxAllowableRecordsInBlock);
-        disk.addBlockToStorage(blockPtrOfRecord);
-        ++indexOfLastBlockInStorage;
-        (*disk.__blocks[indexOfLastBlockInStorage]).addRecordToBlock(record);
-      } else {
-        (*disk.__blocks[indexOfLastBlockInStorage]).addRecordToBlock(record);
-        blockPtrOfRecord = disk.__blocks[indexOfLastBlockInStorage];
-      }
-
-      bPlusTree.insertKey(record.__numVotes, blockPtrOfRecord);
-    }
+    loadRecords(tsvData, &disk, scheduler);
     tsvData.close();
+  } else {
+    cout << "Unable to open data file " << dataFilePath << endl;
+  }
+  // attached once the records are loaded, as loading caches nothing but would pay for invalidating every key
+  if (cacheKb > 0) {
+    bPlusTree.attachQueryCache(&queryCache);
+  }
+  if (freezeIndex) {
+    bPlusTree.freezeInternalLevels();
+    FrozenLevels<int>* frozenLevels = bPlusTree.getFrozenLevels();
+    cout << "Froze " << frozenLevels->getNumberOfLevels() << " internal levels of the numVotes index into "
+         << frozenLevels->getSizeInBytes() << "B, lookups use them until the index changes" << endl;
+  }
+
+  // chooses between the numVotes index and a scan of storage for ranges of numVotes, its histogram is built on the first range
+  QueryPlanner queryPlanner(&disk, &bPlusTree);
+
+  // loading inserts every record into 4 indexes, too many calls to trace, so only what runs afterwards is traced
+  if (!traceFilePath.empty() && isInstrumentationCompiled()) {
+    startTraceRecording();
+  }
+
+  if (!queryFilePath.empty()) {
+    runQueries(&disk, &bPlusTree, queries, resultsFilePath);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkInserts) {
+    runInsertThroughputBenchmark(&disk, BLOCK_SIZE, maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkDeletes) {
+    runPurgeBenchmark(&disk, BLOCK_SIZE, maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock, maxAllowableRecordsInBlock, 1000);
+    runDeleteLatencyBenchmark(&disk, BLOCK_SIZE, maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock, maxAllowableRecordsInBlock, 1000);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkNodeSizes) {
+    runNodeSizeSweepBenchmark(&disk);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkParallelScan) {
+    runParallelRangeScanBenchmark(&disk, &bPlusTree, maxThreads);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkLearnedIndex) {
+    runLearnedIndexBenchmark(&disk, &bPlusTree, BLOCK_SIZE, maxAllowableBlkPtrsInOverflowBlock);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkFrozenLevels) {
+    runFrozenLevelsBenchmark(&disk, &bPlusTree, BLOCK_SIZE);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkSnapshots) {
+    runSnapshotScanBenchmark(&disk, maxAllowableKeysInBlock, maxAllowableBlkPtrsInOverflowBlock);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkShards) {
+    runShardedIndexBenchmark(&disk, &bPlusTree, BLOCK_SIZE, maxAllowableRecordsInBlock, maxAllowableKeysInBlock,
+                             maxAllowableBlkPtrsInOverflowBlock, maxThreads);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkZoneMaps) {
+    runZoneMapScanBenchmark(&disk, BLOCK_SIZE, maxAllowableRecordsInBlock);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkLeafFilters) {
+    runLeafFilterBenchmark(&disk, &bPlusTree, BLOCK_SIZE);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkPredicateScan) {
+    runPredicateScanBenchmark(&disk, &bPlusTree, maxThreads);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkAccessPaths) {
+    runAccessPathBenchmark(&disk, &bPlusTree);
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (benchmarkCounters) {
+    // both node sizes index the same records, whichever block size they were stored with
+    runHardwareCounterBenchmark(&disk, 200, calulateMaximumKeysInBPTreeNode(200), getMaxBlkPtrsInOverflowBlock(200));
+    runHardwareCounterBenchmark(&disk, 500, calulateMaximumKeysInBPTreeNode(500), getMaxBlkPtrsInOverflowBlock(500));
+    printInstrumentationResults(traceFilePath);
+    return 0;
+  }
+  if (!statisticsFilePath.empty()) {
+    writeStatisticsJson(statisticsFilePath, &disk, BLOCK_SIZE, &bPlusTree, &avgRatingIndex, &movieIdIndex, &votesRatingIndex);
+    return 0;
   }
 
   printExperiment1Results(&disk, BLOCK_SIZE, &bPlusTree);
   printExperiment2Results(&bPlusTree);
   printExperiment3Results(&bPlusTree);
-  printExperiment4Results(&bPlusTree);
-  printExperiment5Results(&bPlusTree);
+  printExperiment4Results(&disk, &bPlusTree, &queryPlanner);
+  printIndexOnlyAggregationResults(&bPlusTree, &votesRatingIndex);
+  printExperiment5Results(&disk, &bPlusTree);
+  printInstrumentationResults(traceFilePath);
 
   system("pause");
 }
 
-/**
- * @brief Get the Max Blk Ptrs In Overflow Block object.
- * 
- * @param blockSize User specified blocksize.
- * @return uint Maximum allowable block pointers in an overflow block.
- */
-uint getMaxBlkPtrsInOverflowBlock(uint blockSize) {
-  // blocksize minus 1 next pointer, the remaining space will be for blkPtrs
-  float numberOfBlocksInDecimal = float((float) (blockSize - float(sizeof(void *))) / float(sizeof(void *)));
-  uint maxBlkPtrs = floor(numberOfBlocksInDecimal);
-  return maxBlkPtrs;
-}
-
-/**
- * @brief Get the Max Allowable Records In Block object.
- * 
- * @param blockSize User specified block size.
- * @return uint Maximum allowable records in a block.
- */
-uint getMaxAllowableRecordsInBlock(uint blockSize) {
-  uint recordSize = sizeof(Record);
-  uint maxAllowableRecords = floor(blockSize/recordSize);
-  return maxAllowableRecords;
-}
-
-/**
- * @brief Calculate the maximum keys (N) in a tree node.
- * 
- * @param blockSize Block size specified by the user.
- * @return uint Parameter N
- */
-uint calulateMaximumKeysInBPTreeNode(uint blockSize) {
-
-  // our largest data type in a tree node is the pointer which = 8 bytes.
-  // other data include a boolean isLeaf and array of integer(4 bytes)
-
-  // sizeOfPointer(N+1) + sizeOfInt(N) + sizeOfBool + PADDING(3 if N is odd, 7 if N is even) <= blockSize
-  // 8(N+1) + 4(N) + 1 + 7 <= blockSize (worst case is add 7 padding)
-
-  //blocksize minus size of extra pointer, bool and padding
-  uint lowerN = floor((float) float(blockSize - SIZE_OF_POINTER - sizeof(bool) - BOOLEAN_PADDING) / 12);
-  uint upperN = ceil((float) float(blockSize - SIZE_OF_POINTER - sizeof(bool) - BOOLEAN_PADDING) / 12);
-
-  // we try to pack as many keys as possible so we see if upperN can be used
-  if ((upperN % 2) == 0) {
-    //upperN is even
-    uint totalSize = SIZE_OF_POINTER * (upperN + 1) + 4 * upperN + 1 + 7;
-    if (totalSize <= blockSize) {
-      return upperN;
-    } 
-  } else if ((lowerN % 1) == 0) {
-    //upperN is odd
-    uint totalSize = SIZE_OF_POINTER * (upperN + 1) + 4 * upperN + 1 + 3;
-    if (totalSize <= blockSize) {
-      return upperN;
-    } 
-  }
-  if ((lowerN % 2) == 0) {
-    //lowerN is even
-    uint totalSize = SIZE_OF_POINTER * (lowerN + 1) + 4 * lowerN + 1 + 7;
-    if (totalSize <= blockSize) {
-      return lowerN;
-    } 
-  } else if ((lowerN % 1) == 0) {
-    //lowerN is odd
-    uint totalSize = SIZE_OF_POINTER * (lowerN + 1) + 4 * lowerN + 1 + 3;
-    if (totalSize <= blockSize) {
-      return lowerN;
-    } 
-  }
-  return lowerN; //lowerN will definitely fit
-}
-
-
 // note database size has to include the size of the index + size of relational data
-void printExperiment1Results(Storage *disk, uint blockSize, BPlusTree *bPlusTree) {
+void printExperiment1Results(Storage *disk, uint blockSize, NumVotesIndex *bPlusTree) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "Experiment 1 Results:" << NEWLINE << COUT_LINE_DELIMITER << endl;
   cout << "The number of blocks used is: " << disk->getNumberOfBlocksInStorage() << endl;
   // cout << "The size of relational data (in B) based on blocks is: " << disk->getDatabaseSizeByBlocks(blockSize) << "B" << endl;
@@ -218,7 +401,7 @@ void printExperiment1Results(Storage *disk, uint blockSize, BPlusTree *bPlusTree
   cout << double(disk->getDatabaseSizeByBlocks(blockSize) + bPlusTree->getSizeOfBPlusTree(blockSize))/MB << "MB" << endl;
 }
 
-void printExperiment2Results(BPlusTree *bPlusTree) {
+void printExperiment2Results(NumVotesIndex *bPlusTree) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "Experiment 2 Results:" << NEWLINE << COUT_LINE_DELIMITER << endl;
   cout << "The parameter n of the B+ Tree is: " << bPlusTree->getMaxKeys() << endl;
   cout << "The number of nodes in the B+ Tree is: " << bPlusTree->getNumberOfNodesInTree() << endl;
@@ -230,7 +413,7 @@ void printExperiment2Results(BPlusTree *bPlusTree) {
   cout << "The number of overflow blocks used are: " << bPlusTree->getNumberOfOverflowBlocks() << endl;
 }
 
-void printExperiment3Results(BPlusTree *BPlusTree) {
+void printExperiment3Results(NumVotesIndex *BPlusTree) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "Experiment 3 Results: " << endl; 
   cout << "Retrieving movies with numVotes = 500..." << NEWLINE << COUT_LINE_DELIMITER << endl;
 
@@ -241,19 +424,19 @@ void printExperiment3Results(BPlusTree *BPlusTree) {
   cout << "The average of \"averageRating\" of the data queried is: " << averageRating << endl;
 }
 
-void printExperiment4Results(BPlusTree *BPlusTree) {
+void printExperiment4Results(Storage *disk, NumVotesIndex *BPlusTree, QueryPlanner *queryPlanner) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "Experiment 4 Results: " <<endl;
   cout << "Retrieving movies with 30,000 <= numVotes <= 40,000..." << NEWLINE << COUT_LINE_DELIMITER << endl;
-  vector<pair<int, OverflowBlock*>> keyAndBlockPtrPairs = BPlusTree->rangeQuery(30000, 40000);
-  pair<double, uint> totalRatingsAndRecord = getRangeQueryTotalRatingsAndRecords(keyAndBlockPtrPairs);
+  pair<double, uint> totalRatingsAndRecord = getPlannedRangeTotalRatingsAndRecords(disk, BPlusTree, queryPlanner, 30000, 40000);
   double averageRating = calculateAvgRating(totalRatingsAndRecord.first, totalRatingsAndRecord.second);
   cout << "The average of \"averageRating\" of the data queried is: " << averageRating << endl;
 }
 
-void printExperiment5Results(BPlusTree *BPlusTree) {
+void printExperiment5Results(Storage *disk, NumVotesIndex *BPlusTree) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "Experiment 5 Results: " << endl;
   cout << "Deleting movies with numVotes = 1000..." << NEWLINE << COUT_LINE_DELIMITER << endl;
-  uint numberOfTreeNodesDeleted = BPlusTree->deleteRecordByKey(1000);
+  // delete through storage so the avgRating and tConst indexes stay in sync
+  uint numberOfTreeNodesDeleted = disk->deleteRecordsByNumVotes(1000);
   cout << "The number of tree nodes deleted is: " << numberOfTreeNodesDeleted << endl;
   cout << "The number of nodes in the updated B+ Tree is: " << BPlusTree->getNumberOfNodesInTree() << endl;
   cout << "The height of the updated B+ Tree is: " << BPlusTree->getTreeHeight() << endl;
@@ -264,6 +447,24 @@ void printExperiment5Results(BPlusTree *BPlusTree) {
   cout << COUT_LINE_DELIMITER << NEWLINE << "End of experiments!" << NEWLINE << COUT_LINE_DELIMITER << endl;
 }
 
+void printIndexOnlyAggregationResults(NumVotesIndex *bPlusTree, VotesRatingIndex *votesRatingIndex) {
+  cout << COUT_LINE_DELIMITER << NEWLINE << "Index-only aggregation Results: " << endl;
+  cout << "Averaging \"averageRating\" of movies with 30,000 <= numVotes <= 40,000..." << NEWLINE << COUT_LINE_DELIMITER << endl;
+
+  IndexAggregate numVotesAggregate = bPlusTree->rangeQueryAggregate(30000, 40000);
+  cout << "Through the numVotes index, index nodes accessed: " << numVotesAggregate.indexNodesAccessed;
+  cout << ", data blocks accessed: " << numVotesAggregate.dataBlocksAccessed << endl;
+
+  IndexAggregate compositeAggregate = votesRatingIndex->rangeQueryAggregate(
+    VotesRatingKey::lowestWithNumVotes(30000), VotesRatingKey::highestWithNumVotes(40000));
+  cout << "Through the (numVotes, avgRating) index, index nodes accessed: " << compositeAggregate.indexNodesAccessed;
+  cout << ", data blocks accessed: " << compositeAggregate.dataBlocksAccessed << endl;
+
+  cout << "Total Records is: " << compositeAggregate.totalRecords << endl;
+  cout << "The average of \"averageRating\" of the data queried is: ";
+  cout << calculateAvgRating(compositeAggregate.totalRating, compositeAggregate.totalRecords) << endl;
+}
+
 /**
  * @brief Check whether to print a data block. Maximum of 5 data blocks to print if more are accessed.
  * 
@@ -309,10 +510,14 @@ pair<double, uint> getSearchQueryTotalRatingsAndRecords(OverflowBlock* overflowB
   uint totalRecords = 0;
   uint dataBlocksAccessedCounter = 0;
   uint overflowBlocksAccessedCounter = 0;
+  set<Block*> visitedBlocks; // a block holding several records of the key appears once per record
 
   do {
       ++overflowBlocksAccessedCounter;
       for (auto blkptr: overflowBlock->blockPtrs) {
+        if (!visitedBlocks.insert(blkptr).second) {
+          continue; // records of this block were already counted
+        }
         ++dataBlocksAccessedCounter;
         // according to project specification print only first 5 data blocks
         if (canPrintBlock(dataBlocksAccessedCounter)) {
@@ -359,9 +564,13 @@ pair<double, uint> getRangeQueryTotalRatingsAndRecords(vector<pair<int, Overflow
 
   // outer loop through all the different key-overflow block pair
   for (auto &keyBlockPair: recordBlockPtrsArray) {
+    set<Block*> visitedBlocks; // a block holding several records of the key appears once per record
     do {
       ++overflowBlocksAccessedCounter;
       for (auto blkptr: keyBlockPair.second->blockPtrs) {
+        if (!visitedBlocks.insert(blkptr).second) {
+          continue; // records of this block were already counted for this key
+        }
         ++dataBlocksAccessedCounter;
         // according to project specification print only first 5 data blocks
         if (canPrintBlock(dataBlocksAccessedCounter)) {
@@ -390,3 +599,203 @@ pair<double, uint> getRangeQueryTotalRatingsAndRecords(vector<pair<int, Overflow
 
   return totalRatingsAndRecords;
 }
+
+/**
+ * @brief Gets the total rating of the records with numVotes within a range and the number of records by
+ * reading every block of storage, skipping the blocks whose zone map rules the range out.
+ * 
+ * @param disk The storage holding the records.
+ * @param startKey The starting range (inclusive).
+ * @param endKey The ending range (inclusive).
+ * @return pair<double, uint> A pair which is the total rating and the number of records.
+ */
+pair<double, uint> getScanTotalRatingsAndRecords(Storage *disk, int startKey, int endKey) {
+  ScanAggregate aggregate = disk->scanRecords(startKey, endKey, -FLT_MAX, FLT_MAX, true);
+  cout << "Number of data blocks accessed: " << aggregate.dataBlocksAccessed << endl;
+  cout << "Total Average Rating is: " << aggregate.totalRating << endl;
+  cout << "Total Records is: " << aggregate.totalRecords << endl;
+  return make_pair(aggregate.totalRating, aggregate.totalRecords);
+}
+
+/**
+ * @brief Gets the total rating of the records with numVotes within a range and the number of records through
+ * the numVotes index or a scan of storage, whichever the planner expects to read fewer blocks, and prints its plan.
+ * 
+ * @param disk The storage holding the records.
+ * @param bPlusTree The numVotes index of the storage.
+ * @param queryPlanner The planner choosing the access path.
+ * @param startKey The starting range (inclusive).
+ * @param endKey The ending range (inclusive).
+ * @return pair<double, uint> A pair which is the total rating and the number of records.
+ */
+pair<double, uint> getPlannedRangeTotalRatingsAndRecords(Storage *disk, NumVotesIndex *bPlusTree, QueryPlanner *queryPlanner, int startKey, int endKey) {
+  RangePlan rangePlan = queryPlanner->planRange(startKey, endKey);
+  cout << rangePlan.explain();
+  if (rangePlan.accessPath == ACCESS_FULL_SCAN) {
+    return getScanTotalRatingsAndRecords(disk, startKey, endKey);
+  }
+  vector<pair<int, OverflowBlock*>> keyAndBlockPtrPairs = bPlusTree->rangeQuery(startKey, endKey);
+  return getRangeQueryTotalRatingsAndRecords(keyAndBlockPtrPairs);
+}
+
+/**
+ * @brief Writes the space used by the data blocks and the statistics of every index to a JSON file.
+ * 
+ * @param filePath Path of the JSON file, overwritten if it exists.
+ * @param disk The storage holding the data blocks.
+ * @param blockSize User specified block size.
+ * @param bPlusTree The numVotes index.
+ * @param avgRatingIndex The avgRating index.
+ * @param movieIdIndex The tConst index.
+ * @param votesRatingIndex The (numVotes, avgRating) index.
+ */
+void writeStatisticsJson(const string& filePath, Storage *disk, uint blockSize, NumVotesIndex *bPlusTree, AvgRatingIndex *avgRatingIndex,
+                         MovieIdIndex *movieIdIndex, VotesRatingIndex *votesRatingIndex) {
+  ofstream statisticsFile(filePath);
+  if (!statisticsFile.is_open()) {
+    cout << "Cannot open " << filePath << " to write the statistics." << endl;
+    throw "Cannot open the statistics file.";
+  }
+  statisticsFile << "{\"blockSize\":" << blockSize
+                 << ",\"dataBlocks\":" << disk->getBlockSpaceUsage().toJson()
+                 << ",\"indexes\":{\"numVotes\":" << bPlusTree->getStatistics(blockSize).toJson()
+                 << ",\"avgRating\":" << avgRatingIndex->getStatistics(blockSize).toJson()
+                 << ",\"tConst\":" << movieIdIndex->getStatistics(blockSize).toJson()
+                 << ",\"numVotesAvgRating\":" << votesRatingIndex->getStatistics(blockSize).toJson()
+                 << "},\"reclamation\":" << getEpochStatistics().toJson() << "}" << endl;
+  statisticsFile.close();
+  cout << "Statistics written to " << filePath << endl;
+}
+
+/**
+ * @brief Prints the latencies of the tree operations and writes the trace, when the build is instrumented.
+ * 
+ * @param traceFilePath Path of the Chrome trace to write, empty to not write one.
+ */
+void printInstrumentationResults(const string& traceFilePath) {
+  if (!isInstrumentationCompiled()) {
+    if (!traceFilePath.empty()) {
+      cout << "No trace written, build with -DBPLUSTREE_INSTRUMENTATION to time the tree operations." << endl;
+    }
+    return;
+  }
+  cout << COUT_LINE_DELIMITER << endl;
+  printLatencyReport();
+  if (!traceFilePath.empty()) {
+    writeChromeTrace(traceFilePath);
+  }
+}
+
+/**
+ * @brief Parses a count given on the command line.
+ * 
+ * @param text The text of the argument.
+ * @param number Set to the count if the text is valid.
+ * @return true If the text is a whole number from 1 up to the largest uint, without a sign.
+ */
+bool parsePositiveNumber(const string& text, uint& number) {
+  // more than 10 digits is above any uint, and a sign or other character is not a count
+  if (text.empty() || text.size() > 10 || text.find_first_not_of("0123456789") != string::npos) {
+    return false;
+  }
+  unsigned long long value = stoull(text);
+  if (value == 0 || value > UINT_MAX) {
+    return false;
+  }
+  number = value;
+  return true;
+}
+
+/**
+ * @brief Parses a row of the data file into a record. Runs on the parser threads, so it reports a bad
+ * row by its result rather than by printing or throwing.
+ * 
+ * @param row The tConst, averageRating and numVotes of a title, separated by tabs.
+ * @param record Set to the record of the row.
+ * @return true If the row holds a tConst that fits the record, a rating and a number of votes.
+ */
+bool parseRecord(const string& row, Record& record) {
+  // a file written on Windows ends its rows with \r\n
+  stringstream linestream(!row.empty() && row.back() == '\r' ? row.substr(0, row.size() - 1) : row); //linestream is an object of stringstream that references the string of each row 
+  string data; // column data of each record
+  size_t parsedLength = 0;
+
+  // store movie id in record struct, leaving room for its terminating '\0'
+  if (!getline(linestream, data, ROW_DELIMITER) || data.empty() || data.size() >= TCONSTSIZE) {
+    return false;
+  }
+  strcpy(record.__movieId, data.c_str());
+
+  try {
+    // store average rating in record struct
+    if (!getline(linestream, data, ROW_DELIMITER)) {
+      return false;
+    }
+    record.__avgRating = stof(data, &parsedLength);
+    if (parsedLength != data.size()) {
+      return false;
+    }
+
+    // store number of votes in record struct
+    if (!getline(linestream, data, ROW_DELIMITER)) {
+      return false;
+    }
+    record.__numVotes = stoi(data, &parsedLength);
+    return parsedLength == data.size();
+  } catch (const logic_error&) {
+    // stof and stoi throw invalid_argument for text that is not a number, out_of_range for one too large
+    return false;
+  }
+}
+
+/**
+ * @brief Reads the rows of the data file in chunks, parses the rows of a chunk on the scheduler and
+ * inserts them in the order of the file, so the records land in the same blocks as when read row by row.
+ * 
+ * @param tsvData The data file, opened.
+ * @param disk The storage to insert the records into.
+ * @param scheduler The threads to parse the rows on.
+ */
+void loadRecords(ifstream& tsvData, Storage* disk, ThreadPool& scheduler) {
+  const uint rowsPerChunk = 65536;
+  string row;
+  
+  // remove the row of column headers.
+  getline(tsvData,row);
+
+  vector<string> rows;
+  vector<Record> records;
+  vector<char> isRowParsed; // char rather than bool, so the parsers write to bytes of their own
+  uint firstLineOfChunk = 2; // the column headers are line 1
+  while (tsvData.good()) {
+    rows.clear();
+    while (rows.size() < rowsPerChunk && getline(tsvData, row)) {
+      rows.push_back(row);
+    }
+    records.resize(rows.size());
+    isRowParsed.assign(rows.size(), false);
+
+    uint numberOfTasks = min((uint) rows.size(), scheduler.getNumberOfThreads());
+    TaskGroup parsers;
+    for (uint task = 0; task < numberOfTasks; ++task) {
+      scheduler.submit([task, numberOfTasks, &rows, &records, &isRowParsed]() {
+        uint taskEnd = (task + 1) * rows.size() / numberOfTasks;
+        for (uint i = task * rows.size() / numberOfTasks; i < taskEnd; ++i) {
+          isRowParsed[i] = parseRecord(rows[i], records[i]);
+        }
+      }, &parsers);
+    }
+    scheduler.waitForGroup(parsers);
+
+    //insert record into database, the storage keeps all of its indexes in sync. bad rows are reported here, in the order of the file
+    for (uint i = 0; i < rows.size(); ++i) {
+      if (!isRowParsed[i]) {
+        cout << "Skipping line " << firstLineOfChunk + i << " of the data file, expected a tConst of up to " << TCONSTSIZE - 1
+             << " characters, an averageRating and a numVotes separated by tabs: " << rows[i] << endl;
+        continue;
+      }
+      disk->insertRecord(records[i]);
+    }
+    firstLineOfChunk += rows.size();
+  }
+}
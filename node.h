@@ -3,21 +3,51 @@
 
 #include <vector>
 
+#include "block.h"
+#include "indexkey.h"
+#include "keycompression.h"
+#include "leaffilter.h"
+
 using namespace std;
 
 typedef unsigned int uint;
 
+/**
+ * @brief An insert waiting in the buffer of an internal node to be flushed down to its leaf.
+ * 
+ * @tparam KeyType The type of the column the tree is indexing.
+ */
+template <typename KeyType>
+struct BufferedInsert {
+  public:
+    KeyType key; // key of the record
+    Block* blockPtr; // block the record is stored in
+    IncludedColumns includedColumns; // included columns of the record, only kept by a covering index
+
+    /**
+     * @brief Construct a new Buffered Insert object.
+     * 
+     */
+    BufferedInsert(const KeyType& key, Block* blockPtr, const IncludedColumns& includedColumns)
+        : key(key), blockPtr(blockPtr), includedColumns(includedColumns) {}
+};
+
 /**
  * @brief A node inside the B+ Tree.
  * 
+ * @tparam KeyType The type of the column the tree is indexing.
  */
+template <typename KeyType>
 struct Node {
   public:
     vector<void *> ptrs; // stores pointer to pointer of blocks for leaf, stores pointer to child for non-leaf
-    vector<int> keys; // keys in the node
+    vector<KeyType> keys; // keys in the node
     bool isLeaf; // whether the node is a leaf node or internal node
+    PackedKeys packedKeys; // bit-packed image of the keys, only kept up to date when the tree compresses its keys
+    LeafFilter filter; // Bloom filter of the keys of a leaf, only kept up to date when the tree filters its leaves
+    vector<BufferedInsert<KeyType>> buffer; // inserts not yet flushed to the children, only used by internal nodes of a buffered tree
 
-    friend class BPlusTree;
+    template <typename, typename> friend class BPlusTree;
 
     /**
      * @brief Construct a new Node object.
@@ -4,7 +4,7 @@
 #include <vector>
 
 #include "block.h"
-#include "bplustree.h"
+#include "indexkey.h"
 
 /**
  * @brief To deal with duplicate key values, we will use an overflow block to insert the block pointers of these duplicated keys.
@@ -14,6 +14,7 @@ struct OverflowBlock {
   public:
 
     vector<Block*> blockPtrs; // array of pointers to blocks
+    vector<IncludedColumns> includedColumns; // columns of each record, parallel to blockPtrs, only filled by covering indexes
     OverflowBlock *next; // pointer to next overflow block
 
     /**
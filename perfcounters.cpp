@@ -0,0 +1,129 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perfcounters.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+PerfCounters::PerfCounters() {
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    fileDescriptors[counter] = -1;
+  }
+#ifdef __linux__
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1; // user space only, so a perf_event_paranoid of 2 still allows it
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (counter) {
+      case INSTRUCTIONS:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case BRANCH_MISSES:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case LLC_MISSES:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      case DTLB_MISSES:
+        attributes.type = PERF_TYPE_HW_CACHE;
+        attributes.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    }
+    // counters are opened one by one instead of as a group, so one the CPU lacks does not take the others down
+    fileDescriptors[counter] = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fileDescriptors[counter] < 0 && unavailableReason.empty()) {
+      unavailableReason = getCounterName((HardwareCounter) counter) + ": " + strerror(errno);
+    }
+  }
+#else
+  unavailableReason = "perf_event_open is only available on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    if (fileDescriptors[counter] >= 0) {
+      close(fileDescriptors[counter]);
+    }
+  }
+#endif
+}
+
+bool PerfCounters::isAvailable() {
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    if (fileDescriptors[counter] >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+string PerfCounters::getUnavailableReason() {
+  return unavailableReason;
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    if (fileDescriptors[counter] >= 0) {
+      ioctl(fileDescriptors[counter], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fileDescriptors[counter], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+#endif
+}
+
+CounterReadings PerfCounters::stop() {
+  CounterReadings readings;
+#ifdef __linux__
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    if (fileDescriptors[counter] >= 0) {
+      ioctl(fileDescriptors[counter], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+    ull counts[3]; // value, time enabled, time running
+    if (fileDescriptors[counter] < 0 || read(fileDescriptors[counter], counts, sizeof(counts)) != sizeof(counts) || counts[2] == 0) {
+      continue;
+    }
+    // more counters than the CPU has registers are multiplexed, so the count is scaled to the whole time
+    readings.values[counter] = counts[2] < counts[1] ? (ull) ((double) counts[0] * counts[1] / counts[2]) : counts[0];
+    readings.isCounted[counter] = true;
+  }
+#endif
+  return readings;
+}
+
+string PerfCounters::getCounterName(HardwareCounter counter) {
+  switch (counter) {
+    case INSTRUCTIONS:
+      return "instructions";
+    case BRANCH_MISSES:
+      return "branch misses";
+    case LLC_MISSES:
+      return "LLC misses";
+    case DTLB_MISSES:
+      return "dTLB misses";
+    default:
+      return "unknown";
+  }
+}
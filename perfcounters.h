@@ -0,0 +1,107 @@
+#ifndef H_PERFCOUNTERS
+#define H_PERFCOUNTERS
+
+#include <string>
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief The hardware events counted around a benchmark loop.
+ * 
+ */
+enum HardwareCounter {
+  INSTRUCTIONS,
+  BRANCH_MISSES,
+  LLC_MISSES,
+  DTLB_MISSES,
+  NUMBER_OF_HARDWARE_COUNTERS
+};
+
+/**
+ * @brief What the counters counted between a start and a stop.
+ * 
+ */
+struct CounterReadings {
+  public:
+    ull values[NUMBER_OF_HARDWARE_COUNTERS]; // events counted, scaled up if the kernel multiplexed the counter
+    bool isCounted[NUMBER_OF_HARDWARE_COUNTERS]; // if the counter could be opened and ran
+
+    /**
+     * @brief Construct readings where nothing was counted.
+     * 
+     */
+    CounterReadings() {
+      for (uint counter = 0; counter < NUMBER_OF_HARDWARE_COUNTERS; ++counter) {
+        values[counter] = 0;
+        isCounted[counter] = false;
+      }
+    }
+};
+
+/**
+ * @brief Hardware performance counters of the calling thread read through perf_event_open, user space
+ * only. A counter the kernel or the CPU does not offer, e.g. in a virtual machine or with a strict
+ * perf_event_paranoid, is left out and the others still count. Off Linux nothing is counted.
+ * 
+ */
+class PerfCounters {
+  private:
+    int fileDescriptors[NUMBER_OF_HARDWARE_COUNTERS]; // one per counter, -1 if it could not be opened
+    string unavailableReason; // why the first counter that failed could not be opened
+
+  public:
+    /**
+     * @brief Opens the counters for the calling thread, disabled until started.
+     * 
+     */
+    PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Closes the counters.
+     * 
+     */
+    ~PerfCounters();
+
+    /**
+     * @brief Checks if any counter could be opened.
+     * 
+     * @return true If at least one counter counts.
+     */
+    bool isAvailable();
+
+    /**
+     * @brief Get why a counter could not be opened.
+     * 
+     * @return string The error of the first counter that failed, empty if all opened.
+     */
+    string getUnavailableReason();
+
+    /**
+     * @brief Resets the counters and starts counting.
+     * 
+     */
+    void start();
+
+    /**
+     * @brief Stops counting and reads the counters.
+     * 
+     * @return CounterReadings The events counted since the last start.
+     */
+    CounterReadings stop();
+
+    /**
+     * @brief Get the name a counter is reported under.
+     * 
+     * @param counter The counter.
+     * @return string Its name.
+     */
+    static string getCounterName(HardwareCounter counter);
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <list>
+#include <map>
+#include <mutex>
+
+#include "querycache.h"
+#include "indexkey.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+template <typename KeyType, typename KeyCompare>
+QueryCache<KeyType, KeyCompare>::QueryCache(ull capacityBytes)
+    : capacityBytes(capacityBytes), sizeBytes(0), version(0), hits(0), misses(0), invalidations(0), evictions(0) {}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::eraseEntry(EntryIterator entry) {
+  if (!(*entry).isRange) {
+    keyEntries.erase((*entry).startKey);
+  } else {
+    auto rangesWithStart = rangeEntries.equal_range((*entry).startKey);
+    for (auto range = rangesWithStart.first; range != rangesWithStart.second; ++range) {
+      if (range->second == entry) {
+        rangeEntries.erase(range);
+        break;
+      }
+    }
+  }
+  sizeBytes -= (*entry).sizeInBytes;
+  entries.erase(entry);
+}
+
+template <typename KeyType, typename KeyCompare>
+typename QueryCache<KeyType, KeyCompare>::EntryIterator QueryCache<KeyType, KeyCompare>::insertEntry(QueryCacheEntry<KeyType> entry) {
+  // the records are charged with the entry, the bookkeeping of the maps and list is left out
+  entry.sizeInBytes = sizeof(QueryCacheEntry<KeyType>) + entry.result.records.size() * sizeof(Record);
+  if (entry.sizeInBytes > capacityBytes) {
+    return entries.end();
+  }
+  while (sizeBytes + entry.sizeInBytes > capacityBytes) {
+    eraseEntry(prev(entries.end()));
+    ++evictions;
+  }
+  sizeBytes += entry.sizeInBytes;
+  entries.push_front(entry);
+  return entries.begin();
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::evictLeastRecentRange() {
+  for (auto entry = entries.rbegin(); entry != entries.rend(); ++entry) {
+    if ((*entry).isRange) {
+      eraseEntry(prev(entry.base()));
+      ++evictions;
+      return;
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+bool QueryCache<KeyType, KeyCompare>::lookupKey(const KeyType& key, CachedQueryResult& result, ull& readVersion) {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  readVersion = version;
+  auto keyEntry = keyEntries.find(key);
+  if (keyEntry == keyEntries.end()) {
+    ++misses;
+    return false;
+  }
+  ++hits;
+  entries.splice(entries.begin(), entries, keyEntry->second); // now the most recently used
+  result = (*keyEntry->second).result;
+  return true;
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::storeKey(const KeyType& key, const CachedQueryResult& result, ull readVersion) {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  if (readVersion != version) {
+    return; // a change came in while the key was read, it may have been read before the change
+  }
+  auto keyEntry = keyEntries.find(key);
+  if (keyEntry != keyEntries.end()) {
+    eraseEntry(keyEntry->second);
+  }
+  EntryIterator entry = insertEntry(QueryCacheEntry<KeyType>{false, key, key, result, 0});
+  if (entry != entries.end()) {
+    keyEntries[key] = entry;
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+bool QueryCache<KeyType, KeyCompare>::lookupRange(const KeyType& startKey, const KeyType& endKey, CachedQueryResult& result, ull& readVersion) {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  readVersion = version;
+  auto rangesWithStart = rangeEntries.equal_range(startKey);
+  for (auto range = rangesWithStart.first; range != rangesWithStart.second; ++range) {
+    const KeyType& cachedEndKey = (*range->second).endKey;
+    if (!keyCompare(cachedEndKey, endKey) && !keyCompare(endKey, cachedEndKey)) {
+      ++hits;
+      entries.splice(entries.begin(), entries, range->second); // now the most recently used
+      result = (*range->second).result;
+      return true;
+    }
+  }
+  ++misses;
+  return false;
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::storeRange(const KeyType& startKey, const KeyType& endKey, const CachedQueryResult& result, ull readVersion) {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  if (readVersion != version) {
+    return; // a change came in while the range was read, it may have been read before the change
+  }
+  auto rangesWithStart = rangeEntries.equal_range(startKey);
+  for (auto range = rangesWithStart.first; range != rangesWithStart.second; ++range) {
+    const KeyType& cachedEndKey = (*range->second).endKey;
+    if (!keyCompare(cachedEndKey, endKey) && !keyCompare(endKey, cachedEndKey)) {
+      eraseEntry(range->second);
+      break;
+    }
+  }
+  // every change to a key walks the ranges starting up to it, so their number is kept bounded
+  if (rangeEntries.size() >= MAX_CACHED_RANGES) {
+    evictLeastRecentRange();
+  }
+  QueryCacheEntry<KeyType> rangeEntry{true, startKey, endKey, result, 0};
+  rangeEntry.result.records.clear(); // a range is only cached as an aggregate
+  EntryIterator entry = insertEntry(rangeEntry);
+  if (entry != entries.end()) {
+    rangeEntries.insert(make_pair(startKey, entry));
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::invalidateKey(const KeyType& key) {
+  invalidateRange(key, key);
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::invalidateRange(const KeyType& startKey, const KeyType& endKey) {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  ++version;
+  auto keyEntry = keyEntries.lower_bound(startKey);
+  while (keyEntry != keyEntries.end() && !keyCompare(endKey, keyEntry->first)) {
+    EntryIterator entry = keyEntry->second;
+    ++keyEntry; // erasing the entry erases it from keyEntries too
+    eraseEntry(entry);
+    ++invalidations;
+  }
+  // the ranges starting up to the end key overlap the changed keys if they end at or past the start key
+  auto rangeEntry = rangeEntries.begin();
+  while (rangeEntry != rangeEntries.end() && !keyCompare(endKey, rangeEntry->first)) {
+    EntryIterator entry = rangeEntry->second;
+    ++rangeEntry;
+    if (!keyCompare((*entry).endKey, startKey)) {
+      eraseEntry(entry);
+      ++invalidations;
+    }
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+void QueryCache<KeyType, KeyCompare>::clear() {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  keyEntries.clear();
+  rangeEntries.clear();
+  entries.clear();
+  sizeBytes = 0;
+}
+
+template <typename KeyType, typename KeyCompare>
+CacheStatistics QueryCache<KeyType, KeyCompare>::getStatistics() {
+  lock_guard<mutex> cacheLock(cacheMutex);
+  CacheStatistics statistics;
+  statistics.hits = hits;
+  statistics.misses = misses;
+  statistics.invalidations = invalidations;
+  statistics.evictions = evictions;
+  statistics.numberOfEntries = entries.size();
+  statistics.bytesUsed = sizeBytes;
+  statistics.capacityBytes = capacityBytes;
+  return statistics;
+}
+
+// the cache is compiled once for every column type that can be indexed
+template class QueryCache<int>;
+template class QueryCache<float>;
+template class QueryCache<MovieIdKey, MovieIdKeyCompare>;
+template class QueryCache<VotesRatingKey, VotesRatingKeyCompare>;
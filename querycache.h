@@ -0,0 +1,184 @@
+#ifndef H_QUERYCACHE
+#define H_QUERYCACHE
+
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "record.h"
+#include "statistics.h"
+
+#define MAX_CACHED_RANGES 128 // range results kept at most, every change to a key checks the ranges starting up to it
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief What a query matched, as kept by the query cache: the records of a key, or the aggregate of a range.
+ * 
+ */
+struct CachedQueryResult {
+  public:
+    vector<Record> records; // records of a key, left empty for a range, which only keeps its aggregate
+    double totalRating; // sum of avgRating of the records matched
+    uint numberOfRecords; // records matched
+    uint keysFound; // distinct keys matched
+
+    /**
+     * @brief Construct an empty Cached Query Result object.
+     * 
+     */
+    CachedQueryResult() : totalRating(0.0), numberOfRecords(0), keysFound(0) {}
+};
+
+/**
+ * @brief A result in the query cache, of a key or of a range.
+ * 
+ * @tparam KeyType The type of the column the tree is indexing.
+ */
+template <typename KeyType>
+struct QueryCacheEntry {
+  public:
+    bool isRange; // whether the entry is the aggregate of a range rather than the records of a key
+    KeyType startKey; // the key, or the start of the range (inclusive)
+    KeyType endKey; // the end of the range (inclusive), the key again for a key
+    CachedQueryResult result; // what the query matched
+    uint sizeInBytes; // memory the entry is charged for
+};
+
+/**
+ * @brief A cache of query results for the hot keys of an index, the records of a key and the
+ * aggregates of ranges, evicting the least recently used results once they take more memory than
+ * allowed. The tree it is attached to invalidates the results of every key it changes. Safe to use
+ * from several threads.
+ * 
+ * @tparam KeyType The type of the column the tree is indexing.
+ * @tparam KeyCompare Strict weak ordering of the keys.
+ */
+template <typename KeyType, typename KeyCompare = less<KeyType>>
+class QueryCache {
+  private:
+    typedef typename list<QueryCacheEntry<KeyType>>::iterator EntryIterator;
+
+    ull capacityBytes; // memory the results may take
+    ull sizeBytes; // memory the results take
+    list<QueryCacheEntry<KeyType>> entries; // results, the most recently used first
+    map<KeyType, EntryIterator, KeyCompare> keyEntries; // results of keys, by key
+    multimap<KeyType, EntryIterator, KeyCompare> rangeEntries; // results of ranges, by the start of the range
+    KeyCompare keyCompare; // orders the keys
+    ull version; // bumped by every invalidation, a result read at an older version may miss a change
+    mutex cacheMutex; // guards everything above and the counters
+    ull hits; // lookups answered from the cache
+    ull misses; // lookups not in the cache
+    ull invalidations; // results dropped because their keys changed
+    ull evictions; // results dropped to make room
+
+    /**
+     * @brief Drops a result from the cache.
+     * 
+     * @param entry The result to drop.
+     */
+    void eraseEntry(EntryIterator entry);
+
+    /**
+     * @brief Adds a result as the most recently used, evicting the least recently used results until it fits.
+     * 
+     * @param entry The result to add.
+     * @return EntryIterator The result added, entries.end() if it is larger than the whole cache.
+     */
+    EntryIterator insertEntry(QueryCacheEntry<KeyType> entry);
+
+    /**
+     * @brief Drops the least recently used range result.
+     * 
+     */
+    void evictLeastRecentRange();
+
+  public:
+    /**
+     * @brief Construct a new Query Cache object.
+     * 
+     * @param capacityBytes Memory the cached results may take in bytes(B).
+     */
+    explicit QueryCache(ull capacityBytes);
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    /**
+     * @brief Looks up the records of a key.
+     * 
+     * @param key The key queried.
+     * @param result Set to the cached records if they are cached.
+     * @param readVersion Set to the version of the cache, to be passed to storeKey once the key is read.
+     * @return true If the records of the key were cached.
+     */
+    bool lookupKey(const KeyType& key, CachedQueryResult& result, ull& readVersion);
+
+    /**
+     * @brief Caches the records of a key, unless a key changed since the read started, as the records
+     * may then be stale.
+     * 
+     * @param key The key queried.
+     * @param result The records of the key.
+     * @param readVersion The version lookupKey gave before the key was read.
+     */
+    void storeKey(const KeyType& key, const CachedQueryResult& result, ull readVersion);
+
+    /**
+     * @brief Looks up the aggregate of a range.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @param result Set to the cached aggregate if it is cached.
+     * @param readVersion Set to the version of the cache, to be passed to storeRange once the range is read.
+     * @return true If the aggregate of the range was cached.
+     */
+    bool lookupRange(const KeyType& startKey, const KeyType& endKey, CachedQueryResult& result, ull& readVersion);
+
+    /**
+     * @brief Caches the aggregate of a range, unless a key changed since the read started. Once
+     * MAX_CACHED_RANGES ranges are cached, the least recently used range makes room.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @param result The aggregate of the range.
+     * @param readVersion The version lookupRange gave before the range was read.
+     */
+    void storeRange(const KeyType& startKey, const KeyType& endKey, const CachedQueryResult& result, ull readVersion);
+
+    /**
+     * @brief Drops the results a change to a key makes stale: the records of the key and the aggregate
+     * of every range holding it.
+     * 
+     * @param key The key changed.
+     */
+    void invalidateKey(const KeyType& key);
+
+    /**
+     * @brief Drops the results a change to every key of a range makes stale.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     */
+    void invalidateRange(const KeyType& startKey, const KeyType& endKey);
+
+    /**
+     * @brief Drops every result, keeping the counters.
+     * 
+     */
+    void clear();
+
+    /**
+     * @brief Get the hits, misses, invalidations and evictions so far, and the memory taken.
+     * 
+     * @return CacheStatistics The counters of the cache.
+     */
+    CacheStatistics getStatistics();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <sstream>
+
+#include "queryplanner.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+void KeyHistogram::build(const vector<pair<int, OverflowBlock*>>& keysAndOverflowBlocks, uint numberOfBuckets) {
+  // what the index path reads for every key, the data blocks of a key counted once like a range query does
+  vector<HistogramBucket> keyCounts;
+  keyCounts.reserve(keysAndOverflowBlocks.size());
+  vector<Block*> blocksOfKey;
+  numberOfRecords = 0;
+  for (auto& keyAndOverflowBlock: keysAndOverflowBlocks) {
+    HistogramBucket keyCount = {keyAndOverflowBlock.first, keyAndOverflowBlock.first, 1, 0, 0, 0};
+    blocksOfKey.clear();
+    for (OverflowBlock* overflowBlock = keyAndOverflowBlock.second; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+      ++keyCount.overflowBlocks;
+      keyCount.numberOfRecords += overflowBlock->blockPtrs.size();
+      blocksOfKey.insert(blocksOfKey.end(), overflowBlock->blockPtrs.begin(), overflowBlock->blockPtrs.end());
+    }
+    sort(blocksOfKey.begin(), blocksOfKey.end());
+    keyCount.dataBlocks = unique(blocksOfKey.begin(), blocksOfKey.end()) - blocksOfKey.begin();
+    numberOfRecords += keyCount.numberOfRecords;
+    keyCounts.push_back(keyCount);
+  }
+  numberOfKeys = keyCounts.size();
+
+  // a bucket is closed once it holds its share of the records, so a key holding more gets a bucket of its own
+  buckets.clear();
+  double recordsPerBucket = (double) numberOfRecords / max(1u, numberOfBuckets);
+  for (auto& keyCount: keyCounts) {
+    if (buckets.empty() || buckets.back().numberOfRecords >= recordsPerBucket) {
+      buckets.push_back(keyCount);
+      continue;
+    }
+    HistogramBucket& bucket = buckets.back();
+    bucket.highKey = keyCount.highKey;
+    ++bucket.numberOfKeys;
+    bucket.numberOfRecords += keyCount.numberOfRecords;
+    bucket.dataBlocks += keyCount.dataBlocks;
+    bucket.overflowBlocks += keyCount.overflowBlocks;
+  }
+}
+
+RangeEstimate KeyHistogram::estimateRange(int startKey, int endKey) const {
+  RangeEstimate estimate;
+  auto bucket = lower_bound(buckets.begin(), buckets.end(), startKey,
+                            [](const HistogramBucket& bucket, int key) { return bucket.highKey < key; });
+  for (; bucket != buckets.end() && bucket->lowKey <= endKey; ++bucket) {
+    long long overlapLowKey = max(startKey, bucket->lowKey);
+    long long overlapHighKey = min(endKey, bucket->highKey);
+    double coveredFraction = (double) (overlapHighKey - overlapLowKey + 1) / ((long long) bucket->highKey - bucket->lowKey + 1);
+    // keys are spread evenly over the bucket, so a range over its sparse tail would come out as none,
+    // a bucket the range overlaps counts for at least one of its keys
+    coveredFraction = max(coveredFraction, 1.0 / bucket->numberOfKeys);
+    estimate.numberOfKeys += bucket->numberOfKeys * coveredFraction;
+    estimate.numberOfRecords += bucket->numberOfRecords * coveredFraction;
+    estimate.dataBlocks += bucket->dataBlocks * coveredFraction;
+    estimate.overflowBlocks += bucket->overflowBlocks * coveredFraction;
+  }
+  return estimate;
+}
+
+string RangePlan::explain() const {
+  ostringstream plan;
+  plan << "EXPLAIN " << startKey << " <= numVotes <= " << endKey << endl;
+  plan << "  " << (accessPath == ACCESS_INDEX_RANGE ? "->" : "  ") << " Index range scan on numVotes: " << internalNodeAccesses
+       << " internal nodes + " << round(leafAccesses) << " leaves + " << round(estimate.overflowBlocks) << " overflow blocks + "
+       << round(estimate.dataBlocks) << " data blocks = " << round(indexBlockAccesses) << " block accesses, cost " << round(indexCost) << endl;
+  plan << "  " << (accessPath == ACCESS_FULL_SCAN ? "->" : "  ") << " Full scan of storage: " << scanBlockAccesses
+       << " data blocks, cost " << round(scanCost) << endl;
+  plan << "  Estimated " << round(estimate.numberOfKeys) << " keys and " << round(estimate.numberOfRecords) << " records from "
+       << histogramBuckets << " histogram buckets over " << histogramRecords << " records" << endl;
+  return plan.str();
+}
+
+void QueryPlanner::analyzeLocked() {
+  // read before the keys, so a change made while the histogram is built makes it stale sooner rather than never
+  recordChangesAtAnalyze = disk->getNumberOfRecordChanges();
+  histogram.build(numVotesIndex->getOverflowBlocksOfRange(INT_MIN, INT_MAX), HISTOGRAM_BUCKETS);
+  isAnalyzed = true;
+  ++numberOfAnalyzes;
+}
+
+void QueryPlanner::analyze() {
+  if (numVotesIndex == nullptr) {
+    return;
+  }
+  lock_guard<mutex> plannerLock(plannerMutex);
+  analyzeLocked();
+}
+
+RangePlan QueryPlanner::planRange(int startKey, int endKey) {
+  RangePlan plan;
+  plan.startKey = startKey;
+  plan.endKey = endKey;
+  plan.scanBlockAccesses = disk->getNumberOfBlocksInStorage();
+  plan.scanCost = plan.scanBlockAccesses;
+  if (numVotesIndex == nullptr) {
+    return plan;
+  }
+
+  lock_guard<mutex> plannerLock(plannerMutex);
+  ull recordChanges = disk->getNumberOfRecordChanges() - recordChangesAtAnalyze;
+  if (!isAnalyzed || recordChanges > histogram.numberOfRecords * HISTOGRAM_REFRESH_FRACTION) {
+    analyzeLocked();
+  }
+  plan.histogramBuckets = histogram.buckets.size();
+  plan.histogramRecords = histogram.numberOfRecords;
+  if (endKey < startKey || histogram.numberOfKeys == 0) {
+    plan.accessPath = ACCESS_INDEX_RANGE; // the index finds nothing without reading a block
+    return plan;
+  }
+  plan.estimate = histogram.estimateRange(startKey, endKey);
+
+  uint treeHeight = numVotesIndex->getTreeHeight();
+  double keysPerLeaf = (double) histogram.numberOfKeys / max(1u, numVotesIndex->getNumberOfLeavesInTree());
+  plan.internalNodeAccesses = treeHeight > 0 ? treeHeight - 1 : 0;
+  plan.leafAccesses = max(1.0, ceil(plan.estimate.numberOfKeys / max(1.0, keysPerLeaf)));
+  plan.indexBlockAccesses = plan.internalNodeAccesses + plan.leafAccesses + plan.estimate.overflowBlocks + plan.estimate.dataBlocks;
+  plan.indexCost = plan.indexBlockAccesses * RANDOM_BLOCK_ACCESS_COST;
+  plan.accessPath = plan.indexCost <= plan.scanCost ? ACCESS_INDEX_RANGE : ACCESS_FULL_SCAN;
+  return plan;
+}
+
+KeyHistogram QueryPlanner::getHistogram() {
+  lock_guard<mutex> plannerLock(plannerMutex);
+  return histogram;
+}
+
+uint QueryPlanner::getNumberOfAnalyzes() {
+  lock_guard<mutex> plannerLock(plannerMutex);
+  return numberOfAnalyzes;
+}
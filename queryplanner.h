@@ -0,0 +1,199 @@
+#ifndef H_QUERYPLANNER
+#define H_QUERYPLANNER
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bplustree.h"
+#include "overflowblock.h"
+#include "storage.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+#define HISTOGRAM_BUCKETS 128 // buckets of the numVotes histogram, each holding about as many records
+#define HISTOGRAM_REFRESH_FRACTION 0.1 // share of the records changed through the storage after which the histogram is built again
+#define RANDOM_BLOCK_ACCESS_COST 2.0 // cost of a block read through the index against a block read in sequence by a scan
+
+/**
+ * @brief How the records matching a predicate are reached.
+ * 
+ */
+enum AccessPath {
+  ACCESS_INDEX_RANGE, // every key of the numVotes range through the numVotes index, reading the blocks its records are in
+  ACCESS_FULL_SCAN // every block of the storage, one after another
+};
+
+/**
+ * @brief A run of consecutive numVotes of the histogram, with what the index holds for them.
+ * 
+ */
+struct HistogramBucket {
+  public:
+    int lowKey; // smallest numVotes in the bucket
+    int highKey; // largest numVotes in the bucket
+    uint numberOfKeys; // distinct numVotes in the bucket
+    uint numberOfRecords; // records of the keys
+    uint dataBlocks; // data blocks read for the keys, a block counted once per key it holds
+    uint overflowBlocks; // overflow blocks of the keys
+};
+
+/**
+ * @brief What the histogram expects a range of numVotes to hold.
+ * 
+ */
+struct RangeEstimate {
+  public:
+    double numberOfKeys; // distinct numVotes in range
+    double numberOfRecords; // records in range
+    double dataBlocks; // data blocks the index path reads, a block counted once per key it holds
+    double overflowBlocks; // overflow blocks the index path reads
+
+    /**
+     * @brief Construct the estimate of an empty range.
+     * 
+     */
+    RangeEstimate() : numberOfKeys(0.0), numberOfRecords(0.0), dataBlocks(0.0), overflowBlocks(0.0) {}
+};
+
+/**
+ * @brief An equi-depth histogram of the numVotes keys of the index, each bucket holding about as many records
+ * so a popular key gets a bucket of its own and a sparse range shares one. A key never spans two buckets.
+ * 
+ */
+struct KeyHistogram {
+  public:
+    vector<HistogramBucket> buckets; // in key order
+    uint numberOfKeys; // distinct numVotes indexed
+    uint numberOfRecords; // records indexed
+
+    /**
+     * @brief Construct an empty histogram.
+     * 
+     */
+    KeyHistogram() : numberOfKeys(0), numberOfRecords(0) {}
+
+    /**
+     * @brief Builds the buckets from every key of the index with its overflow chain, replacing the buckets built before.
+     * 
+     * @param keysAndOverflowBlocks Every key in increasing order with its overflow block.
+     * @param numberOfBuckets Buckets wanted, fewer are made if there are fewer keys.
+     */
+    void build(const vector<pair<int, OverflowBlock*>>& keysAndOverflowBlocks, uint numberOfBuckets);
+
+    /**
+     * @brief Estimates what a range holds, taking the keys of a bucket the range partly covers as spread evenly over the bucket
+     * and counting at least one key of every bucket the range overlaps.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @return RangeEstimate The keys, records and blocks expected in range.
+     */
+    RangeEstimate estimateRange(int startKey, int endKey) const;
+};
+
+/**
+ * @brief The access path chosen for a range of numVotes, with the block accesses and costs of both paths.
+ * 
+ */
+struct RangePlan {
+  public:
+    AccessPath accessPath; // the cheaper path
+    int startKey; // the starting range (inclusive)
+    int endKey; // the ending range (inclusive)
+    RangeEstimate estimate; // what the range is expected to hold
+    uint histogramBuckets; // buckets the estimate was taken from
+    uint histogramRecords; // records indexed when the histogram was built
+    uint internalNodeAccesses; // internal nodes read descending to the first leaf
+    double leafAccesses; // leaves read along the range
+    double indexBlockAccesses; // internal nodes, leaves, overflow blocks and data blocks read through the index
+    double indexCost; // the accesses of the index path weighted by RANDOM_BLOCK_ACCESS_COST
+    uint scanBlockAccesses; // data blocks read by a full scan
+    double scanCost; // the accesses of a full scan
+
+    /**
+     * @brief Construct a plan scanning an empty storage.
+     * 
+     */
+    RangePlan() : accessPath(ACCESS_FULL_SCAN), startKey(0), endKey(0), histogramBuckets(0), histogramRecords(0), internalNodeAccesses(0),
+                  leafAccesses(0.0), indexBlockAccesses(0.0), indexCost(0.0), scanBlockAccesses(0), scanCost(0.0) {}
+
+    /**
+     * @brief Formats the plan like an EXPLAIN: both paths with their estimated accesses and cost, the chosen one marked.
+     * 
+     * @return string The plan, one line per path and one for the estimate.
+     */
+    string explain() const;
+};
+
+/**
+ * @brief Chooses between the numVotes index and a full scan of the storage for a range of numVotes by the
+ * block accesses each needs. The accesses of the index come from a histogram of its keys, built when the first
+ * range is planned and again once HISTOGRAM_REFRESH_FRACTION of the records changed through the storage, and
+ * the accesses of a scan from the blocks of the storage. Safe to plan from several threads.
+ * 
+ */
+class QueryPlanner {
+  private:
+    Storage* disk; // storage the records are in
+    NumVotesIndex* numVotesIndex; // numVotes index attached to the storage, nullptr if every range is scanned
+    mutex plannerMutex; // guards the histogram and when it was built
+    KeyHistogram histogram; // keys of the index as of the last analyze
+    bool isAnalyzed; // whether the histogram was built
+    ull recordChangesAtAnalyze; // records changed through the storage when the histogram was built
+    uint numberOfAnalyzes; // times the histogram was built
+
+    /**
+     * @brief Builds the histogram with the planner lock held.
+     * 
+     */
+    void analyzeLocked();
+
+  public:
+    /**
+     * @brief Construct a planner, the histogram is built when the first range is planned.
+     * 
+     * @param disk The storage the records are in.
+     * @param numVotesIndex The numVotes index attached to the storage, nullptr to always scan.
+     */
+    QueryPlanner(Storage* disk, NumVotesIndex* numVotesIndex)
+        : disk(disk), numVotesIndex(numVotesIndex), isAnalyzed(false), recordChangesAtAnalyze(0), numberOfAnalyzes(0) {}
+
+    QueryPlanner(const QueryPlanner&) = delete;
+    QueryPlanner& operator=(const QueryPlanner&) = delete;
+
+    /**
+     * @brief Builds the histogram of the keys of the index now, e.g. after changing the index without the storage.
+     * 
+     */
+    void analyze();
+
+    /**
+     * @brief Chooses the access path of a range of numVotes, building the histogram first if it is missing or stale.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @return RangePlan The path chosen, with the estimates of both paths.
+     */
+    RangePlan planRange(int startKey, int endKey);
+
+    /**
+     * @brief Get the histogram as of the last analyze.
+     * 
+     * @return KeyHistogram A copy of the histogram.
+     */
+    KeyHistogram getHistogram();
+
+    /**
+     * @brief Get the number of times the histogram was built.
+     * 
+     * @return uint The analyzes since construction.
+     */
+    uint getNumberOfAnalyzes();
+};
+
+#endif
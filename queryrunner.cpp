@@ -0,0 +1,191 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "queryrunner.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+/**
+ * @brief A stream buffer that drops everything written to it, to silence the tree without keeping its
+ * output in memory over a long run.
+ * 
+ */
+class DiscardingBuffer : public streambuf {
+  protected:
+    int overflow(int character) override {
+      return character;
+    }
+};
+
+// function declarations
+QueryResult runQuery(Storage* disk, NumVotesIndex* bPlusTree, const Query& query);
+string queryResultToJson(const Query& query, const QueryResult& result);
+string latenciesToJson(vector<double>& latenciesUs);
+
+vector<Query> readQueryFile(const string& filePath) {
+  ifstream queryFile(filePath);
+  if (!queryFile.is_open()) {
+    cout << "Unable to open query file " << filePath << endl;
+    throw "Unable to open query file";
+  }
+
+  vector<Query> queries;
+  string line;
+  uint lineNumber = 0;
+  while (getline(queryFile, line)) {
+    ++lineNumber;
+    istringstream lineStream(line.substr(0, line.find('#')));
+    string operation;
+    if (!(lineStream >> operation)) {
+      continue;
+    }
+
+    Query query;
+    query.lineNumber = lineNumber;
+    bool isValid = false;
+    if (operation.compare("search") == 0 || operation.compare("delete") == 0) {
+      query.kind = operation.compare("search") == 0 ? QUERY_SEARCH : QUERY_DELETE;
+      isValid = bool(lineStream >> query.startKey);
+      query.endKey = query.startKey;
+    } else if (operation.compare("range") == 0) {
+      query.kind = QUERY_RANGE;
+      isValid = bool(lineStream >> query.startKey >> query.endKey) && query.startKey <= query.endKey;
+    }
+    string extraText;
+    if (!isValid || lineStream >> extraText) {
+      cout << "Line " << lineNumber << " of " << filePath << " is not a query: " << line << endl;
+      cout << "Expected search <numVotes>, range <start> <end> with start <= end, or delete <numVotes>." << endl;
+      throw "Invalid query file";
+    }
+    queries.push_back(query);
+  }
+  return queries;
+}
+
+/**
+ * @brief Runs one query and times it.
+ * 
+ * @param disk The storage the query reads and deletes from.
+ * @param bPlusTree The numVotes index of the storage.
+ * @param query The query to run.
+ * @return QueryResult What the query found or deleted.
+ */
+QueryResult runQuery(Storage* disk, NumVotesIndex* bPlusTree, const Query& query) {
+  QueryResult result;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  if (query.kind == QUERY_DELETE) {
+    uint recordsBefore = disk->getNumberOfRecords();
+    result.nodesDeleted = disk->deleteRecordsByNumVotes(query.startKey);
+    result.recordsFound = recordsBefore - disk->getNumberOfRecords();
+    result.keysFound = result.recordsFound > 0;
+  } else {
+    // both go through the query cache of the tree when one is attached
+    CachedQueryResult cachedResult = query.kind == QUERY_SEARCH ? bPlusTree->getRecordsOfKey(query.startKey)
+                                                                : bPlusTree->getAggregateOfRange(query.startKey, query.endKey);
+    result.keysFound = cachedResult.keysFound;
+    result.recordsFound = cachedResult.numberOfRecords;
+    result.totalRating = cachedResult.totalRating;
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  result.latencyUs = chrono::duration<double, micro>(end - start).count();
+  return result;
+}
+
+/**
+ * @brief Formats the result of a query as a JSON object.
+ * 
+ * @param query The query run.
+ * @param result What it found or deleted.
+ * @return string The JSON object.
+ */
+string queryResultToJson(const Query& query, const QueryResult& result) {
+  ostringstream json;
+  json << "{\"line\":" << query.lineNumber;
+  if (query.kind == QUERY_RANGE) {
+    json << ",\"op\":\"range\",\"start\":" << query.startKey << ",\"end\":" << query.endKey;
+  } else {
+    json << ",\"op\":\"" << (query.kind == QUERY_SEARCH ? "search" : "delete") << "\",\"key\":" << query.startKey;
+  }
+  if (query.kind == QUERY_DELETE) {
+    json << ",\"recordsDeleted\":" << result.recordsFound << ",\"nodesDeleted\":" << result.nodesDeleted;
+  } else {
+    json << ",\"keysFound\":" << result.keysFound << ",\"records\":" << result.recordsFound << ",\"averageRating\":"
+         << (result.recordsFound == 0 ? 0.0 : result.totalRating / result.recordsFound);
+  }
+  json << ",\"latencyUs\":" << result.latencyUs << "}";
+  return json.str();
+}
+
+/**
+ * @brief Formats the count, median, 99th percentile and slowest of some latencies as a JSON object.
+ * 
+ * @param latenciesUs Latencies in microseconds, sorted in place.
+ * @return string The JSON object.
+ */
+string latenciesToJson(vector<double>& latenciesUs) {
+  ostringstream json;
+  json << "{\"count\":" << latenciesUs.size();
+  if (!latenciesUs.empty()) {
+    sort(latenciesUs.begin(), latenciesUs.end());
+    json << ",\"p50Us\":" << latenciesUs[latenciesUs.size() / 2] << ",\"p99Us\":" << latenciesUs[latenciesUs.size() * 99 / 100]
+         << ",\"maxUs\":" << latenciesUs.back();
+  }
+  json << "}";
+  return json.str();
+}
+
+void runQueries(Storage* disk, NumVotesIndex* bPlusTree, const vector<Query>& queries, const string& resultsFilePath) {
+  ofstream resultsFile(resultsFilePath);
+  if (!resultsFile.is_open()) {
+    cout << "Unable to open " << resultsFilePath << " for writing" << endl;
+    throw "Unable to open results file";
+  }
+  cout << "Running " << queries.size() << " queries..." << endl;
+
+  vector<double> latenciesUs[3]; // of the searches, ranges and deletes, in the order of QueryKind
+  double totalLatencyUs = 0;
+  DiscardingBuffer discardingBuffer;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (const Query& query: queries) {
+    streambuf* coutBuffer = cout.rdbuf(&discardingBuffer);
+    QueryResult result = runQuery(disk, bPlusTree, query);
+    cout.rdbuf(coutBuffer);
+    latenciesUs[query.kind].push_back(result.latencyUs);
+    totalLatencyUs += result.latencyUs;
+    resultsFile << queryResultToJson(query, result) << "\n";
+  }
+  chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  double elapsedMs = chrono::duration<double, milli>(end - start).count();
+
+  // throughput counts the time in the queries, not writing their results
+  double queriesPerSecond = totalLatencyUs == 0 ? 0 : queries.size() / (totalLatencyUs / 1000000);
+  resultsFile << "{\"summary\":{\"queries\":" << queries.size() << ",\"queryTimeMs\":" << totalLatencyUs / 1000
+              << ",\"elapsedMs\":" << elapsedMs << ",\"queriesPerSecond\":" << queriesPerSecond
+              << ",\"search\":" << latenciesToJson(latenciesUs[QUERY_SEARCH])
+              << ",\"range\":" << latenciesToJson(latenciesUs[QUERY_RANGE])
+              << ",\"delete\":" << latenciesToJson(latenciesUs[QUERY_DELETE]);
+  NumVotesQueryCache* queryCache = bPlusTree->getQueryCache();
+  if (queryCache != nullptr) {
+    resultsFile << ",\"cache\":" << queryCache->getStatistics().toJson();
+  }
+  resultsFile << "}}" << endl;
+  resultsFile.close();
+
+  cout << "Ran " << queries.size() << " queries (" << latenciesUs[QUERY_SEARCH].size() << " searches, "
+       << latenciesUs[QUERY_RANGE].size() << " ranges, " << latenciesUs[QUERY_DELETE].size() << " deletes) in "
+       << totalLatencyUs / 1000 << "ms, " << uint(queriesPerSecond) << " queries/s" << endl;
+  if (queryCache != nullptr) {
+    CacheStatistics cacheStatistics = queryCache->getStatistics();
+    cout << "Query cache: " << cacheStatistics.hits << " hits, " << cacheStatistics.misses << " misses ("
+         << cacheStatistics.getHitRate() * 100 << "% hit rate), " << cacheStatistics.invalidations << " invalidations, "
+         << cacheStatistics.evictions << " evictions" << endl;
+  }
+  cout << "Results written to " << resultsFilePath << endl;
+}
@@ -0,0 +1,76 @@
+#ifndef H_QUERYRUNNER
+#define H_QUERYRUNNER
+
+#include <string>
+#include <vector>
+
+#include "storage.h"
+#include "bplustree.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+/**
+ * @brief The operations a query file can hold, all on numVotes.
+ * 
+ */
+enum QueryKind {
+  QUERY_SEARCH,
+  QUERY_RANGE,
+  QUERY_DELETE
+};
+
+/**
+ * @brief One line of a query file.
+ * 
+ */
+struct Query {
+  public:
+    QueryKind kind; // operation to run
+    int startKey; // numVotes searched or deleted, or the start of the range
+    int endKey; // end of the range, inclusive, equal to startKey for a search or a delete
+    uint lineNumber; // line of the query file, to match a result to its query
+};
+
+/**
+ * @brief What one query found or deleted, and how long it took.
+ * 
+ */
+struct QueryResult {
+  public:
+    uint keysFound; // distinct numVotes found
+    uint recordsFound; // records read, or deleted by a delete
+    double totalRating; // sum of the avgRating of the records read
+    uint nodesDeleted; // tree nodes freed by a delete
+    double latencyUs; // time taken in microseconds, reading the records included
+
+    /**
+     * @brief Construct an empty Query Result object.
+     * 
+     */
+    QueryResult() : keysFound(0), recordsFound(0), totalRating(0.0), nodesDeleted(0), latencyUs(0.0) {}
+};
+
+/**
+ * @brief Reads a query file, one query per line: `search <numVotes>`, `range <start> <end>` or
+ * `delete <numVotes>`. Text after a # is a comment and blank lines are skipped.
+ * 
+ * @param filePath Path of the query file.
+ * @return vector<Query> The queries in the order of the file.
+ */
+vector<Query> readQueryFile(const string& filePath);
+
+/**
+ * @brief Runs the queries one after another against the records on disk through the numVotes index,
+ * timing each, and writes one JSON object per query followed by a summary to the results file.
+ * Everything the tree prints while running is discarded.
+ * 
+ * @param disk The storage the queries read and delete from.
+ * @param bPlusTree The numVotes index of the storage.
+ * @param queries The queries to run.
+ * @param resultsFilePath Path of the JSON Lines results file, overwritten if it exists.
+ */
+void runQueries(Storage* disk, NumVotesIndex* bPlusTree, const vector<Query>& queries, const string& resultsFilePath);
+
+#endif
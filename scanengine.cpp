@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <set>
+
+#include "scanengine.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+typedef unsigned int uint;
+
+ScanPredicate::ScanPredicate() : startNumVotes(INT_MIN), endNumVotes(INT_MAX), startAvgRating(-FLT_MAX), endAvgRating(FLT_MAX) {}
+
+ScanPredicate::ScanPredicate(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating, const string& movieIdPrefix)
+    : startNumVotes(startNumVotes), endNumVotes(endNumVotes), startAvgRating(startAvgRating), endAvgRating(endAvgRating),
+      movieIdPrefix(movieIdPrefix) {}
+
+bool ScanPredicate::matches(const Record& record) const {
+  return record.__numVotes >= startNumVotes && record.__numVotes <= endNumVotes && record.__avgRating >= startAvgRating &&
+         record.__avgRating <= endAvgRating && hasMovieIdPrefix(record.__movieId, movieIdPrefix);
+}
+
+uint ScanBatch::findRecordInSegment(uint index, uint& segment) const {
+  while (segment + 1 < numberOfSegments && segmentStarts[segment + 1] <= index) {
+    ++segment;
+  }
+  return segmentFirstRecords[segment] + index - segmentStarts[segment];
+}
+
+uint ScanEngine::loadBatch(Block* blockPtr, bool isCompressed, const vector<uint8_t>& prefixMatches, const ScanPredicate& predicate,
+                           uint firstRecord, ScanBatch& batch) {
+  uint firstIdx = batch.numberOfRecords;
+  uint endRecord;
+  if (isCompressed) {
+    // the columns are decoded one after another, the tConsts only as codes into the dictionary
+    const CompressedRecords& compressedRecords = (*blockPtr).getCompressedRecords();
+    endRecord = min(compressedRecords.numberOfRecords, firstRecord + SCAN_BATCH_SIZE - firstIdx);
+    for (uint recordIdx = firstRecord; recordIdx < endRecord; ++recordIdx) {
+      batch.numVotes[firstIdx + recordIdx - firstRecord] = compressedRecords.decodeNumVotes(recordIdx);
+    }
+    for (uint recordIdx = firstRecord; recordIdx < endRecord; ++recordIdx) {
+      batch.avgRatings[firstIdx + recordIdx - firstRecord] = compressedRecords.decodeAvgRating(recordIdx);
+    }
+    for (uint recordIdx = firstRecord; recordIdx < endRecord; ++recordIdx) {
+      batch.movieIdMatches[firstIdx + recordIdx - firstRecord] = prefixMatches[compressedRecords.decodePrefixCode(recordIdx)];
+    }
+  } else {
+    const vector<Record>& records = (*blockPtr).__records;
+    endRecord = min((uint) records.size(), firstRecord + SCAN_BATCH_SIZE - firstIdx);
+    for (uint recordIdx = firstRecord; recordIdx < endRecord; ++recordIdx) {
+      batch.numVotes[firstIdx + recordIdx - firstRecord] = records[recordIdx].__numVotes;
+      batch.avgRatings[firstIdx + recordIdx - firstRecord] = records[recordIdx].__avgRating;
+    }
+    memset(batch.movieIdMatches + firstIdx, predicate.movieIdPrefix.empty() ? PREFIX_MATCHES_ALL : PREFIX_MATCHES_SOME, endRecord - firstRecord);
+  }
+  batch.segmentBlocks[batch.numberOfSegments] = blockPtr;
+  batch.segmentStarts[batch.numberOfSegments] = firstIdx;
+  batch.segmentFirstRecords[batch.numberOfSegments] = firstRecord;
+  ++batch.numberOfSegments;
+  batch.numberOfRecords += endRecord - firstRecord;
+  return endRecord;
+}
+
+void ScanEngine::evaluateBatch(const ScanPredicate& predicate, ScanBatch& batch) {
+  int startNumVotes = predicate.startNumVotes;
+  int endNumVotes = predicate.endNumVotes;
+  float startAvgRating = predicate.startAvgRating;
+  float endAvgRating = predicate.endAvgRating;
+  uint record = 0;
+#ifdef __SSE2__
+  // SSE2 is part of every x86-64 CPU, so 16 records are compared at once in any build: four registers of
+  // numVotes and of avgRating, their masks narrowed to one byte per record and anded with the tConst matches
+  __m128i startNumVotesLanes = _mm_set1_epi32(startNumVotes);
+  __m128i endNumVotesLanes = _mm_set1_epi32(endNumVotes);
+  __m128 startAvgRatingLanes = _mm_set1_ps(startAvgRating);
+  __m128 endAvgRatingLanes = _mm_set1_ps(endAvgRating);
+  __m128i noMatchLanes = _mm_set1_epi8(PREFIX_MATCHES_NONE);
+  __m128i oneLanes = _mm_set1_epi8(1);
+  for (; record + 16 <= batch.numberOfRecords; record += 16) {
+    __m128i recordMasks[4];
+    for (uint lane = 0; lane < 4; ++lane) {
+      __m128i numVotes = _mm_loadu_si128((const __m128i*) (batch.numVotes + record + lane * 4));
+      __m128 avgRatings = _mm_loadu_ps(batch.avgRatings + record + lane * 4);
+      __m128i numVotesOutside = _mm_or_si128(_mm_cmplt_epi32(numVotes, startNumVotesLanes), _mm_cmpgt_epi32(numVotes, endNumVotesLanes));
+      __m128 avgRatingsInside = _mm_and_ps(_mm_cmpge_ps(avgRatings, startAvgRatingLanes), _mm_cmple_ps(avgRatings, endAvgRatingLanes));
+      recordMasks[lane] = _mm_andnot_si128(numVotesOutside, _mm_castps_si128(avgRatingsInside));
+    }
+    __m128i masks = _mm_packs_epi16(_mm_packs_epi32(recordMasks[0], recordMasks[1]), _mm_packs_epi32(recordMasks[2], recordMasks[3]));
+    __m128i noMovieIdMatch = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (batch.movieIdMatches + record)), noMatchLanes);
+    _mm_storeu_si128((__m128i*) (batch.isMatching + record), _mm_and_si128(_mm_andnot_si128(noMovieIdMatch, masks), oneLanes));
+  }
+#endif
+  // the records left over, or every record without SSE2, compared without a branch
+  for (; record < batch.numberOfRecords; ++record) {
+    batch.isMatching[record] = (batch.numVotes[record] >= startNumVotes) & (batch.numVotes[record] <= endNumVotes) &
+                               (batch.avgRatings[record] >= startAvgRating) & (batch.avgRatings[record] <= endAvgRating) &
+                               (batch.movieIdMatches[record] != PREFIX_MATCHES_NONE);
+  }
+  // the position is always written and only kept if the record matches, so a selective predicate never mispredicts
+  uint numberOfSelected = 0;
+  for (uint i = 0; i < batch.numberOfRecords; ++i) {
+    batch.selection[numberOfSelected] = i;
+    numberOfSelected += batch.isMatching[i];
+  }
+  batch.numberOfSelected = numberOfSelected;
+  if (predicate.movieIdPrefix.empty()) {
+    return;
+  }
+
+  // the tConsts whose trailing digits decide are only read for the records matching everything else
+  numberOfSelected = 0;
+  uint segment = 0;
+  char movieId[TCONSTSIZE];
+  for (uint j = 0; j < batch.numberOfSelected; ++j) {
+    uint i = batch.selection[j];
+    if (batch.movieIdMatches[i] == PREFIX_MATCHES_SOME) {
+      uint recordIdx = batch.findRecordInSegment(i, segment);
+      Block* blockPtr = batch.segmentBlocks[segment];
+      if ((*blockPtr).isCompressed()) {
+        (*blockPtr).getCompressedRecords().decodeMovieId(recordIdx, movieId);
+      } else {
+        memcpy(movieId, (*blockPtr).__records[recordIdx].__movieId, TCONSTSIZE);
+      }
+      if (!hasMovieIdPrefix(movieId, predicate.movieIdPrefix)) {
+        continue;
+      }
+    }
+    batch.selection[numberOfSelected++] = i;
+  }
+  batch.numberOfSelected = numberOfSelected;
+}
+
+void ScanEngine::consumeBatch(ScanBatch& batch, ScanAggregate& aggregate, vector<Record>* records) {
+  for (uint j = 0; j < batch.numberOfSelected; ++j) {
+    aggregate.totalRating += batch.avgRatings[batch.selection[j]];
+  }
+  aggregate.totalRecords += batch.numberOfSelected;
+  if (records != nullptr) {
+    // the records are only put together once they are known to match
+    uint segment = 0;
+    for (uint j = 0; j < batch.numberOfSelected; ++j) {
+      uint recordIdx = batch.findRecordInSegment(batch.selection[j], segment);
+      Block* blockPtr = batch.segmentBlocks[segment];
+      if ((*blockPtr).isCompressed()) {
+        records->push_back((*blockPtr).getCompressedRecords().decodeRecord(recordIdx));
+      } else {
+        records->push_back((*blockPtr).__records[recordIdx]);
+      }
+    }
+  }
+  batch.numberOfRecords = 0;
+  batch.numberOfSelected = 0;
+  batch.numberOfSegments = 0;
+}
+
+void ScanEngine::scanBlockRange(const ScanPredicate& predicate, uint firstBlock, uint endBlock, ScanAggregate& aggregate,
+                                vector<Record>* records) {
+  unique_ptr<ScanBatch> batch(new ScanBatch());
+  vector<uint8_t> prefixMatches;
+  for (uint blockIdx = firstBlock; blockIdx < endBlock; ++blockIdx) {
+    Block* blockPtr = disk->__blocks[blockIdx];
+    if (!(*blockPtr).getZoneMap().overlaps(predicate.startNumVotes, predicate.endNumVotes, predicate.startAvgRating,
+                                           predicate.endAvgRating)) {
+      ++aggregate.dataBlocksSkipped;
+      continue;
+    }
+    bool isCompressed = (*blockPtr).isCompressed();
+    uint numberOfRecords = (*blockPtr).__records.size();
+    if (isCompressed) {
+      // the dictionary decides the tConst prefix once for every record sharing a prefix
+      const CompressedRecords& compressedRecords = (*blockPtr).getCompressedRecords();
+      bool isAnyPrefixMatching = false;
+      prefixMatches.clear();
+      for (auto& movieIdPrefix: compressedRecords.movieIdPrefixes) {
+        prefixMatches.push_back(matchMovieIdPrefix(movieIdPrefix, predicate.movieIdPrefix));
+        isAnyPrefixMatching = isAnyPrefixMatching || prefixMatches.back() != PREFIX_MATCHES_NONE;
+      }
+      if (!isAnyPrefixMatching) {
+        ++aggregate.dataBlocksSkipped;
+        continue;
+      }
+      numberOfRecords = compressedRecords.numberOfRecords;
+    }
+    ++aggregate.dataBlocksAccessed;
+    uint recordIdx = 0;
+    while (recordIdx < numberOfRecords) {
+      recordIdx = loadBatch(blockPtr, isCompressed, prefixMatches, predicate, recordIdx, *batch);
+      if ((*batch).numberOfRecords == SCAN_BATCH_SIZE) {
+        evaluateBatch(predicate, *batch);
+        consumeBatch(*batch, aggregate, records);
+      }
+    }
+  }
+  evaluateBatch(predicate, *batch);
+  consumeBatch(*batch, aggregate, records);
+}
+
+ScanAggregate ScanEngine::runFullScan(const ScanPredicate& predicate, vector<Record>* records) {
+  uint numberOfBlocks = disk->__blocks.size();
+  uint numberOfRanges = min(threadPool.getNumberOfThreads() * SCAN_TASKS_PER_THREAD, numberOfBlocks / MIN_BLOCKS_PER_SCAN_TASK);
+  if (numberOfRanges <= 1) {
+    ScanAggregate aggregate;
+    scanBlockRange(predicate, 0, numberOfBlocks, aggregate, records);
+    return aggregate;
+  }
+
+  vector<ScanAggregate> partialAggregates(numberOfRanges);
+  vector<vector<Record>> partialRecords(records == nullptr ? 0 : numberOfRanges);
+  TaskGroup blockRanges;
+  for (uint rangeIdx = 0; rangeIdx < numberOfRanges; ++rangeIdx) {
+    uint firstBlock = (unsigned long long) rangeIdx * numberOfBlocks / numberOfRanges;
+    uint endBlock = (unsigned long long) (rangeIdx + 1) * numberOfBlocks / numberOfRanges;
+    vector<Record>* rangeRecords = records == nullptr ? nullptr : &partialRecords[rangeIdx];
+    threadPool.submit([this, &predicate, firstBlock, endBlock, rangeIdx, rangeRecords, &partialAggregates]() {
+      scanBlockRange(predicate, firstBlock, endBlock, partialAggregates[rangeIdx], rangeRecords);
+    }, &blockRanges);
+  }
+  threadPool.waitForGroup(blockRanges);
+
+  // the ranges are merged in block order, so the records come out as a serial scan finds them
+  ScanAggregate aggregate;
+  for (uint rangeIdx = 0; rangeIdx < numberOfRanges; ++rangeIdx) {
+    aggregate.totalRating += partialAggregates[rangeIdx].totalRating;
+    aggregate.totalRecords += partialAggregates[rangeIdx].totalRecords;
+    aggregate.dataBlocksAccessed += partialAggregates[rangeIdx].dataBlocksAccessed;
+    aggregate.dataBlocksSkipped += partialAggregates[rangeIdx].dataBlocksSkipped;
+    if (records != nullptr) {
+      records->insert(records->end(), partialRecords[rangeIdx].begin(), partialRecords[rangeIdx].end());
+    }
+  }
+  return aggregate;
+}
+
+ScanAggregate ScanEngine::runIndexRange(const ScanPredicate& predicate, vector<Record>* records) {
+  ScanAggregate aggregate;
+  for (auto& keyAndOverflowBlock: numVotesIndex->getOverflowBlocksOfRange(predicate.startNumVotes, predicate.endNumVotes)) {
+    set<Block*> visitedBlocks; // a block holding several records of the key appears once per record
+    for (OverflowBlock* overflowBlock = keyAndOverflowBlock.second; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+      for (auto blockPtr: overflowBlock->blockPtrs) {
+        if (!visitedBlocks.insert(blockPtr).second) {
+          continue;
+        }
+        ++aggregate.dataBlocksAccessed;
+        for (auto& record: (*blockPtr).__records) {
+          if (record.__numVotes == keyAndOverflowBlock.first && predicate.matches(record)) {
+            aggregate.totalRating += record.__avgRating;
+            ++aggregate.totalRecords;
+            if (records != nullptr) {
+              records->push_back(record);
+            }
+          }
+        }
+      }
+    }
+  }
+  return aggregate;
+}
+
+ScanAggregate ScanEngine::run(const ScanPredicate& predicate, AccessPath accessPath, vector<Record>* records) {
+  if (accessPath == ACCESS_FULL_SCAN) {
+    return runFullScan(predicate, records);
+  }
+  if (numVotesIndex == nullptr) {
+    cout << "The scan engine has no numVotes index to read the range through." << endl;
+    throw "No numVotes index.";
+  }
+  return runIndexRange(predicate, records);
+}
+
+ScanPlan ScanEngine::plan(const ScanPredicate& predicate) {
+  ScanPlan plan;
+  plan.rangePlan = queryPlanner.planRange(predicate.startNumVotes, predicate.endNumVotes);
+  plan.accessPath = plan.rangePlan.accessPath;
+  if (plan.rangePlan.histogramRecords > 0) {
+    plan.numVotesSelectivity = plan.rangePlan.estimate.numberOfRecords / plan.rangePlan.histogramRecords;
+  }
+
+  // the histogram only knows numVotes, so the rest of the predicate is estimated from a sample
+  uint recordsMatching = 0;
+  uint numberOfBlocks = disk->__blocks.size();
+  uint stride = max(1u, numberOfBlocks / PLANNER_SAMPLE_BLOCKS);
+  for (uint blockIdx = stride / 2; blockIdx < numberOfBlocks; blockIdx += stride) {
+    for (auto& record: disk->__blocks[blockIdx]->__records) {
+      ++plan.sampledRecords;
+      recordsMatching += predicate.matches(record);
+    }
+  }
+  if (plan.sampledRecords > 0) {
+    plan.selectivity = (double) recordsMatching / plan.sampledRecords;
+  }
+  return plan;
+}
+
+ScanAggregate ScanEngine::aggregate(const ScanPredicate& predicate) {
+  return run(predicate, plan(predicate).accessPath, nullptr);
+}
+
+ScanAggregate ScanEngine::aggregate(const ScanPredicate& predicate, AccessPath accessPath) {
+  return run(predicate, accessPath, nullptr);
+}
+
+vector<Record> ScanEngine::select(const ScanPredicate& predicate) {
+  return select(predicate, plan(predicate).accessPath);
+}
+
+vector<Record> ScanEngine::select(const ScanPredicate& predicate, AccessPath accessPath) {
+  vector<Record> records;
+  run(predicate, accessPath, &records);
+  return records;
+}
+
+MovieIdPrefixMatch matchMovieIdPrefix(const MovieIdPrefix& movieIdPrefix, const string& wantedPrefix) {
+  const string& prefix = movieIdPrefix.prefix;
+  if (wantedPrefix.size() <= prefix.size()) {
+    return prefix.compare(0, wantedPrefix.size(), wantedPrefix) == 0 ? PREFIX_MATCHES_ALL : PREFIX_MATCHES_NONE;
+  }
+  // the prefix wanted goes on into the trailing digits, so the prefix must be all of its start
+  if (!movieIdPrefix.hasSuffix || wantedPrefix.size() > prefix.size() + MOVIE_ID_SUFFIX_DIGITS ||
+      wantedPrefix.compare(0, prefix.size(), prefix) != 0) {
+    return PREFIX_MATCHES_NONE;
+  }
+  return PREFIX_MATCHES_SOME;
+}
+
+bool hasMovieIdPrefix(const char* movieId, const string& wantedPrefix) {
+  // a tConst taking all TCONSTSIZE characters has no terminator, so it never starts with a longer prefix
+  return wantedPrefix.size() <= TCONSTSIZE && strncmp(movieId, wantedPrefix.c_str(), wantedPrefix.size()) == 0;
+}
@@ -0,0 +1,290 @@
+#ifndef H_SCANENGINE
+#define H_SCANENGINE
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block.h"
+#include "bplustree.h"
+#include "record.h"
+#include "storage.h"
+#include "threadpool.h"
+#include "queryplanner.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+#define SCAN_BATCH_SIZE 1024 // records compared together, their numVotes and avgRating take 8KB and stay in the L1 cache
+#define SCAN_TASKS_PER_THREAD 4 // block ranges queued per worker, so a worker done early steals the ranges of the others
+#define MIN_BLOCKS_PER_SCAN_TASK 64 // fewer blocks cost more to queue on the pool than to scan on the calling thread
+#define PLANNER_SAMPLE_BLOCKS 128 // blocks spread over the storage whose records the planner reads to estimate selectivity
+
+/**
+ * @brief How many of the tConsts sharing a prefix of a compressed block start with the prefix wanted.
+ * 
+ */
+enum MovieIdPrefixMatch {
+  PREFIX_MATCHES_NONE, // no tConst of the prefix can start with the prefix wanted
+  PREFIX_MATCHES_ALL, // every tConst of the prefix starts with the prefix wanted
+  PREFIX_MATCHES_SOME // the trailing digits of each tConst decide
+};
+
+/**
+ * @brief A conjunction of a range of numVotes, a range of avgRating and a prefix of tConst. Every part
+ * matches every record by default, so a predicate only sets what it filters on.
+ * 
+ */
+struct ScanPredicate {
+  public:
+    int startNumVotes; // smallest numVotes wanted (inclusive)
+    int endNumVotes; // largest numVotes wanted (inclusive)
+    float startAvgRating; // lowest avgRating wanted (inclusive)
+    float endAvgRating; // highest avgRating wanted (inclusive)
+    string movieIdPrefix; // leading characters of the tConsts wanted, empty for every tConst
+
+    /**
+     * @brief Construct a predicate matching every record.
+     * 
+     */
+    ScanPredicate();
+
+    /**
+     * @brief Construct a predicate on numVotes, avgRating and tConst.
+     * 
+     * @param startNumVotes Smallest numVotes wanted (inclusive).
+     * @param endNumVotes Largest numVotes wanted (inclusive).
+     * @param startAvgRating Lowest avgRating wanted (inclusive).
+     * @param endAvgRating Highest avgRating wanted (inclusive).
+     * @param movieIdPrefix Leading characters of the tConsts wanted, empty for every tConst.
+     */
+    ScanPredicate(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating, const string& movieIdPrefix = "");
+
+    /**
+     * @brief Checks a record against every part of the predicate.
+     * 
+     * @param record The record.
+     * @return true If the record matches the predicate.
+     */
+    bool matches(const Record& record) const;
+};
+
+/**
+ * @brief The access path the planner chose for a predicate, with the estimates it chose it by.
+ * 
+ */
+struct ScanPlan {
+  public:
+    AccessPath accessPath; // path the predicate runs through
+    double numVotesSelectivity; // estimated share of the records within the numVotes range, those the index path reads
+    double selectivity; // estimated share of the records matching the whole predicate
+    uint sampledRecords; // records the share matching the whole predicate was estimated from
+    RangePlan rangePlan; // block accesses of the index path and of a full scan over the numVotes range
+
+    /**
+     * @brief Construct a plan scanning every block.
+     * 
+     */
+    ScanPlan() : accessPath(ACCESS_FULL_SCAN), numVotesSelectivity(1.0), selectivity(1.0), sampledRecords(0) {}
+};
+
+/**
+ * @brief The columns of up to SCAN_BATCH_SIZE records of consecutive blocks, laid out as arrays so every
+ * predicate is compared over the whole batch at once, and the positions of the records still matching.
+ * 
+ */
+struct ScanBatch {
+  public:
+    uint numberOfRecords; // records loaded
+    int numVotes[SCAN_BATCH_SIZE]; // numVotes of each record
+    float avgRatings[SCAN_BATCH_SIZE]; // avgRating of each record
+    uint8_t movieIdMatches[SCAN_BATCH_SIZE]; // MovieIdPrefixMatch of the tConst of each record
+    uint8_t isMatching[SCAN_BATCH_SIZE]; // whether each record passed the comparisons
+    uint selection[SCAN_BATCH_SIZE]; // positions in the batch of the records matching the predicate, in increasing order
+    uint numberOfSelected; // records in selection
+    Block* segmentBlocks[SCAN_BATCH_SIZE]; // block of each run of records loaded from the same block
+    uint segmentStarts[SCAN_BATCH_SIZE]; // position in the batch of the first record of each run
+    uint segmentFirstRecords[SCAN_BATCH_SIZE]; // position in its block of the first record of each run
+    uint numberOfSegments; // runs loaded
+
+    /**
+     * @brief Construct an empty Scan Batch object.
+     * 
+     */
+    ScanBatch() : numberOfRecords(0), numberOfSelected(0), numberOfSegments(0) {}
+
+    /**
+     * @brief Finds the run a record of the batch was loaded with, walking forward from the run of the record before.
+     * 
+     * @param index Position of the record in the batch, not before the record of segment.
+     * @param segment Position of a run, moved to the run of the record.
+     * @return uint Position of the record in its block.
+     */
+    uint findRecordInSegment(uint index, uint& segment) const;
+};
+
+/**
+ * @brief Evaluates predicates on numVotes, avgRating and tConst over every block of a storage. Blocks are
+ * read in ranges spread over a thread pool, and each range is evaluated in batches: the columns of a batch are
+ * loaded into arrays, compared 16 records at a time with SSE2 instructions (one record at a time without a
+ * branch where SSE2 is missing), and the records matching are gathered into a selection vector. Only the records selected are read further,
+ * so a tConst is only decoded when its trailing digits decide the prefix. Blocks are skipped by their zone maps,
+ * and compressed blocks by their dictionary of tConst prefixes. The query planner compares the block accesses of
+ * the numVotes range through the numVotes index against those of a full scan, and takes the cheaper path.
+ * The storage and the index must not change during a scan, and it must not run on a task of its thread pool.
+ * 
+ */
+class ScanEngine {
+  private:
+    Storage* disk; // storage scanned
+    NumVotesIndex* numVotesIndex; // index on numVotes of the storage, nullptr if every predicate is scanned
+    ThreadPool& threadPool; // runs the block ranges
+    QueryPlanner queryPlanner; // chooses between the numVotes index and a full scan by their block accesses
+
+    /**
+     * @brief Loads the columns of records of a block into a batch, as many as fit.
+     * 
+     * @param blockPtr The block.
+     * @param isCompressed Whether the block holds its records packed.
+     * @param prefixMatches MovieIdPrefixMatch of every prefix in the dictionary of a compressed block, empty for a block stored as it is.
+     * @param predicate The predicate, its tConst prefix decides the match of a block stored as it is.
+     * @param firstRecord Position of the first record loaded in the block.
+     * @param batch The batch.
+     * @return uint Position after the last record loaded.
+     */
+    uint loadBatch(Block* blockPtr, bool isCompressed, const vector<uint8_t>& prefixMatches, const ScanPredicate& predicate, uint firstRecord,
+                   ScanBatch& batch);
+
+    /**
+     * @brief Compares every record of a batch against the predicate and fills its selection vector.
+     * 
+     * @param predicate The predicate.
+     * @param batch The loaded batch.
+     */
+    void evaluateBatch(const ScanPredicate& predicate, ScanBatch& batch);
+
+    /**
+     * @brief Adds the records selected in a batch to an aggregate, and empties the batch.
+     * 
+     * @param batch The evaluated batch.
+     * @param aggregate The aggregate of the block range.
+     * @param records Filled with the records selected, nullptr to only aggregate them.
+     */
+    void consumeBatch(ScanBatch& batch, ScanAggregate& aggregate, vector<Record>* records);
+
+    /**
+     * @brief Scans a range of blocks batch by batch.
+     * 
+     * @param predicate The predicate.
+     * @param firstBlock Position of the first block of the range in the storage.
+     * @param endBlock Position after the last block of the range.
+     * @param aggregate Set to the aggregate of the records matching.
+     * @param records Filled with the records matching in storage order, nullptr to only aggregate them.
+     */
+    void scanBlockRange(const ScanPredicate& predicate, uint firstBlock, uint endBlock, ScanAggregate& aggregate, vector<Record>* records);
+
+    /**
+     * @brief Scans every block, in ranges spread over the thread pool.
+     * 
+     * @param predicate The predicate.
+     * @param records Filled with the records matching in storage order, nullptr to only aggregate them.
+     * @return ScanAggregate The records matching, with the blocks read and skipped.
+     */
+    ScanAggregate runFullScan(const ScanPredicate& predicate, vector<Record>* records);
+
+    /**
+     * @brief Reads every key of the numVotes range through the index, checking the rest of the predicate
+     * on the records of each block a key points to.
+     * 
+     * @param predicate The predicate.
+     * @param records Filled with the records matching in numVotes order, nullptr to only aggregate them.
+     * @return ScanAggregate The records matching, with the blocks read.
+     */
+    ScanAggregate runIndexRange(const ScanPredicate& predicate, vector<Record>* records);
+
+    /**
+     * @brief Runs a predicate through an access path.
+     * 
+     * @param predicate The predicate.
+     * @param accessPath The access path, ACCESS_INDEX_RANGE needs a numVotes index.
+     * @param records Filled with the records matching, nullptr to only aggregate them.
+     * @return ScanAggregate The records matching, with the blocks read and skipped.
+     */
+    ScanAggregate run(const ScanPredicate& predicate, AccessPath accessPath, vector<Record>* records);
+
+  public:
+    /**
+     * @brief Construct a scan engine over a storage.
+     * 
+     * @param disk The storage to scan.
+     * @param numVotesIndex The numVotes index attached to the storage, nullptr to always scan.
+     * @param threadPool Runs the block ranges, it must outlive the engine.
+     */
+    ScanEngine(Storage* disk, NumVotesIndex* numVotesIndex, ThreadPool& threadPool)
+        : disk(disk), numVotesIndex(numVotesIndex), threadPool(threadPool), queryPlanner(disk, numVotesIndex) {}
+
+    /**
+     * @brief Chooses the access path of a predicate by the block accesses the query planner estimates for its
+     * numVotes range, and estimates the share of the records matching the whole predicate from the records of
+     * PLANNER_SAMPLE_BLOCKS blocks spread over the storage.
+     * 
+     * @param predicate The predicate.
+     * @return ScanPlan The access path chosen with its estimates.
+     */
+    ScanPlan plan(const ScanPredicate& predicate);
+
+    /**
+     * @brief Aggregates avgRating over the records matching a predicate through the access path the planner chooses.
+     * 
+     * @param predicate The predicate.
+     * @return ScanAggregate The records matching, with the blocks read and skipped.
+     */
+    ScanAggregate aggregate(const ScanPredicate& predicate);
+
+    /**
+     * @brief Aggregates avgRating over the records matching a predicate through an access path.
+     * 
+     * @param predicate The predicate.
+     * @param accessPath The access path, ACCESS_INDEX_RANGE needs a numVotes index.
+     * @return ScanAggregate The records matching, with the blocks read and skipped.
+     */
+    ScanAggregate aggregate(const ScanPredicate& predicate, AccessPath accessPath);
+
+    /**
+     * @brief Get the records matching a predicate through the access path the planner chooses.
+     * 
+     * @param predicate The predicate.
+     * @return vector<Record> The records, in storage order when scanned and in numVotes order through the index.
+     */
+    vector<Record> select(const ScanPredicate& predicate);
+
+    /**
+     * @brief Get the records matching a predicate through an access path.
+     * 
+     * @param predicate The predicate.
+     * @param accessPath The access path, ACCESS_INDEX_RANGE needs a numVotes index.
+     * @return vector<Record> The records, in storage order when scanned and in numVotes order through the index.
+     */
+    vector<Record> select(const ScanPredicate& predicate, AccessPath accessPath);
+};
+
+/**
+ * @brief Checks how many tConsts of a prefix in the dictionary of a compressed block start with a prefix.
+ * 
+ * @param movieIdPrefix The prefix in the dictionary.
+ * @param wantedPrefix The leading characters wanted.
+ * @return MovieIdPrefixMatch Whether none, all or some of the tConsts of the prefix match.
+ */
+MovieIdPrefixMatch matchMovieIdPrefix(const MovieIdPrefix& movieIdPrefix, const string& wantedPrefix);
+
+/**
+ * @brief Checks if a tConst starts with a prefix.
+ * 
+ * @param movieId The tConst, TCONSTSIZE characters at most.
+ * @param wantedPrefix The leading characters wanted.
+ * @return true If the tConst starts with the prefix.
+ */
+bool hasMovieIdPrefix(const char* movieId, const string& wantedPrefix);
+
+#endif
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <climits>
+
+#include "shardedindex.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+ShardedIndex::ShardedIndex(vector<int> sampleKeys, uint numberOfShards, uint maxRecordsPerShard, ThreadPool& threadPool, uint blockSize,
+                           uint diskCapacity, uint maxAllowableRecordsInBlock, uint maxKeys, uint maxBlkPtrs)
+    : blockSize(blockSize), diskCapacity(diskCapacity), maxAllowableRecordsInBlock(maxAllowableRecordsInBlock), maxKeys(maxKeys),
+      maxBlkPtrs(maxBlkPtrs), maxRecordsPerShard(maxRecordsPerShard), threadPool(threadPool), runningScans(0) {
+  shards.push_back(unique_ptr<IndexShard>(new IndexShard(INT_MIN, 0, maxRecordsPerShard, blockSize, diskCapacity,
+                                                         maxAllowableRecordsInBlock, maxKeys, maxBlkPtrs)));
+  // every shard starts with as many of the sampled keys, a key repeated across a boundary stays in one shard
+  sort(sampleKeys.begin(), sampleKeys.end());
+  for (uint shard = 1; shard < numberOfShards && !sampleKeys.empty(); ++shard) {
+    int firstKey = sampleKeys[(ull) shard * sampleKeys.size() / numberOfShards];
+    if (firstKey > shards.back()->firstKey) {
+      shards.push_back(unique_ptr<IndexShard>(new IndexShard(firstKey, shards.size(), maxRecordsPerShard, blockSize, diskCapacity,
+                                                             maxAllowableRecordsInBlock, maxKeys, maxBlkPtrs)));
+    }
+  }
+}
+
+uint ShardedIndex::findShardIndex(int key) {
+  // the shard owning a key is the last starting at or before it
+  auto nextShard = upper_bound(shards.begin(), shards.end(), key,
+                               [](int key, const unique_ptr<IndexShard>& shard) { return key < shard->firstKey; });
+  return nextShard - shards.begin() - 1;
+}
+
+IndexShard* ShardedIndex::lockShardOfKey(int key, unique_lock<mutex>& shardLock) {
+  lock_guard<mutex> routingLock(routingMutex);
+  IndexShard* shard = shards[findShardIndex(key)].get();
+  shardLock = unique_lock<mutex>(shard->shardMutex);
+  ++shard->operations;
+  return shard;
+}
+
+void ShardedIndex::splitShardOfKey(int key) {
+  unique_lock<mutex> routingLock(routingMutex);
+  // a range aggregate holds the shards it found, so none may be split under it
+  scansFinished.wait(routingLock, [this]() { return runningScans == 0; });
+  uint shardIdx = findShardIndex(key);
+  IndexShard* shard = shards[shardIdx].get();
+  lock_guard<mutex> shardLock(shard->shardMutex);
+  uint numberOfRecords = shard->disk.getNumberOfRecords();
+  if (numberOfRecords <= shard->splitThreshold) {
+    return; // another insert split it first
+  }
+
+  // the median key is the first with half of the records before it, so a hot key is split off from its neighbours
+  int medianKey = shard->firstKey;
+  uint recordsBefore = 0;
+  for (auto& keyAndOverflowBlock: shard->index.getOverflowBlocksOfRange(INT_MIN, INT_MAX)) {
+    if (recordsBefore > 0 && recordsBefore >= numberOfRecords / 2) {
+      medianKey = keyAndOverflowBlock.first;
+      break;
+    }
+    for (OverflowBlock* overflowBlock = keyAndOverflowBlock.second; overflowBlock != nullptr; overflowBlock = overflowBlock->next) {
+      recordsBefore += overflowBlock->blockPtrs.size();
+    }
+  }
+  if (medianKey == shard->firstKey) {
+    // the records are of a single key that cannot be split, so wait until the shard doubles before trying again
+    shard->splitThreshold = numberOfRecords * 2;
+    return;
+  }
+
+  unique_ptr<IndexShard> newShard(new IndexShard(medianKey, shards.size(), maxRecordsPerShard, blockSize, diskCapacity,
+                                                 maxAllowableRecordsInBlock, maxKeys, maxBlkPtrs));
+  for (auto blockPtr: shard->disk.__blocks) {
+    for (auto& record: blockPtr->__records) {
+      if (record.__numVotes >= medianKey) {
+        newShard->disk.insertRecord(record);
+      }
+    }
+  }
+  shard->disk.deleteRecordsByNumVotesRange(medianKey, INT_MAX);
+  shards.insert(shards.begin() + shardIdx + 1, move(newShard));
+  ++shardSplits;
+}
+
+void ShardedIndex::insertRecord(const Record& record) {
+  bool isShardTooLarge;
+  {
+    unique_lock<mutex> shardLock;
+    IndexShard* shard = lockShardOfKey(record.__numVotes, shardLock);
+    shard->disk.insertRecord(record);
+    isShardTooLarge = shard->disk.getNumberOfRecords() > shard->splitThreshold;
+  }
+  // split without the shard lock, the routing lock is taken first
+  if (isShardTooLarge) {
+    splitShardOfKey(record.__numVotes);
+  }
+}
+
+CachedQueryResult ShardedIndex::getRecordsOfKey(int key) {
+  unique_lock<mutex> shardLock;
+  IndexShard* shard = lockShardOfKey(key, shardLock);
+  return shard->index.getRecordsOfKey(key);
+}
+
+uint ShardedIndex::deleteRecordsByNumVotes(int key) {
+  unique_lock<mutex> shardLock;
+  IndexShard* shard = lockShardOfKey(key, shardLock);
+  return shard->disk.deleteRecordsByNumVotes(key);
+}
+
+IndexAggregate ShardedIndex::rangeQueryAggregate(int startKey, int endKey) {
+  IndexAggregate aggregate;
+  if (endKey < startKey) {
+    return aggregate;
+  }
+  vector<IndexShard*> overlappingShards;
+  {
+    lock_guard<mutex> routingLock(routingMutex);
+    for (uint shardIdx = findShardIndex(startKey); shardIdx < shards.size() && shards[shardIdx]->firstKey <= endKey; ++shardIdx) {
+      overlappingShards.push_back(shards[shardIdx].get());
+    }
+    ++runningScans;
+  }
+
+  vector<IndexAggregate> partialAggregates(overlappingShards.size());
+  TaskGroup shardScans;
+  for (uint i = 0; i < overlappingShards.size(); ++i) {
+    IndexShard* shard = overlappingShards[i];
+    threadPool.submitToWorker(shard->homeWorker, [shard, i, startKey, endKey, &partialAggregates]() {
+      lock_guard<mutex> shardLock(shard->shardMutex);
+      ++shard->operations;
+      partialAggregates[i] = shard->index.rangeQueryAggregate(startKey, endKey);
+    }, &shardScans);
+  }
+  threadPool.waitForGroup(shardScans);
+  {
+    lock_guard<mutex> routingLock(routingMutex);
+    --runningScans;
+  }
+  scansFinished.notify_all();
+
+  for (auto& partialAggregate: partialAggregates) {
+    aggregate.totalRating += partialAggregate.totalRating;
+    aggregate.totalRecords += partialAggregate.totalRecords;
+    aggregate.indexNodesAccessed += partialAggregate.indexNodesAccessed;
+    aggregate.overflowBlocksAccessed += partialAggregate.overflowBlocksAccessed;
+    aggregate.dataBlocksAccessed += partialAggregate.dataBlocksAccessed;
+    aggregate.keysFound += partialAggregate.keysFound;
+  }
+  return aggregate;
+}
+
+uint ShardedIndex::getNumberOfShards() {
+  lock_guard<mutex> routingLock(routingMutex);
+  return shards.size();
+}
+
+uint ShardedIndex::getNumberOfSplits() {
+  return shardSplits;
+}
+
+vector<ShardStatistics> ShardedIndex::getShardStatistics() {
+  vector<ShardStatistics> shardStatistics;
+  lock_guard<mutex> routingLock(routingMutex);
+  for (auto& shard: shards) {
+    lock_guard<mutex> shardLock(shard->shardMutex);
+    ShardStatistics statistics;
+    statistics.firstKey = shard->firstKey;
+    statistics.numberOfRecords = shard->disk.getNumberOfRecords();
+    statistics.numberOfBlocks = shard->disk.getNumberOfBlocksInStorage();
+    statistics.height = shard->index.getTreeHeight();
+    statistics.operations = shard->operations;
+    shardStatistics.push_back(statistics);
+  }
+  return shardStatistics;
+}
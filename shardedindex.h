@@ -0,0 +1,195 @@
+#ifndef H_SHARDEDINDEX
+#define H_SHARDEDINDEX
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "bplustree.h"
+#include "storage.h"
+#include "record.h"
+#include "querycache.h"
+#include "threadpool.h"
+#include "atomiccounter.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief A contiguous range of numVotes with its own storage and numVotes index, so operations on
+ * different shards never share a root, a block or a lock.
+ * 
+ */
+struct IndexShard {
+  public:
+    int firstKey; // smallest numVotes routed to the shard, the range ends before the first key of the next shard
+    uint homeWorker; // worker of the pool the tasks of the shard are queued on
+    uint splitThreshold; // records the shard may hold before it is split, raised when it cannot be split
+    NumVotesIndex index; // numVotes index of the records of the shard
+    Storage disk; // records of the shard, kept in sync with index
+    mutex shardMutex; // serializes the operations on the shard
+    AtomicCounter<ull> operations; // operations routed to the shard
+
+    /**
+     * @brief Construct an empty shard with its storage indexed.
+     * 
+     * @param firstKey Smallest numVotes routed to the shard.
+     * @param homeWorker Worker of the pool the tasks of the shard are queued on.
+     * @param splitThreshold Records the shard may hold before it is split.
+     * @param blockSize Size of the data blocks in bytes(B).
+     * @param diskCapacity Capacity of the storage of the shard.
+     * @param maxAllowableRecordsInBlock Records per data block.
+     * @param maxKeys Keys per node of the index.
+     * @param maxBlkPtrs Block pointers per overflow block of the index.
+     */
+    IndexShard(int firstKey, uint homeWorker, uint splitThreshold, uint blockSize, uint diskCapacity, uint maxAllowableRecordsInBlock,
+               uint maxKeys, uint maxBlkPtrs)
+        : firstKey(firstKey), homeWorker(homeWorker), splitThreshold(splitThreshold), index(maxKeys, maxBlkPtrs),
+          disk(blockSize, diskCapacity, maxAllowableRecordsInBlock) {
+      disk.attachNumVotesIndex(&index);
+    }
+
+    IndexShard(const IndexShard&) = delete;
+    IndexShard& operator=(const IndexShard&) = delete;
+};
+
+/**
+ * @brief What a shard holds and how much of the traffic it took.
+ * 
+ */
+struct ShardStatistics {
+  public:
+    int firstKey; // smallest numVotes routed to the shard
+    uint numberOfRecords; // records stored in the shard
+    uint numberOfBlocks; // data blocks of the shard
+    uint height; // levels of the index of the shard
+    ull operations; // operations routed to the shard
+};
+
+/**
+ * @brief The numVotes key space split into ranges, each with its own storage and B+ Tree, so writers of
+ * different ranges never wait on the same root or lock. Point operations are routed to the shard owning
+ * the key, and range aggregates fan out to the shards the range overlaps on a thread pool, each shard on
+ * the queue of its own worker so it stays in the cache of one core. A shard holding more records than its
+ * threshold is split at its median key into two. Routing, inserts and deletes are safe from any thread,
+ * except from a task of the pool, as a range aggregate waits for the pool.
+ * 
+ */
+class ShardedIndex {
+  private:
+    uint blockSize; // size of the data blocks in bytes(B)
+    uint diskCapacity; // capacity of the storage of each shard
+    uint maxAllowableRecordsInBlock; // records per data block
+    uint maxKeys; // keys per node of the indexes
+    uint maxBlkPtrs; // block pointers per overflow block of the indexes
+    uint maxRecordsPerShard; // records a shard may hold before it is split
+    ThreadPool& threadPool; // runs the range aggregates of the shards
+    vector<unique_ptr<IndexShard>> shards; // ordered by first key, the first starts at INT_MIN
+    mutex routingMutex; // guards shards and runningScans, held while a shard is split
+    condition_variable scansFinished; // wakes a split waiting for the range aggregates to finish
+    uint runningScans; // range aggregates reading the shards, a split waits for none to run
+    AtomicCounter<uint> shardSplits; // shards split since construction
+
+    /**
+     * @brief Finds the shard a key is routed to, with the routing lock held.
+     * 
+     * @param key The numVotes.
+     * @return uint Position of the shard in shards.
+     */
+    uint findShardIndex(int key);
+
+    /**
+     * @brief Finds and locks the shard a key is routed to, so a split cannot move the key away while it is used.
+     * 
+     * @param key The numVotes.
+     * @param shardLock Left holding the lock of the shard.
+     * @return IndexShard* The shard.
+     */
+    IndexShard* lockShardOfKey(int key, unique_lock<mutex>& shardLock);
+
+    /**
+     * @brief Splits the shard a key is routed to at its median key, if it still holds more records than its threshold.
+     * The records from the median key on move to a new shard following it.
+     * 
+     * @param key A numVotes routed to the shard.
+     */
+    void splitShardOfKey(int key);
+
+  public:
+    /**
+     * @brief Construct a sharded index with the key space split where a sample of the keys is split in equal parts.
+     * 
+     * @param sampleKeys numVotes sampled from the records to be inserted, may be empty for a single shard.
+     * @param numberOfShards Shards to start with.
+     * @param maxRecordsPerShard Records a shard may hold before it is split.
+     * @param threadPool Runs the range aggregates of the shards, it must outlive the index.
+     * @param blockSize Size of the data blocks in bytes(B).
+     * @param diskCapacity Capacity of the storage of each shard.
+     * @param maxAllowableRecordsInBlock Records per data block.
+     * @param maxKeys Keys per node of the indexes.
+     * @param maxBlkPtrs Block pointers per overflow block of the indexes.
+     */
+    ShardedIndex(vector<int> sampleKeys, uint numberOfShards, uint maxRecordsPerShard, ThreadPool& threadPool, uint blockSize,
+                 uint diskCapacity, uint maxAllowableRecordsInBlock, uint maxKeys, uint maxBlkPtrs);
+
+    ShardedIndex(const ShardedIndex&) = delete;
+    ShardedIndex& operator=(const ShardedIndex&) = delete;
+
+    /**
+     * @brief Stores and indexes a record in the shard owning its numVotes, then splits the shard if it grew too large.
+     * 
+     * @param record The record to insert.
+     */
+    void insertRecord(const Record& record);
+
+    /**
+     * @brief Get the records of a key from the shard owning it.
+     * 
+     * @param key The numVotes.
+     * @return CachedQueryResult The records with their total rating.
+     */
+    CachedQueryResult getRecordsOfKey(int key);
+
+    /**
+     * @brief Deletes every record of a key from the shard owning it.
+     * 
+     * @param key The numVotes.
+     * @return uint The number of nodes deleted from the index of the shard.
+     */
+    uint deleteRecordsByNumVotes(int key);
+
+    /**
+     * @brief Aggregates avgRating over a range of numVotes, each shard the range overlaps on the worker it belongs to.
+     * 
+     * @param startKey The starting range (inclusive).
+     * @param endKey The ending range (inclusive).
+     * @return IndexAggregate The records, rating and accesses summed over the shards.
+     */
+    IndexAggregate rangeQueryAggregate(int startKey, int endKey);
+
+    /**
+     * @brief Get the number of shards.
+     * 
+     * @return uint The shards, including those made by splits.
+     */
+    uint getNumberOfShards();
+
+    /**
+     * @brief Get the number of shards split.
+     * 
+     * @return uint The splits since construction.
+     */
+    uint getNumberOfSplits();
+
+    /**
+     * @brief Get what every shard holds, in key order.
+     * 
+     * @return vector<ShardStatistics> One entry per shard.
+     */
+    vector<ShardStatistics> getShardStatistics();
+};
+
+#endif
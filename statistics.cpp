@@ -0,0 +1,124 @@
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "statistics.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+
+// function declarations
+string vectorToJson(const vector<uint>& values);
+string mapToJson(const map<uint, uint>& values);
+
+/**
+ * @brief Formats a list of counts as a JSON array.
+ * 
+ * @param values The counts.
+ * @return string The JSON array.
+ */
+string vectorToJson(const vector<uint>& values) {
+  ostringstream json;
+  json << "[";
+  for (uint i = 0; i < values.size(); ++i) {
+    json << (i == 0 ? "" : ",") << values[i];
+  }
+  json << "]";
+  return json.str();
+}
+
+/**
+ * @brief Formats counts keyed by a number as a JSON object, JSON keys being strings.
+ * 
+ * @param values The counts.
+ * @return string The JSON object.
+ */
+string mapToJson(const map<uint, uint>& values) {
+  ostringstream json;
+  json << "{";
+  bool isFirst = true;
+  for (auto& keyAndCount: values) {
+    json << (isFirst ? "" : ",") << "\"" << keyAndCount.first << "\":" << keyAndCount.second;
+    isFirst = false;
+  }
+  json << "}";
+  return json.str();
+}
+
+string SpaceUsage::toJson() const {
+  ostringstream json;
+  json << "{\"blocks\":" << numberOfBlocks << ",\"bytesUsed\":" << bytesUsed
+       << ",\"bytesAllocated\":" << bytesAllocated << ",\"heapBytes\":" << heapBytes << "}";
+  return json.str();
+}
+
+double CacheStatistics::getHitRate() const {
+  return hits + misses == 0 ? 0.0 : (double) hits / (hits + misses);
+}
+
+string CacheStatistics::toJson() const {
+  ostringstream json;
+  json << "{\"hits\":" << hits << ",\"misses\":" << misses << ",\"hitRate\":" << getHitRate()
+       << ",\"invalidations\":" << invalidations << ",\"evictions\":" << evictions << ",\"entries\":" << numberOfEntries
+       << ",\"bytesUsed\":" << bytesUsed << ",\"capacityBytes\":" << capacityBytes << "}";
+  return json.str();
+}
+
+string SnapshotStatistics::toJson() const {
+  ostringstream json;
+  json << "{\"snapshotsTaken\":" << snapshotsTaken << ",\"openSnapshots\":" << openSnapshots
+       << ",\"snapshotsExpired\":" << snapshotsExpired << ",\"changesLogged\":" << changesLogged
+       << ",\"changesReclaimed\":" << changesReclaimed << ",\"changesRetained\":" << changesRetained
+       << ",\"peakChangesRetained\":" << peakChangesRetained << ",\"maxRetainedChanges\":" << maxRetainedChanges
+       << ",\"bytesRetained\":" << bytesRetained << ",\"scanSteps\":" << scanSteps << "}";
+  return json.str();
+}
+
+double LeafFilterStatistics::getFalsePositiveRate() const {
+  unsigned long long absentKeyLookups = negatives + falsePositives;
+  return absentKeyLookups == 0 ? 0.0 : (double) falsePositives / absentKeyLookups;
+}
+
+string LeafFilterStatistics::toJson() const {
+  ostringstream json;
+  json << "{\"bitsPerKey\":" << bitsPerKey << ",\"hashes\":" << numberOfHashes << ",\"filters\":" << numberOfFilters
+       << ",\"filterBytes\":" << filterBytes << ",\"lookups\":" << lookups << ",\"negatives\":" << negatives
+       << ",\"falsePositives\":" << falsePositives << ",\"falsePositiveRate\":" << getFalsePositiveRate() << "}";
+  return json.str();
+}
+
+string EpochStatistics::toJson() const {
+  ostringstream json;
+  json << "{\"globalEpoch\":" << globalEpoch << ",\"threadsRegistered\":" << threadsRegistered
+       << ",\"objectsRetired\":" << objectsRetired << ",\"objectsReclaimed\":" << objectsReclaimed
+       << ",\"objectsPending\":" << objectsPending << "}";
+  return json.str();
+}
+
+string TreeStatistics::toJson() const {
+  ostringstream json;
+  json << "{\"maxKeys\":" << maxKeys
+       << ",\"height\":" << height
+       << ",\"keys\":" << numberOfKeys
+       << ",\"records\":" << numberOfRecords
+       << ",\"bufferedInserts\":" << numberOfBufferedInserts
+       << ",\"nodesPerLevel\":" << vectorToJson(nodesPerLevel)
+       << ",\"leafOccupancy\":" << vectorToJson(leafOccupancy)
+       << ",\"internalOccupancy\":" << vectorToJson(internalOccupancy)
+       << ",\"leafFillFactor\":" << leafFillFactor
+       << ",\"internalFillFactor\":" << internalFillFactor
+       << ",\"overflowChainLengths\":" << mapToJson(overflowChainLengths)
+       << ",\"recordsPerKey\":" << mapToJson(recordsPerKey)
+       << ",\"maxRecordsPerKey\":" << maxRecordsPerKey
+       << ",\"meanRecordsPerKey\":" << meanRecordsPerKey
+       << ",\"topKeysRecordShare\":" << topKeysRecordShare
+       << ",\"nodes\":" << nodes.toJson()
+       << ",\"overflowBlocks\":" << overflowBlocks.toJson()
+       << ",\"queryCache\":" << (hasQueryCache ? queryCache.toJson() : "null")
+       << ",\"snapshots\":" << (hasSnapshots ? snapshots.toJson() : "null")
+       << ",\"leafFilters\":" << (hasLeafFilters ? leafFilters.toJson() : "null")
+       << "}";
+  return json.str();
+}
@@ -0,0 +1,211 @@
+#ifndef H_STATISTICS
+#define H_STATISTICS
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef unsigned int uint;
+
+/**
+ * @brief Space taken by one kind of block, as laid out in the simulated blocks and in memory.
+ * 
+ */
+struct SpaceUsage {
+  public:
+    uint numberOfBlocks; // blocks of this kind
+    unsigned long long bytesUsed; // bytes the contents take in the block layout
+    unsigned long long bytesAllocated; // bytes of the blocks allocated, a block size each
+    unsigned long long heapBytes; // bytes the blocks take in memory, including the spare capacity of their vectors
+
+    /**
+     * @brief Construct an empty Space Usage object.
+     * 
+     */
+    SpaceUsage() : numberOfBlocks(0), bytesUsed(0), bytesAllocated(0), heapBytes(0) {}
+
+    /**
+     * @brief Formats the space usage as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+/**
+ * @brief Counters of a query cache.
+ * 
+ */
+struct CacheStatistics {
+  public:
+    unsigned long long hits; // lookups answered from the cache
+    unsigned long long misses; // lookups not in the cache
+    unsigned long long invalidations; // results dropped because their keys changed
+    unsigned long long evictions; // results dropped to make room
+    uint numberOfEntries; // results cached
+    unsigned long long bytesUsed; // memory the results take
+    unsigned long long capacityBytes; // memory the results may take
+
+    /**
+     * @brief Construct an empty Cache Statistics object.
+     * 
+     */
+    CacheStatistics() : hits(0), misses(0), invalidations(0), evictions(0), numberOfEntries(0), bytesUsed(0), capacityBytes(0) {}
+
+    /**
+     * @brief Get the share of the lookups answered from the cache.
+     * 
+     * @return double Hits over lookups, 0 before the first lookup.
+     */
+    double getHitRate() const;
+
+    /**
+     * @brief Formats the counters as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+/**
+ * @brief Counters of the snapshots of a B+ Tree and of the version log they read through.
+ * 
+ */
+struct SnapshotStatistics {
+  public:
+    unsigned long long snapshotsTaken; // snapshots taken so far
+    uint openSnapshots; // snapshots taken and not yet released, expired ones excluded
+    unsigned long long snapshotsExpired; // snapshots expired to keep the version log within its bound
+    unsigned long long changesLogged; // index changes logged while a snapshot was open
+    unsigned long long changesReclaimed; // logged changes dropped once no open snapshot needed them
+    uint changesRetained; // logged changes kept for the open snapshots
+    uint peakChangesRetained; // most logged changes kept at once
+    uint maxRetainedChanges; // logged changes that may be kept before the oldest snapshots expire
+    unsigned long long bytesRetained; // estimated memory the logged changes kept take
+    unsigned long long scanSteps; // leaves read by snapshot scans, each under the tree lock on its own
+
+    /**
+     * @brief Construct an empty Snapshot Statistics object.
+     * 
+     */
+    SnapshotStatistics() : snapshotsTaken(0), openSnapshots(0), snapshotsExpired(0), changesLogged(0), changesReclaimed(0),
+                           changesRetained(0), peakChangesRetained(0), maxRetainedChanges(0), bytesRetained(0), scanSteps(0) {}
+
+    /**
+     * @brief Formats the counters as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+/**
+ * @brief Counters of the Bloom filters of the leaves of a B+ Tree and of the lookups they answered.
+ * 
+ */
+struct LeafFilterStatistics {
+  public:
+    uint bitsPerKey; // bits of a filter per key a leaf can hold
+    uint numberOfHashes; // bits set per key
+    uint numberOfFilters; // leaves with a filter
+    unsigned long long filterBytes; // memory the filters take
+    unsigned long long lookups; // point lookups that probed the filter of their leaf
+    unsigned long long negatives; // lookups the filter answered without reading the keys of the leaf
+    unsigned long long falsePositives; // lookups the filter let through to a leaf without the key
+
+    /**
+     * @brief Construct an empty Leaf Filter Statistics object.
+     * 
+     */
+    LeafFilterStatistics() : bitsPerKey(0), numberOfHashes(0), numberOfFilters(0), filterBytes(0), lookups(0), negatives(0), falsePositives(0) {}
+
+    /**
+     * @brief Get the share of the lookups of absent keys the filters let through.
+     * 
+     * @return double False positives over the lookups of absent keys, 0 before the first one.
+     */
+    double getFalsePositiveRate() const;
+
+    /**
+     * @brief Formats the counters as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+/**
+ * @brief Objects retired and reclaimed since the program started.
+ * 
+ */
+struct EpochStatistics {
+  public:
+    unsigned long long globalEpoch; // current global epoch
+    uint threadsRegistered; // threads that entered an epoch or retired an object
+    unsigned long long objectsRetired; // nodes, overflow blocks and data blocks retired
+    unsigned long long objectsReclaimed; // retired objects freed
+    unsigned long long objectsPending; // retired objects waiting for the readers that may hold them to exit
+
+    /**
+     * @brief Construct an empty Epoch Statistics object.
+     * 
+     */
+    EpochStatistics() : globalEpoch(0), threadsRegistered(0), objectsRetired(0), objectsReclaimed(0), objectsPending(0) {}
+
+    /**
+     * @brief Formats the counters as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+/**
+ * @brief Shape and occupancy of a B+ Tree, collected by walking every node and overflow block.
+ * 
+ */
+struct TreeStatistics {
+  public:
+    uint maxKeys; // maximum keys in a node
+    uint height; // levels in the tree, leaves included
+    uint numberOfKeys; // distinct keys in the leaves
+    uint numberOfRecords; // records indexed by the keys, buffered inserts excluded
+    uint numberOfBufferedInserts; // inserts waiting in the buffers of internal nodes
+    vector<uint> nodesPerLevel; // nodes at every level, the root level first
+    vector<uint> leafOccupancy; // number of leaves holding each number of keys, 0 to maxKeys
+    vector<uint> internalOccupancy; // number of internal nodes holding each number of keys, 0 to maxKeys
+    double leafFillFactor; // keys in the leaves over the keys the leaves could hold
+    double internalFillFactor; // keys in the internal nodes over the keys they could hold
+    map<uint, uint> overflowChainLengths; // number of keys whose overflow chain has each length
+    map<uint, uint> recordsPerKey; // number of keys per power of two bucket of records, keyed by the lowest count of the bucket
+    uint maxRecordsPerKey; // records of the most duplicated key
+    double meanRecordsPerKey; // records over distinct keys
+    double topKeysRecordShare; // share of the records held by the 1% most duplicated keys
+    SpaceUsage nodes; // tree nodes
+    SpaceUsage overflowBlocks; // overflow blocks of the keys
+    bool hasQueryCache; // whether a query cache is attached to the tree
+    CacheStatistics queryCache; // counters of the query cache, if attached
+    bool hasSnapshots; // whether snapshots are enabled on the tree
+    SnapshotStatistics snapshots; // counters of the snapshots, if enabled
+    bool hasLeafFilters; // whether the leaves of the tree keep Bloom filters
+    LeafFilterStatistics leafFilters; // counters of the leaf filters, if enabled
+
+    /**
+     * @brief Construct an empty Tree Statistics object.
+     * 
+     */
+    TreeStatistics() : maxKeys(0), height(0), numberOfKeys(0), numberOfRecords(0), numberOfBufferedInserts(0),
+                       leafFillFactor(0.0), internalFillFactor(0.0), maxRecordsPerKey(0), meanRecordsPerKey(0.0),
+                       topKeysRecordShare(0.0), hasQueryCache(false), hasSnapshots(false), hasLeafFilters(false) {}
+
+    /**
+     * @brief Formats the statistics as a JSON object.
+     * 
+     * @return string The JSON object.
+     */
+    string toJson() const;
+};
+
+#endif
@@ -1,12 +1,16 @@
+#include <set>
+
 #include "storage.h"
 #include "block.h"
+#include "epoch.h"
 
 using namespace std;
 
 typedef unsigned int uint;
+typedef unsigned long long ull;
 
 uint Storage::getNumberOfBlocksInStorage() {
-    return __blocks.size();
+    return __blockCounter;
 }
 
 bool Storage::hasStorageSpace(uint blockSize, uint diskCapacity) {
@@ -16,6 +20,7 @@ bool Storage::hasStorageSpace(uint blockSize, uint diskCapacity) {
 
 void Storage::addBlockToStorage(Block* blockPtr) {
     __blocks.push_back(blockPtr);
+    ++__blockCounter;
 }
 
 uint Storage::getDatabaseSizeByBlocks(uint blockSize) {
@@ -25,9 +30,262 @@ uint Storage::getDatabaseSizeByBlocks(uint blockSize) {
 
 uint Storage::getDatabaseSizeInTermsOfRecords() {
   uint recordSize = sizeof(Record);
-  uint recordCounter = 0;
-  for (auto blockPtrs: __blocks) { //get all the blocks
-    recordCounter += (*blockPtrs).__records.size(); //dereference block ptr to get actual block then find the sum of all records.
+  return recordSize * __recordCounter;
+}
+
+uint Storage::getNumberOfRecords() {
+  return __recordCounter;
+}
+
+ull Storage::getNumberOfRecordChanges() {
+  return __recordChangeCounter;
+}
+
+SpaceUsage Storage::getBlockSpaceUsage() {
+  SpaceUsage blockSpaceUsage;
+  for (auto blockPtr: __blocks) {
+    ++blockSpaceUsage.numberOfBlocks;
+    blockSpaceUsage.bytesUsed += (*blockPtr).getRecordBytes();
+    blockSpaceUsage.bytesAllocated += __blockSize;
+    blockSpaceUsage.heapBytes += sizeof(Block) + sizeof(Record) * (*blockPtr).__records.capacity();
+  }
+  return blockSpaceUsage;
+}
+
+void Storage::enableBlockCompression() {
+  if (!__blocks.empty()) {
+    cout << "Block compression must be enabled before any record is inserted." << endl;
+    throw "Storage is not empty.";
+  }
+  __isBlockCompressionEnabled = true;
+}
+
+bool Storage::isBlockCompressionEnabled() {
+  return __isBlockCompressionEnabled;
+}
+
+ScanAggregate Storage::scanRecords(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating, bool useZoneMaps) {
+  ScanAggregate aggregate;
+  for (auto blockPtr: __blocks) {
+    if (useZoneMaps && !(*blockPtr).getZoneMap().overlaps(startNumVotes, endNumVotes, startAvgRating, endAvgRating)) {
+      ++aggregate.dataBlocksSkipped;
+      continue;
+    }
+    ++aggregate.dataBlocksAccessed;
+    if ((*blockPtr).isCompressed()) {
+      // the tConsts are never decoded, the predicate and the aggregate only need the other two columns
+      const CompressedRecords& compressedRecords = (*blockPtr).getCompressedRecords();
+      for (uint i = 0; i < compressedRecords.numberOfRecords; ++i) {
+        int numVotes = compressedRecords.decodeNumVotes(i);
+        if (numVotes < startNumVotes || numVotes > endNumVotes) {
+          continue;
+        }
+        float avgRating = compressedRecords.decodeAvgRating(i);
+        if (avgRating >= startAvgRating && avgRating <= endAvgRating) {
+          aggregate.totalRating += avgRating;
+          ++aggregate.totalRecords;
+        }
+      }
+    } else {
+      for (auto& record: (*blockPtr).__records) {
+        if (record.__numVotes >= startNumVotes && record.__numVotes <= endNumVotes && record.__avgRating >= startAvgRating &&
+            record.__avgRating <= endAvgRating) {
+          aggregate.totalRating += record.__avgRating;
+          ++aggregate.totalRecords;
+        }
+      }
+    }
+  }
+  return aggregate;
+}
+
+void Storage::attachNumVotesIndex(NumVotesIndex* index) {
+  __numVotesIndex = index;
+}
+
+void Storage::attachAvgRatingIndex(AvgRatingIndex* index) {
+  __avgRatingIndex = index;
+}
+
+void Storage::attachMovieIdIndex(MovieIdIndex* index) {
+  __movieIdIndex = index;
+}
+
+void Storage::attachVotesRatingIndex(VotesRatingIndex* index) {
+  __votesRatingIndex = index;
+}
+
+Block* Storage::insertRecord(const Record& record) {
+  // reject the record before it reaches a block if the unique index already has this movie
+  if (__movieIdIndex != nullptr && __movieIdIndex->containsKey(MovieIdKey(record.__movieId))) {
+    cout << "A record with movie id " << MovieIdKey(record.__movieId) << " already exists." << endl;
+    return nullptr;
+  }
+
+  if (__blocks.empty() || !(*__blocks.back()).hasSpaceForRecord(record)) {
+    //check if storage has space else just throw exception
+    if (!hasStorageSpace(__blockSize, __diskCapacity)) {
+      cout << "No space please increase disk capacity" << endl;
+      throw "No space in disk.";
+    }
+    addBlockToStorage(new Block(__maxAllowableRecordsInBlock, __isBlockCompressionEnabled ? __blockSize : 0));
+  }
+  Block* blockPtrOfRecord = __blocks.back();
+  (*blockPtrOfRecord).addRecordToBlock(record);
+  ++__recordCounter;
+  ++__recordChangeCounter;
+
+  // covering indexes keep the included columns of the record in their leaves
+  IncludedColumns includedColumns(record);
+  if (__numVotesIndex != nullptr) {
+    __numVotesIndex->insertKey(record.__numVotes, blockPtrOfRecord, includedColumns);
+  }
+  if (__avgRatingIndex != nullptr) {
+    __avgRatingIndex->insertKey(record.__avgRating, blockPtrOfRecord, includedColumns);
+  }
+  if (__movieIdIndex != nullptr) {
+    __movieIdIndex->insertKey(MovieIdKey(record.__movieId), blockPtrOfRecord, includedColumns);
+  }
+  if (__votesRatingIndex != nullptr) {
+    __votesRatingIndex->insertKey(VotesRatingKey(record.__numVotes, record.__avgRating), blockPtrOfRecord, includedColumns);
+  }
+  return blockPtrOfRecord;
+}
+
+void Storage::removeRecordFromIndexes(const Record& record, Block* blockPtr, const void* indexToSkip) {
+  IncludedColumns includedColumns(record);
+  if (__numVotesIndex != nullptr && __numVotesIndex != indexToSkip) {
+    __numVotesIndex->removeBlockPointerFromKey(record.__numVotes, blockPtr, includedColumns);
+  }
+  if (__avgRatingIndex != nullptr && __avgRatingIndex != indexToSkip) {
+    __avgRatingIndex->removeBlockPointerFromKey(record.__avgRating, blockPtr, includedColumns);
   }
-  return recordSize * recordCounter;
-}
\ No newline at end of file
+  if (__movieIdIndex != nullptr && __movieIdIndex != indexToSkip) {
+    __movieIdIndex->removeBlockPointerFromKey(MovieIdKey(record.__movieId), blockPtr, includedColumns);
+  }
+  if (__votesRatingIndex != nullptr && __votesRatingIndex != indexToSkip) {
+    __votesRatingIndex->removeBlockPointerFromKey(VotesRatingKey(record.__numVotes, record.__avgRating), blockPtr, includedColumns);
+  }
+}
+
+template <typename KeyType, typename KeyCompare>
+uint Storage::deleteRecordsThroughIndex(BPlusTree<KeyType, KeyCompare>* index, KeyType key) {
+  if (index == nullptr) {
+    cout << "The index for this column is not attached to storage." << endl;
+    return 0;
+  }
+
+  // before the records are removed from their blocks, un-index them from every other index.
+  set<Block*> visitedBlocks;
+  KeyCompare keyCompare;
+  __recordCounter -= removeMatchingRecordsFromOtherIndexes(index, index->getOverflowBlockOfKey(key), visitedBlocks, [&](const Record& record) {
+    return recordHasKey(record, key, keyCompare);
+  });
+
+  // the driving index deletes the records from the blocks and removes the key
+  return index->deleteRecordByKey(key);
+}
+
+template <typename KeyType, typename KeyCompare, typename RecordFilter>
+uint Storage::removeMatchingRecordsFromOtherIndexes(BPlusTree<KeyType, KeyCompare>* index, OverflowBlock* overflowBlock, set<Block*>& visitedBlocks, RecordFilter recordMatches) {
+  uint matchingRecords = 0;
+  // a block can appear more than once in the overflow chain, so each block is only visited once.
+  while (overflowBlock != nullptr) {
+    for (auto blkPtr: overflowBlock->blockPtrs) {
+      if (!visitedBlocks.insert(blkPtr).second) {
+        continue;
+      }
+      for (auto &record: blkPtr->__records) {
+        if (recordMatches(record)) {
+          removeRecordFromIndexes(record, blkPtr, index);
+          ++matchingRecords;
+        }
+      }
+    }
+    overflowBlock = overflowBlock->next;
+  }
+  __recordChangeCounter += matchingRecords;
+  return matchingRecords;
+}
+
+template <typename KeyType, typename KeyCompare>
+DeleteSummary Storage::deleteRecordRangeThroughIndex(BPlusTree<KeyType, KeyCompare>* index, KeyType startKey, KeyType endKey) {
+  if (index == nullptr) {
+    cout << "The index for this column is not attached to storage." << endl;
+    return DeleteSummary();
+  }
+
+  // every record of a visited block within the range is un-indexed, so blocks are shared across keys
+  set<Block*> visitedBlocks;
+  KeyCompare keyCompare;
+  for (auto& keyAndOverflowBlock: index->getOverflowBlocksOfRange(startKey, endKey)) {
+    __recordCounter -= removeMatchingRecordsFromOtherIndexes(index, keyAndOverflowBlock.second, visitedBlocks, [&](const Record& record) {
+      KeyType recordKey = RecordKey<KeyType>::extract(record);
+      return !keyCompare(recordKey, startKey) && !keyCompare(endKey, recordKey);
+    });
+  }
+
+  DeleteSummary summary = index->deleteRange(startKey, endKey);
+  summary.dataBlocksFreed = releaseEmptyBlocks();
+  return summary;
+}
+
+template <typename KeyType, typename KeyCompare>
+DeleteSummary Storage::deleteRecordBatchThroughIndex(BPlusTree<KeyType, KeyCompare>* index, const vector<KeyType>& keys) {
+  if (index == nullptr) {
+    cout << "The index for this column is not attached to storage." << endl;
+    return DeleteSummary();
+  }
+
+  // a key repeated in the batch must only be un-indexed once
+  KeyCompare keyCompare;
+  set<KeyType, KeyCompare> uniqueKeys(keys.begin(), keys.end(), keyCompare);
+  for (auto& key: uniqueKeys) {
+    set<Block*> visitedBlocks;
+    __recordCounter -= removeMatchingRecordsFromOtherIndexes(index, index->getOverflowBlockOfKey(key), visitedBlocks, [&](const Record& record) {
+      return recordHasKey(record, key, keyCompare);
+    });
+  }
+
+  DeleteSummary summary = index->deleteBatch(keys);
+  summary.dataBlocksFreed = releaseEmptyBlocks();
+  return summary;
+}
+
+uint Storage::deleteRecordsByNumVotes(int numVotes) {
+  return deleteRecordsThroughIndex(__numVotesIndex, numVotes);
+}
+
+uint Storage::deleteRecordsByAvgRating(float avgRating) {
+  return deleteRecordsThroughIndex(__avgRatingIndex, avgRating);
+}
+
+uint Storage::deleteRecordByMovieId(const MovieIdKey& movieId) {
+  return deleteRecordsThroughIndex(__movieIdIndex, movieId);
+}
+
+DeleteSummary Storage::deleteRecordsByNumVotesRange(int startNumVotes, int endNumVotes) {
+  return deleteRecordRangeThroughIndex(__numVotesIndex, startNumVotes, endNumVotes);
+}
+
+DeleteSummary Storage::deleteRecordsByNumVotesBatch(const vector<int>& numVotesBatch) {
+  return deleteRecordBatchThroughIndex(__numVotesIndex, numVotesBatch);
+}
+
+uint Storage::releaseEmptyBlocks() {
+  // no index points to a block without records, so it can be freed
+  uint blocksReleased = 0;
+  vector<Block*> blocksInUse;
+  blocksInUse.reserve(__blocks.size());
+  for (auto blockPtr: __blocks) {
+    if (blockPtr->__records.empty()) {
+      retire(blockPtr); // a reader may still be walking an overflow block that pointed to it
+      ++blocksReleased;
+    } else {
+      blocksInUse.push_back(blockPtr);
+    }
+  }
+  __blocks.swap(blocksInUse);
+  __blockCounter -= blocksReleased;
+  return blocksReleased;
+}
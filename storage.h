@@ -3,27 +3,125 @@
 
 #include <iostream>
 #include <vector>
+#include <set>
 
 #include "block.h"
+#include "bplustree.h"
+#include "indexkey.h"
+#include "statistics.h"
+#include "atomiccounter.h"
 
 using namespace std;
 
 typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief Result of aggregating avgRating over the records of a full scan matching a predicate, with the
+ * data blocks read and skipped by their zone maps.
+ * 
+ */
+struct ScanAggregate {
+  public:
+    double totalRating; // sum of avgRating of the records matching
+    uint totalRecords; // number of records matching
+    uint dataBlocksAccessed; // data blocks whose records were read
+    uint dataBlocksSkipped; // data blocks whose zone map ruled out every record
+
+    /**
+     * @brief Construct an empty Scan Aggregate object.
+     * 
+     */
+    ScanAggregate() : totalRating(0.0), totalRecords(0), dataBlocksAccessed(0), dataBlocksSkipped(0) {}
+};
 
 /**
  * @brief Allocated Storage in the main memory.
  * 
  */
 struct Storage {
+    private:
+        uint __blockSize; // size of every block in storage
+        uint __diskCapacity; // total capacity of memory allocated
+        uint __maxAllowableRecordsInBlock; // records that fit in a single block
+        AtomicCounter<uint> __recordCounter; // records stored, so the size in records is read without scanning the blocks
+        AtomicCounter<uint> __blockCounter; // blocks allocated, safe to read while the blocks change
+        AtomicCounter<ull> __recordChangeCounter; // records inserted and deleted since construction, to tell when statistics of the records went stale
+        bool __isBlockCompressionEnabled; // whether new blocks hold as many records as fit once packed
+
+        // indexes kept in sync with the records in storage, nullptr when the index is not attached
+        NumVotesIndex* __numVotesIndex;
+        AvgRatingIndex* __avgRatingIndex;
+        MovieIdIndex* __movieIdIndex;
+        VotesRatingIndex* __votesRatingIndex;
+
+        /**
+         * @brief Removes a record from every attached index except the one driving the deletion.
+         * 
+         * @param record The record being deleted.
+         * @param blockPtr The block the record is stored in.
+         * @param indexToSkip The index which removes the key itself.
+         */
+        void removeRecordFromIndexes(const Record& record, Block* blockPtr, const void* indexToSkip);
+
+        /**
+         * @brief Deletes all records with a key through one index, and keeps every other index in sync.
+         * 
+         * @param index The index to delete the key from.
+         * @param key The key of the records to delete.
+         * @return uint The number of nodes deleted from the index.
+         */
+        template <typename KeyType, typename KeyCompare>
+        uint deleteRecordsThroughIndex(BPlusTree<KeyType, KeyCompare>* index, KeyType key);
+
+        /**
+         * @brief Removes the records an overflow chain points to from every other index, if they match the filter.
+         * 
+         * @param index The index driving the deletion, which removes the records itself.
+         * @param overflowBlock The head of the overflow chain.
+         * @param visitedBlocks Blocks already searched, a block is only searched once.
+         * @param recordMatches Whether a record of a visited block is being deleted.
+         * @return uint The number of records matching the filter.
+         */
+        template <typename KeyType, typename KeyCompare, typename RecordFilter>
+        uint removeMatchingRecordsFromOtherIndexes(BPlusTree<KeyType, KeyCompare>* index, OverflowBlock* overflowBlock, set<Block*>& visitedBlocks, RecordFilter recordMatches);
+
+        /**
+         * @brief Deletes all records with a key within a range through one index, and keeps every other index in sync.
+         * 
+         * @param index The index to delete the keys from.
+         * @param startKey The starting range (inclusive) of the delete.
+         * @param endKey The ending range (inclusive) of the delete.
+         * @return DeleteSummary What was deleted, with the data blocks released from storage.
+         */
+        template <typename KeyType, typename KeyCompare>
+        DeleteSummary deleteRecordRangeThroughIndex(BPlusTree<KeyType, KeyCompare>* index, KeyType startKey, KeyType endKey);
+
+        /**
+         * @brief Deletes all records with any of the keys through one index, and keeps every other index in sync.
+         * 
+         * @param index The index to delete the keys from.
+         * @param keys The keys of the records to delete.
+         * @return DeleteSummary What was deleted, with the data blocks released from storage.
+         */
+        template <typename KeyType, typename KeyCompare>
+        DeleteSummary deleteRecordBatchThroughIndex(BPlusTree<KeyType, KeyCompare>* index, const vector<KeyType>& keys);
+
     public:
 
         vector<Block*> __blocks; // array storing pointers to block inside storage.
         
         /**
-         * @brief Construct a new Storage object using the default constructor.
+         * @brief Construct a new Storage object.
          * 
+         * @param blockSize User specified block size.
+         * @param diskCapacity The total capacity of memory allocated.
+         * @param maxAllowableRecordsInBlock Maximum records that can be stored in 1 block.
          */
-        Storage() = default;
+        explicit Storage(uint blockSize, uint diskCapacity, uint maxAllowableRecordsInBlock)
+            : __blockSize(blockSize), __diskCapacity(diskCapacity), __maxAllowableRecordsInBlock(maxAllowableRecordsInBlock),
+              __isBlockCompressionEnabled(false), __numVotesIndex(nullptr), __avgRatingIndex(nullptr), __movieIdIndex(nullptr),
+              __votesRatingIndex(nullptr) {}
 
         // Getters
         /**
@@ -65,6 +163,147 @@ struct Storage {
          */
         uint getDatabaseSizeInTermsOfRecords();
 
+        /**
+         * @brief Get the number of records stored, kept up to date by every insert and delete so it is
+         * safe to poll from another thread.
+         * 
+         * @return uint The number of records stored.
+         */
+        uint getNumberOfRecords();
+
+        /**
+         * @brief Get the number of records inserted and deleted so far, safe to poll from another thread.
+         * 
+         * @return ull The records changed since construction.
+         */
+        ull getNumberOfRecordChanges();
+
+        /**
+         * @brief Get the bytes the records take against the bytes of the blocks allocated.
+         * 
+         * @return SpaceUsage The space used by the data blocks.
+         */
+        SpaceUsage getBlockSpaceUsage();
+
+        // compression
+
+        /**
+         * @brief Packs the records of every block allocated afterwards, tConsts by a dictionary of their prefixes,
+         * numVotes and avgRating bit-packed, so a block holds as many records as fit once packed. Must be enabled
+         * before the first record is inserted.
+         * 
+         */
+        void enableBlockCompression();
+
+        /**
+         * @brief Checks if the blocks pack their records.
+         * 
+         * @return true If block compression was enabled.
+         */
+        bool isBlockCompressionEnabled();
+
+        /**
+         * @brief Aggregates avgRating over every record within a range of numVotes and a range of avgRating by
+         * reading the blocks one after another, without any index. Only the numVotes and avgRating of the
+         * records of a compressed block are decoded.
+         * 
+         * @param startNumVotes Smallest numVotes wanted (inclusive).
+         * @param endNumVotes Largest numVotes wanted (inclusive).
+         * @param startAvgRating Lowest avgRating wanted (inclusive).
+         * @param endAvgRating Highest avgRating wanted (inclusive).
+         * @param useZoneMaps Whether to skip the blocks whose zone map rules out every record.
+         * @return ScanAggregate The records matching, with the blocks read and skipped.
+         */
+        ScanAggregate scanRecords(int startNumVotes, int endNumVotes, float startAvgRating, float endAvgRating, bool useZoneMaps);
+
+        // indexes
+
+        /**
+         * @brief Attach the index on numVotes, records inserted or deleted afterwards are kept in sync.
+         * 
+         * @param index The index to attach.
+         */
+        void attachNumVotesIndex(NumVotesIndex* index);
+
+        /**
+         * @brief Attach the index on avgRating, records inserted or deleted afterwards are kept in sync.
+         * 
+         * @param index The index to attach.
+         */
+        void attachAvgRatingIndex(AvgRatingIndex* index);
+
+        /**
+         * @brief Attach the unique index on tConst, records inserted or deleted afterwards are kept in sync.
+         * 
+         * @param index The index to attach.
+         */
+        void attachMovieIdIndex(MovieIdIndex* index);
+
+        /**
+         * @brief Attach the composite index on (numVotes, avgRating), records inserted or deleted afterwards are kept in sync.
+         * 
+         * @param index The index to attach.
+         */
+        void attachVotesRatingIndex(VotesRatingIndex* index);
+
+        /**
+         * @brief Insert a record into the last block with space, allocating a new block if needed,
+         * and insert it into every attached index.
+         * 
+         * @param record The record to insert.
+         * @return Block* The block the record was stored in, nullptr if the movie id is already in the unique index.
+         */
+        Block* insertRecord(const Record& record);
+
+        /**
+         * @brief Delete all records with the given numVotes from the blocks and every attached index.
+         * 
+         * @param numVotes The numVotes of the records to delete.
+         * @return uint The number of nodes deleted from the numVotes index.
+         */
+        uint deleteRecordsByNumVotes(int numVotes);
+
+        /**
+         * @brief Delete all records with the given avgRating from the blocks and every attached index.
+         * 
+         * @param avgRating The avgRating of the records to delete.
+         * @return uint The number of nodes deleted from the avgRating index.
+         */
+        uint deleteRecordsByAvgRating(float avgRating);
+
+        /**
+         * @brief Delete the record with the given tConst from its block and every attached index.
+         * 
+         * @param movieId The tConst of the record to delete.
+         * @return uint The number of nodes deleted from the tConst index.
+         */
+        uint deleteRecordByMovieId(const MovieIdKey& movieId);
+
+        /**
+         * @brief Delete all records with numVotes within the range specified(inclusively), e.g. to purge
+         * every title with fewer than N votes. Blocks left without records are released.
+         * 
+         * @param startNumVotes The starting range (inclusive) of the delete.
+         * @param endNumVotes The ending range (inclusive) of the delete.
+         * @return DeleteSummary The records, tree nodes and data blocks freed.
+         */
+        DeleteSummary deleteRecordsByNumVotesRange(int startNumVotes, int endNumVotes);
+
+        /**
+         * @brief Delete all records with any of the numVotes given. Blocks left without records are released.
+         * 
+         * @param numVotesBatch The numVotes of the records to delete.
+         * @return DeleteSummary The records, tree nodes and data blocks freed.
+         */
+        DeleteSummary deleteRecordsByNumVotesBatch(const vector<int>& numVotesBatch);
+
+        /**
+         * @brief Removes the blocks without records from storage and frees them.
+         * 
+         * @return uint The number of blocks released.
+         */
+        uint releaseEmptyBlocks();
+
 };
 
 #endif   
@@ -0,0 +1,176 @@
+#include <thread>
+
+#include "threadpool.h"
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+thread_local ThreadPool* workerPool = nullptr; // pool the calling thread is a worker of, nullptr outside any pool
+thread_local uint workerQueueIndex = 0; // queue of the calling worker
+
+ThreadPool::ThreadPool(uint numberOfThreads)
+    : nextDelayedTaskId(0), isStopping(false), queuedTasks(0), nextQueue(0), tasksRun(0), tasksStolen(0) {
+  if (numberOfThreads == 0) {
+    numberOfThreads = thread::hardware_concurrency();
+  }
+  // hardware_concurrency is 0 when unknown
+  numberOfThreads = numberOfThreads == 0 ? 1 : numberOfThreads;
+  for (uint i = 0; i < numberOfThreads; ++i) {
+    workerQueues.push_back(unique_ptr<WorkerQueue>(new WorkerQueue()));
+  }
+  // every queue exists before the first worker may steal from it
+  for (uint i = 0; i < numberOfThreads; ++i) {
+    workers.push_back(thread(&ThreadPool::runWorker, this, i));
+  }
+}
+
+void ThreadPool::runWorker(uint workerIndex) {
+  workerPool = this;
+  workerQueueIndex = workerIndex;
+  while (true) {
+    ScheduledTask task;
+    if (takeTask(workerIndex, task)) {
+      runTask(task);
+      continue;
+    }
+
+    unique_lock<mutex> sleepLock(sleepMutex);
+    if (!delayedTasks.empty() && delayedTasks.begin()->first <= chrono::steady_clock::now()) {
+      task = move(delayedTasks.begin()->second.second);
+      delayedTasks.erase(delayedTasks.begin());
+      sleepLock.unlock();
+      runTask(task);
+      continue;
+    }
+    // a task queued after the queues were checked is counted before the submitter takes sleepMutex to wake a worker
+    if (queuedTasks.load() > 0) {
+      continue;
+    } else if (isStopping) {
+      return;
+    } else if (delayedTasks.empty()) {
+      taskAvailable.wait(sleepLock);
+    } else {
+      // copied, as the delayed task may be taken or cancelled while the worker sleeps
+      chrono::steady_clock::time_point dueTime = delayedTasks.begin()->first;
+      taskAvailable.wait_until(sleepLock, dueTime);
+    }
+  }
+}
+
+bool ThreadPool::takeTask(uint workerIndex, ScheduledTask& task) {
+  WorkerQueue& ownQueue = *workerQueues[workerIndex];
+  {
+    lock_guard<mutex> queueLock(ownQueue.queueMutex);
+    if (!ownQueue.tasks.empty()) {
+      task = move(ownQueue.tasks.back());
+      ownQueue.tasks.pop_back();
+      --queuedTasks;
+      return true;
+    }
+  }
+  // start with the next queue, so the workers do not all steal from the first
+  for (uint i = 1; i < workerQueues.size(); ++i) {
+    WorkerQueue& victimQueue = *workerQueues[(workerIndex + i) % workerQueues.size()];
+    lock_guard<mutex> queueLock(victimQueue.queueMutex);
+    if (!victimQueue.tasks.empty()) {
+      task = move(victimQueue.tasks.front());
+      victimQueue.tasks.pop_front();
+      --queuedTasks;
+      tasksStolen.fetch_add(1, memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(ScheduledTask& task) {
+  task.run();
+  tasksRun.fetch_add(1, memory_order_relaxed);
+  if (task.group != nullptr) {
+    lock_guard<mutex> groupLock(task.group->groupMutex);
+    if (--task.group->unfinishedTasks == 0) {
+      task.group->tasksFinished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::submit(function<void()> task, TaskGroup* group) {
+  submitToWorker(workerPool == this ? workerQueueIndex : nextQueue.fetch_add(1, memory_order_relaxed), move(task), group);
+}
+
+void ThreadPool::submitToWorker(uint workerIndex, function<void()> task, TaskGroup* group) {
+  if (group != nullptr) {
+    lock_guard<mutex> groupLock(group->groupMutex);
+    ++group->unfinishedTasks;
+  }
+  uint queueIndex = workerIndex % workerQueues.size();
+  {
+    lock_guard<mutex> queueLock(workerQueues[queueIndex]->queueMutex);
+    workerQueues[queueIndex]->tasks.push_back(ScheduledTask{move(task), group});
+    ++queuedTasks;
+  }
+  {
+    // taken so a worker that found nothing to do cannot miss the wake up before it sleeps
+    lock_guard<mutex> sleepLock(sleepMutex);
+  }
+  taskAvailable.notify_one();
+}
+
+ull ThreadPool::submitAfter(uint delayMs, function<void()> task) {
+  ull delayedTaskId;
+  {
+    lock_guard<mutex> sleepLock(sleepMutex);
+    delayedTaskId = nextDelayedTaskId++;
+    chrono::steady_clock::time_point dueTime = chrono::steady_clock::now() + chrono::milliseconds(delayMs);
+    delayedTasks.insert(make_pair(dueTime, make_pair(delayedTaskId, ScheduledTask{move(task), nullptr})));
+  }
+  // the sleeping workers wait for the delayed task due first, which may now be this one
+  taskAvailable.notify_all();
+  return delayedTaskId;
+}
+
+bool ThreadPool::cancel(ull delayedTaskId) {
+  lock_guard<mutex> sleepLock(sleepMutex);
+  for (auto delayedTask = delayedTasks.begin(); delayedTask != delayedTasks.end(); ++delayedTask) {
+    if (delayedTask->second.first == delayedTaskId) {
+      delayedTasks.erase(delayedTask);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::waitForGroup(TaskGroup& group) {
+  unique_lock<mutex> groupLock(group.groupMutex);
+  group.tasksFinished.wait(groupLock, [&group] { return group.unfinishedTasks == 0; });
+}
+
+uint ThreadPool::getNumberOfThreads() {
+  return workers.size();
+}
+
+uint ThreadPool::getQueueDepth() {
+  return queuedTasks.load(memory_order_relaxed);
+}
+
+ull ThreadPool::getNumberOfTasksRun() {
+  return tasksRun.load(memory_order_relaxed);
+}
+
+ull ThreadPool::getNumberOfSteals() {
+  return tasksStolen.load(memory_order_relaxed);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> sleepLock(sleepMutex);
+    isStopping = true;
+    delayedTasks.clear();
+  }
+  taskAvailable.notify_all();
+  for (auto& worker: workers) {
+    worker.join();
+  }
+}
@@ -0,0 +1,201 @@
+#ifndef H_THREADPOOL
+#define H_THREADPOOL
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef unsigned int uint;
+typedef unsigned long long ull;
+
+/**
+ * @brief Counts the unfinished tasks of one batch submitted to a thread pool, so the batch can be
+ * waited for without waiting on the other tasks of the pool.
+ *
+ */
+class TaskGroup {
+  private:
+    mutex groupMutex; // guards unfinishedTasks
+    condition_variable tasksFinished; // wakes waitForGroup when the last task of the group is done
+    uint unfinishedTasks; // tasks of the group submitted and not yet done
+
+    friend class ThreadPool;
+
+  public:
+    /**
+     * @brief Construct an empty Task Group object.
+     *
+     */
+    TaskGroup() : unfinishedTasks(0) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+};
+
+/**
+ * @brief A task waiting to run, with the group it counts towards.
+ *
+ */
+struct ScheduledTask {
+  public:
+    function<void()> run; // the work
+    TaskGroup* group; // group told when the task is done, nullptr if none
+};
+
+/**
+ * @brief The tasks waiting for one worker. The worker takes the newest task from the back, so
+ * tasks a task submits run while their data is still in its cache, and idle workers steal the
+ * oldest task from the front.
+ *
+ */
+struct WorkerQueue {
+  public:
+    mutex queueMutex; // guards tasks
+    deque<ScheduledTask> tasks; // tasks waiting, oldest first
+};
+
+/**
+ * @brief A work-stealing scheduler with a fixed set of worker threads, each with its own queue of
+ * tasks. Tasks submitted from outside are dealt out to the queues in turn, tasks submitted by a task
+ * go to the queue of its worker, and a worker whose queue is empty steals from the others. Tasks can
+ * also be delayed, to run periodic work such as maintenance without a thread of its own.
+ * Tasks must not throw, and a task must not wait for a group of the pool it runs on.
+ *
+ */
+class ThreadPool {
+  private:
+    vector<unique_ptr<WorkerQueue>> workerQueues; // one queue per worker
+    vector<thread> workers; // threads running the tasks
+    mutex sleepMutex; // guards delayedTasks, nextDelayedTaskId and isStopping, held by workers checking for work before sleeping
+    condition_variable taskAvailable; // wakes idle workers when a task is submitted or the pool stops
+    multimap<chrono::steady_clock::time_point, pair<ull, ScheduledTask>> delayedTasks; // delayed tasks by the time they are due, with their ids
+    ull nextDelayedTaskId; // id of the next delayed task
+    bool isStopping; // tells the workers to return once the queues are empty
+    atomic<uint> queuedTasks; // tasks in the worker queues, delayed tasks not included
+    atomic<uint> nextQueue; // queue the next task submitted from outside the pool goes to
+    atomic<ull> tasksRun; // tasks run so far
+    atomic<ull> tasksStolen; // tasks run by another worker than the one they were queued for
+
+    /**
+     * @brief Runs tasks until the pool stops.
+     *
+     * @param workerIndex Index of the queue of the worker.
+     */
+    void runWorker(uint workerIndex);
+
+    /**
+     * @brief Takes the newest task of a worker's own queue or, if it is empty, steals the oldest task
+     * of another queue.
+     *
+     * @param workerIndex Index of the queue of the worker.
+     * @param task Set to the task taken.
+     * @return true If a task was taken.
+     */
+    bool takeTask(uint workerIndex, ScheduledTask& task);
+
+    /**
+     * @brief Runs a task and tells its group it is done.
+     *
+     * @param task The task to run.
+     */
+    void runTask(ScheduledTask& task);
+
+  public:
+    /**
+     * @brief Construct a new Thread Pool object and start its workers.
+     *
+     * @param numberOfThreads Number of workers, 0 for one per hardware thread.
+     */
+    explicit ThreadPool(uint numberOfThreads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues a task to run on a worker.
+     *
+     * @param task The task to run.
+     * @param group The group the task counts towards, nullptr if it is not waited for.
+     */
+    void submit(function<void()> task, TaskGroup* group = nullptr);
+
+    /**
+     * @brief Queues a task on the queue of one worker, so tasks on the same data run on the same core
+     * while its cache holds the data. Other workers still steal the task when they run out of work.
+     *
+     * @param workerIndex The worker, taken modulo the number of workers.
+     * @param task The task to run.
+     * @param group The group the task counts towards, nullptr if it is not waited for.
+     */
+    void submitToWorker(uint workerIndex, function<void()> task, TaskGroup* group = nullptr);
+
+    /**
+     * @brief Queues a task to run once a delay has passed, as soon as a worker is idle.
+     *
+     * @param delayMs Delay in milliseconds.
+     * @param task The task to run.
+     * @return ull Id of the delayed task, to cancel it.
+     */
+    ull submitAfter(uint delayMs, function<void()> task);
+
+    /**
+     * @brief Cancels a delayed task that has not started yet.
+     *
+     * @param delayedTaskId Id returned when the task was submitted.
+     * @return true If the task was cancelled, false if it already started or ran.
+     */
+    bool cancel(ull delayedTaskId);
+
+    /**
+     * @brief Waits until every task of a group is done.
+     *
+     * @param group The group to wait for.
+     */
+    void waitForGroup(TaskGroup& group);
+
+    /**
+     * @brief Get the number of worker threads.
+     *
+     * @return uint The number of workers.
+     */
+    uint getNumberOfThreads();
+
+    /**
+     * @brief Get the number of tasks waiting in the worker queues. Safe to poll from any thread.
+     *
+     * @return uint Tasks waiting to run, delayed tasks not included.
+     */
+    uint getQueueDepth();
+
+    /**
+     * @brief Get the number of tasks run so far. Safe to poll from any thread.
+     *
+     * @return ull Tasks run.
+     */
+    ull getNumberOfTasksRun();
+
+    /**
+     * @brief Get the number of tasks a worker stole from the queue of another. Safe to poll from any thread.
+     *
+     * @return ull Tasks stolen.
+     */
+    ull getNumberOfSteals();
+
+    /**
+     * @brief Destroy the Thread Pool object, running the tasks still queued, dropping the delayed
+     * tasks not yet due and joining the workers.
+     *
+     */
+    ~ThreadPool();
+};
+
+#endif